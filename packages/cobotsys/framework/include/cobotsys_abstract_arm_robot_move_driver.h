@@ -22,6 +22,19 @@ enum class MoveResult {
     Cancled,
 };
 
+/**
+ * @brief 路点过渡区信息
+ *
+ * 当相邻的两个路点都允许过渡(RobotWaypoint::blendRadius > 0)时，机器人不会在路点处停止，
+ * 而是沿圆弧从路点附近平滑通过。这里描述的是实际使用的过渡区。
+ */
+struct MoveBlendRegion {
+    bool blended = false;        ///< true 表示经过过渡区通过该路点，false 表示在该路点停止
+    double radius = 0;           ///< 实际使用的过渡半径(米)，可能因路径过短而小于请求值
+    double enterDistance = 0;    ///< 过渡区起点到路点的直线距离(米)
+    double exitDistance = 0;     ///< 路点到过渡区终点的直线距离(米)
+};
+
 class ArmRobotMoveStatusObserver {
 public:
     ArmRobotMoveStatusObserver();
@@ -32,17 +45,59 @@ public:
      * @param moveId
      */
     virtual void onMoveFinish(uint32_t moveId, MoveResult moveResult) = 0;
+
+    /**
+     * 带过渡区信息的完成回调，默认实现直接转发到 onMoveFinish(moveId, moveResult)。
+     * 对于过渡通过的路点，回调发生在机器人经过过渡圆弧中点(离路点最近处)时。
+     * 不与 onMoveFinish 重载，子类只重写 onMoveFinish 时不会隐藏这个函数。
+     * @param moveId
+     * @param moveResult
+     * @param blendRegion 过渡区信息
+     */
+    virtual void onMoveBlendFinish(uint32_t moveId, MoveResult moveResult, const MoveBlendRegion& blendRegion);
 };
 }
 
 
 namespace cobotsys {
 
+/**
+ * @brief 路点上的 IO 动作
+ *
+ * 机器人向该路点运动的过程中越过触发位置时，由 Mover 在伺服周期里直接设置 IO，
+ * 不需要在路点停下来等 onMoveFinish() 再操作，比如吸盘接触前提前开真空、运动中途释放。
+ * 触发位置在规划时换算成采样点，目标被取消时未触发的动作不再执行。
+ */
+struct MoveIoEvent {
+    enum Trigger {
+        PathParameter,  ///< value 为到该路点这一段路径的比例，0 为上一个路点，1 为该路点
+        DistanceToGoal, ///< value 为 TCP 到该路点的直线距离(米)，距离小于等于 value 时触发
+    };
+
+    Trigger trigger;
+    double value;
+    DigitIoPorts ioPorts;
+    DigitIoStatus ioStatus;
+    std::shared_ptr<AbstractDigitIoDriver> ioDriver; ///< 为空时使用实时驱动的 getDigitIoDriver()
+
+    static MoveIoEvent atPathParameter(double s, DigitIoPorts ports, DigitIoStatus status,
+                                       const std::shared_ptr<AbstractDigitIoDriver>& driver = nullptr) {
+        return {PathParameter, s, ports, status, driver};
+    }
+
+    static MoveIoEvent atDistanceToGoal(double distance, DigitIoPorts ports, DigitIoStatus status,
+                                        const std::shared_ptr<AbstractDigitIoDriver>& driver = nullptr) {
+        return {DistanceToGoal, distance, ports, status, driver};
+    }
+};
+
 struct RobotWaypoint {
     uint32_t moveId;
     double desireVelocity;
     cv::Point3d position;
     cv::Vec3d rpy;
+    double blendRadius = 0; ///< 过渡半径(米)，0表示在该点停止；大于0表示与下一个路点平滑过渡
+    std::vector<MoveIoEvent> ioEvents; ///< 运动到该路点过程中触发的 IO 动作
 
     std::vector<double> toArray() const {
         return {
@@ -55,6 +110,7 @@ struct RobotWaypoint {
         RobotWaypoint robotWaypoint;
         robotWaypoint.moveId = 0;
         robotWaypoint.desireVelocity = vel;
+        robotWaypoint.blendRadius = 0;
         if (posi.size() >= 6) {
             robotWaypoint.position = {posi[0], posi[1], posi[2]};
             robotWaypoint.rpy = {posi[3], posi[4], posi[5]};
@@ -87,7 +143,8 @@ public:
     /**
      *
      * @param[in] moveId 本次移动的ID，由 generateMoveId() 生成。
-     * @param[in] waypoints 一次性的给出关键点。然后规划路径
+     * @param[in] waypoints 一次性的给出关键点。然后规划路径。
+     *            连续的 blendRadius > 0 的路点之间不停止，按过渡半径平滑通过。
      * @retval true 目标位置可以到达
      * @retval false 目标位置不可到达
      */
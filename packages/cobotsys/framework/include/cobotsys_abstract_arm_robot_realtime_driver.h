@@ -7,6 +7,7 @@
 #define PROJECT_COBOTSYS_ABSTRACT_ARM_ROBOT_REALTIME_DRIVER_H
 
 #include <vector>
+#include <chrono>
 #include <cobotsys.h>
 #include <cobotsys_abstract_object.h>
 #include <cobotsys_abstract_digit_io_driver.h>
@@ -32,6 +33,8 @@ struct ArmRobotStatus {
     std::vector<double> q_actual; ///< actual joint position
     std::vector<double> qd_actual; ///< actual joint velocity
     std::vector<double> qdd_actual; ///< acutal joint acceleration
+
+    std::chrono::steady_clock::time_point timestamp; ///< 状态采样时间(单调时钟)，与 Wrench::time 使用同一个时钟
 };
 
 typedef std::shared_ptr<ArmRobotStatus> ArmRobotStatusPtr; ///<  ArmRobotStatus 智能指针
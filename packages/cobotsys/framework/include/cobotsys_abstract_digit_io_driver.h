@@ -8,6 +8,8 @@
 
 
 #include <QFlags>
+#include <chrono>
+#include <memory>
 #include "cobotsys_abstract_object.h"
 
 namespace cobotsys {
@@ -43,6 +45,36 @@ enum class DigitIoPort {
 
 Q_DECLARE_FLAGS(DigitIoPorts, DigitIoPort);
 
+enum class DigitIoEdge {
+    Rising = 0,  ///< Reset -> Set
+    Falling = 1, ///< Set -> Reset
+};
+
+/**
+ * @brief 输入口的一次电平跳变
+ */
+struct DigitIoEvent {
+    DigitIoPort port;
+    DigitIoEdge edge;
+    std::chrono::steady_clock::time_point timestamp; ///< 发现跳变的状态包的接收时间，与 ArmRobotStatus::timestamp 同一个时钟
+};
+
+/**
+ * 输入口跳变的观察者
+ */
+class DigitIoObserver {
+public:
+    DigitIoObserver();
+    virtual ~DigitIoObserver();
+
+    /**
+     * 在驱动解析状态包的线程里回调，同一个状态包里的多个跳变按端口顺序通知。
+     * 回调里不能阻塞，也不要调用机器人驱动的接口，只记录状态，交给控制线程处理。
+     * @param event
+     */
+    virtual void onDigitIoEdge(const DigitIoEvent& event) = 0;
+};
+
 class AbstractDigitIoDriver : public AbstractObject {
 public:
     AbstractDigitIoDriver();
@@ -68,6 +100,16 @@ public:
     virtual bool isDigitOutput() const = 0;
 
     virtual bool setToolVoltage(double v) = 0;
+
+    /**
+     * 注册输入口跳变的观察者，驱动每收到一个状态包就检查一次输入口，有跳变时通知所有观察者，
+     * 使用者不需要再轮询 getIoStatus()。
+     * 连接后的第一个状态包里已经是 Set 的端口会通知一次 Rising，断开连接时 Set 的端口会通知 Falling。
+     * @retval false 驱动不支持跳变通知，只能轮询 getIoStatus()
+     */
+    virtual bool attach(const std::shared_ptr<DigitIoObserver>& observer);
+
+    virtual void detach(const std::shared_ptr<DigitIoObserver>& observer);
 };
 }
 
@@ -11,6 +11,7 @@
 #include <vector>
 #include <chrono>
 #include "cobotsys_data_types.h"
+#include "cobotsys_lockfree_ring.h"
 
 
 namespace cobotsys {
@@ -34,6 +35,12 @@ public:
     virtual void onForceSensorDataStreamUpdate(const std::shared_ptr<Wrench>& ptrWrench) = 0;
 };
 
+/**
+ * 力传感器采样历史，传感器的接收线程是唯一的写者，消费者各自无锁读取最新样本或者一段历史。
+ * 按 1kHz 计算可以保存约 1 秒的数据。
+ */
+typedef LockFreeRing<WrenchSample, 1024> WrenchRing;
+
 class AbstractForceSensor : public AbstractObject {
 public:
 	AbstractForceSensor();
@@ -43,6 +50,13 @@ public:
     virtual void stop() = 0;
     virtual void attach(const std::shared_ptr<ForceSensorStreamObserver>& observer) = 0;
 
+	/**
+	 * 带时间戳和序号的采样历史。
+	 * onForceSensorDataStreamUpdate() 只给出最新值，处理得比传感器慢的消费者可以用
+	 * WrenchRing::readSince() 取得全部样本，并根据序号知道漏掉了多少。
+	 * @return 不支持时为空
+	 */
+	virtual std::shared_ptr<const WrenchRing> getWrenchRing() const;
 };
 
 /**
@@ -11,6 +11,7 @@
 #include "cobotsys_abstract_object.h"
 #include "cobotsys_abstract_kinematic_solver.h"
 #include "cobotsys_data_types.h"
+#include "cobotsys_force_control_recorder.h"
 
 namespace cobotsys {
 
@@ -25,6 +26,26 @@ namespace cobotsys {
  * @{
  */
 
+/**
+ * @brief 力数据和机器人状态的时间对齐统计
+ *
+ * 时间偏差 = 力采样时间 - 当时最新的机器人状态时间，单位秒。
+ * 正值表示力数据比机器人状态新。
+ * 使用固定周期的控制内环时，另外统计内环的运行情况。
+ */
+struct ForceControlTimingStatistics {
+    uint64_t samples = 0;      ///< 参与统计的力样本数
+    uint64_t interpolated = 0; ///< 在两帧机器人状态之间插值的样本数
+    uint64_t extrapolated = 0; ///< 比最新机器人状态新，按关节速度外推的样本数
+    uint64_t unaligned = 0;    ///< 缺少时间戳或者历史不够，直接使用最新关节角的样本数
+    double lastSkew = 0;       ///< 最近一次的时间偏差
+    double meanSkew = 0;       ///< 时间偏差平均值
+    double maxAbsSkew = 0;     ///< 时间偏差绝对值的最大值
+    uint64_t controlTicks = 0; ///< 控制内环运行次数
+    uint64_t heldTicks = 0;    ///< 内环周期内没有新的力样本的次数
+    uint64_t skippedTicks = 0; ///< 力数据中断太久而丢弃的内环节拍数
+};
+
 class AbstractForceControlSolver : public AbstractObject {
 public:
 	AbstractForceControlSolver();
@@ -49,8 +70,19 @@ public:
 
 	void setKinematicSolver(const std::shared_ptr<AbstractKinematicSolver>& kinSolver) { m_ptrKinematicSolver = kinSolver; }
 
+	/**
+	 * 设置信号记录器，求解器每个力样本写一条 SOURCE_SENSOR 记录，为空时不记录
+	 */
+	void setRecorder(const std::shared_ptr<ForceControlRecorder>& recorder) { m_ptrRecorder = recorder; }
+
+	/**
+	 * 力数据和机器人状态的时间对齐统计，不支持时全部为 0
+	 */
+	virtual ForceControlTimingStatistics getTimingStatistics() const;
+
 protected:
 	std::shared_ptr<AbstractKinematicSolver> m_ptrKinematicSolver;
+	std::shared_ptr<ForceControlRecorder> m_ptrRecorder;
 };
 /**
  * @}
@@ -6,7 +6,9 @@
 #ifndef COBOTSYS_COBOTSYS_ABSTRACT_KINEMATIC_SOLVER_H
 #define COBOTSYS_COBOTSYS_ABSTRACT_KINEMATIC_SOLVER_H
 
+#include <cstdint>
 #include <vector>
+#include <memory>
 #include "cobotsys_abstract_object.h"
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -17,11 +19,47 @@ namespace cobotsys {
  * @addtogroup framework
  * @{
  */
+
+/**
+ * 运动学求解器。
+ *
+ * 求解器对象同一时间只能在一个线程里使用(迭代求解器内部有中间状态)。
+ * 多个线程需要同一个模型时，每个线程用 createThreadContext() 取得自己的上下文，不需要加锁。
+ */
 class AbstractKinematicSolver : public AbstractObject {
+public:
+	typedef Eigen::Matrix<double, 6, 1> Joint6d; ///< 6 轴机械臂的关节角，定长，不分配内存
+	typedef Eigen::Matrix<double, 6, 1> Twist6d; ///< 末端速度 [vx, vy, vz, wx, wy, wz]，相对于基坐标
+	typedef Eigen::Matrix<double, 6, 6> Jacobian6d;
+
+	/**
+	 * 由雅可比矩阵奇异值得到的可操作度指标。线速度(米)和角速度(弧度)混在一起，只适合同一台机器人内比较。
+	 */
+	struct Manipulability {
+		double measure = 0;          ///< Yoshikawa 可操作度 sqrt(det(J * J^T))，奇异时为 0
+		double conditionNumber = 0;  ///< 最大奇异值 / 最小奇异值，奇异时为无穷大
+		double minSingularValue = 0; ///< 最小奇异值，越小越接近奇异位形
+	};
+
 public:
 	AbstractKinematicSolver();
     virtual ~AbstractKinematicSolver();
 
+	/**
+	 * 创建一个与本对象共享模型(setup() 读入的运动链、限位等只读数据)的求解器上下文，
+	 * 只带自己的求解中间状态，创建开销很小，供另一个线程独立使用。
+	 * 之后本对象重新 setup() 不影响已经创建的上下文。
+	 * 默认实现不支持，返回空指针，调用者需要自己保证单线程使用。
+	 */
+	virtual std::shared_ptr<AbstractKinematicSolver> createThreadContext();
+
+	/**
+	 * 模型版本号。每次 setup() 换了模型都会变(全局递增，不同对象之间也不重复)，
+	 * createThreadContext() 得到的上下文与本对象版本号相同。缓存了逆解结果的调用者用它判断模型是否变了。
+	 * 默认实现返回 0，表示不提供版本号。
+	 */
+	virtual uint64_t modelGeneration() const;
+
     /**
      * 用于逆运动求解计算，模型文件设置通过 setup() 来指定。
      * @param[in] initialJoint 当前机器人的状态(关节角)
@@ -32,6 +70,36 @@ public:
 	virtual int cartToJnt(const Eigen::VectorXd& initialJoint, const Eigen::Affine3d& targetPos, Eigen::VectorXd& targetJoint)=0;
 	virtual int cartToJnt(const std::vector<double>& initialJoint, const std::vector<double>& targetPos, std::vector<double>& targetJoint)=0;
 	virtual int cartToJnt(const Eigen::VectorXd& initialJoint, const std::vector<double>& targetPos, std::vector<double>& targetJoint) = 0;
+
+	/**
+	 * 求目标位姿的所有逆解构型(比如 UR 解析解的最多 8 组)，关节角在限位内。
+	 * 默认实现不支持，返回 -1。
+	 * @param[in] targetPos 目标机器人的末端坐标(相对于基坐标)
+	 * @param[out] solutions 所有逆解
+	 * @retval 0 至少有一组解，其余为错误码
+	 */
+	virtual int cartToJntAll(const std::vector<double>& targetPos, std::vector<std::vector<double> >& solutions);
+
+	/**
+	 * 6 轴机械臂的定长类型逆解，实现应当不分配内存，适合大量调用。
+	 * 默认实现转换为 Eigen::VectorXd / Eigen::Affine3d 后调用 cartToJnt()。
+	 * @param[in] initialJoint 初始关节角
+	 * @param[in] targetPos 目标末端位姿(相对于基坐标)
+	 * @param[out] targetJoint 求解结果，失败时不修改
+	 * @retval 0 求解成功，其余为错误码
+	 */
+	virtual int cartToJnt(const Joint6d& initialJoint, const Eigen::Isometry3d& targetPos, Joint6d& targetJoint);
+
+	/**
+	 * 批量逆解。targetPoses 与 targetJoints 都是连续存放的 count 个元素。
+	 * @param[in] initialJoint 第一个位姿的初始关节角
+	 * @param[in] chainSeed true 时每个位姿用上一个成功的结果作初始关节角(连续路径)，
+	 *            false 时都用 initialJoint(互相独立的候选位姿)
+	 * @param[out] results 可以为空，每个位姿的错误码
+	 * @return 失败的位姿个数，0 表示全部成功
+	 */
+	virtual int cartToJntBatch(const Joint6d& initialJoint, const Eigen::Isometry3d* targetPoses, size_t count,
+	                           Joint6d* targetJoints, int* results = nullptr, bool chainSeed = true);
 	
 	/**
 	* 用于正向运动求解计算，模型文件设置通过 setup() 来指定。
@@ -42,6 +110,60 @@ public:
 	virtual int jntToCart(const Eigen::VectorXd& targetJoint, Eigen::Affine3d& targetPos)=0;
 	virtual int jntToCart(const std::vector<double>& targetJoint, std::vector<double>& targetPos)=0;
 
+	/**
+	 * 6 轴机械臂的定长类型正解，实现应当不分配内存。
+	 * 默认实现转换为 Eigen::VectorXd / Eigen::Affine3d 后调用 jntToCart()。
+	 */
+	virtual int jntToCart(const Joint6d& targetJoint, Eigen::Isometry3d& targetPos);
+
+	/**
+	 * 正解，姿态用单位四元数输出，不做 RPY 转换。
+	 * 默认实现调用 Isometry3d 版本后转换。
+	 */
+	virtual int jntToCart(const Joint6d& targetJoint, Eigen::Vector3d& position, Eigen::Quaterniond& orientation);
+
+	/**
+	 * 批量正解。targetJoints 与 targetPoses 都是连续存放的 count 个元素。
+	 * @return 失败的个数，0 表示全部成功
+	 */
+	virtual int jntToCartBatch(const Joint6d* targetJoints, size_t count, Eigen::Isometry3d* targetPoses);
+
+	/**
+	 * 雅可比矩阵，6 x 关节数。前三行线速度、后三行角速度，参考点为末端执行器原点，表示在基坐标系下。
+	 * 默认实现不支持，返回 -1。
+	 * @param[in] joint 机器人的状态(关节角)
+	 * @param[out] jac 雅可比矩阵
+	 * @retval 0 求解成功，其余为错误码
+	 */
+	virtual int jacobian(const Eigen::VectorXd& joint, Eigen::MatrixXd& jac);
+
+	/**
+	 * 6 轴机械臂的定长版本，实现应当不分配内存。默认实现转换后调用上面的版本。
+	 */
+	virtual int jacobian(const Joint6d& joint, Jacobian6d& jac);
+
+	/**
+	 * 阻尼最小二乘法把末端速度换算成关节速度：jointVel = J^T (J J^T + lambda^2 I)^-1 cartVel。
+	 * 最小奇异值低于 singularThreshold 时阻尼从 0 逐渐增大到 maxDamping，
+	 * 接近奇异位形时关节速度保持有界，代价是末端速度的跟踪误差。
+	 * 用 jacobian() 计算，定长版本不分配内存。
+	 * @param[in] joint 机器人的状态(关节角)
+	 * @param[in] cartVel 末端速度(也可以是一个小的位姿增量)
+	 * @param[out] jointVel 关节速度
+	 * @param[out] quality 可以为空，同时返回当前位形的可操作度
+	 * @retval 0 求解成功，其余为错误码
+	 */
+	virtual int cartVelToJntVel(const Joint6d& joint, const Twist6d& cartVel, Joint6d& jointVel,
+	                            double singularThreshold = 0.05, double maxDamping = 0.05, Manipulability* quality = nullptr);
+	virtual int cartVelToJntVel(const Eigen::VectorXd& joint, const Twist6d& cartVel, Eigen::VectorXd& jointVel,
+	                            double singularThreshold = 0.05, double maxDamping = 0.05, Manipulability* quality = nullptr);
+
+	/**
+	 * 可操作度、条件数和最小奇异值，用 jacobian() 计算。
+	 * @retval 0 求解成功，其余为错误码
+	 */
+	virtual int manipulability(const Eigen::VectorXd& joint, Manipulability& quality);
+
 	/**
 	* 用于将世界坐标系中的3维向量转化为机器人末端坐标系中的3维向量。
 	* @param[in] jointArray 机器人的状态(关节角)
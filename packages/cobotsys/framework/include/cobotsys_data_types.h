@@ -85,6 +85,36 @@ struct BinObjGrabPose {
 struct Wrench {
     cv::Point3d force;
     cv::Point3d torque;
+    std::chrono::steady_clock::time_point time; ///< 采样时间(单调时钟)，为 0 表示驱动没有提供时间戳
+};
+
+/**
+ * @brief 带时间戳的六维力采样，用于 WrenchRing 历史缓冲
+ *
+ * 只包含简单类型，可以按字节复制。
+ */
+struct WrenchSample {
+    uint64_t sequence; ///< 样本序号，从 1 开始连续递增
+    std::chrono::steady_clock::time_point time; ///< 采样时间(单调时钟)
+    double force[3];
+    double torque[3];
+
+    Wrench toWrench() const {
+        Wrench wrench;
+        wrench.force = cv::Point3d(force[0], force[1], force[2]);
+        wrench.torque = cv::Point3d(torque[0], torque[1], torque[2]);
+        wrench.time = time;
+        return wrench;
+    }
+
+    void setWrench(const Wrench& wrench) {
+        force[0] = wrench.force.x;
+        force[1] = wrench.force.y;
+        force[2] = wrench.force.z;
+        torque[0] = wrench.torque.x;
+        torque[1] = wrench.torque.y;
+        torque[2] = wrench.torque.z;
+    }
 };
 
 
@@ -13,6 +13,11 @@ ArmRobotMoveStatusObserver::ArmRobotMoveStatusObserver() {
 
 ArmRobotMoveStatusObserver::~ArmRobotMoveStatusObserver() {
 }
+
+void ArmRobotMoveStatusObserver::onMoveBlendFinish(uint32_t moveId, MoveResult moveResult,
+                                                   const MoveBlendRegion& blendRegion) {
+    onMoveFinish(moveId, moveResult);
+}
 }
 
 namespace cobotsys {
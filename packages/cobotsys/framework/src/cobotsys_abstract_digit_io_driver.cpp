@@ -12,4 +12,17 @@ AbstractDigitIoDriver::AbstractDigitIoDriver() {
 
 AbstractDigitIoDriver::~AbstractDigitIoDriver() {
 }
+
+bool AbstractDigitIoDriver::attach(const std::shared_ptr<DigitIoObserver>& observer) {
+    return false;
+}
+
+void AbstractDigitIoDriver::detach(const std::shared_ptr<DigitIoObserver>& observer) {
+}
+
+DigitIoObserver::DigitIoObserver() {
+}
+
+DigitIoObserver::~DigitIoObserver() {
+}
 }
\ No newline at end of file
@@ -14,6 +14,10 @@ namespace cobotsys {
     INFO_DESTRUCTOR(this);
 }
 
+std::shared_ptr<const WrenchRing> AbstractForceSensor::getWrenchRing() const {
+	return nullptr;
+}
+
 ForceSensorStreamObserver::ForceSensorStreamObserver() {
 }
 
@@ -12,4 +12,8 @@ namespace cobotsys {
 
 	AbstractForceControlSolver::~AbstractForceControlSolver() {
 }
+
+	ForceControlTimingStatistics AbstractForceControlSolver::getTimingStatistics() const {
+		return ForceControlTimingStatistics();
+	}
 }
\ No newline at end of file
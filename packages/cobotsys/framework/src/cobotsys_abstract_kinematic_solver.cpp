@@ -4,7 +4,54 @@
 //
 
 #include "cobotsys_abstract_kinematic_solver.h"
+#include <Eigen/SVD>
+#include <limits>
 
+namespace {
+typedef cobotsys::AbstractKinematicSolver::Manipulability Manipulability;
+
+/**
+ * 奇异值从大到小排列。关节数少于 6 时末端总有不能运动的方向，按奇异处理。
+ */
+template<typename VectorType>
+void fillManipulability(const VectorType& sigma, Manipulability& quality) {
+	double sigmaMin = sigma.size() == 6 ? sigma[5] : 0;
+	quality.measure = sigma.size() == 6 ? sigma.prod() : 0;
+	quality.minSingularValue = sigmaMin;
+	quality.conditionNumber = sigmaMin > 0 ? sigma[0] / sigmaMin : std::numeric_limits<double>::infinity();
+}
+
+/**
+ * 由奇异值分解求阻尼最小二乘解，MatrixType 为定长矩阵时整个过程不分配内存。
+ * 最小奇异值低于阈值时 lambda^2 = (1 - (sigmaMin / threshold)^2) * maxDamping^2，否则不加阻尼。
+ */
+template<typename MatrixType, typename VectorType>
+void solveDampedLeastSquares(const MatrixType& jac, const cobotsys::AbstractKinematicSolver::Twist6d& cartVel,
+                             VectorType& jointVel, double singularThreshold, double maxDamping, Manipulability* quality) {
+	Eigen::JacobiSVD<MatrixType> svd(jac, Eigen::ComputeFullU | Eigen::ComputeFullV);
+	const auto& sigma = svd.singularValues();
+	Manipulability current;
+	fillManipulability(sigma, current);
+
+	double lambda2 = 0;
+	if (singularThreshold > 0 && current.minSingularValue < singularThreshold) {
+		double ratio = current.minSingularValue / singularThreshold;
+		lambda2 = (1 - ratio * ratio) * maxDamping * maxDamping;
+	}
+
+	jointVel.setZero(jac.cols());
+	for (Eigen::Index i = 0; i < sigma.size(); i++) {
+		double denominator = sigma[i] * sigma[i] + lambda2;
+		if (denominator < 1e-12) {
+			continue;
+		}
+		jointVel += svd.matrixV().col(i) * (sigma[i] / denominator * svd.matrixU().col(i).dot(cartVel));
+	}
+	if (quality) {
+		*quality = current;
+	}
+}
+}
 
 namespace cobotsys {
 	AbstractKinematicSolver::AbstractKinematicSolver() {
@@ -12,4 +59,119 @@ namespace cobotsys {
 
 	AbstractKinematicSolver::~AbstractKinematicSolver() {
 }
-}
\ No newline at end of file
+
+	std::shared_ptr<AbstractKinematicSolver> AbstractKinematicSolver::createThreadContext() {
+		return nullptr;
+	}
+
+	uint64_t AbstractKinematicSolver::modelGeneration() const {
+		return 0;
+	}
+
+	int AbstractKinematicSolver::cartToJntAll(const std::vector<double>& targetPos, std::vector<std::vector<double> >& solutions) {
+		solutions.clear();
+		return -1;
+	}
+
+	int AbstractKinematicSolver::cartToJnt(const Joint6d& initialJoint, const Eigen::Isometry3d& targetPos, Joint6d& targetJoint) {
+		Eigen::VectorXd q_init = initialJoint;
+		Eigen::VectorXd q_out(initialJoint.size());
+		Eigen::Affine3d pose(targetPos.matrix());
+		int retval = cartToJnt(q_init, pose, q_out);
+		if (retval == 0 && q_out.size() == targetJoint.size()) {
+			targetJoint = q_out;
+		}
+		return retval;
+	}
+
+	int AbstractKinematicSolver::cartToJntBatch(const Joint6d& initialJoint, const Eigen::Isometry3d* targetPoses, size_t count,
+	                                            Joint6d* targetJoints, int* results, bool chainSeed) {
+		int failCount = 0;
+		Joint6d seed = initialJoint;
+		for (size_t i = 0; i < count; i++) {
+			int retval = cartToJnt(seed, targetPoses[i], targetJoints[i]);
+			if (results) {
+				results[i] = retval;
+			}
+			if (retval != 0) {
+				failCount++;
+			} else if (chainSeed) {
+				seed = targetJoints[i];
+			}
+		}
+		return failCount;
+	}
+
+	int AbstractKinematicSolver::jntToCart(const Joint6d& targetJoint, Eigen::Isometry3d& targetPos) {
+		Eigen::VectorXd q = targetJoint;
+		Eigen::Affine3d pose;
+		int retval = jntToCart(q, pose);
+		targetPos.matrix() = pose.matrix();
+		return retval;
+	}
+
+	int AbstractKinematicSolver::jntToCart(const Joint6d& targetJoint, Eigen::Vector3d& position, Eigen::Quaterniond& orientation) {
+		Eigen::Isometry3d pose;
+		int retval = jntToCart(targetJoint, pose);
+		position = pose.translation();
+		orientation = Eigen::Quaterniond(pose.rotation());
+		return retval;
+	}
+
+	int AbstractKinematicSolver::jntToCartBatch(const Joint6d* targetJoints, size_t count, Eigen::Isometry3d* targetPoses) {
+		int failCount = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (jntToCart(targetJoints[i], targetPoses[i]) != 0) {
+				failCount++;
+			}
+		}
+		return failCount;
+	}
+
+	int AbstractKinematicSolver::jacobian(const Eigen::VectorXd& joint, Eigen::MatrixXd& jac) {
+		return -1;
+	}
+
+	int AbstractKinematicSolver::jacobian(const Joint6d& joint, Jacobian6d& jac) {
+		Eigen::VectorXd q = joint;
+		Eigen::MatrixXd jacX;
+		int retval = jacobian(q, jacX);
+		if (retval == 0) {
+			if (jacX.rows() != jac.rows() || jacX.cols() != jac.cols()) {
+				return -1;
+			}
+			jac = jacX;
+		}
+		return retval;
+	}
+
+	int AbstractKinematicSolver::cartVelToJntVel(const Joint6d& joint, const Twist6d& cartVel, Joint6d& jointVel,
+	                                             double singularThreshold, double maxDamping, Manipulability* quality) {
+		Jacobian6d jac;
+		int retval = jacobian(joint, jac);
+		if (retval == 0) {
+			solveDampedLeastSquares(jac, cartVel, jointVel, singularThreshold, maxDamping, quality);
+		}
+		return retval;
+	}
+
+	int AbstractKinematicSolver::cartVelToJntVel(const Eigen::VectorXd& joint, const Twist6d& cartVel, Eigen::VectorXd& jointVel,
+	                                             double singularThreshold, double maxDamping, Manipulability* quality) {
+		Eigen::MatrixXd jac;
+		int retval = jacobian(joint, jac);
+		if (retval == 0) {
+			solveDampedLeastSquares(jac, cartVel, jointVel, singularThreshold, maxDamping, quality);
+		}
+		return retval;
+	}
+
+	int AbstractKinematicSolver::manipulability(const Eigen::VectorXd& joint, Manipulability& quality) {
+		Eigen::MatrixXd jac;
+		int retval = jacobian(joint, jac);
+		if (retval == 0) {
+			Eigen::JacobiSVD<Eigen::MatrixXd> svd(jac);
+			fillManipulability(svd.singularValues(), quality);
+		}
+		return retval;
+	}
+}
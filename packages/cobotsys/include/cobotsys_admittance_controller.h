@@ -0,0 +1,106 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#ifndef PROJECT_COBOTSYS_ADMITTANCE_CONTROLLER_H
+#define PROJECT_COBOTSYS_ADMITTANCE_CONTROLLER_H
+
+#include <chrono>
+#include <mutex>
+#include <stdint.h>
+
+namespace cobotsys {
+
+/**
+ * @brief 固定采样周期的导纳控制器(死区 + PID + 饱和)，与传感器和机器人的频率无关
+ *
+ * 结构与 Simulink 生成的 ForceController 相同:
+ *
+ *     e = DeadZone(f)
+ *     d = (D*e - xf) * N
+ *     u = Saturation(P*e + xi + d)
+ *     xi += Ts * I * e,  xf += Ts * d
+ *
+ * 区别是内环按固定的采样周期 Ts 运行，Ts 是显式参数，不再由调用次数决定。
+ * 传感器采样(已经在传感器频率下做过抗混叠滤波)通过 update() 输入，内环的节拍由采样时间推进:
+ * 每个节拍使用这个周期内收到的采样的平均值(降采样)，周期内没有采样时保持上一个输入。
+ * 所以传感器或者机器人频率变化时，增益的含义不变；Ts 可以设为 0.001 以 1 kHz 运行。
+ *
+ * 线程安全，update() 和 output() 可以在不同线程调用。
+ */
+class AdmittanceController {
+public:
+    enum {
+        AXES = 6,
+    };
+
+    struct Parameters {
+        double P[AXES] = {0, 0, 0, 0, 0, 0};
+        double I[AXES] = {0, 0, 0, 0, 0, 0};
+        double D[AXES] = {0, 0, 0, 0, 0, 0};
+        double N[AXES] = {0, 0, 0, 0, 0, 0};     ///< 微分滤波系数
+        double deadZoneStart[AXES] = {0, 0, 0, 0, 0, 0};
+        double deadZoneEnd[AXES] = {0, 0, 0, 0, 0, 0};
+        double saturationLower[AXES] = {0, 0, 0, 0, 0, 0};
+        double saturationUpper[AXES] = {0, 0, 0, 0, 0, 0};
+        double sampleTime = 0.008;               ///< 内环采样周期(s)
+        int maxCatchUp = 100;                    ///< 一次 update 最多补跑的节拍数，超过时丢弃多余的节拍
+    };
+
+    struct Statistics {
+        uint64_t samples = 0; ///< 输入的采样数
+        uint64_t ticks = 0;   ///< 内环运行次数
+        uint64_t held = 0;    ///< 周期内没有新采样、保持上一个输入的节拍数
+        uint64_t skipped = 0; ///< 采样中断太久而丢弃的节拍数
+    };
+
+public:
+    AdmittanceController();
+
+    /**
+     * 设置参数并清空状态
+     */
+    void setParameters(const Parameters& parameters);
+    Parameters getParameters() const;
+
+    void reset();
+
+    /**
+     * 输入一个采样，并运行采样时间之前所有到期的内环节拍
+     * @param force 去掉零点和重力、滤波后的力
+     * @param time 采样时间
+     * @return 这次运行的节拍数
+     */
+    int update(const double force[AXES], std::chrono::steady_clock::time_point time);
+
+    /**
+     * 最近一个节拍的输出
+     */
+    void output(double offset[AXES]) const;
+
+    Statistics getStatistics() const;
+
+protected:
+    void tick();
+
+protected:
+    mutable std::mutex m_mutex;
+    Parameters m_parameters;
+    std::chrono::steady_clock::duration m_period;
+
+    bool m_started;
+    std::chrono::steady_clock::time_point m_nextTick;
+    double m_sum[AXES];   ///< 当前周期内采样的和
+    int m_count;          ///< 当前周期内的采样数
+    double m_input[AXES]; ///< 上一个节拍的输入
+
+    double m_integrator[AXES];
+    double m_filter[AXES];
+    double m_output[AXES];
+
+    Statistics m_statistics;
+};
+
+}
+
+#endif //PROJECT_COBOTSYS_ADMITTANCE_CONTROLLER_H
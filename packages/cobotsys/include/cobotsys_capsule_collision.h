@@ -0,0 +1,174 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#ifndef PROJECT_COBOTSYS_CAPSULE_COLLISION_H
+#define PROJECT_COBOTSYS_CAPSULE_COLLISION_H
+
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace cobotsys {
+
+/**
+ * @brief 机械臂的胶囊体碰撞检测
+ *
+ * 机械臂的每个连杆用胶囊体(线段加半径)近似，线段直接由 DH 参数得到：
+ * 连杆 i 沿 z(i-1) 走 d、沿 x(i) 走 a，长度不为 0 的部分各是一个胶囊体，末端执行器偏移是最后一个胶囊体。
+ * 障碍物是有向长方体(料框壁、夹具)和平面(桌面、墙)。
+ *
+ * distance() 返回一组关节角下的最小距离，包括自碰撞(连杆序号相差至少 selfCollisionGap 的胶囊体对)
+ * 和连杆与障碍物之间的距离，小于 0 表示穿透。胶囊体和长方体的距离在线段参数上做一维凸优化求得。
+ * 全部是固定的几何计算，没有动态内存分配，可以在执行轨迹之前检查每一个采样点。
+ *
+ * 配置文件格式见 CONFIG/CollisionConfig/ur10_cell.json，机械臂的 DH 参数直接读 KinematicSolver 的配置文件。
+ */
+class CapsuleCollisionChecker {
+public:
+    enum {
+        MAX_JOINTS = 16,
+        MAX_CAPSULES = MAX_JOINTS * 2 + 1,
+    };
+
+    struct DhParam {
+        double a;
+        double alpha;
+        double d;
+        double theta;
+    };
+
+    /**
+     * 最小距离和对应的物体
+     */
+    struct DistanceResult {
+        double distance = 0;
+        int capsule = -1;       ///< 胶囊体序号
+        int other = -1;         ///< 另一个胶囊体序号，或者障碍物序号
+        bool isObstacle = false;
+    };
+
+public:
+    CapsuleCollisionChecker();
+
+    /**
+     * 从配置文件读取机械臂和障碍物
+     */
+    bool setup(const std::string& configPath);
+
+    /**
+     * @param dh 每个关节的 DH 参数(标准 DH，与 KDL::Frame::DH 相同)
+     * @param worldBase 世界坐标系到第一个关节坐标系
+     * @param eeFrame 最后一个关节到末端执行器
+     * @param linkRadius 每个连杆的半径，个数与 dh 相同
+     * @param toolRadius 末端执行器胶囊体的半径
+     * @retval false 参数个数不对，或者关节数超过 MAX_JOINTS
+     */
+    bool setRobot(const std::vector<DhParam>& dh, const Eigen::Isometry3d& worldBase, const Eigen::Isometry3d& eeFrame,
+                  const std::vector<double>& linkRadius, double toolRadius);
+
+    /**
+     * 连杆序号相差小于 gap 的胶囊体之间不检查自碰撞，默认 2(只跳过相邻连杆)
+     */
+    void setSelfCollisionGap(int gap);
+
+    /**
+     * 这个连杆(DH 序号，从 0 开始)的胶囊体不和障碍物检查，比如固定在桌面上的基座
+     */
+    void ignoreObstacleForLink(int link);
+
+    /**
+     * @param pose 长方体中心在世界坐标系下的位姿
+     * @param size 长、宽、高
+     */
+    void addBox(const std::string& name, const Eigen::Isometry3d& pose, const Eigen::Vector3d& size);
+
+    /**
+     * 平面 normal . x = offset，normal 指向的一侧是自由空间
+     */
+    void addPlane(const std::string& name, const Eigen::Vector3d& normal, double offset);
+    void clearObstacles();
+
+    bool isValid() const { return !m_capsules.empty(); }
+    size_t jointCount() const { return m_links.size(); }
+    size_t capsuleCount() const { return m_capsules.size(); }
+    size_t obstacleCount() const { return m_boxes.size() + m_planes.size(); }
+
+    /**
+     * 障碍物序号从长方体开始，之后是平面
+     */
+    const std::string& obstacleName(int obstacle) const;
+
+    /**
+     * 一组关节角下的最小距离(米)，小于 0 表示穿透
+     * @param q jointCount() 个关节角
+     * @param result 可以为空，输出最小距离对应的物体
+     */
+    double distance(const double* q, DistanceResult* result = nullptr) const;
+    double distance(const std::vector<double>& q, DistanceResult* result = nullptr) const;
+
+    /**
+     * 批量计算，q 是 count 组连续存放的关节角
+     */
+    void distanceBatch(const double* q, size_t count, double* distances) const;
+
+    /**
+     * 沿轨迹逐点检查
+     * @param margin 安全距离，最小距离小于这个值就认为碰撞
+     * @return 第一个碰撞的点的序号，没有碰撞返回 -1
+     */
+    int firstCollision(const std::vector<std::vector<double> >& trajectory, double margin = 0) const;
+
+    /**
+     * 当前关节角下所有胶囊体在世界坐标系下的端点，用于显示
+     */
+    void capsuleSegments(const double* q, std::vector<Eigen::Vector3d>& start, std::vector<Eigen::Vector3d>& end) const;
+
+protected:
+    /**
+     * 固定在某个连杆坐标系下的胶囊体
+     */
+    struct Capsule {
+        int frame;              ///< 0 为基坐标系，i 为第 i 个关节之后的坐标系
+        int dhLink;             ///< DH 连杆序号，末端执行器为关节数
+        int link;               ///< 有胶囊体的连杆的顺序，用于判断是否相邻
+        bool checkObstacle;
+        Eigen::Vector3d start;
+        Eigen::Vector3d end;
+        double radius;
+    };
+
+    struct Box {
+        std::string name;
+        Eigen::Matrix3d rotation;   ///< 长方体坐标系到世界坐标系
+        Eigen::Vector3d center;
+        Eigen::Vector3d halfSize;
+    };
+
+    struct Plane {
+        std::string name;
+        Eigen::Vector3d normal;
+        double offset;
+    };
+
+    void computeSegments(const double* q, Eigen::Vector3d* start, Eigen::Vector3d* end) const;
+    void updatePairs();
+
+protected:
+    std::vector<DhParam> m_links;
+    std::vector<double> m_cosAlpha;
+    std::vector<double> m_sinAlpha;
+    Eigen::Matrix3d m_baseRotation;
+    Eigen::Vector3d m_baseTranslation;
+    std::vector<Capsule> m_capsules;
+    std::vector<std::pair<int, int> > m_selfPairs;
+    std::vector<int> m_ignoreObstacleLinks;
+    int m_selfCollisionGap;
+    std::vector<Box> m_boxes;
+    std::vector<Plane> m_planes;
+};
+
+}
+
+#endif //PROJECT_COBOTSYS_CAPSULE_COLLISION_H
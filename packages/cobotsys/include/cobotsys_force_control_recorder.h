@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#ifndef PROJECT_COBOTSYS_FORCE_CONTROL_RECORDER_H
+#define PROJECT_COBOTSYS_FORCE_CONTROL_RECORDER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cobotsys_lockfree_ring.h"
+
+namespace cobotsys {
+
+/**
+ * @brief 力控回路的一条记录
+ *
+ * 力控求解器每个力样本写一条 SOURCE_SENSOR 记录，控制线程每次下发运动写一条 SOURCE_ROBOT 记录，
+ * 各自没有的字段为 NaN。
+ */
+struct ForceControlRecord {
+    enum Source {
+        SOURCE_SENSOR = 1,
+        SOURCE_ROBOT = 2,
+    };
+
+    int64_t time;                ///< steady_clock 时间(ns)，力记录为采样时间，运动记录为机器人状态时间
+    uint32_t source;
+    uint32_t sequence;           ///< 同一来源内的序号，由记录器填写，间隔大于 1 表示有丢失
+    double rawWrench[6];         ///< 传感器原始读数
+    double compensatedWrench[6]; ///< 去掉零点和重力
+    double filteredWrench[6];    ///< 滤波后，控制器的输入
+    double offset[6];            ///< 控制器输出
+    double commandQ[6];          ///< 下发的关节角
+    double measuredQ[6];         ///< 当时的实际关节角
+
+    /**
+     * 全部数据字段设为 NaN
+     */
+    void clear();
+};
+
+/**
+ * @brief 力控回路信号的全速率二进制记录
+ *
+ * 每个来源一个单写者无锁环形缓冲区，record() 只做一次拷贝，不加锁、不做系统调用，
+ * 不会阻塞控制回路。后台线程把数据拷贝到预先分配并映射到内存的文件中，
+ * 后台线程来不及读取而被覆盖的记录计入 lost，文件写满后的记录计入 overflow。
+ *
+ * 文件格式: 64 字节的 Header，后面是连续存放的 ForceControlRecord。
+ * 写入过程中 Header 中的记录数会定期更新，程序异常退出时文件也可以读取。
+ * 只在 Linux 下可用，其他平台 open() 返回 false。
+ */
+class ForceControlRecorder {
+public:
+    enum {
+        RING_CAPACITY = 4096,
+        VERSION = 1,
+    };
+
+    struct Header {
+        char magic[8];         ///< "CBFCREC1"
+        uint32_t version;
+        uint32_t recordSize;
+        uint64_t recordCount;
+        uint64_t capacity;
+        int64_t startTime;     ///< 打开文件时的 steady_clock 时间(ns)
+        int64_t wallTime;      ///< 打开文件时的 system_clock 时间(ns)
+        uint64_t lost;
+        uint64_t overflow;
+    };
+
+    struct Statistics {
+        uint64_t written = 0;
+        uint64_t lost = 0;
+        uint64_t overflow = 0;
+    };
+
+public:
+    ForceControlRecorder();
+    ~ForceControlRecorder();
+
+    ForceControlRecorder(const ForceControlRecorder&) = delete;
+    ForceControlRecorder& operator=(const ForceControlRecorder&) = delete;
+
+    /**
+     * 预分配文件并启动后台线程，已经打开时先关闭
+     * @param maxRecords 文件能容纳的最多记录数
+     */
+    bool open(const std::string& filePath, uint64_t maxRecords);
+
+    /**
+     * 写完缓冲区中剩余的记录，把文件截断到实际大小
+     */
+    void close();
+
+    bool isOpen() const { return m_running; }
+
+    /**
+     * 写入一条记录，按 record.source 放入对应的缓冲区。
+     * 同一个来源只能在一个线程里调用，没有打开时直接返回。
+     */
+    void record(const ForceControlRecord& record);
+
+    Statistics getStatistics() const;
+
+    /**
+     * 读取记录文件，供离线转换使用
+     */
+    static bool load(const std::string& filePath, Header& header, std::vector<ForceControlRecord>& records);
+
+protected:
+    typedef LockFreeRing<ForceControlRecord, RING_CAPACITY> RecordRing;
+
+    void writerThreadFunc();
+    void drain(RecordRing& ring, uint64_t& nextSequence);
+    void updateHeader();
+
+protected:
+    std::unique_ptr<RecordRing> m_sensorRing;
+    std::unique_ptr<RecordRing> m_robotRing;
+    uint64_t m_sensorRead;
+    uint64_t m_robotRead;
+
+    int m_fd;
+    void* m_mapping;
+    size_t m_mappingSize;
+    Header* m_header;
+    ForceControlRecord* m_records;
+    uint64_t m_capacity;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    std::atomic<uint64_t> m_written;
+    std::atomic<uint64_t> m_lost;
+    std::atomic<uint64_t> m_overflow;
+};
+
+}
+
+#endif //PROJECT_COBOTSYS_FORCE_CONTROL_RECORDER_H
@@ -0,0 +1,124 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#ifndef PROJECT_COBOTSYS_GRAVITY_COMPENSATION_H
+#define PROJECT_COBOTSYS_GRAVITY_COMPENSATION_H
+
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+
+namespace cobotsys {
+
+/**
+ * @brief 末端负载的重力和力传感器零点补偿
+ *
+ * 传感器坐标系与末端坐标系重合，R 是末端相对基坐标系的旋转，传感器读数为
+ *
+ *     F = R^T * G + F0
+ *     T = c x (R^T * G) + T0
+ *
+ * G 是负载在基坐标系下的重力(安装水平时为 [0, 0, -m*g])，c 是负载重心，F0/T0 是传感器零点。
+ * 在线补偿只需要当前末端的旋转，不再做正解，每次只有几十次乘加。
+ */
+class GravityCompensation {
+public:
+    struct Parameters {
+        Eigen::Vector3d gravity = Eigen::Vector3d::Zero();      ///< 基坐标系下的负载重力(N)
+        Eigen::Vector3d center = Eigen::Vector3d::Zero();       ///< 负载重心，传感器坐标系(m)
+        Eigen::Vector3d forceOffset = Eigen::Vector3d::Zero();  ///< 力零点(N)
+        Eigen::Vector3d torqueOffset = Eigen::Vector3d::Zero(); ///< 力矩零点(Nm)
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+public:
+    GravityCompensation();
+
+    void setParameters(const Parameters& parameters);
+    const Parameters& getParameters() const { return m_parameters; }
+
+    /**
+     * 读取标定结果文件，格式与 save() 写出的相同
+     */
+    bool load(const std::string& configPath);
+    bool save(const std::string& filePath) const;
+
+    /**
+     * 负载重力在传感器上产生的力和力矩，不含零点
+     * @param rotation 末端相对基坐标系的旋转
+     * @param[out] wrench fx, fy, fz, tx, ty, tz
+     */
+    void gravityWrench(const Eigen::Matrix3d& rotation, double wrench[6]) const;
+
+    /**
+     * 从传感器原始读数中去掉零点和负载重力，得到外力
+     */
+    void compensate(const Eigen::Matrix3d& rotation, const double raw[6], double external[6]) const;
+
+    /**
+     * 负载质量(kg)，按 9.81 的重力加速度换算
+     */
+    double mass() const;
+
+protected:
+    Parameters m_parameters;
+};
+
+/**
+ * @brief 最小二乘标定负载重力、重心和传感器零点
+ *
+ * 机械臂停在若干个不同的姿态，每个姿态记录末端旋转和平均后的传感器读数，
+ * 先由力求出 G 和 F0，再用求出的 G 由力矩求出 c 和 T0，两步都是 6 个未知数的线性最小二乘。
+ * 至少需要 3 个旋转轴不共线的姿态，姿态越分散结果越好。
+ */
+class GravityCalibrator {
+public:
+    struct Result {
+        GravityCompensation::Parameters parameters;
+        double mass = 0;             ///< 负载质量(kg)
+        double forceRms = 0;         ///< 力残差的均方根(N)
+        double torqueRms = 0;        ///< 力矩残差的均方根(Nm)
+        double conditionNumber = 0;  ///< 力方程的条件数，过大说明姿态不够分散
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+public:
+    GravityCalibrator();
+
+    void clear();
+
+    /**
+     * @param rotation 末端相对基坐标系的旋转
+     * @param wrench 这个姿态下的传感器读数 fx, fy, fz, tx, ty, tz
+     */
+    void addSample(const Eigen::Matrix3d& rotation, const double wrench[6]);
+    size_t sampleCount() const { return m_samples.size(); }
+
+    /**
+     * @param maxConditionNumber 条件数超过这个值认为姿态不够分散
+     * @retval 0 成功
+     * @retval -1 样本少于 3 个
+     * @retval -2 姿态不够分散
+     */
+    int solve(Result& result, double maxConditionNumber = 1e4) const;
+
+protected:
+    struct Sample {
+        Eigen::Matrix3d rotation;
+        Eigen::Vector3d force;
+        Eigen::Vector3d torque;
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    std::vector<Sample, Eigen::aligned_allocator<Sample> > m_samples;
+};
+
+}
+
+#endif //PROJECT_COBOTSYS_GRAVITY_COMPENSATION_H
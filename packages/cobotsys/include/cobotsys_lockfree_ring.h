@@ -0,0 +1,180 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#ifndef PROJECT_COBOTSYS_LOCKFREE_RING_H
+#define PROJECT_COBOTSYS_LOCKFREE_RING_H
+
+#include <stdint.h>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+namespace cobotsys {
+
+/**
+ * @brief 单写者、多读者的固定容量环形缓冲区
+ *
+ * 写者和读者都不加锁，也不互相等待：每个槽位带一个序号(seqlock)，
+ * 读者读完数据后再检查一次序号，读到一半被覆盖的数据直接丢弃，不会读到写了一半的值。
+ * 样本序号从 1 开始连续递增，读者根据序号的间隔就能知道自己漏掉了多少样本。
+ *
+ * 数据按 64 位原子字存放，T 必须是可以按字节复制的类型。
+ * 只能有一个线程调用 push()，读接口可以在任意多个线程里同时调用。
+ */
+template<class T, size_t Capacity>
+class LockFreeRing {
+    static_assert((Capacity & (Capacity - 1)) == 0 && Capacity > 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+
+public:
+    enum {
+        CAPACITY = Capacity,
+    };
+
+public:
+    LockFreeRing() : m_written(0) {
+        for (auto& slot : m_slots) {
+            slot.sequence.store(0, std::memory_order_relaxed);
+            for (auto& word : slot.words)
+                word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    LockFreeRing(const LockFreeRing&) = delete;
+    LockFreeRing& operator=(const LockFreeRing&) = delete;
+
+    /**
+     * 写入一个样本，只能在一个线程里调用
+     * @return 这个样本的序号
+     */
+    uint64_t push(const T& value) {
+        uint64_t sequence = m_written.load(std::memory_order_relaxed) + 1;
+        Slot& slot = m_slots[sequence & MASK];
+
+        uint64_t words[WORDS] = {0};
+        std::memcpy(words, &value, sizeof(T));
+
+        // 先把槽位标记为正在写，读者看到 0 或者序号变了就放弃这次读取
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++)
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        slot.sequence.store(sequence, std::memory_order_release);
+        m_written.store(sequence, std::memory_order_release);
+        return sequence;
+    }
+
+    /**
+     * 最新样本的序号，0 表示还没有数据
+     */
+    uint64_t written() const {
+        return m_written.load(std::memory_order_acquire);
+    }
+
+    /**
+     * 读取指定序号的样本
+     * @retval false 还没有写入，或者已经被覆盖
+     */
+    bool at(uint64_t sequence, T& value) const {
+        if (sequence == 0)
+            return false;
+        const Slot& slot = m_slots[sequence & MASK];
+        if (slot.sequence.load(std::memory_order_acquire) != sequence)
+            return false;
+
+        uint64_t words[WORDS];
+        for (size_t i = 0; i < WORDS; i++)
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+            return false;
+
+        std::memcpy(&value, words, sizeof(T));
+        return true;
+    }
+
+    /**
+     * 读取最新的样本
+     * @param sequence 可以为空，输出样本序号
+     * @retval false 还没有数据
+     */
+    bool latest(T& value, uint64_t* sequence = nullptr) const {
+        // 最新的槽位只有在写者又绕了一整圈时才会读失败，重试次数有上限
+        for (int retry = 0; retry < 4; retry++) {
+            uint64_t newest = written();
+            if (newest == 0)
+                return false;
+            if (at(newest, value)) {
+                if (sequence)
+                    *sequence = newest;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * 读取最近的 count 个样本，按时间先后存放
+     * @return 实际读到的个数
+     */
+    size_t readLatest(T* values, size_t count) const {
+        uint64_t newest = written();
+        if (count > Capacity)
+            count = Capacity;
+        uint64_t first = newest >= count ? newest - count + 1 : 1;
+        size_t readCount = 0;
+        for (uint64_t sequence = first; sequence <= newest; sequence++) {
+            if (at(sequence, values[readCount]))
+                readCount++;
+        }
+        return readCount;
+    }
+
+    /**
+     * 读取 lastSequence 之后的新样本，最多 maxCount 个，按时间先后存放，并把 lastSequence 推进到已处理的位置
+     * @param dropped 可以为空，累加因为读得太慢被覆盖而漏掉的样本个数
+     * @return 实际读到的个数
+     */
+    size_t readSince(uint64_t& lastSequence, T* values, size_t maxCount, uint64_t* dropped = nullptr) const {
+        uint64_t newest = written();
+        if (newest <= lastSequence)
+            return 0;
+
+        uint64_t first = lastSequence + 1;
+        if (newest - first >= Capacity) {
+            if (dropped)
+                *dropped += newest - Capacity + 1 - first;
+            first = newest - Capacity + 1;
+        }
+
+        size_t readCount = 0;
+        uint64_t sequence = first;
+        for (; sequence <= newest && readCount < maxCount; sequence++) {
+            if (at(sequence, values[readCount]))
+                readCount++;
+            else if (dropped)
+                (*dropped)++;
+        }
+        lastSequence = sequence - 1;
+        return readCount;
+    }
+
+protected:
+    enum {
+        MASK = Capacity - 1,
+        WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t),
+    };
+
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        std::atomic<uint64_t> words[WORDS];
+    };
+
+    Slot m_slots[Capacity];
+    std::atomic<uint64_t> m_written;
+};
+
+}
+
+#endif //PROJECT_COBOTSYS_LOCKFREE_RING_H
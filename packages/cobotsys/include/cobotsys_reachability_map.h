@@ -0,0 +1,133 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#ifndef PROJECT_COBOTSYS_REACHABILITY_MAP_H
+#define PROJECT_COBOTSYS_REACHABILITY_MAP_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <cobotsys_abstract_kinematic_solver.h>
+
+namespace cobotsys {
+
+/**
+ * @brief 机械臂工作空间的可达性地图
+ *
+ * 把工作空间划分成立方体体素，每个体素记录末端执行器在这里可以朝向哪些方向，
+ * 以及每个方向上可操作度最好的一组关节角，可以直接作为逆解初值。
+ * 方向只考虑末端执行器的 z 轴(接近方向)，按立方体贴图分成 DIRECTION_BINS 个区域。
+ *
+ * 查询都是 O(1)：抓取候选位姿在运行逆解之前就可以排除或者取得初值。
+ * 地图由 ReachabilityMapBuilder 离线生成(见 test_apps/reachability_map_builder)，save()/load() 读写二进制文件。
+ */
+class ReachabilityMap {
+public:
+    enum {
+        JOINT_NUM = 6,
+        DIRECTION_BINS = 24, ///< 立方体 6 个面，每个面 2x2
+    };
+    typedef AbstractKinematicSolver::Joint6d Joint6d;
+
+public:
+    ReachabilityMap();
+
+    bool isValid() const { return !m_masks.empty(); }
+
+    bool save(const std::string& filePath) const;
+    bool load(const std::string& filePath);
+
+    /**
+     * 位置所在体素至少有一个方向可达
+     */
+    bool isReachable(const Eigen::Vector3d& position) const;
+
+    /**
+     * 位置和接近方向都可达
+     */
+    bool isReachable(const Eigen::Isometry3d& pose) const;
+
+    /**
+     * 位置所在体素可达方向的比例，0 到 1，工作空间外为 0
+     */
+    double coverage(const Eigen::Vector3d& position) const;
+
+    /**
+     * 取位姿对应体素和方向上记录的关节角，作为逆解初值
+     * @retval false 该位姿不可达
+     */
+    bool seed(const Eigen::Isometry3d& pose, Joint6d& joint) const;
+
+    /**
+     * 接近方向(单位向量)所在的方向区域，0 到 DIRECTION_BINS - 1
+     */
+    static int directionBin(const Eigen::Vector3d& direction);
+
+    const Eigen::Vector3d& minCorner() const { return m_minCorner; }
+    double resolution() const { return m_resolution; }
+    const Eigen::Vector3i& dims() const { return m_dims; }
+    size_t seedCount() const { return m_seeds.size() / JOINT_NUM; }
+
+protected:
+    friend class ReachabilityMapBuilder;
+
+    /**
+     * @return 体素下标，工作空间外为 -1
+     */
+    int64_t cellIndex(const Eigen::Vector3d& position) const;
+    bool cellSeed(int64_t cell, int bin, Joint6d& joint) const;
+
+protected:
+    Eigen::Vector3d m_minCorner;
+    double m_resolution;
+    Eigen::Vector3i m_dims;
+    std::vector<uint32_t> m_masks;      ///< 每个体素的可达方向位图
+    std::vector<uint32_t> m_firstSeed;  ///< 每个体素第一组关节角在 m_seeds 里的序号，按位图中置位的顺序存放
+    std::vector<int16_t> m_seeds;       ///< 关节角，按 2pi/32767 量化，范围 [-2pi, 2pi]
+};
+
+
+/**
+ * @brief 由关节空间采样生成可达性地图
+ *
+ * 每个样本是一组关节角和它的正解位姿，score 一般取可操作度。
+ * 同一个体素同一个方向上保留 score 最大的样本作为初值。
+ */
+class ReachabilityMapBuilder {
+public:
+    /**
+     * @param minCorner,maxCorner 地图范围(米，相对于基坐标)
+     * @param resolution 体素边长(米)
+     */
+    ReachabilityMapBuilder(const Eigen::Vector3d& minCorner, const Eigen::Vector3d& maxCorner, double resolution);
+
+    /**
+     * @retval false 位置在地图范围外
+     */
+    bool addSample(const Eigen::Isometry3d& pose, const ReachabilityMap::Joint6d& joint, double score);
+
+    size_t sampleCount() const { return m_sampleCount; }
+
+    /**
+     * 生成紧凑的查询用地图
+     */
+    void build(ReachabilityMap& map) const;
+
+protected:
+    struct Entry {
+        double score;
+        double joint[ReachabilityMap::JOINT_NUM];
+    };
+
+    ReachabilityMap m_grid; // 只用到范围和体素下标计算
+    size_t m_sampleCount;
+    std::unordered_map<uint64_t, Entry> m_entries; // 键为 体素下标 * DIRECTION_BINS + 方向
+};
+
+}
+
+#endif //PROJECT_COBOTSYS_REACHABILITY_MAP_H
@@ -0,0 +1,128 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#ifndef PROJECT_COBOTSYS_WRENCH_FILTER_H
+#define PROJECT_COBOTSYS_WRENCH_FILTER_H
+
+namespace cobotsys {
+
+/**
+ * @brief 六维力的二阶 IIR 滤波器组
+ *
+ * 6 个轴使用同一个传递函数 H(z) = (b0 + b1*z^-1 + b2*z^-2) / (a0 + a1*z^-1 + a2*z^-2)，
+ * 直接 II 型实现，计算顺序与 Simulink 生成的 DiscreteTransferFcn 完全相同，结果逐位一致。
+ * 状态按延迟级分组、每组 6 个轴连续存放，一次调用处理全部 6 个轴，循环里没有分支，编译器可以自动向量化。
+ * 全部是定长数组，不分配内存。
+ * 注意: 打开 FMA 的编译选项(如 -march=native)会把乘加合并，逐位一致只在两边合并方式相同时成立。
+ */
+class WrenchIirFilter {
+public:
+    enum {
+        AXES = 6,
+        ORDER = 2,
+    };
+
+public:
+    /**
+     * 默认是直通滤波器 H(z) = 1
+     */
+    WrenchIirFilter() {
+        const double num[ORDER + 1] = {1, 0, 0};
+        const double den[ORDER + 1] = {1, 0, 0};
+        setCoefficients(num, den);
+    }
+
+    /**
+     * 设置系数并清空状态
+     * @param num 分子 b0, b1, b2
+     * @param den 分母 a0, a1, a2，a0 不能为 0
+     */
+    void setCoefficients(const double num[ORDER + 1], const double den[ORDER + 1]) {
+        for (int i = 0; i <= ORDER; i++) {
+            m_num[i] = num[i];
+            m_den[i] = den[i];
+        }
+        reset();
+    }
+
+    void reset() {
+        for (int i = 0; i < AXES; i++) {
+            m_state1[i] = 0;
+            m_state2[i] = 0;
+        }
+    }
+
+    /**
+     * 滤波一个采样，input 和 output 可以是同一个数组
+     */
+    void filter(const double input[AXES], double output[AXES]) {
+        for (int i = 0; i < AXES; i++) {
+            double w = ((input[i] - m_den[1] * m_state1[i]) - m_state2[i] * m_den[2]) / m_den[0];
+            double y = w * m_num[0];
+            y += m_num[1] * m_state1[i];
+            y += m_state2[i] * m_num[2];
+            m_state2[i] = m_state1[i];
+            m_state1[i] = w;
+            output[i] = y;
+        }
+    }
+
+protected:
+    double m_num[ORDER + 1];
+    double m_den[ORDER + 1];
+    double m_state1[AXES]; ///< w[n-1]
+    double m_state2[AXES]; ///< w[n-2]
+};
+
+/**
+ * @brief 六维一阶指数平滑 y += factor * (x - y)
+ *
+ * 第一个采样直接作为输出。与原来按 std::vector 逐轴计算的 ExponentialFilter 结果逐位一致，
+ * 系数同样按 float 保存。
+ */
+class WrenchExponentialFilter {
+public:
+    enum {
+        AXES = 6,
+    };
+
+public:
+    explicit WrenchExponentialFilter(float factor = 1.0f) : m_factor(factor), m_first(true) {
+        reset();
+    }
+
+    void setFactor(float factor) { m_factor = factor; }
+    float getFactor() const { return m_factor; }
+
+    void reset() {
+        m_first = true;
+        for (int i = 0; i < AXES; i++)
+            m_value[i] = 0;
+    }
+
+    /**
+     * 滤波一个采样，input 和 output 可以是同一个数组
+     */
+    void filter(const double input[AXES], double output[AXES]) {
+        if (m_first) {
+            m_first = false;
+            for (int i = 0; i < AXES; i++)
+                m_value[i] = input[i];
+        } else {
+            for (int i = 0; i < AXES; i++)
+                m_value[i] += m_factor * (input[i] - m_value[i]);
+        }
+        for (int i = 0; i < AXES; i++)
+            output[i] = m_value[i];
+    }
+
+protected:
+    float m_factor;
+    bool m_first;
+    double m_value[AXES];
+};
+
+}
+
+#endif //PROJECT_COBOTSYS_WRENCH_FILTER_H
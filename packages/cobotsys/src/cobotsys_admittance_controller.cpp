@@ -0,0 +1,123 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#include "cobotsys_admittance_controller.h"
+#include <algorithm>
+
+namespace cobotsys {
+
+namespace {
+const double MIN_SAMPLE_TIME = 1e-4;
+
+double deadZone(double value, double start, double end) {
+    if (value > end)
+        return value - end;
+    if (value >= start)
+        return 0.0;
+    return value - start;
+}
+}
+
+AdmittanceController::AdmittanceController() {
+    setParameters(Parameters());
+}
+
+void AdmittanceController::setParameters(const Parameters& parameters) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_parameters = parameters;
+        m_parameters.sampleTime = std::max(MIN_SAMPLE_TIME, parameters.sampleTime);
+        m_parameters.maxCatchUp = std::max(1, parameters.maxCatchUp);
+        m_period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(m_parameters.sampleTime));
+    }
+    reset();
+}
+
+AdmittanceController::Parameters AdmittanceController::getParameters() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_parameters;
+}
+
+void AdmittanceController::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_started = false;
+    m_count = 0;
+    for (int i = 0; i < AXES; i++) {
+        m_sum[i] = 0;
+        m_input[i] = 0;
+        m_integrator[i] = 0;
+        m_filter[i] = 0;
+        m_output[i] = 0;
+    }
+    m_statistics = Statistics();
+}
+
+int AdmittanceController::update(const double force[AXES], std::chrono::steady_clock::time_point time) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_statistics.samples++;
+
+    // 第一个采样确定节拍的起点
+    if (!m_started) {
+        m_started = true;
+        m_nextTick = time + m_period;
+    }
+
+    // 到期的节拍只使用这个采样之前的数据，这个采样计入下一个周期
+    int ticks = 0;
+    while (time >= m_nextTick) {
+        if (ticks >= m_parameters.maxCatchUp) {
+            uint64_t behind = (uint64_t) ((time - m_nextTick) / m_period) + 1;
+            m_statistics.skipped += behind;
+            m_nextTick += behind * m_period;
+            break;
+        }
+        tick();
+        m_nextTick += m_period;
+        ticks++;
+    }
+
+    for (int i = 0; i < AXES; i++)
+        m_sum[i] += force[i];
+    m_count++;
+    return ticks;
+}
+
+void AdmittanceController::output(double offset[AXES]) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int i = 0; i < AXES; i++)
+        offset[i] = m_output[i];
+}
+
+AdmittanceController::Statistics AdmittanceController::getStatistics() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+void AdmittanceController::tick() {
+    if (m_count > 0) {
+        for (int i = 0; i < AXES; i++) {
+            m_input[i] = m_sum[i] / m_count;
+            m_sum[i] = 0;
+        }
+        m_count = 0;
+    } else {
+        m_statistics.held++;
+    }
+
+    const Parameters& p = m_parameters;
+    const double ts = p.sampleTime;
+    for (int i = 0; i < AXES; i++) {
+        double e = deadZone(m_input[i], p.deadZoneStart[i], p.deadZoneEnd[i]);
+        double d = (p.D[i] * e - m_filter[i]) * p.N[i];
+        double u = (p.P[i] * e + m_integrator[i]) + d;
+        m_output[i] = std::min(p.saturationUpper[i], std::max(p.saturationLower[i], u));
+
+        m_integrator[i] += ts * (p.I[i] * e);
+        m_filter[i] += ts * d;
+    }
+    m_statistics.ticks++;
+}
+
+}
@@ -0,0 +1,425 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#include "cobotsys_capsule_collision.h"
+#include "extra2.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace cobotsys {
+
+namespace {
+const double LENGTH_TOLERANCE = 1e-6;
+const double BOX_SEARCH_TOLERANCE = 1e-4; // 线段上搜索到 0.1 毫米
+const double GOLDEN_RATIO = 0.6180339887498949;
+
+/**
+ * 两条线段之间的最短距离，Ericson《Real-Time Collision Detection》5.1.9
+ */
+double segmentDistance(const Eigen::Vector3d& p1, const Eigen::Vector3d& q1,
+                       const Eigen::Vector3d& p2, const Eigen::Vector3d& q2) {
+    Eigen::Vector3d d1 = q1 - p1;
+    Eigen::Vector3d d2 = q2 - p2;
+    Eigen::Vector3d r = p1 - p2;
+    double a = d1.squaredNorm();
+    double e = d2.squaredNorm();
+    double f = d2.dot(r);
+    double s = 0, t = 0;
+
+    if (a <= LENGTH_TOLERANCE * LENGTH_TOLERANCE && e <= LENGTH_TOLERANCE * LENGTH_TOLERANCE) {
+        return r.norm();
+    }
+    if (a <= LENGTH_TOLERANCE * LENGTH_TOLERANCE) {
+        t = std::max(0.0, std::min(1.0, f / e));
+    } else {
+        double c = d1.dot(r);
+        if (e <= LENGTH_TOLERANCE * LENGTH_TOLERANCE) {
+            s = std::max(0.0, std::min(1.0, -c / a));
+        } else {
+            double b = d1.dot(d2);
+            double denom = a * e - b * b;
+            s = denom > 0 ? std::max(0.0, std::min(1.0, (b * f - c * e) / denom)) : 0;
+            t = (b * s + f) / e;
+            if (t < 0) {
+                t = 0;
+                s = std::max(0.0, std::min(1.0, -c / a));
+            } else if (t > 1) {
+                t = 1;
+                s = std::max(0.0, std::min(1.0, (b - c) / a));
+            }
+        }
+    }
+    return (p1 + d1 * s - p2 - d2 * t).norm();
+}
+
+/**
+ * 点到以原点为中心、轴对齐长方体的有符号距离，内部为负
+ */
+inline double boxSignedDistance(const Eigen::Vector3d& p, const Eigen::Vector3d& halfSize) {
+    Eigen::Vector3d d = p.cwiseAbs() - halfSize;
+    return d.cwiseMax(0.0).norm() + std::min(d.maxCoeff(), 0.0);
+}
+
+/**
+ * 线段(已变换到长方体坐标系)到长方体的有符号距离。
+ * 有符号距离是凸函数，沿线段参数也是凸的，用黄金分割搜索最小值。
+ */
+double segmentBoxDistance(const Eigen::Vector3d& start, const Eigen::Vector3d& end, const Eigen::Vector3d& halfSize) {
+    Eigen::Vector3d dir = end - start;
+    double length = dir.norm();
+    double lo = 0, hi = 1;
+    double x1 = hi - GOLDEN_RATIO * (hi - lo);
+    double x2 = lo + GOLDEN_RATIO * (hi - lo);
+    double f1 = boxSignedDistance(start + x1 * dir, halfSize);
+    double f2 = boxSignedDistance(start + x2 * dir, halfSize);
+    while ((hi - lo) * length > BOX_SEARCH_TOLERANCE) {
+        if (f1 < f2) {
+            hi = x2;
+            x2 = x1;
+            f2 = f1;
+            x1 = hi - GOLDEN_RATIO * (hi - lo);
+            f1 = boxSignedDistance(start + x1 * dir, halfSize);
+        } else {
+            lo = x1;
+            x1 = x2;
+            f1 = f2;
+            x2 = lo + GOLDEN_RATIO * (hi - lo);
+            f2 = boxSignedDistance(start + x2 * dir, halfSize);
+        }
+    }
+    double best = std::min(f1, f2);
+    best = std::min(best, boxSignedDistance(start, halfSize));
+    return std::min(best, boxSignedDistance(end, halfSize));
+}
+
+/**
+ * 与 KDL::Rotation::RPY 相同：先绕 x 转 roll，再绕 y 转 pitch，再绕 z 转 yaw(固定轴)
+ */
+Eigen::Isometry3d readFrame(const QJsonObject& obj) {
+    std::vector<double> xyz = readRealArray(obj["xyz"]);
+    std::vector<double> rpy = readRealArray(obj["rpy"]);
+    xyz.resize(3, 0);
+    rpy.resize(3, 0);
+    Eigen::Isometry3d frame = Eigen::Isometry3d::Identity();
+    frame.linear() = (Eigen::AngleAxisd(rpy[2], Eigen::Vector3d::UnitZ()) *
+                      Eigen::AngleAxisd(rpy[1], Eigen::Vector3d::UnitY()) *
+                      Eigen::AngleAxisd(rpy[0], Eigen::Vector3d::UnitX())).toRotationMatrix();
+    frame.translation() = Eigen::Vector3d(xyz[0], xyz[1], xyz[2]);
+    return frame;
+}
+
+Eigen::Vector3d readVector3(const QJsonValue& value, double defaultValue) {
+    std::vector<double> values = readRealArray(value);
+    values.resize(3, defaultValue);
+    return Eigen::Vector3d(values[0], values[1], values[2]);
+}
+}
+
+
+CapsuleCollisionChecker::CapsuleCollisionChecker()
+        : m_baseRotation(Eigen::Matrix3d::Identity()), m_baseTranslation(Eigen::Vector3d::Zero()),
+          m_selfCollisionGap(2) {
+}
+
+bool CapsuleCollisionChecker::setup(const std::string& configPath) {
+    QJsonObject json;
+    if (!loadJson(json, configPath))
+        return false;
+
+    QJsonObject robotJson;
+    std::string kinematicConfig = json["kinematic_config"].toString().toStdString();
+    if (!loadJson(robotJson, kinematicConfig)) {
+        COBOT_LOG.error("Collision") << "Fail to load kinematic config: " << kinematicConfig;
+        return false;
+    }
+
+    std::vector<DhParam> dh;
+    foreach (const QJsonValue& value, robotJson["param"].toArray()) {
+        QJsonObject dhObj = value.toObject()["dh"].toObject();
+        DhParam param;
+        param.a = dhObj["a"].toDouble();
+        param.alpha = dhObj["alpha"].toDouble();
+        param.d = dhObj["d"].toDouble();
+        param.theta = dhObj["theta"].toDouble();
+        dh.push_back(param);
+    }
+
+    // 半径个数少于关节数时，剩下的连杆用最后一个半径
+    std::vector<double> linkRadius = readRealArray(json["link_radius"]);
+    if (linkRadius.empty())
+        linkRadius.push_back(0.05);
+    linkRadius.resize(dh.size(), linkRadius.back());
+
+    if (!setRobot(dh, readFrame(robotJson["world_base"].toObject()), readFrame(robotJson["ee_frame"].toObject()),
+                  linkRadius, json["tool_radius"].toDouble(0.04))) {
+        COBOT_LOG.error("Collision") << "Invalid robot in " << kinematicConfig;
+        return false;
+    }
+    setSelfCollisionGap(json["self_collision_gap"].toInt(2));
+    for (auto link : readRealArray(json["ignore_obstacle_links"]))
+        ignoreObstacleForLink((int) link);
+
+    clearObstacles();
+    foreach (const QJsonValue& value, json["boxes"].toArray()) {
+        QJsonObject boxObj = value.toObject();
+        addBox(boxObj["name"].toString().toStdString(), readFrame(boxObj), readVector3(boxObj["size"], 0));
+    }
+    foreach (const QJsonValue& value, json["planes"].toArray()) {
+        QJsonObject planeObj = value.toObject();
+        addPlane(planeObj["name"].toString().toStdString(), readVector3(planeObj["normal"], 0),
+                 planeObj["offset"].toDouble());
+    }
+    COBOT_LOG.info("Collision") << m_capsules.size() << " capsules, " << m_selfPairs.size() << " self pairs, "
+                                << obstacleCount() << " obstacles";
+    return true;
+}
+
+bool CapsuleCollisionChecker::setRobot(const std::vector<DhParam>& dh, const Eigen::Isometry3d& worldBase,
+                                       const Eigen::Isometry3d& eeFrame, const std::vector<double>& linkRadius,
+                                       double toolRadius) {
+    m_links.clear();
+    m_capsules.clear();
+    m_selfPairs.clear();
+    if (dh.empty() || dh.size() > MAX_JOINTS || linkRadius.size() != dh.size())
+        return false;
+
+    m_links = dh;
+    m_cosAlpha.resize(dh.size());
+    m_sinAlpha.resize(dh.size());
+    m_baseRotation = worldBase.linear();
+    m_baseTranslation = worldBase.translation();
+
+    int link = 0;
+    for (size_t i = 0; i < dh.size(); i++) {
+        m_cosAlpha[i] = std::cos(dh[i].alpha);
+        m_sinAlpha[i] = std::sin(dh[i].alpha);
+
+        // 沿 z(i-1) 的部分固定在前一个坐标系，沿 x(i) 的部分固定在后一个坐标系
+        bool hasCapsule = false;
+        Capsule capsule;
+        capsule.dhLink = (int) i;
+        capsule.link = link;
+        capsule.checkObstacle = true;
+        capsule.radius = linkRadius[i];
+        if (std::fabs(dh[i].d) > LENGTH_TOLERANCE) {
+            capsule.frame = (int) i;
+            capsule.start = Eigen::Vector3d::Zero();
+            capsule.end = Eigen::Vector3d(0, 0, dh[i].d);
+            m_capsules.push_back(capsule);
+            hasCapsule = true;
+        }
+        if (std::fabs(dh[i].a) > LENGTH_TOLERANCE) {
+            capsule.frame = (int) i + 1;
+            capsule.start = Eigen::Vector3d(-dh[i].a, 0, 0);
+            capsule.end = Eigen::Vector3d::Zero();
+            m_capsules.push_back(capsule);
+            hasCapsule = true;
+        }
+        if (hasCapsule)
+            link++;
+    }
+    if (eeFrame.translation().norm() > LENGTH_TOLERANCE) {
+        Capsule capsule;
+        capsule.frame = (int) dh.size();
+        capsule.dhLink = (int) dh.size();
+        capsule.link = link;
+        capsule.checkObstacle = true;
+        capsule.start = Eigen::Vector3d::Zero();
+        capsule.end = eeFrame.translation();
+        capsule.radius = toolRadius;
+        m_capsules.push_back(capsule);
+    }
+
+    updatePairs();
+    return !m_capsules.empty();
+}
+
+void CapsuleCollisionChecker::setSelfCollisionGap(int gap) {
+    m_selfCollisionGap = gap;
+    updatePairs();
+}
+
+void CapsuleCollisionChecker::ignoreObstacleForLink(int link) {
+    if (std::find(m_ignoreObstacleLinks.begin(), m_ignoreObstacleLinks.end(), link) == m_ignoreObstacleLinks.end())
+        m_ignoreObstacleLinks.push_back(link);
+    updatePairs();
+}
+
+void CapsuleCollisionChecker::updatePairs() {
+    m_selfPairs.clear();
+    for (size_t i = 0; i < m_capsules.size(); i++) {
+        Capsule& capsule = m_capsules[i];
+        capsule.checkObstacle = std::find(m_ignoreObstacleLinks.begin(), m_ignoreObstacleLinks.end(),
+                                          capsule.dhLink) == m_ignoreObstacleLinks.end();
+        for (size_t j = i + 1; j < m_capsules.size(); j++) {
+            if (std::abs(m_capsules[j].link - capsule.link) >= m_selfCollisionGap)
+                m_selfPairs.push_back(std::make_pair((int) i, (int) j));
+        }
+    }
+}
+
+void CapsuleCollisionChecker::addBox(const std::string& name, const Eigen::Isometry3d& pose,
+                                     const Eigen::Vector3d& size) {
+    Box box;
+    box.name = name;
+    box.rotation = pose.linear();
+    box.center = pose.translation();
+    box.halfSize = size.cwiseAbs() * 0.5;
+    m_boxes.push_back(box);
+}
+
+void CapsuleCollisionChecker::addPlane(const std::string& name, const Eigen::Vector3d& normal, double offset) {
+    double norm = normal.norm();
+    if (norm < LENGTH_TOLERANCE) {
+        COBOT_LOG.warning("Collision") << "Ignore plane " << name << " with zero normal";
+        return;
+    }
+    Plane plane;
+    plane.name = name;
+    plane.normal = normal / norm;
+    plane.offset = offset / norm;
+    m_planes.push_back(plane);
+}
+
+void CapsuleCollisionChecker::clearObstacles() {
+    m_boxes.clear();
+    m_planes.clear();
+}
+
+const std::string& CapsuleCollisionChecker::obstacleName(int obstacle) const {
+    static const std::string unknown;
+    if (obstacle >= 0 && obstacle < (int) m_boxes.size())
+        return m_boxes[obstacle].name;
+    obstacle -= (int) m_boxes.size();
+    if (obstacle >= 0 && obstacle < (int) m_planes.size())
+        return m_planes[obstacle].name;
+    return unknown;
+}
+
+void CapsuleCollisionChecker::computeSegments(const double* q, Eigen::Vector3d* start, Eigen::Vector3d* end) const {
+    // 各连杆坐标系的位姿，逐个右乘 RotZ(theta + q) * TransZ(d) * TransX(a) * RotX(alpha)
+    Eigen::Matrix3d rotations[MAX_JOINTS + 1];
+    Eigen::Vector3d origins[MAX_JOINTS + 1];
+    rotations[0] = m_baseRotation;
+    origins[0] = m_baseTranslation;
+    for (size_t i = 0; i < m_links.size(); i++) {
+        const Eigen::Matrix3d& r = rotations[i];
+        double st = std::sin(m_links[i].theta + q[i]);
+        double ct = std::cos(m_links[i].theta + q[i]);
+        Eigen::Vector3d x = ct * r.col(0) + st * r.col(1);
+        Eigen::Vector3d y = ct * r.col(1) - st * r.col(0);
+        Eigen::Matrix3d& next = rotations[i + 1];
+        next.col(0) = x;
+        next.col(1) = m_cosAlpha[i] * y + m_sinAlpha[i] * r.col(2);
+        next.col(2) = m_cosAlpha[i] * r.col(2) - m_sinAlpha[i] * y;
+        origins[i + 1] = origins[i] + m_links[i].d * r.col(2) + m_links[i].a * x;
+    }
+
+    for (size_t i = 0; i < m_capsules.size(); i++) {
+        const Capsule& capsule = m_capsules[i];
+        start[i] = rotations[capsule.frame] * capsule.start + origins[capsule.frame];
+        end[i] = rotations[capsule.frame] * capsule.end + origins[capsule.frame];
+    }
+}
+
+double CapsuleCollisionChecker::distance(const double* q, DistanceResult* result) const {
+    DistanceResult best;
+    best.distance = std::numeric_limits<double>::max();
+    if (m_capsules.empty()) {
+        if (result)
+            *result = best;
+        return best.distance;
+    }
+
+    Eigen::Vector3d start[MAX_CAPSULES], end[MAX_CAPSULES];
+    computeSegments(q, start, end);
+
+    for (auto& pair : m_selfPairs) {
+        double dist = segmentDistance(start[pair.first], end[pair.first], start[pair.second], end[pair.second]) -
+                      m_capsules[pair.first].radius - m_capsules[pair.second].radius;
+        if (dist < best.distance) {
+            best.distance = dist;
+            best.capsule = pair.first;
+            best.other = pair.second;
+            best.isObstacle = false;
+        }
+    }
+
+    for (size_t i = 0; i < m_capsules.size(); i++) {
+        const Capsule& capsule = m_capsules[i];
+        if (!capsule.checkObstacle)
+            continue;
+
+        for (size_t k = 0; k < m_planes.size(); k++) {
+            const Plane& plane = m_planes[k];
+            double dist = std::min(plane.normal.dot(start[i]), plane.normal.dot(end[i])) - plane.offset -
+                          capsule.radius;
+            if (dist < best.distance) {
+                best.distance = dist;
+                best.capsule = (int) i;
+                best.other = (int) (m_boxes.size() + k);
+                best.isObstacle = true;
+            }
+        }
+
+        Eigen::Vector3d center = (start[i] + end[i]) * 0.5;
+        double halfLength = (end[i] - start[i]).norm() * 0.5;
+        for (size_t k = 0; k < m_boxes.size(); k++) {
+            const Box& box = m_boxes[k];
+            // 包围球已经比当前最小距离远，不用精确计算
+            double lowerBound = (center - box.center).norm() - halfLength - box.halfSize.norm() - capsule.radius;
+            if (lowerBound >= best.distance)
+                continue;
+
+            Eigen::Vector3d localStart = box.rotation.transpose() * (start[i] - box.center);
+            Eigen::Vector3d localEnd = box.rotation.transpose() * (end[i] - box.center);
+            double dist = segmentBoxDistance(localStart, localEnd, box.halfSize) - capsule.radius;
+            if (dist < best.distance) {
+                best.distance = dist;
+                best.capsule = (int) i;
+                best.other = (int) k;
+                best.isObstacle = true;
+            }
+        }
+    }
+
+    if (result)
+        *result = best;
+    return best.distance;
+}
+
+double CapsuleCollisionChecker::distance(const std::vector<double>& q, DistanceResult* result) const {
+    if (q.size() != m_links.size()) {
+        COBOT_LOG.error("Collision") << "Joint count mismatch: " << q.size() << " vs " << m_links.size();
+        if (result)
+            *result = DistanceResult();
+        return 0;
+    }
+    return distance(q.data(), result);
+}
+
+void CapsuleCollisionChecker::distanceBatch(const double* q, size_t count, double* distances) const {
+    size_t jointNum = m_links.size();
+    for (size_t i = 0; i < count; i++)
+        distances[i] = distance(q + i * jointNum);
+}
+
+int CapsuleCollisionChecker::firstCollision(const std::vector<std::vector<double> >& trajectory, double margin) const {
+    for (size_t i = 0; i < trajectory.size(); i++) {
+        if (distance(trajectory[i]) < margin)
+            return (int) i;
+    }
+    return -1;
+}
+
+void CapsuleCollisionChecker::capsuleSegments(const double* q, std::vector<Eigen::Vector3d>& start,
+                                              std::vector<Eigen::Vector3d>& end) const {
+    start.resize(m_capsules.size());
+    end.resize(m_capsules.size());
+    if (!m_capsules.empty())
+        computeSegments(q, start.data(), end.data());
+}
+
+}
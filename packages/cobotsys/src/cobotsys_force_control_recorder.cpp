@@ -0,0 +1,237 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#include "cobotsys_force_control_recorder.h"
+#include "cobotsys_logger.h"
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace cobotsys {
+
+namespace {
+const char RECORD_MAGIC[8] = {'C', 'B', 'F', 'C', 'R', 'E', 'C', '1'};
+const int WRITER_PERIOD_MS = 2;
+const int HEADER_UPDATE_PERIOD = 50; ///< 每隔多少个写线程周期更新一次 Header
+
+static_assert(sizeof(ForceControlRecorder::Header) == 64, "Header must be 64 bytes");
+
+void fillNaN(double values[6]) {
+    for (int i = 0; i < 6; i++)
+        values[i] = std::numeric_limits<double>::quiet_NaN();
+}
+}
+
+void ForceControlRecord::clear() {
+    fillNaN(rawWrench);
+    fillNaN(compensatedWrench);
+    fillNaN(filteredWrench);
+    fillNaN(offset);
+    fillNaN(commandQ);
+    fillNaN(measuredQ);
+}
+
+ForceControlRecorder::ForceControlRecorder() :
+        m_sensorRing(new RecordRing),
+        m_robotRing(new RecordRing),
+        m_sensorRead(1),
+        m_robotRead(1),
+        m_fd(-1),
+        m_mapping(nullptr),
+        m_mappingSize(0),
+        m_header(nullptr),
+        m_records(nullptr),
+        m_capacity(0),
+        m_running(false),
+        m_written(0),
+        m_lost(0),
+        m_overflow(0) {
+}
+
+ForceControlRecorder::~ForceControlRecorder() {
+    close();
+}
+
+void ForceControlRecorder::record(const ForceControlRecord& record) {
+    if (!m_running)
+        return;
+    RecordRing& ring = record.source == ForceControlRecord::SOURCE_SENSOR ? *m_sensorRing : *m_robotRing;
+    ForceControlRecord copy = record;
+    copy.sequence = (uint32_t) (ring.written() + 1);
+    ring.push(copy);
+}
+
+ForceControlRecorder::Statistics ForceControlRecorder::getStatistics() const {
+    Statistics statistics;
+    statistics.written = m_written;
+    statistics.lost = m_lost;
+    statistics.overflow = m_overflow;
+    return statistics;
+}
+
+void ForceControlRecorder::drain(RecordRing& ring, uint64_t& nextSequence) {
+    uint64_t newest = ring.written();
+    if (newest >= nextSequence + RING_CAPACITY) {
+        uint64_t oldest = newest - RING_CAPACITY + 1;
+        m_lost += oldest - nextSequence;
+        nextSequence = oldest;
+    }
+
+    ForceControlRecord record;
+    uint64_t written = m_written.load(std::memory_order_relaxed);
+    for (; nextSequence <= newest; nextSequence++) {
+        if (!ring.at(nextSequence, record)) {
+            m_lost++;
+            continue;
+        }
+        if (written >= m_capacity) {
+            m_overflow++;
+            continue;
+        }
+        m_records[written++] = record;
+    }
+    m_written.store(written, std::memory_order_relaxed);
+}
+
+void ForceControlRecorder::updateHeader() {
+    m_header->recordCount = m_written;
+    m_header->lost = m_lost;
+    m_header->overflow = m_overflow;
+}
+
+void ForceControlRecorder::writerThreadFunc() {
+    int period = 0;
+    while (m_running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_PERIOD_MS));
+        drain(*m_sensorRing, m_sensorRead);
+        drain(*m_robotRing, m_robotRead);
+        if (++period >= HEADER_UPDATE_PERIOD) {
+            period = 0;
+            updateHeader();
+        }
+    }
+}
+
+bool ForceControlRecorder::load(const std::string& filePath, Header& header, std::vector<ForceControlRecord>& records) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file || !file.read((char*) &header, sizeof(header))) {
+        COBOT_LOG.error("Recorder") << "Fail to read " << filePath;
+        return false;
+    }
+    if (std::memcmp(header.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC)) != 0 || header.version != VERSION ||
+        header.recordSize != sizeof(ForceControlRecord)) {
+        COBOT_LOG.error("Recorder") << "Unsupported record file " << filePath;
+        return false;
+    }
+
+    records.resize(header.recordCount);
+    file.read((char*) records.data(), records.size() * sizeof(ForceControlRecord));
+    records.resize(file.gcount() / sizeof(ForceControlRecord));
+    return true;
+}
+
+#if defined(__linux__)
+
+bool ForceControlRecorder::open(const std::string& filePath, uint64_t maxRecords) {
+    close();
+    if (maxRecords == 0)
+        return false;
+
+    m_fd = ::open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0) {
+        COBOT_LOG.error("Recorder") << "Fail to open " << filePath << ", " << strerror(errno);
+        return false;
+    }
+
+    // 预先分配磁盘空间，写入时不会因为扩展文件而阻塞
+    m_mappingSize = sizeof(Header) + maxRecords * sizeof(ForceControlRecord);
+    int error = posix_fallocate(m_fd, 0, (off_t) m_mappingSize);
+    if (error == 0) {
+        m_mapping = mmap(nullptr, m_mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (m_mapping == MAP_FAILED) {
+            error = errno;
+            m_mapping = nullptr;
+        }
+    }
+    if (error != 0) {
+        COBOT_LOG.error("Recorder") << "Fail to map " << filePath << ", " << strerror(error);
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    madvise(m_mapping, m_mappingSize, MADV_SEQUENTIAL);
+
+    m_header = (Header*) m_mapping;
+    m_records = (ForceControlRecord*) ((char*) m_mapping + sizeof(Header));
+    m_capacity = maxRecords;
+
+    std::memset(m_header, 0, sizeof(Header));
+    std::memcpy(m_header->magic, RECORD_MAGIC, sizeof(RECORD_MAGIC));
+    m_header->version = VERSION;
+    m_header->recordSize = sizeof(ForceControlRecord);
+    m_header->capacity = maxRecords;
+    m_header->startTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    m_header->wallTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
+    // 之前留在缓冲区里的记录不写入新文件
+    m_sensorRead = m_sensorRing->written() + 1;
+    m_robotRead = m_robotRing->written() + 1;
+    m_written = 0;
+    m_lost = 0;
+    m_overflow = 0;
+
+    m_running = true;
+    m_thread = std::thread(&ForceControlRecorder::writerThreadFunc, this);
+    COBOT_LOG.notice("Recorder") << "Recording to " << filePath << ", capacity: " << maxRecords;
+    return true;
+}
+
+void ForceControlRecorder::close() {
+    if (!m_running)
+        return;
+    m_running = false;
+    m_thread.join();
+
+    drain(*m_sensorRing, m_sensorRead);
+    drain(*m_robotRing, m_robotRead);
+    updateHeader();
+
+    size_t fileSize = sizeof(Header) + m_written * sizeof(ForceControlRecord);
+    msync(m_mapping, fileSize, MS_SYNC);
+    munmap(m_mapping, m_mappingSize);
+    if (ftruncate(m_fd, (off_t) fileSize) != 0) {
+        COBOT_LOG.warning("Recorder") << "Fail to truncate record file, " << strerror(errno);
+    }
+    ::close(m_fd);
+
+    m_fd = -1;
+    m_mapping = nullptr;
+    m_header = nullptr;
+    m_records = nullptr;
+    COBOT_LOG.notice("Recorder") << "Records: " << m_written << ", lost: " << m_lost << ", overflow: " << m_overflow;
+}
+
+#else
+
+bool ForceControlRecorder::open(const std::string&, uint64_t) {
+    COBOT_LOG.error("Recorder") << "Force control recorder is only supported on Linux";
+    return false;
+}
+
+void ForceControlRecorder::close() {
+}
+
+#endif
+
+}
@@ -0,0 +1,162 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#include "cobotsys_gravity_compensation.h"
+#include "extra2.h"
+#include <Eigen/SVD>
+#include <QFile>
+#include <QJsonDocument>
+#include <cmath>
+#include <limits>
+
+namespace cobotsys {
+
+namespace {
+const double GRAVITY_ACCELERATION = 9.81;
+
+bool readVector3(const QJsonValue& value, Eigen::Vector3d& vector) {
+    std::vector<double> values = readRealArray(value);
+    if (values.size() != 3)
+        return false;
+    vector = Eigen::Vector3d(values[0], values[1], values[2]);
+    return true;
+}
+
+QJsonArray toJsonArray(const Eigen::Vector3d& vector) {
+    QJsonArray array;
+    for (int i = 0; i < 3; i++)
+        array.append(vector[i]);
+    return array;
+}
+
+Eigen::Matrix3d skew(const Eigen::Vector3d& v) {
+    Eigen::Matrix3d m;
+    m << 0, -v.z(), v.y(),
+            v.z(), 0, -v.x(),
+            -v.y(), v.x(), 0;
+    return m;
+}
+}
+
+GravityCompensation::GravityCompensation() {
+}
+
+void GravityCompensation::setParameters(const Parameters& parameters) {
+    m_parameters = parameters;
+}
+
+bool GravityCompensation::load(const std::string& configPath) {
+    QJsonObject json;
+    if (!loadJson(json, configPath))
+        return false;
+
+    Parameters parameters;
+    if (!readVector3(json["gravity"], parameters.gravity)) {
+        COBOT_LOG.error("Gravity") << "Missing \"gravity\" in " << configPath;
+        return false;
+    }
+    readVector3(json["center"], parameters.center);
+    readVector3(json["force_offset"], parameters.forceOffset);
+    readVector3(json["torque_offset"], parameters.torqueOffset);
+    m_parameters = parameters;
+    return true;
+}
+
+bool GravityCompensation::save(const std::string& filePath) const {
+    QJsonObject json;
+    json["gravity"] = toJsonArray(m_parameters.gravity);
+    json["center"] = toJsonArray(m_parameters.center);
+    json["force_offset"] = toJsonArray(m_parameters.forceOffset);
+    json["torque_offset"] = toJsonArray(m_parameters.torqueOffset);
+    json["mass"] = mass();
+
+    QFile file(QString::fromStdString(filePath));
+    if (!file.open(QIODevice::WriteOnly)) {
+        COBOT_LOG.error("Gravity") << file.errorString() << ", " << filePath;
+        return false;
+    }
+    file.write(QJsonDocument(json).toJson());
+    return true;
+}
+
+void GravityCompensation::gravityWrench(const Eigen::Matrix3d& rotation, double wrench[6]) const {
+    Eigen::Vector3d force = rotation.transpose() * m_parameters.gravity;
+    Eigen::Vector3d torque = m_parameters.center.cross(force);
+    for (int i = 0; i < 3; i++) {
+        wrench[i] = force[i];
+        wrench[i + 3] = torque[i];
+    }
+}
+
+void GravityCompensation::compensate(const Eigen::Matrix3d& rotation, const double raw[6], double external[6]) const {
+    double gravity[6];
+    gravityWrench(rotation, gravity);
+    for (int i = 0; i < 3; i++) {
+        external[i] = raw[i] - m_parameters.forceOffset[i] - gravity[i];
+        external[i + 3] = raw[i + 3] - m_parameters.torqueOffset[i] - gravity[i + 3];
+    }
+}
+
+double GravityCompensation::mass() const {
+    return m_parameters.gravity.norm() / GRAVITY_ACCELERATION;
+}
+
+GravityCalibrator::GravityCalibrator() {
+}
+
+void GravityCalibrator::clear() {
+    m_samples.clear();
+}
+
+void GravityCalibrator::addSample(const Eigen::Matrix3d& rotation, const double wrench[6]) {
+    Sample sample;
+    sample.rotation = rotation;
+    sample.force = Eigen::Vector3d(wrench[0], wrench[1], wrench[2]);
+    sample.torque = Eigen::Vector3d(wrench[3], wrench[4], wrench[5]);
+    m_samples.push_back(sample);
+}
+
+int GravityCalibrator::solve(Result& result, double maxConditionNumber) const {
+    const int count = (int) m_samples.size();
+    if (count < 3)
+        return -1;
+
+    // 第一步: f = R^T * G + F0，未知数 [G, F0]
+    Eigen::MatrixXd A(3 * count, 6);
+    Eigen::VectorXd b(3 * count);
+    for (int i = 0; i < count; i++) {
+        A.block<3, 3>(3 * i, 0) = m_samples[i].rotation.transpose();
+        A.block<3, 3>(3 * i, 3).setIdentity();
+        b.segment<3>(3 * i) = m_samples[i].force;
+    }
+    Eigen::JacobiSVD<Eigen::MatrixXd> forceSvd(A, Eigen::ComputeThinU | Eigen::ComputeThinV);
+    const Eigen::VectorXd& sv = forceSvd.singularValues();
+    result.conditionNumber = sv[sv.size() - 1] > 0 ? sv[0] / sv[sv.size() - 1]
+                                                   : std::numeric_limits<double>::infinity();
+    if (result.conditionNumber > maxConditionNumber)
+        return -2;
+
+    Eigen::VectorXd x = forceSvd.solve(b);
+    GravityCompensation::Parameters& parameters = result.parameters;
+    parameters.gravity = x.head<3>();
+    parameters.forceOffset = x.tail<3>();
+    result.forceRms = std::sqrt((A * x - b).squaredNorm() / (3 * count));
+
+    // 第二步: t = c x (R^T * G) + T0 = -[R^T * G]x * c + T0，未知数 [c, T0]
+    // 负载很轻时重心不可观，SVD 给出最小范数解，重心趋于 0
+    for (int i = 0; i < count; i++) {
+        A.block<3, 3>(3 * i, 0) = -skew(m_samples[i].rotation.transpose() * parameters.gravity);
+        b.segment<3>(3 * i) = m_samples[i].torque;
+    }
+    Eigen::JacobiSVD<Eigen::MatrixXd> torqueSvd(A, Eigen::ComputeThinU | Eigen::ComputeThinV);
+    x = torqueSvd.solve(b);
+    parameters.center = x.head<3>();
+    parameters.torqueOffset = x.tail<3>();
+    result.torqueRms = std::sqrt((A * x - b).squaredNorm() / (3 * count));
+
+    result.mass = parameters.gravity.norm() / GRAVITY_ACCELERATION;
+    return 0;
+}
+
+}
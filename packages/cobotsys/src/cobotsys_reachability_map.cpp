@@ -0,0 +1,280 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#include "cobotsys_reachability_map.h"
+#include "cobotsys_logger.h"
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace cobotsys {
+
+namespace {
+const char FILE_MAGIC[8] = "CRMAP";
+const uint32_t FILE_VERSION = 1;
+const double PI = 3.14159265358979323846; // M_PI 不是标准 C++，MSVC 下默认没有定义
+const double JOINT_QUANTUM = 2 * PI / 32767;
+
+/**
+ * 方向位图里置位的个数，不依赖编译器内建函数
+ */
+inline size_t countBits(uint32_t mask) {
+    return std::bitset<32>(mask).count();
+}
+
+inline int16_t quantizeJoint(double q) {
+    double value = std::round(q / JOINT_QUANTUM);
+    return (int16_t) std::max(-32767.0, std::min(32767.0, value));
+}
+
+inline double dequantizeJoint(int16_t value) {
+    return value * JOINT_QUANTUM;
+}
+
+template<class T>
+void writeValue(std::ofstream& out, const T& value) {
+    out.write((const char*) &value, sizeof(T));
+}
+
+template<class T>
+void readValue(std::ifstream& in, T& value) {
+    in.read((char*) &value, sizeof(T));
+}
+
+template<class T>
+void writeArray(std::ofstream& out, const std::vector<T>& values) {
+    if (!values.empty())
+        out.write((const char*) values.data(), values.size() * sizeof(T));
+}
+
+template<class T>
+void readArray(std::ifstream& in, std::vector<T>& values, uint64_t count) {
+    values.resize(count);
+    if (count)
+        in.read((char*) values.data(), count * sizeof(T));
+}
+}
+
+
+ReachabilityMap::ReachabilityMap()
+        : m_minCorner(Eigen::Vector3d::Zero()), m_resolution(0), m_dims(Eigen::Vector3i::Zero()) {
+}
+
+int ReachabilityMap::directionBin(const Eigen::Vector3d& direction) {
+    // 立方体贴图：绝对值最大的分量决定面，另外两个分量的符号决定面上的 2x2 区域
+    int axis = 0;
+    Eigen::Vector3d absDir = direction.cwiseAbs();
+    if (absDir[1] > absDir[axis]) axis = 1;
+    if (absDir[2] > absDir[axis]) axis = 2;
+    int face = axis * 2 + (direction[axis] < 0 ? 1 : 0);
+    int sub = (direction[(axis + 1) % 3] >= 0 ? 1 : 0) + (direction[(axis + 2) % 3] >= 0 ? 2 : 0);
+    return face * 4 + sub;
+}
+
+int64_t ReachabilityMap::cellIndex(const Eigen::Vector3d& position) const {
+    if (m_resolution <= 0)
+        return -1;
+    int64_t index[3];
+    for (int i = 0; i < 3; i++) {
+        double cell = std::floor((position[i] - m_minCorner[i]) / m_resolution);
+        if (!(cell >= 0 && cell < m_dims[i])) // NaN 也在这里排除
+            return -1;
+        index[i] = (int64_t) cell;
+    }
+    return (index[2] * m_dims[1] + index[1]) * m_dims[0] + index[0];
+}
+
+bool ReachabilityMap::cellSeed(int64_t cell, int bin, Joint6d& joint) const {
+    uint32_t mask = m_masks[cell];
+    if ((mask & (1u << bin)) == 0)
+        return false;
+
+    // 体素内的关节角按方向序号连续存放，前面置位的个数就是偏移
+    size_t seedIndex = m_firstSeed[cell] + countBits(mask & ((1u << bin) - 1));
+    const int16_t* values = &m_seeds[seedIndex * JOINT_NUM];
+    for (int j = 0; j < JOINT_NUM; j++)
+        joint[j] = dequantizeJoint(values[j]);
+    return true;
+}
+
+bool ReachabilityMap::isReachable(const Eigen::Vector3d& position) const {
+    int64_t cell = cellIndex(position);
+    return cell >= 0 && m_masks[cell] != 0;
+}
+
+bool ReachabilityMap::isReachable(const Eigen::Isometry3d& pose) const {
+    int64_t cell = cellIndex(pose.translation());
+    if (cell < 0)
+        return false;
+    return (m_masks[cell] & (1u << directionBin(pose.linear().col(2)))) != 0;
+}
+
+double ReachabilityMap::coverage(const Eigen::Vector3d& position) const {
+    int64_t cell = cellIndex(position);
+    if (cell < 0)
+        return 0;
+    return (double) countBits(m_masks[cell]) / DIRECTION_BINS;
+}
+
+bool ReachabilityMap::seed(const Eigen::Isometry3d& pose, Joint6d& joint) const {
+    int64_t cell = cellIndex(pose.translation());
+    if (cell < 0)
+        return false;
+    return cellSeed(cell, directionBin(pose.linear().col(2)), joint);
+}
+
+bool ReachabilityMap::save(const std::string& filePath) const {
+    std::ofstream out(filePath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        COBOT_LOG.error("ReachabilityMap") << "Fail to open " << filePath;
+        return false;
+    }
+
+    out.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+    writeValue(out, FILE_VERSION);
+    writeValue(out, (uint32_t) JOINT_NUM);
+    writeValue(out, (uint32_t) DIRECTION_BINS);
+    for (int i = 0; i < 3; i++)
+        writeValue(out, m_minCorner[i]);
+    writeValue(out, m_resolution);
+    for (int i = 0; i < 3; i++)
+        writeValue(out, (int32_t) m_dims[i]);
+    writeValue(out, (uint64_t) m_masks.size());
+    writeValue(out, (uint64_t) seedCount());
+    writeArray(out, m_masks);
+    writeArray(out, m_firstSeed);
+    writeArray(out, m_seeds);
+
+    if (!out.good()) {
+        COBOT_LOG.error("ReachabilityMap") << "Fail to write " << filePath;
+        return false;
+    }
+    return true;
+}
+
+bool ReachabilityMap::load(const std::string& filePath) {
+    std::ifstream in(filePath, std::ios::binary);
+    if (!in.is_open()) {
+        COBOT_LOG.error("ReachabilityMap") << "Fail to open " << filePath;
+        return false;
+    }
+
+    char magic[sizeof(FILE_MAGIC)];
+    uint32_t version = 0, jointNum = 0, binNum = 0;
+    in.read(magic, sizeof(magic));
+    readValue(in, version);
+    readValue(in, jointNum);
+    readValue(in, binNum);
+    if (!in.good() || std::memcmp(magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || version != FILE_VERSION ||
+        jointNum != JOINT_NUM || binNum != DIRECTION_BINS) {
+        COBOT_LOG.error("ReachabilityMap") << "Unsupported reachability map: " << filePath;
+        return false;
+    }
+
+    ReachabilityMap map;
+    int32_t dims[3];
+    uint64_t cellCount = 0, seedNum = 0;
+    for (int i = 0; i < 3; i++)
+        readValue(in, map.m_minCorner[i]);
+    readValue(in, map.m_resolution);
+    for (int i = 0; i < 3; i++) {
+        readValue(in, dims[i]);
+        map.m_dims[i] = dims[i];
+    }
+    readValue(in, cellCount);
+    readValue(in, seedNum);
+    if (!in.good() || map.m_resolution <= 0 || dims[0] <= 0 || dims[1] <= 0 || dims[2] <= 0 ||
+        cellCount != (uint64_t) dims[0] * dims[1] * dims[2]) {
+        COBOT_LOG.error("ReachabilityMap") << "Corrupted reachability map header: " << filePath;
+        return false;
+    }
+
+    readArray(in, map.m_masks, cellCount);
+    readArray(in, map.m_firstSeed, cellCount);
+    readArray(in, map.m_seeds, seedNum * JOINT_NUM);
+    if (!in.good()) {
+        COBOT_LOG.error("ReachabilityMap") << "Truncated reachability map: " << filePath;
+        return false;
+    }
+
+    // 检查每个体素的关节角都在数组范围内，查询时就不用再检查
+    for (uint64_t cell = 0; cell < cellCount; cell++) {
+        if (map.m_firstSeed[cell] + (uint64_t) countBits(map.m_masks[cell]) > seedNum) {
+            COBOT_LOG.error("ReachabilityMap") << "Corrupted reachability map data: " << filePath;
+            return false;
+        }
+    }
+
+    *this = std::move(map);
+    return true;
+}
+
+
+ReachabilityMapBuilder::ReachabilityMapBuilder(const Eigen::Vector3d& minCorner, const Eigen::Vector3d& maxCorner,
+                                               double resolution)
+        : m_sampleCount(0) {
+    m_grid.m_minCorner = minCorner;
+    m_grid.m_resolution = resolution;
+    for (int i = 0; i < 3; i++) {
+        double extent = resolution > 0 ? (maxCorner[i] - minCorner[i]) / resolution : 0;
+        m_grid.m_dims[i] = std::max(1, (int) std::ceil(extent));
+    }
+}
+
+bool ReachabilityMapBuilder::addSample(const Eigen::Isometry3d& pose, const ReachabilityMap::Joint6d& joint,
+                                       double score) {
+    int64_t cell = m_grid.cellIndex(pose.translation());
+    if (cell < 0)
+        return false;
+
+    m_sampleCount++;
+    uint64_t key = (uint64_t) cell * ReachabilityMap::DIRECTION_BINS +
+                   ReachabilityMap::directionBin(pose.linear().col(2));
+    auto iter = m_entries.find(key);
+    if (iter != m_entries.end() && iter->second.score >= score)
+        return true;
+
+    Entry& entry = m_entries[key];
+    entry.score = score;
+    for (int j = 0; j < ReachabilityMap::JOINT_NUM; j++)
+        entry.joint[j] = joint[j];
+    return true;
+}
+
+void ReachabilityMapBuilder::build(ReachabilityMap& map) const {
+    const Eigen::Vector3i& dims = m_grid.m_dims;
+    size_t cellCount = (size_t) dims[0] * dims[1] * dims[2];
+
+    // 键按体素、方向排序，关节角就按 cellSeed() 要求的顺序存放
+    std::vector<uint64_t> keys;
+    keys.reserve(m_entries.size());
+    for (auto& item : m_entries)
+        keys.push_back(item.first);
+    std::sort(keys.begin(), keys.end());
+
+    map.m_minCorner = m_grid.m_minCorner;
+    map.m_resolution = m_grid.m_resolution;
+    map.m_dims = dims;
+    map.m_masks.assign(cellCount, 0);
+    map.m_firstSeed.assign(cellCount, 0);
+    map.m_seeds.resize(keys.size() * ReachabilityMap::JOINT_NUM);
+
+    size_t next = 0;
+    for (size_t cell = 0; cell < cellCount; cell++) {
+        map.m_firstSeed[cell] = (uint32_t) next;
+        for (; next < keys.size() && keys[next] / ReachabilityMap::DIRECTION_BINS == cell; next++) {
+            int bin = (int) (keys[next] % ReachabilityMap::DIRECTION_BINS);
+            map.m_masks[cell] |= 1u << bin;
+
+            const Entry& entry = m_entries.at(keys[next]);
+            int16_t* values = &map.m_seeds[next * ReachabilityMap::JOINT_NUM];
+            for (int j = 0; j < ReachabilityMap::JOINT_NUM; j++)
+                values[j] = quantizeJoint(entry.joint[j]);
+        }
+    }
+}
+
+}
@@ -7,8 +7,21 @@
 #include <QtCore/QJsonObject>
 #include <QtCore/qjsonarray.h>
 #include <extra2.h>
-
-ForceControlSolver::ForceControlSolver() : QObject(nullptr) {
+#include <algorithm>
+#include <cmath>
+
+ForceControlSolver::ForceControlSolver() :
+	QObject(nullptr),
+	m_offsetFilterPeriod(0.008),
+	m_hasSolveTime(false),
+	m_controlLoop(false),
+	m_pidSensorRate(125),
+	m_rateCheckCount(0),
+	m_rateChecked(false),
+	m_timeAlignment(true),
+	m_maxExtrapolation(0.008),
+	m_skewSum(0)
+{
 	for (int i = 0; i < 3; i++)
 	{
 		m_gravity[i] = 0;
@@ -22,9 +35,8 @@ ForceControlSolver::ForceControlSolver() : QObject(nullptr) {
 		m_offsetEE[i] = 0;
 	}
 
-	m_jntSize = 6;
 	m_posEfFactor = 0.1;
-	m_posEf.init(m_jntSize, m_posEfFactor);
+	m_offsetFilter.setFactor(m_posEfFactor);
 
 	//construct ForceControllerClass
 	ForceControllerClass();
@@ -47,13 +59,19 @@ void ForceControlSolver::onForceSensorDataStreamUpdate(const std::shared_ptr<cob
 	m_wrenchData.torque.x = ptrWrench->torque.x;
 	m_wrenchData.torque.y = ptrWrench->torque.y;
 	m_wrenchData.torque.z = ptrWrench->torque.z;
+	m_wrenchData.time = ptrWrench->time;
 	//COBOT_LOG.notice() << " wrench:   force: " << m_wrenchData.force.x<<","<< m_wrenchData.force.y<<","<< m_wrenchData.force.z<<"\r\n"
 	//	<<" \t\t\t torque: " << m_wrenchData.torque.x << "," << m_wrenchData.torque.y << "," << m_wrenchData.torque.z << "\r\n";
 
+	// 重力补偿使用力采样时刻的末端姿态，而不是最新收到的姿态
+	Eigen::Quaterniond rotation;
+	if (alignRotation(m_wrenchData.time, rotation)) {
+		calGravityEE(rotation.toRotationMatrix());
+	}
 	calcForceEE();
 
 	//
-	step(m_forceEE, m_gravityEE, m_offsetEE);
+	filterStep(m_wrenchData, m_forceEE, m_gravityEE, m_offsetEE);
 	//COBOT_LOG.notice() << " offset:   transition: " << m_offsetEE [0]<<","<< m_offsetEE [1]<<","<< m_offsetEE [2]<<"\r\n"
 	//	<<" \t\t\t rotation: " << m_offsetEE[3] << "," << m_offsetEE[4] << "," << m_offsetEE[5] << "\r\n";
 }
@@ -101,9 +119,7 @@ bool ForceControlSolver::setup(const QString& configFilePath) {
 	if (loadJson(json, configFilePath)) {
 		//parser json file
 		QJsonArray data;
-		//todo gravity data should be calculate by robot pose move
-		//for now, just input the config values
-		//gravity
+		//gravity: 手工填写的负载重力，有标定结果文件时使用标定结果
 		data = json["gravity_repair"].toObject()["gravity"].toArray();
 		m_gravity[0] = data.at(0).toDouble(0);
 		m_gravity[1] = data.at(1).toDouble(0);
@@ -119,6 +135,29 @@ bool ForceControlSolver::setup(const QString& configFilePath) {
 		for (int i = 0; i < 6; i++) {
 			m_biasRepair[i] = data.at(i).toDouble();
 		}
+
+		GravityCompensation::Parameters gravityParam;
+		gravityParam.gravity = Eigen::Vector3d(m_gravity);
+		gravityParam.center = Eigen::Vector3d(m_gcenter);
+		gravityParam.forceOffset = Eigen::Vector3d(m_biasRepair);
+		gravityParam.torqueOffset = Eigen::Vector3d(m_biasRepair + 3);
+		m_gravityCompensation.setParameters(gravityParam);
+
+		//gravity_calibration: gravity_calibration 工具生成的标定结果，包括传感器零点
+		QString calibrationFile = json["gravity_calibration"].toString();
+		if (!calibrationFile.isEmpty()) {
+			if (m_gravityCompensation.load(calibrationFile.toStdString())) {
+				const GravityCompensation::Parameters& calibrated = m_gravityCompensation.getParameters();
+				for (int i = 0; i < 3; i++) {
+					m_biasRepair[i] = calibrated.forceOffset[i];
+					m_biasRepair[i + 3] = calibrated.torqueOffset[i];
+				}
+				COBOT_LOG.notice() << "Load gravity calibration, payload mass: " << m_gravityCompensation.mass();
+			}
+			else {
+				COBOT_LOG.warning() << "Fail to load gravity calibration " << calibrationFile << ", use gravity_repair";
+			}
+		}
 		//filter_param
 		data = json["filter_param"].toObject()["den"].toArray();
 		m_param.filter_den[0] = data.at(0).toDouble(1.0);
@@ -175,6 +214,55 @@ bool ForceControlSolver::setup(const QString& configFilePath) {
 		for (int i = 0; i < 6; i++) {
 			m_param.saturation_upper_limit[i] = data.at(i).toDouble(0.1);
 		}
+		//time_alignment
+		m_timeAlignment = json["time_alignment"].toObject()["enable"].toBool(true);
+		m_maxExtrapolation = json["time_alignment"].toObject()["max_extrapolation"].toDouble(0.008);
+
+		//control_loop
+		QJsonObject controlLoop = json["control_loop"].toObject();
+		m_controlLoop = controlLoop["enable"].toBool(false);
+		m_pidSensorRate = controlLoop["pid_sensor_rate"].toDouble(125);
+		if (m_controlLoop) {
+			//pid_factor 是按生成的 step() 整定的: 每 4 次调用运行一次 PID，积分步长固定 0.008 s，
+			//所以每秒的积分时间是 传感器频率 / 4 * 0.008。换算成内环的增益，P 不变，
+			//I 和 N 乘以这个比例，D 除以这个比例，内环的响应与整定时的频率下相同。
+			//pid_sensor_rate 为 0 时 pid_factor 直接作为内环的增益。
+			double scale = m_pidSensorRate > 0 ? m_pidSensorRate / 4 * 0.008 : 1.0;
+			AdmittanceController::Parameters parameters;
+			for (int i = 0; i < 6; i++) {
+				parameters.P[i] = m_param.P[i];
+				parameters.I[i] = m_param.I[i] * scale;
+				parameters.D[i] = m_param.D[i] / scale;
+				parameters.N[i] = m_param.N[i] * scale;
+				parameters.deadZoneStart[i] = m_param.dead_zone_start[i];
+				parameters.deadZoneEnd[i] = m_param.dead_zone_end[i];
+				parameters.saturationLower[i] = m_param.saturation_lower_limit[i];
+				parameters.saturationUpper[i] = m_param.saturation_upper_limit[i];
+			}
+			parameters.sampleTime = controlLoop["sample_time"].toDouble(0.008);
+			parameters.maxCatchUp = controlLoop["max_catch_up"].toInt(100);
+			m_controller.setParameters(parameters);
+			COBOT_LOG.notice() << "Force control loop sample time: " << m_controller.getParameters().sampleTime
+				<< ", pid_factor tuned at " << m_pidSensorRate << " Hz, I/N scale: " << scale;
+		}
+		else {
+			COBOT_LOG.warning() << "Force control loop disabled, pid_factor is only valid at "
+				<< m_pidSensorRate << " Hz sensor rate";
+		}
+
+		//offset_filter: factor 是每 period 秒的平滑系数，solve() 按实际调用间隔换算
+		m_posEfFactor = json["offset_filter"].toObject()["factor"].toDouble(0.1);
+		m_offsetFilterPeriod = json["offset_filter"].toObject()["period"].toDouble(0.008);
+		m_offsetFilter.setFactor(m_posEfFactor);
+
+		//6 个轴一起在 filterStep 中滤波，ForceController 内部的 filter 设为直通 H(z) = 1
+		m_forceFilter.setCoefficients(m_param.filter_num, m_param.filter_den);
+		m_param.filter_num[0] = 1;
+		m_param.filter_num[1] = 0;
+		m_param.filter_num[2] = 0;
+		m_param.filter_den[0] = 1;
+		m_param.filter_den[1] = 0;
+		m_param.filter_den[2] = 0;
 
 		//set
 		setBlockParameters(&m_param);
@@ -191,49 +279,239 @@ void ForceControlSolver::onArmRobotDisconnect() {
 
 void ForceControlSolver::onArmRobotStatusUpdate(const ArmRobotStatusPtr& ptrRobotStatus) {
 	m_curQ = ptrRobotStatus->q_actual;
-	calGravityEE();
+	if (m_curQ.size() != 6 || !m_ptrKinematicSolver) {
+		return;
+	}
+
+	// 每帧机器人状态只做一次正解，记录末端姿态历史；收到力数据时按力的采样时间取姿态
+	if (!m_ptrPoseKinematic) {
+		m_ptrPoseKinematic = m_ptrKinematicSolver->createThreadContext();
+		if (!m_ptrPoseKinematic) {
+			m_ptrPoseKinematic = m_ptrKinematicSolver;
+		}
+	}
+	AbstractKinematicSolver::Joint6d q = Eigen::Map<const AbstractKinematicSolver::Joint6d>(m_curQ.data());
+	Eigen::Vector3d position;
+	Eigen::Quaterniond rotation;
+	if (m_ptrPoseKinematic->jntToCart(q, position, rotation) != 0) {
+		return;
+	}
+
+	RotationSample sample;
+	sample.time = ptrRobotStatus->timestamp;
+	if (sample.time == std::chrono::steady_clock::time_point()) {
+		sample.time = std::chrono::steady_clock::now();
+	}
+	sample.rotation[0] = rotation.w();
+	sample.rotation[1] = rotation.x();
+	sample.rotation[2] = rotation.y();
+	sample.rotation[3] = rotation.z();
+	m_rotations.push(sample);
+}
+
+namespace {
+Eigen::Quaterniond toQuaternion(const double rotation[4]) {
+	return Eigen::Quaterniond(rotation[0], rotation[1], rotation[2], rotation[3]);
+}
 }
 
-void ForceControlSolver::calGravityEE() {
-	//force ee repair
-	Eigen::Vector3d vgravity(m_gravity);
-	//vgravity.x() = m_gravity[0];
-	//vgravity.y() = m_gravity[1];
-	//vgravity.z() = m_gravity[2];
+bool ForceControlSolver::alignRotation(std::chrono::steady_clock::time_point time, Eigen::Quaterniond& rotation) {
+	RotationSample after;
+	uint64_t sequence = 0;
+	if (!m_rotations.latest(after, &sequence)) {
+		return false;
+	}
+	rotation = toQuaternion(after.rotation);
 
-	Eigen::Vector3d eeGravity;
-	if (m_ptrKinematicSolver) {
-		m_ptrKinematicSolver->vector_WorldToEE(m_curQ, vgravity, eeGravity);
+	if (time == std::chrono::steady_clock::time_point()) {
+		std::lock_guard<std::mutex> lock_guard(m_timingMutex);
+		m_timing.unaligned++;
+		return true;
 	}
-	else {
-		COBOT_LOG.error() << "kinematic solver not created!";
+
+	double skew = std::chrono::duration<double>(time - after.time).count();
+	if (!m_timeAlignment) {
+		updateTimingStatistics(skew, m_timing.unaligned);
+		return true;
 	}
-	for (size_t i = 0; i < 3; i++) {
-		m_gravityEE[i] = eeGravity[i];
+
+	// 力数据比最新的机器人状态新，沿最近两帧的转动外推，外推时间有上限
+	RotationSample before;
+	if (skew >= 0) {
+		if (m_rotations.at(sequence - 1, before)) {
+			double span = std::chrono::duration<double>(after.time - before.time).count();
+			if (span > 0) {
+				double t = 1.0 + std::min(skew, m_maxExtrapolation) / span;
+				rotation = toQuaternion(before.rotation).slerp(t, rotation).normalized();
+			}
+		}
+		updateTimingStatistics(skew, m_timing.extrapolated);
+		return true;
+	}
+
+	// 往前找到不晚于力采样时间的姿态，在两帧之间球面插值
+	for (uint64_t s = sequence - 1; s > 0 && sequence - s < RotationRing::CAPACITY; s--) {
+		if (!m_rotations.at(s, before)) {
+			break;
+		}
+		if (before.time <= time) {
+			double span = std::chrono::duration<double>(after.time - before.time).count();
+			double alpha = span > 0 ? std::chrono::duration<double>(time - before.time).count() / span : 1.0;
+			rotation = toQuaternion(before.rotation).slerp(alpha, toQuaternion(after.rotation));
+			updateTimingStatistics(skew, m_timing.interpolated);
+			return true;
+		}
+		after = before;
 	}
-	// torque ee repair
-	m_gravityEE[3] = m_gcenter[0] * (eeGravity.y() + eeGravity.z());
-	m_gravityEE[4] = m_gcenter[1] * (eeGravity.z() + eeGravity.x());
-	m_gravityEE[5] = m_gcenter[2] * (eeGravity.x() + eeGravity.y());
 
+	// 历史不够长，使用能找到的最早姿态
+	rotation = toQuaternion(after.rotation);
+	updateTimingStatistics(skew, m_timing.unaligned);
+	return true;
 }
 
-int ForceControlSolver::solve(std::vector<double>& offset) {
-	offset.clear();
-	std::vector<double> src;
+void ForceControlSolver::updateTimingStatistics(double skew, uint64_t& counter) {
+	std::lock_guard<std::mutex> lock_guard(m_timingMutex);
+	counter++;
+	m_timing.samples++;
+	m_timing.lastSkew = skew;
+	m_timing.maxAbsSkew = std::max(m_timing.maxAbsSkew, std::fabs(skew));
+	m_skewSum += skew;
+}
+
+ForceControlTimingStatistics ForceControlSolver::getTimingStatistics() const {
+	std::lock_guard<std::mutex> lock_guard(m_timingMutex);
+	ForceControlTimingStatistics statistics = m_timing;
+	if (statistics.samples > 0) {
+		statistics.meanSkew = m_skewSum / statistics.samples;
+	}
+	if (m_controlLoop) {
+		AdmittanceController::Statistics loop = m_controller.getStatistics();
+		statistics.controlTicks = loop.ticks;
+		statistics.heldTicks = loop.held;
+		statistics.skippedTicks = loop.skipped;
+	}
+	return statistics;
+}
+
+void ForceControlSolver::calGravityEE(const Eigen::Matrix3d& rotation) {
+	m_gravityCompensation.gravityWrench(rotation, m_gravityEE);
+}
+
+void ForceControlSolver::filterStep(const cobotsys::Wrench& raw, const double (&force)[6], const double (&gravity)[6], double (&offset)[6]) {
+	//与 ForceController 中 Sum2 的计算相同，滤波后的力误差以零重力送入，结果与原来逐位一致
+	static const double zero[6] = { 0, 0, 0, 0, 0, 0 };
+	double error[6];
 	for (int i = 0; i < 6; i++)
 	{
-		src.push_back(m_offsetEE[i]);
+		error[i] = force[i] - gravity[i];
+	}
+
+	std::chrono::steady_clock::time_point time = raw.time;
+	if (time == std::chrono::steady_clock::time_point()) {
+		time = std::chrono::steady_clock::now();
+	}
+
+	//使用内环时只有传感器线程调用这里；不使用时 solve(wrench, ...) 也会调用，滤波器、step() 和记录器都要加锁
+	std::unique_lock<std::mutex> lock(m_stepMutex, std::defer_lock);
+	if (!m_controlLoop) {
+		lock.lock();
+		checkSensorRate(time);
+	}
+
+	double filtered[6];
+	m_forceFilter.filter(error, filtered);
+
+	//固定周期的内环按力的采样时间推进，与调用的频率和来源无关
+	if (m_controlLoop) {
+		m_controller.update(filtered, time);
+		m_controller.output(offset);
+	}
+	else {
+		step(filtered, zero, offset);
+	}
+
+	if (m_ptrRecorder) {
+		ForceControlRecord record;
+		record.clear();
+		record.source = ForceControlRecord::SOURCE_SENSOR;
+		record.time = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+		record.rawWrench[0] = raw.force.x;
+		record.rawWrench[1] = raw.force.y;
+		record.rawWrench[2] = raw.force.z;
+		record.rawWrench[3] = raw.torque.x;
+		record.rawWrench[4] = raw.torque.y;
+		record.rawWrench[5] = raw.torque.z;
+		for (int i = 0; i < 6; i++)
+		{
+			record.compensatedWrench[i] = error[i];
+			record.filteredWrench[i] = filtered[i];
+			record.offset[i] = offset[i];
+		}
+		m_ptrRecorder->record(record);
+	}
+}
+
+void ForceControlSolver::checkSensorRate(std::chrono::steady_clock::time_point time) {
+	if (m_rateChecked || m_pidSensorRate <= 0) {
+		return;
+	}
+	if (m_rateCheckCount == 0) {
+		m_rateCheckStart = time;
 	}
+	m_rateCheckCount++;
 
-	m_posEf.doFilter(src, offset);
+	//统计 1 秒的采样
+	double span = std::chrono::duration<double>(time - m_rateCheckStart).count();
+	if (span < 1.0) {
+		return;
+	}
+	m_rateChecked = true;
+	double rate = (m_rateCheckCount - 1) / span;
+	if (std::fabs(rate - m_pidSensorRate) > 0.2 * m_pidSensorRate) {
+		COBOT_LOG.error() << "Force sensor rate " << rate << " Hz, pid_factor is tuned at "
+			<< m_pidSensorRate << " Hz, the effective gains differ, enable control_loop";
+	}
+}
+
+int ForceControlSolver::solve(std::vector<double>& offset) {
+	//使用内环时 m_offsetEE 由传感器线程写，这里从内环取输出
+	double current[6];
+	if (m_controlLoop) {
+		m_controller.output(current);
+	}
+	else {
+		std::lock_guard<std::mutex> lock_guard(m_stepMutex);
+		std::copy(m_offsetEE, m_offsetEE + 6, current);
+	}
+
+	//平滑系数按调用间隔换算，500 Hz 的机器人状态和 125 Hz 时的时间常数相同:
+	//每个周期剩下 (1 - factor)，dt 内剩下 (1 - factor)^(dt / period)
+	auto now = std::chrono::steady_clock::now();
+	if (m_hasSolveTime && m_offsetFilterPeriod > 0) {
+		double dt = std::chrono::duration<double>(now - m_lastSolveTime).count();
+		double factor = 1 - std::pow(1 - m_posEfFactor, dt / m_offsetFilterPeriod);
+		m_offsetFilter.setFactor(std::max(0.0, std::min(1.0, factor)));
+	}
+	m_lastSolveTime = now;
+	m_hasSolveTime = true;
+
+	double filtered[6];
+	m_offsetFilter.filter(current, filtered);
+	offset.assign(filtered, filtered + 6);
 	return 0;
 }
 
 int ForceControlSolver::solve(const cobotsys::Wrench& wrench, const std::vector<double>& currentQ, std::vector<double>& offset) {
-	double force[6];
-	double gravity[6];
 	double roffset[6];
+	//内环只由传感器线程的力数据推进，这里的力不再送入滤波器和内环，否则两路数据混在一起
+	if (m_controlLoop) {
+		m_controller.output(roffset);
+		offset.assign(roffset, roffset + 6);
+		return 0;
+	}
+
+	double force[6];
 	force[0] = wrench.force.x;
 	force[1] = wrench.force.y;
 	force[2] = wrench.force.z;
@@ -247,30 +525,21 @@ int ForceControlSolver::solve(const cobotsys::Wrench& wrench, const std::vector<
 	}
 	//todo transform from sensor to ee
 
-	// gravity 
-	//force ee repair
-	Eigen::Vector3d vgravity(m_gravity);
-	//vgravity.x() = m_gravity[0];
-	//vgravity.y() = m_gravity[1];
-	//vgravity.z() = m_gravity[2];
-
-	Eigen::Vector3d eeGravity;
-	if (m_ptrKinematicSolver) {
-		m_ptrKinematicSolver->vector_WorldToEE(m_curQ, vgravity, eeGravity);
-	}
-	else {
-		COBOT_LOG.error() << "kinematic solver not created!";
+	// gravity: 使用局部变量，m_gravityEE 属于传感器线程
+	double gravity[6] = { 0, 0, 0, 0, 0, 0 };
+	if (m_ptrKinematicSolver && currentQ.size() == 6) {
+		AbstractKinematicSolver::Joint6d q = Eigen::Map<const AbstractKinematicSolver::Joint6d>(currentQ.data());
+		Eigen::Isometry3d pose;
+		if (m_ptrKinematicSolver->jntToCart(q, pose) == 0) {
+			m_gravityCompensation.gravityWrench(pose.linear(), gravity);
+		}
 	}
-	for (size_t i = 0; i < 3; i++) {
-		m_gravityEE[i] = eeGravity[i];
+	else {
+		COBOT_LOG.error() << "kinematic solver not created!";
 	}
-	// torque ee repair
-	m_gravityEE[3] = m_gcenter[0] * (eeGravity.y() + eeGravity.z());
-	m_gravityEE[4] = m_gcenter[1] * (eeGravity.z() + eeGravity.x());
-	m_gravityEE[5] = m_gcenter[2] * (eeGravity.x() + eeGravity.y());
 
 	//solve
-	step(force, gravity, roffset);
+	filterStep(wrench, force, gravity, roffset);
 
 	//output
 	offset.clear();
@@ -7,13 +7,17 @@
 #define PROJECT_FORCECONTROLSOLVER_H
 
 #include <mutex>
+#include <chrono>
 #include <cobotsys_abstract_forcecontrol_solver.h>
+#include <cobotsys_lockfree_ring.h>
+#include <cobotsys_gravity_compensation.h>
+#include <cobotsys_wrench_filter.h>
+#include <cobotsys_admittance_controller.h>
 #include <cobotsys_abstract_force_sensor.h>
 #include <cobotsys_abstract_arm_robot_realtime_driver.h>
 #include "../solver/ForceController.h"
 #include <QObject>
 #include <QString>
-#include "../filter/ExponentialFilter.h"
 
 using namespace cobotsys;
 
@@ -38,9 +42,26 @@ public:
 	virtual int solve(const cobotsys::Wrench& wrench, const std::vector<double>& currentQ, std::vector<double>& offset);
 	virtual int solve(std::vector<double>& offset);
 
+	virtual ForceControlTimingStatistics getTimingStatistics() const;
+
+protected:
+	/**
+	 * 带时间戳的末端姿态，每帧机器人状态做一次正解，用于把姿态插值到力的采样时间
+	 */
+	struct RotationSample {
+		std::chrono::steady_clock::time_point time;
+		double rotation[4]; ///< 末端相对基坐标系的旋转，四元数 w, x, y, z
+	};
+
+	typedef LockFreeRing<RotationSample, 64> RotationRing;
+
 protected:
-	void calGravityEE();
+	void calGravityEE(const Eigen::Matrix3d& rotation);
 	void calcForceEE();
+	void filterStep(const cobotsys::Wrench& raw, const double (&force)[6], const double (&gravity)[6], double (&offset)[6]);
+	void checkSensorRate(std::chrono::steady_clock::time_point time);
+	bool alignRotation(std::chrono::steady_clock::time_point time, Eigen::Quaterniond& rotation);
+	void updateTimingStatistics(double skew, uint64_t& counter);
 protected:
 	bool m_bcontrol;
 	cobotsys::Wrench m_wrenchData;
@@ -55,9 +76,34 @@ protected:
 	double m_gravityEE[6];
 	double m_offsetEE[6];
 
-	ExponentialFilter m_posEf;
-	int m_jntSize;
-	double m_posEfFactor;
+	//filter
+	WrenchIirFilter m_forceFilter;        ///< filter_param 定义的力误差滤波，ForceController 内部的 filter 设为直通
+	WrenchExponentialFilter m_offsetFilter; ///< 输出偏移的平滑
+	double m_posEfFactor;                   ///< 每个 m_offsetFilterPeriod 的平滑系数
+	double m_offsetFilterPeriod;            ///< m_posEfFactor 对应的调用周期(s)
+	std::chrono::steady_clock::time_point m_lastSolveTime;
+	bool m_hasSolveTime;
+
+	//fixed-rate control loop
+	AdmittanceController m_controller;   ///< 固定周期的 PID，启用时代替 ForceController::step
+	bool m_controlLoop;
+	double m_pidSensorRate;              ///< pid_factor 整定时的传感器频率(Hz)
+	std::mutex m_stepMutex;              ///< 不使用内环时保护 ForceController 和滤波器的状态以及 m_offsetEE
+	std::chrono::steady_clock::time_point m_rateCheckStart;
+	uint64_t m_rateCheckCount;
+	bool m_rateChecked;
+
+	//gravity compensation
+	GravityCompensation m_gravityCompensation;
+	std::shared_ptr<AbstractKinematicSolver> m_ptrPoseKinematic; ///< 机器人状态线程专用的求解器上下文
+
+	//time alignment
+	RotationRing m_rotations;
+	bool m_timeAlignment;
+	double m_maxExtrapolation;
+	mutable std::mutex m_timingMutex;
+	ForceControlTimingStatistics m_timing;
+	double m_skewSum;
 };
 
 
@@ -9,6 +9,7 @@
 #include <QtWidgets/QFileDialog>
 #include <cobotsys_file_finder.h>
 #include <thread>
+#include <algorithm>
 
 ForceGuideController::ForceGuideController() :
 	QObject(nullptr),
@@ -21,7 +22,17 @@ ForceGuideController::ForceGuideController() :
 	m_bSensorConnect(false),
 	m_posReady(false),
 	m_sensorReady(false),
-	m_setVoltage(false)
+	m_setVoltage(false),
+	m_jacobianMode(false),
+	m_nominalPeriod(0.008),
+	m_singularThreshold(0.05),
+	m_maxDamping(0.05),
+	m_maxJointSpeed(1.0),
+	m_stateSequence(0),
+	m_statePeriod(0.008),
+	m_maxRecords(0),
+	m_buttonEvents(false),
+	m_buttonPressed(false)
 {
 	//m_firstMove = true;
     m_exit = false;
@@ -29,6 +40,7 @@ ForceGuideController::ForceGuideController() :
 
 ForceGuideController::~ForceGuideController() {
     m_exit = true;
+	m_stateCond.notify_all();
 	if (m_controlThread.joinable()){
 		m_controlThread.join();
 	}
@@ -73,14 +85,39 @@ bool ForceGuideController::setup(const QString &configFilePath) {
 		int jmin = json["joint_min"].toInt(-180);
 		int jmax = json["joint_max"].toInt(180);
 
+		// "ik": 每 8ms 做一次完整逆解; "jacobian": 由机器人状态驱动，用雅可比阻尼最小二乘把位移换算成关节速度
+		m_jacobianMode = json["control_mode"].toString("ik") == "jacobian";
+		QJsonObject jacobianParam = json["jacobian_mode"].toObject();
+		m_nominalPeriod = jacobianParam["nominal_period"].toDouble(0.008);
+		m_singularThreshold = jacobianParam["singular_threshold"].toDouble(0.05);
+		m_maxDamping = jacobianParam["max_damping"].toDouble(0.05);
+		m_maxJointSpeed = jacobianParam["max_joint_speed"].toDouble(1.0);
+
+		// 全速率记录力控信号，每次 start 重新写这个文件
+		QJsonObject recorderParam = json["recorder"].toObject();
+		m_recordFile = recorderParam["file"].toString();
+		m_maxRecords = (uint64_t) recorderParam["max_records"].toDouble(1000000);
+		if (!m_recordFile.isEmpty()) {
+			m_ptrRecorder = std::make_shared<ForceControlRecorder>();
+		}
+
 		//kinematic solver first
 		createKinematicSolver();
+		if (m_jacobianMode && m_ptrKinematicSolver) {
+			m_ptrControlKinematic = m_ptrKinematicSolver->createThreadContext();
+			if (!m_ptrControlKinematic) {
+				m_ptrControlKinematic = m_ptrKinematicSolver;
+			}
+		}
 		//force control solver second
 		createForceControlSolver();
 		//set kinematic solver
 		if (m_ptrForceControlSolver&&m_ptrKinematicSolver) {
 			m_ptrForceControlSolver->setKinematicSolver(m_ptrKinematicSolver);
 		}
+		if (m_ptrForceControlSolver) {
+			m_ptrForceControlSolver->setRecorder(m_ptrRecorder);
+		}
 
 		//robot next
 		createRobot();
@@ -118,6 +155,11 @@ bool ForceGuideController::createRobot() {
 			auto obs = std::dynamic_pointer_cast<ArmRobotRealTimeStatusObserver>(m_ptrForceControlSolver);
 			m_ptrRobot->attach(obs);
 		}
+		// 工具按钮由跳变通知驱动，控制线程不再轮询 IO
+		m_buttonEvents = attachButton();
+		if (!m_buttonEvents) {
+			COBOT_LOG.notice() << "Digit io driver has no edge notification, poll tool button";
+		}
 		if (m_ptrRobot->setup(m_robotConfig)) {
 			COBOT_LOG.notice() << "Robot setup success";
 			ret = true;
@@ -233,6 +275,7 @@ bool ForceGuideController::createForceControlSolver() {
 void ForceGuideController::guideControlThread() {
 	auto time_cur = std::chrono::high_resolution_clock::now();
 	int nc = 0;
+	uint64_t stateSequence = 0;
     static bool robotConnectCheck = true;
     static bool posReadyCheck = true;
     static bool sensorConnectCheck = true;
@@ -243,7 +286,14 @@ void ForceGuideController::guideControlThread() {
 	while (!m_exit)
 	{
 		std::chrono::duration<double> dur(0.008);
-		std::this_thread::sleep_until(time_cur + dur);
+		if (m_jacobianMode) {
+			// 由机器人状态驱动，按控制器本身的周期运行(CB3 125Hz, e-Series 500Hz)
+			if (!waitRobotState(stateSequence))
+				continue;
+		}
+		else {
+			std::this_thread::sleep_until(time_cur + dur);
+		}
 		auto time_rdy = std::chrono::high_resolution_clock::now();
 		std::chrono::duration<double> time_diff = time_rdy - time_cur; // 时间间隙
 		time_cur = time_rdy;
@@ -345,10 +395,14 @@ void ForceGuideController::guideControlThread() {
 
           m_mutex.lock();
           std::vector<double> curQ = m_curQ;
+          double statePeriod = m_statePeriod;
+          auto stateTime = m_stateTime;
           m_mutex.unlock();
 
           //check button state
-          if (ioStatus->getIoStatus(DigitIoPort::Port_Ur_Tool_In_0) == DigitIoStatus::Reset) {
+          bool buttonPressed = m_buttonEvents ? m_buttonPressed.load()
+              : ioStatus->getIoStatus(DigitIoPort::Port_Ur_Tool_In_0) == DigitIoStatus::Set;
+          if (!buttonPressed) {
             if (buttonStateCheck) {
               COBOT_LOG.warning() << "io button released!";
               buttonStateCheck = false;
@@ -374,11 +428,20 @@ void ForceGuideController::guideControlThread() {
             offset_ee.push_back(offset[i]);
           }
 
+          std::vector<double> targetQ;
+          if (m_jacobianMode) {
+            if (jacobianStep(curQ, offset_ee, statePeriod, targetQ)) {
+              m_ptrRobot->move(targetQ);
+              recordMove(stateTime, curQ, offset_ee, targetQ);
+            }
+            continue;
+          }
+
           std::vector<double> pos;
           m_ptrKinematicSolver->pose_EEToWorld(curQ, offset_ee, pos);
-          std::vector<double> targetQ;
           if (m_ptrKinematicSolver->cartToJnt(curQ, pos, targetQ) == 0) {
             m_ptrRobot->move(targetQ);
+            recordMove(stateTime, curQ, offset_ee, targetQ);
             //if (m_firstMove) {
             //	m_firstMove = false;
             //	COBOT_LOG.notice() << "first move: " << targetQ[0] << ", " << targetQ[1] << ", " << targetQ[2] << ", " << targetQ[3] << ", " << targetQ[4] << ", " << targetQ[5];
@@ -389,6 +452,68 @@ void ForceGuideController::guideControlThread() {
 	}
 }
 
+bool ForceGuideController::waitRobotState(uint64_t& lastSequence) {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	bool updated = m_stateCond.wait_for(lock, std::chrono::milliseconds(100), [&]() {
+		return m_exit || m_stateSequence != lastSequence;
+	});
+	lastSequence = m_stateSequence;
+	return updated && !m_exit;
+}
+
+void ForceGuideController::recordMove(std::chrono::steady_clock::time_point time, const std::vector<double>& curQ,
+	const std::vector<double>& offset, const std::vector<double>& targetQ) {
+	if (!m_ptrRecorder) {
+		return;
+	}
+	ForceControlRecord record;
+	record.clear();
+	record.source = ForceControlRecord::SOURCE_ROBOT;
+	record.time = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+	for (size_t i = 0; i < 6; i++) {
+		if (i < offset.size()) record.offset[i] = offset[i];
+		if (i < curQ.size()) record.measuredQ[i] = curQ[i];
+		if (i < targetQ.size()) record.commandQ[i] = targetQ[i];
+	}
+	m_ptrRecorder->record(record);
+}
+
+bool ForceGuideController::jacobianStep(const std::vector<double>& curQ, const std::vector<double>& offset, double dt, std::vector<double>& targetQ) {
+	typedef AbstractKinematicSolver::Joint6d Joint6d;
+	if (!m_ptrControlKinematic || curQ.size() != 6 || offset.size() < 6) {
+		return false;
+	}
+
+	Joint6d q = Eigen::Map<const Joint6d>(curQ.data());
+	Eigen::Isometry3d pose;
+	if (m_ptrControlKinematic->jntToCart(q, pose) != 0) {
+		return false;
+	}
+
+	// 力控求解器输出的是末端坐标系下每个名义周期的位移，换算成基坐标系下的速度，与实际周期无关
+	Eigen::Vector3d linear(offset[0], offset[1], offset[2]);
+	Eigen::Vector3d angular(offset[3], offset[4], offset[5]);
+	AbstractKinematicSolver::Twist6d cartVel;
+	cartVel.head<3>() = pose.linear() * linear / m_nominalPeriod;
+	cartVel.tail<3>() = pose.linear() * angular / m_nominalPeriod;
+
+	Joint6d qd;
+	if (m_ptrControlKinematic->cartVelToJntVel(q, cartVel, qd, m_singularThreshold, m_maxDamping) != 0) {
+		return false;
+	}
+
+	// 超过关节速度上限时整体等比例缩小，保持末端运动方向不变
+	double peak = qd.cwiseAbs().maxCoeff();
+	if (peak > m_maxJointSpeed) {
+		qd *= m_maxJointSpeed / peak;
+	}
+
+	dt = std::max(0.001, std::min(dt, 0.02));
+	Joint6d next = q + qd * dt;
+	targetQ.assign(next.data(), next.data() + 6);
+	return true;
+}
+
 void ForceGuideController::startRobot() {
 	if (m_ptrRobot) {
 		if (m_ptrRobot->start()) {
@@ -404,6 +529,26 @@ void ForceGuideController::stopRobot() {
 	}
 }
 
+bool ForceGuideController::attachButton() {
+	if (m_ptrRobot) {
+		auto ioDriver = m_ptrRobot->getDigitIoDriver(1);
+		auto ioOb = std::dynamic_pointer_cast<DigitIoObserver>(shared_from_this());
+		return ioDriver && ioDriver->attach(ioOb);
+	}
+	return false;
+}
+
+void ForceGuideController::detachButton() {
+	if (m_ptrRobot) {
+		auto ioDriver = m_ptrRobot->getDigitIoDriver(1);
+		if (ioDriver) {
+			ioDriver->detach(std::dynamic_pointer_cast<DigitIoObserver>(shared_from_this()));
+		}
+	}
+	// 解除后收不到断开时的 Falling 通知，按松开处理
+	m_buttonPressed = false;
+}
+
 void ForceGuideController::startForceSensor() {
 	if (m_ptrSensor) {
 		if (m_ptrSensor->start()) {
@@ -422,10 +567,17 @@ void ForceGuideController::stopForceSensor() {
 bool ForceGuideController::start() {
 	bool ret = true;
 
+	if (m_ptrRecorder) {
+		m_ptrRecorder->open(m_recordFile.toStdString(), m_maxRecords);
+	}
+
 	//
 	startForceSensor();
 
 	//
+	if (m_buttonEvents) {
+		attachButton();
+	}
 	startRobot();
 
 	m_bcontrolStart = true;
@@ -437,7 +589,31 @@ void ForceGuideController::pause() {
 void ForceGuideController::stop() {
 	m_bcontrolStart = false;
 	stopForceSensor();
+	detachButton();
 	stopRobot();
+
+	if (m_ptrRecorder) {
+		m_ptrRecorder->close();
+	}
+
+	if (m_ptrForceControlSolver) {
+		auto timing = m_ptrForceControlSolver->getTimingStatistics();
+		COBOT_LOG.notice() << "Force/robot time skew(ms) mean: " << timing.meanSkew * 1000
+			<< ", max: " << timing.maxAbsSkew * 1000 << ", samples: " << timing.samples
+			<< ", interpolated: " << timing.interpolated << ", extrapolated: " << timing.extrapolated
+			<< ", unaligned: " << timing.unaligned;
+		if (timing.controlTicks > 0) {
+			COBOT_LOG.notice() << "Force control loop ticks: " << timing.controlTicks
+				<< ", held: " << timing.heldTicks << ", skipped: " << timing.skippedTicks;
+		}
+	}
+}
+
+void ForceGuideController::clearAttachedObject() {
+	// IO 驱动属于机器人驱动，它持有的观察者指针会让本对象和机器人驱动互相引用，无法释放
+	detachButton();
+	detachSharedObject(m_ptrRobot);
+	detachSharedObject(m_ptrSensor);
 }
 
 void ForceGuideController::onArmRobotConnect() {
@@ -461,7 +637,13 @@ void ForceGuideController::onArmRobotStatusUpdate(const ArmRobotStatusPtr& ptrRo
 	m_mutex.lock();
 	m_curQ = ptrRobotStatus->q_actual;
 	m_posReady = true;
+	if (m_stateSequence > 0 && ptrRobotStatus->timestamp > m_stateTime) {
+		m_statePeriod = std::chrono::duration<double>(ptrRobotStatus->timestamp - m_stateTime).count();
+	}
+	m_stateTime = ptrRobotStatus->timestamp;
+	m_stateSequence++;
 	m_mutex.unlock();
+	m_stateCond.notify_one();
 
 	//std::vector<double> pos;
 	//m_ptrKinematicSolver->jntToCart(m_curQ, pos);
@@ -485,6 +667,14 @@ void ForceGuideController::onArmRobotStatusUpdate(const ArmRobotStatusPtr& ptrRo
 	//}
 }
 
+void ForceGuideController::onDigitIoEdge(const DigitIoEvent& event) {
+	if (event.port != DigitIoPort::Port_Ur_Tool_In_0) {
+		return;
+	}
+	// 驱动在通知这个状态包的机器人状态之前回调，控制线程处理同一个状态包时就能看到新的按钮状态
+	m_buttonPressed = (event.edge == DigitIoEdge::Rising);
+}
+
 void ForceGuideController::onForceSensorConnect() {
     m_bSensorConnect = true;
 	COBOT_LOG.notice() << "Force sensor connected";
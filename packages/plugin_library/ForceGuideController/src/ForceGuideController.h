@@ -7,18 +7,22 @@
 #define PROJECT_FORCEGUIDECONTROLLER_H
 
 #include <mutex>
+#include <atomic>
 #include <thread>
+#include <chrono>
+#include <condition_variable>
 #include <cobotsys_abstract_controller.h>
 #include <cobotsys_abstract_arm_robot_realtime_driver.h>
 #include <cobotsys_abstract_force_sensor.h>
 #include <cobotsys_abstract_kinematic_solver.h>
 #include <cobotsys_abstract_forcecontrol_solver.h>
+#include <cobotsys_force_control_recorder.h>
 #include <QObject>
 #include <QString>
 
 using namespace cobotsys;
 
-class ForceGuideController : public QObject, public AbstractController, public ArmRobotRealTimeStatusObserver, public ForceSensorStreamObserver {
+class ForceGuideController : public QObject, public AbstractController, public ArmRobotRealTimeStatusObserver, public ForceSensorStreamObserver, public DigitIoObserver {
 	Q_OBJECT
 public:
 	ForceGuideController();
@@ -28,6 +32,7 @@ public:
 	virtual bool start();
 	virtual void pause();
 	virtual void stop();
+	virtual void clearAttachedObject();
 
 public:
 	virtual void onForceSensorConnect();
@@ -39,6 +44,9 @@ public:
 	virtual void onArmRobotDisconnect();
 	virtual void onArmRobotStatusUpdate(const ArmRobotStatusPtr& ptrRobotStatus);
 
+public:
+	virtual void onDigitIoEdge(const DigitIoEvent& event);
+
 protected:
 	bool createRobot();
 	bool createForceSensor();
@@ -51,7 +59,13 @@ protected:
 	void startForceSensor();
 	void stopForceSensor();
 
+	bool attachButton();
+	void detachButton();
+
 	void guideControlThread();
+	bool waitRobotState(uint64_t& lastSequence);
+	bool jacobianStep(const std::vector<double>& curQ, const std::vector<double>& offset, double dt, std::vector<double>& targetQ);
+	void recordMove(std::chrono::steady_clock::time_point time, const std::vector<double>& curQ, const std::vector<double>& offset, const std::vector<double>& targetQ);
 
 
 protected:
@@ -93,6 +107,27 @@ protected:
 	bool m_posReady;
 	bool m_sensorReady;
 	bool m_setVoltage;
+
+	//jacobian mode
+	bool m_jacobianMode;
+	std::shared_ptr<AbstractKinematicSolver> m_ptrControlKinematic; ///< 控制线程专用的求解器上下文
+	double m_nominalPeriod;     ///< 力控求解器的位移输出对应的周期
+	double m_singularThreshold;
+	double m_maxDamping;
+	double m_maxJointSpeed;
+	std::condition_variable m_stateCond;
+	uint64_t m_stateSequence;
+	std::chrono::steady_clock::time_point m_stateTime;
+	double m_statePeriod;
+
+	//recorder
+	std::shared_ptr<ForceControlRecorder> m_ptrRecorder; ///< 没有配置 recorder 时为空
+	QString m_recordFile;
+	uint64_t m_maxRecords;
+
+	//tool button
+	bool m_buttonEvents;                ///< IO 驱动支持跳变通知时为 true，否则轮询 getIoStatus
+	std::atomic<bool> m_buttonPressed;  ///< 由跳变通知更新
 };
 
 
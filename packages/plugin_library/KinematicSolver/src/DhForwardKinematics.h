@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#ifndef COBOTSYS_DHFORWARDKINEMATICS_H
+#define COBOTSYS_DHFORWARDKINEMATICS_H
+
+#include <vector>
+#include <cmath>
+#include "frames.hpp"
+
+/**
+ * 标准 DH 串联机械臂的正解，关节数 N 在编译期确定，逐个连杆的计算在编译期展开。
+ *
+ * 连杆变换 T_i = RotZ(theta_i + q_i) * TransZ(d_i) * TransX(a_i) * RotX(alpha_i)，与 KDL::Frame::DH 相同。
+ * cos(alpha) 等常量在 setup() 里算好，每个关节只求一次 sin/cos，
+ * 旋转矩阵按列原地更新，没有虚函数调用，也不经过通用的 KDL::Frame 乘法。
+ */
+template<int N>
+class DhForwardKinematics {
+public:
+    enum {
+        JOINT_NUM = N,
+    };
+
+public:
+    DhForwardKinematics() : m_valid(false), m_eeIdentity(false) {}
+
+    /**
+     * @param a,alpha,d,theta N 个关节的 DH 参数
+     * @param worldBase 世界坐标系到第一个关节坐标系
+     * @param eeFrame 最后一个关节到末端执行器
+     * @retval false 参数个数不是 N
+     */
+    bool setup(const std::vector<double>& a, const std::vector<double>& alpha,
+               const std::vector<double>& d, const std::vector<double>& theta,
+               const KDL::Frame& worldBase, const KDL::Frame& eeFrame) {
+        m_valid = false;
+        if (a.size() != N || alpha.size() != N || d.size() != N || theta.size() != N)
+            return false;
+        for (int i = 0; i < N; i++) {
+            m_links[i].a = a[i];
+            m_links[i].d = d[i];
+            m_links[i].theta = theta[i];
+            m_links[i].cosAlpha = std::cos(alpha[i]);
+            m_links[i].sinAlpha = std::sin(alpha[i]);
+        }
+        m_worldBase = worldBase;
+        m_eeFrame = eeFrame;
+        m_eeIdentity = eeFrame == KDL::Frame::Identity();
+        m_valid = true;
+        return true;
+    }
+
+    bool isValid() const { return m_valid; }
+
+    /**
+     * 末端执行器在世界坐标系下的位姿
+     */
+    KDL::Frame forward(const double* q) const {
+        State state;
+        for (int k = 0; k < 3; k++) {
+            state.x[k] = m_worldBase.M(k, 0);
+            state.y[k] = m_worldBase.M(k, 1);
+            state.z[k] = m_worldBase.M(k, 2);
+            state.p[k] = m_worldBase.p(k);
+        }
+        Unroll<0>::apply(m_links, q, state);
+
+        KDL::Frame flange(KDL::Rotation(state.x[0], state.y[0], state.z[0],
+                                        state.x[1], state.y[1], state.z[1],
+                                        state.x[2], state.y[2], state.z[2]),
+                          KDL::Vector(state.p[0], state.p[1], state.p[2]));
+        return m_eeIdentity ? flange : flange * m_eeFrame;
+    }
+
+protected:
+    struct Link {
+        double a, d, theta;
+        double cosAlpha, sinAlpha;
+    };
+
+    /**
+     * 当前坐标系在世界坐标系下的三个轴和原点
+     */
+    struct State {
+        double x[3], y[3], z[3], p[3];
+    };
+
+    static void sinCos(double angle, double& s, double& c) {
+#if defined(__GLIBC__)
+        ::sincos(angle, &s, &c);
+#else
+        s = std::sin(angle);
+        c = std::cos(angle);
+#endif
+    }
+
+    /**
+     * 右乘一个连杆变换：x' = ct x + st y，y' = ca (-st x + ct y) + sa z，z' = -sa (-st x + ct y) + ca z，
+     * p' = p + a x' + d z
+     */
+    static void applyLink(const Link& link, double q, State& state) {
+        double st, ct;
+        sinCos(link.theta + q, st, ct);
+        for (int k = 0; k < 3; k++) {
+            double xk = ct * state.x[k] + st * state.y[k];
+            double yk = ct * state.y[k] - st * state.x[k];
+            double zk = state.z[k];
+            state.p[k] += link.a * xk + link.d * zk;
+            state.x[k] = xk;
+            state.y[k] = link.cosAlpha * yk + link.sinAlpha * zk;
+            state.z[k] = link.cosAlpha * zk - link.sinAlpha * yk;
+        }
+    }
+
+    template<int I, int Dummy = 0>
+    struct Unroll {
+        static void apply(const Link* links, const double* q, State& state) {
+            applyLink(links[I], q[I], state);
+            Unroll<I + 1, Dummy>::apply(links, q, state);
+        }
+    };
+
+    template<int Dummy>
+    struct Unroll<N, Dummy> {
+        static void apply(const Link*, const double*, State&) {}
+    };
+
+protected:
+    bool m_valid;
+    bool m_eeIdentity;
+    Link m_links[N];
+    KDL::Frame m_worldBase;
+    KDL::Frame m_eeFrame;
+};
+
+
+#endif //COBOTSYS_DHFORWARDKINEMATICS_H
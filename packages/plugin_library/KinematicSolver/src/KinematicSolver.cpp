@@ -10,11 +10,18 @@
 #include "KinematicSolver.h"
 #include <cobotsys_file_finder.h>
 #include "frames_io.hpp"
+#include <cmath>
+#include <algorithm>
 using namespace cobotsys;
 using namespace std;
 using namespace KDL;
-KinematicSolver::KinematicSolver(){
 
+namespace {
+std::atomic<uint64_t> s_modelGeneration(0);
+}
+
+KinematicSolver::KinematicSolver()
+	: m_model(std::make_shared<KinematicModel>()), m_ownerThread(std::thread::id()), m_threadWarned(false) {
 }
 
 KinematicSolver::~KinematicSolver(){
@@ -29,43 +36,12 @@ int KinematicSolver::cartToJnt(const std::vector<double>& initialJoint, const st
 	}
 	KDL::Frame targetFrame = stdVectortoFrame(targetPos);
 	KDL::JntArray q_out(initialJoint.size());
-	int retval;
-	//COBOT_LOG.notice() << "q_init:( " << q_init(0) <<"," << q_init(1) << "," << q_init(2) << "," << q_init(3) << "," << q_init(4) << "," << q_init(5) << ")";
-	//m_ik_solver->display_information = true;
-	retval = m_ik_solver->CartToJnt(q_init, targetFrame, q_out);
-
-	switch (retval) {
-	case 0:
-		targetJoint.clear();
+	int retval = solveIk(q_init, targetFrame, q_out);
+	if (retval == 0) {
 		for (int i = 0; i < q_out.data.size(); i++) {
 			targetJoint.push_back(q_out(i));
 		}
-		break;
-	case -1:
-		COBOT_LOG.warning() << "Kinamatic Solver:the gradient of $ E $ towards the joints is to small.";
-		break;
-	case -2:
-		COBOT_LOG.warning() << "Kinamatic Solver:joint position increments are to small.";
-		break;
-	case -3:
-		COBOT_LOG.warning() << "Kinamatic Solver:number of iterations is exceeded.";
-		break;
-	default:
-		COBOT_LOG.warning() << "Kinamatic Solver failed.";
-		break;
 	}
-	//if (retval != 0) {
-	//	std::cout << "---------Inverse Kinematic Solver failed ----------------------------" << endl;
-	//	COBOT_LOG.error() << "pos " << targetFrame << endl;
-	//	std::cout << "reached pos " << m_ik_solver->T_base_head << endl;
-	//	std::cout << "TF from pos to head \n" << targetFrame.Inverse()*m_ik_solver->T_base_head << endl;
-	//	std::cout << "gradient " << m_ik_solver->grad.transpose() << endl;
-	//	std::cout << "q_out " << q_out.data.transpose() / M_PI*180.0 << endl;
-	//	std::cout << "q_init " << q_init.data.transpose() / M_PI*180.0 << endl;
-	//	std::cout << "return value " << retval << endl;
-	//	std::cout << "last #iter " << m_ik_solver->lastNrOfIter << endl;
-	//	std::cout << "last diff  " << m_ik_solver->lastDifference << endl;
-	//}
 	return retval;
 }
 
@@ -75,43 +51,12 @@ int KinematicSolver::cartToJnt(const Eigen::VectorXd& initialJoint, const std::v
 	q_init.data = initialJoint;
 	KDL::Frame targetFrame = stdVectortoFrame(targetPos);
 	KDL::JntArray q_out(initialJoint.size());
-	int retval;
-	//COBOT_LOG.notice() << "q_init:( " << q_init(0) <<"," << q_init(1) << "," << q_init(2) << "," << q_init(3) << "," << q_init(4) << "," << q_init(5) << ")";
-	//m_ik_solver->display_information = true;
-	retval = m_ik_solver->CartToJnt(q_init, targetFrame, q_out);
-
-	switch (retval) {
-	case 0:
-		targetJoint.clear();
+	int retval = solveIk(q_init, targetFrame, q_out);
+	if (retval == 0) {
 		for (int i = 0; i < q_out.data.size(); i++) {
 			targetJoint.push_back(q_out(i));
 		}
-		break;
-	case -1:
-		COBOT_LOG.warning() << "Kinamatic Solver:the gradient of $ E $ towards the joints is to small.";
-		break;
-	case -2:
-		COBOT_LOG.warning() << "Kinamatic Solver:joint position increments are to small.";
-		break;
-	case -3:
-		COBOT_LOG.warning() << "Kinamatic Solver:number of iterations is exceeded.";
-		break;
-	default:
-		COBOT_LOG.warning() << "Kinamatic Solver failed.";
-		break;
 	}
-	//if (retval != 0) {
-	//	std::cout << "---------Inverse Kinematic Solver failed ----------------------------" << endl;
-	//	COBOT_LOG.error() << "pos " << targetFrame << endl;
-	//	std::cout << "reached pos " << m_ik_solver->T_base_head << endl;
-	//	std::cout << "TF from pos to head \n" << targetFrame.Inverse()*m_ik_solver->T_base_head << endl;
-	//	std::cout << "gradient " << m_ik_solver->grad.transpose() << endl;
-	//	std::cout << "q_out " << q_out.data.transpose() / M_PI*180.0 << endl;
-	//	std::cout << "q_init " << q_init.data.transpose() / M_PI*180.0 << endl;
-	//	std::cout << "return value " << retval << endl;
-	//	std::cout << "last #iter " << m_ik_solver->lastNrOfIter << endl;
-	//	std::cout << "last diff  " << m_ik_solver->lastDifference << endl;
-	//}
 	return retval;
 }
 
@@ -125,11 +70,71 @@ int KinematicSolver::cartToJnt(const Eigen::VectorXd& initialJoint, const Eigen:
 	KDL::Frame targetFrame;
 	tf::transformEigenToKDL(targetPos, targetFrame);
 	KDL::JntArray q_out(targetJoint.size());
-	int retval;
-	retval = m_ik_solver->CartToJnt(q_init, targetFrame, q_out);
+	int retval = solveIk(q_init, targetFrame, q_out);
+	if (retval == 0) {
+		targetJoint = q_out.data;
+	}
+	return retval;
+}
+
+int KinematicSolver::cartToJntAll(const std::vector<double>& targetPos, std::vector<std::vector<double> >& solutions) {
+	solutions.clear();
+	if (!m_model->useAnalyticIk) {
+		return -1;
+	}
+	double q_sols[UrAnalyticIk::MAX_SOLUTIONS][UrAnalyticIk::JOINT_NUM];
+	int num = m_model->analyticIk.solve(stdVectortoFrame(targetPos), 0, q_sols);
+	for (int i = 0; i < num; i++) {
+		if (fitJointLimits(q_sols[i], nullptr)) {
+			solutions.push_back(std::vector<double>(q_sols[i], q_sols[i] + UrAnalyticIk::JOINT_NUM));
+		}
+	}
+	return solutions.empty() ? -1 : 0;
+}
+
+/**
+ * 逆解入口：UR 结构先用解析解，取离初始关节角最近的一组；解析解无解时再用 LMA 迭代。
+ */
+int KinematicSolver::solveIk(const KDL::JntArray& q_init, const KDL::Frame& targetFrame, KDL::JntArray& q_out) {
+	if (m_model->useAnalyticIk && q_init.rows() == UrAnalyticIk::JOINT_NUM) {
+		q_out.resize(UrAnalyticIk::JOINT_NUM);
+		if (analyticIk(q_init.data.data(), targetFrame, q_out.data.data()) == 0) {
+			return 0;
+		}
+	}
+	return lmaIk(q_init, targetFrame, q_out);
+}
+
+/**
+ * 6 轴定长版本，解析解成功时不分配内存；只有退回 LMA 时才创建 KDL::JntArray。
+ * 失败时不修改 q_out。
+ */
+int KinematicSolver::solveIk(const double* q_init, const KDL::Frame& targetFrame, double* q_out) {
+	if (m_model->useAnalyticIk && analyticIk(q_init, targetFrame, q_out) == 0) {
+		return 0;
+	}
+	KDL::JntArray q_init_jnt(UrAnalyticIk::JOINT_NUM);
+	KDL::JntArray q_out_jnt(UrAnalyticIk::JOINT_NUM);
+	for (int i = 0; i < UrAnalyticIk::JOINT_NUM; i++) {
+		q_init_jnt(i) = q_init[i];
+	}
+	int retval = lmaIk(q_init_jnt, targetFrame, q_out_jnt);
+	if (retval == 0) {
+		for (int i = 0; i < UrAnalyticIk::JOINT_NUM; i++) {
+			q_out[i] = q_out_jnt(i);
+		}
+	}
+	return retval;
+}
+
+int KinematicSolver::lmaIk(const KDL::JntArray& q_init, const KDL::Frame& targetFrame, KDL::JntArray& q_out) {
+	checkOwnerThread();
+	//COBOT_LOG.notice() << "q_init:( " << q_init(0) <<"," << q_init(1) << "," << q_init(2) << "," << q_init(3) << "," << q_init(4) << "," << q_init(5) << ")";
+	//m_ik_solver->display_information = true;
+	int retval = m_ik_solver->CartToJnt(q_init, targetFrame, q_out);
+
 	switch (retval) {
 	case 0:
-		targetJoint = q_out.data;
 		break;
 	case -1:
 		COBOT_LOG.warning() << "Kinamatic Solver:the gradient of $ E $ towards the joints is to small.";
@@ -159,28 +164,236 @@ int KinematicSolver::cartToJnt(const Eigen::VectorXd& initialJoint, const Eigen:
 	return retval;
 }
 
-int KinematicSolver::jntToCart(const std::vector<double>& targetJoint, std::vector<double>& targetPos) {
-	KDL::JntArray targetJnt(targetJoint.size());
-	for (int i = 0; i < targetJoint.size(); i++) {
-		targetJnt(i) = targetJoint.at(i);
+int KinematicSolver::analyticIk(const double* q_init, const KDL::Frame& targetFrame, double* q_out) const {
+	double q_sols[UrAnalyticIk::MAX_SOLUTIONS][UrAnalyticIk::JOINT_NUM];
+	int num = m_model->analyticIk.solve(targetFrame, q_init[5], q_sols);
+
+	int best = -1;
+	double bestDist = 0;
+	for (int i = 0; i < num; i++) {
+		if (!fitJointLimits(q_sols[i], q_init)) {
+			continue;
+		}
+		double dist = 0;
+		for (int j = 0; j < UrAnalyticIk::JOINT_NUM; j++) {
+			double diff = q_sols[i][j] - q_init[j];
+			dist += diff * diff;
+		}
+		if (best < 0 || dist < bestDist) {
+			best = i;
+			bestDist = dist;
+		}
+	}
+	if (best < 0) {
+		return -1;
 	}
+	for (int j = 0; j < UrAnalyticIk::JOINT_NUM; j++) {
+		q_out[j] = q_sols[best][j];
+	}
+	return 0;
+}
+
+/**
+ * 每个关节加减 2pi，取在关节限位内、离初始关节角最近的值。
+ * @param q_init 为空时只做限位检查，取 (-pi, pi] 内的值
+ * @retval false 有关节无论怎样都超出限位
+ */
+bool KinematicSolver::fitJointLimits(double* q, const double* q_init) const {
+	bool hasLimits = m_model->jointLimits.size() == UrAnalyticIk::JOINT_NUM;
+	for (int j = 0; j < UrAnalyticIk::JOINT_NUM; j++) {
+		double seed = q_init ? q_init[j] : 0;
+		double nearest = seed + std::remainder(q[j] - seed, 2 * M_PI);
+		if (!hasLimits) {
+			q[j] = nearest;
+			continue;
+		}
+		const JointLimits& limits = m_model->jointLimits[j];
+		bool fitted = false;
+		double best = 0;
+		for (int k = -1; k <= 1; k++) {
+			double value = nearest + k * 2 * M_PI;
+			if (value < limits.lower || value > limits.upper) {
+				continue;
+			}
+			if (!fitted || std::fabs(value - seed) < std::fabs(best - seed)) {
+				best = value;
+				fitted = true;
+			}
+		}
+		if (!fitted) {
+			return false;
+		}
+		q[j] = best;
+	}
+	return true;
+}
+
+int KinematicSolver::jntToCart(const std::vector<double>& targetJoint, std::vector<double>& targetPos) {
 	KDL::Frame targetFrame;
-	int retval;
-	retval=m_fk_solver->JntToCart(targetJnt, targetFrame);
+	int retval = forwardFrame(targetJoint.data(), targetJoint.size(), targetFrame);
 	targetPos = frameToStdVector(targetFrame);
 	return retval;
 }
 
 int KinematicSolver::jntToCart(const Eigen::VectorXd& targetJoint, Eigen::Affine3d& targetPos) {
-	KDL::JntArray targetJnt(targetJoint.size());
-	targetJnt.data = targetJoint;
 	KDL::Frame targetFrame;
-	int retval;
-	retval = m_fk_solver->JntToCart(targetJnt, targetFrame);
+	int retval = forwardFrame(targetJoint.data(), targetJoint.size(), targetFrame);
 	tf::transformKDLToEigen(targetFrame, targetPos);
 	return retval;
 }
 
+int KinematicSolver::jntToCart(const Joint6d& targetJoint, Eigen::Vector3d& position, Eigen::Quaterniond& orientation) {
+	if (!isSixAxis()) {
+		return -1;
+	}
+	KDL::Frame targetFrame = chainToFrame(targetJoint.data());
+	position = Eigen::Vector3d(targetFrame.p.x(), targetFrame.p.y(), targetFrame.p.z());
+	targetFrame.M.GetQuaternion(orientation.x(), orientation.y(), orientation.z(), orientation.w());
+	return 0;
+}
+
+int KinematicSolver::cartToJnt(const Joint6d& initialJoint, const Eigen::Isometry3d& targetPos, Joint6d& targetJoint) {
+	if (!isSixAxis()) {
+		return -1;
+	}
+	KDL::Frame targetFrame;
+	tf::transformEigenToKDL(targetPos, targetFrame);
+	return solveIk(initialJoint.data(), targetFrame, targetJoint.data());
+}
+
+int KinematicSolver::cartToJntBatch(const Joint6d& initialJoint, const Eigen::Isometry3d* targetPoses, size_t count,
+                                    Joint6d* targetJoints, int* results, bool chainSeed) {
+	if (!isSixAxis()) {
+		if (results) {
+			std::fill(results, results + count, -1);
+		}
+		return (int)count;
+	}
+	int failCount = 0;
+	const double* seed = initialJoint.data();
+	KDL::Frame targetFrame;
+	for (size_t i = 0; i < count; i++) {
+		tf::transformEigenToKDL(targetPoses[i], targetFrame);
+		int retval = solveIk(seed, targetFrame, targetJoints[i].data());
+		if (results) {
+			results[i] = retval;
+		}
+		if (retval != 0) {
+			failCount++;
+		} else if (chainSeed) {
+			seed = targetJoints[i].data();
+		}
+	}
+	return failCount;
+}
+
+int KinematicSolver::jntToCart(const Joint6d& targetJoint, Eigen::Isometry3d& targetPos) {
+	if (!isSixAxis()) {
+		return -1;
+	}
+	tf::transformKDLToEigen(chainToFrame(targetJoint.data()), targetPos);
+	return 0;
+}
+
+int KinematicSolver::jntToCartBatch(const Joint6d* targetJoints, size_t count, Eigen::Isometry3d* targetPoses) {
+	if (!isSixAxis()) {
+		return (int)count;
+	}
+	for (size_t i = 0; i < count; i++) {
+		tf::transformKDLToEigen(chainToFrame(targetJoints[i].data()), targetPoses[i]);
+	}
+	return 0;
+}
+
+bool KinematicSolver::isSixAxis() const {
+	if (m_model->chain.getNrOfJoints() != UrAnalyticIk::JOINT_NUM) {
+		COBOT_LOG.error() << "Kinematic Solver: fixed size API needs 6 joints, chain has " << m_model->chain.getNrOfJoints();
+		return false;
+	}
+	return true;
+}
+
+int KinematicSolver::forwardFrame(const double* q, size_t size, KDL::Frame& frame) const {
+	if (size != m_model->chain.getNrOfJoints()) {
+		frame = KDL::Frame::Identity();
+		return -1;
+	}
+	frame = chainToFrame(q);
+	return 0;
+}
+
+/**
+ * 6 轴 DH 模型用编译期展开的正解；其他情况与 ChainFkSolverPos_recursive 相同，逐段相乘。
+ * 都直接读 q 数组，不需要 KDL::JntArray。
+ */
+KDL::Frame KinematicSolver::chainToFrame(const double* q) const {
+	if (m_model->dhFk.isValid()) {
+		return m_model->dhFk.forward(q);
+	}
+	KDL::Frame frame = KDL::Frame::Identity();
+	unsigned int j = 0;
+	for (unsigned int i = 0; i < m_model->chain.getNrOfSegments(); i++) {
+		const KDL::Segment& segment = m_model->chain.getSegment(i);
+		if (segment.getJoint().getType() != KDL::Joint::None) {
+			frame = frame * segment.pose(q[j++]);
+		} else {
+			frame = frame * segment.pose(0.0);
+		}
+	}
+	return frame;
+}
+
+int KinematicSolver::jacobian(const Eigen::VectorXd& joint, Eigen::MatrixXd& jac) {
+	if (joint.size() != m_model->chain.getNrOfJoints()) {
+		COBOT_LOG.error() << "Kinematic Solver: joint size " << joint.size() << " != " << m_model->chain.getNrOfJoints();
+		return -1;
+	}
+	jac.resize(6, joint.size());
+	chainJacobian(joint.data(), jac.data());
+	return 0;
+}
+
+int KinematicSolver::jacobian(const Joint6d& joint, Jacobian6d& jac) {
+	if (!isSixAxis()) {
+		return -1;
+	}
+	chainJacobian(joint.data(), jac.data());
+	return 0;
+}
+
+/**
+ * 几何雅可比，与 KDL::ChainJntToJacSolver 相同(参考点为链末端，表示在基坐标系下)，
+ * 但没有中间状态，不分配内存。jac 按列存放，6 x 关节数。
+ * 转动关节一列为 [z x (p_ee - o); z]，移动关节为 [z; 0]，z、o 为关节轴方向和原点。
+ */
+void KinematicSolver::chainJacobian(const double* q, double* jac) const {
+	KDL::Vector tip = chainToFrame(q).p;
+	KDL::Frame frame = KDL::Frame::Identity();
+	unsigned int j = 0;
+	for (unsigned int i = 0; i < m_model->chain.getNrOfSegments(); i++) {
+		const KDL::Segment& segment = m_model->chain.getSegment(i);
+		const KDL::Joint& joint = segment.getJoint();
+		if (joint.getType() == KDL::Joint::None) {
+			frame = frame * segment.pose(0.0);
+			continue;
+		}
+		KDL::Vector axis = frame.M * joint.JointAxis();
+		KDL::Vector linear = axis;
+		KDL::Vector angular = KDL::Vector::Zero();
+		if (joint.getType() <= KDL::Joint::RotZ) {
+			linear = axis * (tip - frame * joint.JointOrigin());
+			angular = axis;
+		}
+		double* column = jac + 6 * j;
+		for (int k = 0; k < 3; k++) {
+			column[k] = linear[k];
+			column[k + 3] = angular[k];
+		}
+		frame = frame * segment.pose(q[j]);
+		j++;
+	}
+}
+
 std::vector<double> KinematicSolver::frameToStdVector(KDL::Frame frame) {
 	std::vector<double> vec;
 	double x, y, z;
@@ -204,57 +417,80 @@ KDL::Frame KinematicSolver::stdVectortoFrame(std::vector<double> vec) {
 }
 
 int KinematicSolver::vector_WorldToEE(const Eigen::VectorXd& jointArray, const Eigen::Vector3d& vector_world, Eigen::Vector3d& vector_ee) {
-	KDL::JntArray targetJnt(jointArray.size());
-	targetJnt.data = jointArray;
 	KDL::Frame frame_world2ee;
-	int retval;
-	retval = m_fk_solver->JntToCart(targetJnt, frame_world2ee);
+	int retval = forwardFrame(jointArray.data(), jointArray.size(), frame_world2ee);
 	KDL::Vector vect_w(vector_world.x(), vector_world.y(), vector_world.z());
-	KDL::Vector vect_ee = frame_world2ee.Inverse().M*vect_w;
+	KDL::Vector vect_ee = frame_world2ee.M.Inverse(vect_w);
 	vector_ee = Eigen::Vector3d(vect_ee.x(), vect_ee.y(), vect_ee.z());
 	return retval;
 }
 int KinematicSolver::vector_WorldToEE(const std::vector<double>& jointArray, const Eigen::Vector3d& vector_world, Eigen::Vector3d& vector_ee) {
-	KDL::JntArray targetJnt(jointArray.size());
-	for (int i = 0; i < jointArray.size(); i++) {
-		targetJnt(i) = jointArray[i];
-	}
 	KDL::Frame frame_world2ee;
-	int retval;
-	retval = m_fk_solver->JntToCart(targetJnt, frame_world2ee);
+	int retval = forwardFrame(jointArray.data(), jointArray.size(), frame_world2ee);
 	KDL::Vector vect_w(vector_world.x(), vector_world.y(), vector_world.z());
-	KDL::Vector vect_ee = frame_world2ee.Inverse().M*vect_w;
+	KDL::Vector vect_ee = frame_world2ee.M.Inverse(vect_w);
 	vector_ee = Eigen::Vector3d(vect_ee.x(), vect_ee.y(), vect_ee.z());
 	return retval;
 }
 
 int KinematicSolver::pose_EEToWorld(const Eigen::VectorXd& jointArray, const std::vector<double>& pose_ee, std::vector<double>& pose_world) {
-	KDL::JntArray targetJnt(jointArray.size());
-	targetJnt.data = jointArray;
-	KDL::Frame frame_ee=stdVectortoFrame(pose_ee);
+	KDL::Frame frame_ee = stdVectortoFrame(pose_ee);
 	KDL::Frame frame_world2ee;
-	int retval;
-	retval = m_fk_solver->JntToCart(targetJnt, frame_world2ee);
+	int retval = forwardFrame(jointArray.data(), jointArray.size(), frame_world2ee);
 	KDL::Frame frame_world = frame_world2ee*frame_ee;
-	pose_world.clear();
 	pose_world = frameToStdVector(frame_world);
 	return retval;
 }
 int KinematicSolver::pose_EEToWorld(const std::vector<double>& jointArray, const std::vector<double>& pose_ee, std::vector<double>& pose_world) {
-	KDL::JntArray targetJnt(jointArray.size());
-	for (int i = 0; i < jointArray.size(); i++) {
-		targetJnt(i)= jointArray[i];
-	}
 	KDL::Frame frame_ee = stdVectortoFrame(pose_ee);
 	KDL::Frame frame_world2ee;
-	int retval;
-	retval = m_fk_solver->JntToCart(targetJnt, frame_world2ee);
+	int retval = forwardFrame(jointArray.data(), jointArray.size(), frame_world2ee);
 	KDL::Frame frame_world = frame_world2ee*frame_ee;
-	pose_world.clear();
 	pose_world = frameToStdVector(frame_world);
 	return retval;
 }
 
+/**
+ * 上下文只复制模型指针，各自创建 LMA 求解器
+ */
+std::shared_ptr<AbstractKinematicSolver> KinematicSolver::createThreadContext() {
+	if (!m_ik_solver) {
+		COBOT_LOG.error() << "Kinematic Solver: setup() before createThreadContext()";
+		return nullptr;
+	}
+	auto context = std::make_shared<KinematicSolver>();
+	context->setModel(m_model);
+	return context;
+}
+
+uint64_t KinematicSolver::modelGeneration() const {
+	return m_model->generation;
+}
+
+void KinematicSolver::setModel(const std::shared_ptr<const KinematicModel>& model) {
+	m_ik_solver.reset();
+	m_model = model;
+	m_ik_solver.reset(new KDL::ChainIkSolverPos_LMA(m_model->chain));
+	m_ownerThread = std::thread::id();
+}
+
+/**
+ * LMA 的中间状态不能跨线程共享，发现第二个线程使用时提示一次
+ */
+void KinematicSolver::checkOwnerThread() {
+	std::thread::id self = std::this_thread::get_id();
+	std::thread::id owner = m_ownerThread.load();
+	if (owner == self) {
+		return;
+	}
+	if (owner == std::thread::id() && m_ownerThread.compare_exchange_strong(owner, self)) {
+		return;
+	}
+	if (!m_threadWarned.exchange(true)) {
+		COBOT_LOG.warning() << "Kinematic Solver: LMA solver used from more than one thread, use createThreadContext() for each thread.";
+	}
+}
+
 bool KinematicSolver::setup(const QString& configFilePath) {
 	//auto a = FileFinder::find(configFilePath.toStdString);
     //load model from json file.
@@ -264,6 +500,7 @@ bool KinematicSolver::setup(const QString& configFilePath) {
 	//COBOT_LOG.info() << "configFilePath" <<configFilePath.toStdString();
     QJsonObject json;
     if (loadJson(json, configFilePath)) {
+		auto model = std::make_shared<KinematicModel>();
 		//world_base
 		QJsonArray data;
 		double pt[3], rpy[3];
@@ -278,21 +515,26 @@ bool KinematicSolver::setup(const QString& configFilePath) {
 		KDL::Frame wb;
 		wb.p = KDL::Vector(pt[0],pt[1],pt[2]);
 		wb.M = KDL::Rotation::RPY(rpy[0], rpy[1], rpy[2]);
-		m_robot_chain.addSegment(Segment(Joint(Joint::None), wb));
+		model->chain.addSegment(Segment(Joint(Joint::None), wb));
+		std::vector<double> dh_a, dh_alpha, dh_d, dh_theta;
         foreach (const QJsonValue & value, json["param"].toArray()) {
             QJsonObject segmentObj = value.toObject();
 				double a = segmentObj["dh"].toObject()["a"].toDouble();
 				double alpha = segmentObj["dh"].toObject()["alpha"].toDouble();
 				double d = segmentObj["dh"].toObject()["d"].toDouble();
 				double theta = segmentObj["dh"].toObject()["theta"].toDouble();
-				m_robot_chain.addSegment(Segment(Joint(Joint::RotZ),
+				model->chain.addSegment(Segment(Joint(Joint::RotZ),
 					Frame::DH(a, alpha, d, theta)));
+				dh_a.push_back(a);
+				dh_alpha.push_back(alpha);
+				dh_d.push_back(d);
+				dh_theta.push_back(theta);
 				JointLimits jointLimits;
 				jointLimits.lower = segmentObj["limits"].toObject()["lower"].toDouble();
 				jointLimits.upper = segmentObj["limits"].toObject()["upper"].toDouble();
 				jointLimits.effort = segmentObj["limits"].toObject()["effort"].toDouble();
 				jointLimits.velocity = segmentObj["limits"].toObject()["velocity"].toDouble();
-				m_robot_joint_limits.push_back(jointLimits);
+				model->jointLimits.push_back(jointLimits);
         }
 		data = json["ee_frame"].toObject()["xyz"].toArray();
 		for (int i = 0; i < 3; i++) {
@@ -305,9 +547,15 @@ bool KinematicSolver::setup(const QString& configFilePath) {
 		KDL::Frame ee;
 		ee.p = KDL::Vector(pt[0],pt[1],pt[2]);
 		ee.M = KDL::Rotation::RPY(rpy[0], rpy[1], rpy[2]);
-		m_robot_chain.addSegment(Segment(Joint(Joint::None), ee));
-		m_fk_solver=new KDL::ChainFkSolverPos_recursive(m_robot_chain);
-		m_ik_solver=new KDL::ChainIkSolverPos_LMA(m_robot_chain);
+		model->chain.addSegment(Segment(Joint(Joint::None), ee));
+
+		// ik_solver: "auto" 为 UR 结构时用解析解，"lma" 总是用迭代
+		QString ikSolver = json["ik_solver"].toString("auto");
+		model->useAnalyticIk = (ikSolver != "lma") && model->analyticIk.setup(dh_a, dh_alpha, dh_d, dh_theta, wb, ee);
+		model->dhFk.setup(dh_a, dh_alpha, dh_d, dh_theta, wb, ee);
+		model->generation = ++s_modelGeneration;
+		COBOT_LOG.notice() << "Kinematic Solver IK: " << (model->useAnalyticIk ? "analytic" : "LMA");
+		setModel(model);
 
 		//for (int i = 0; i < m_robot_chain.getNrOfSegments();++i) {
 		//	KDL::Segment seg =  m_robot_chain.getSegment(i);
@@ -11,9 +11,20 @@
 #include <QObject>
 #include "chain.hpp"
 #include "chainiksolverpos_lma.hpp"
-#include "chainfksolverpos_recursive.hpp"
+#include "UrAnalyticIk.h"
+#include "DhForwardKinematics.h"
+#include <memory>
+#include <atomic>
+#include <thread>
 
 using namespace cobotsys;
+
+/**
+ * 基于 KDL 的运动学求解器。
+ *
+ * 正解、雅可比和 UR 解析逆解只读模型，可以多线程调用；LMA 迭代逆解有中间状态，只能在一个线程里使用，
+ * 其他线程通过 createThreadContext() 取得共享模型的上下文。
+ */
 class KinematicSolver : public cobotsys::AbstractKinematicSolver {
     struct JointLimits{
       double lower;
@@ -21,6 +32,18 @@ class KinematicSolver : public cobotsys::AbstractKinematicSolver {
       double effort;
       double velocity;
     };
+
+	/**
+	 * setup() 读入的模型，之后不再修改，所有上下文共享
+	 */
+	struct KinematicModel {
+		KDL::Chain chain;
+		std::vector<JointLimits> jointLimits;
+		UrAnalyticIk analyticIk;
+		bool useAnalyticIk = false; // DH 参数是 UR 结构时用解析解，LMA 作为后备
+		DhForwardKinematics<6> dhFk; // 6 个关节时的正解，其他情况逐段相乘
+		uint64_t generation = 0;     // setup() 时分配的版本号，见 modelGeneration()
+	};
 public:
 	KinematicSolver();
     virtual ~KinematicSolver();
@@ -38,9 +61,18 @@ public:
 	virtual int cartToJnt(const Eigen::VectorXd& initialJoint, const Eigen::Affine3d& targetPos, Eigen::VectorXd& targetJoint);
 	virtual int cartToJnt(const std::vector<double>& initialJoint, const std::vector<double>& targetPos, std::vector<double>& targetJoint);
 	virtual int cartToJnt(const Eigen::VectorXd& initialJoint, const std::vector<double>& targetPos, std::vector<double>& targetJoint);
+	virtual int cartToJntAll(const std::vector<double>& targetPos, std::vector<std::vector<double> >& solutions);
+	virtual int cartToJnt(const Joint6d& initialJoint, const Eigen::Isometry3d& targetPos, Joint6d& targetJoint);
+	virtual int cartToJntBatch(const Joint6d& initialJoint, const Eigen::Isometry3d* targetPoses, size_t count,
+	                           Joint6d* targetJoints, int* results = nullptr, bool chainSeed = true);
 	
 	virtual int jntToCart(const Eigen::VectorXd& targetJoint, Eigen::Affine3d& targetPos);
 	virtual int jntToCart(const std::vector<double>& targetJoint, std::vector<double>& targetPos);
+	virtual int jntToCart(const Joint6d& targetJoint, Eigen::Isometry3d& targetPos);
+	virtual int jntToCart(const Joint6d& targetJoint, Eigen::Vector3d& position, Eigen::Quaterniond& orientation);
+	virtual int jntToCartBatch(const Joint6d* targetJoints, size_t count, Eigen::Isometry3d* targetPoses);
+	virtual int jacobian(const Eigen::VectorXd& joint, Eigen::MatrixXd& jac);
+	virtual int jacobian(const Joint6d& joint, Jacobian6d& jac);
 	virtual int vector_WorldToEE(const Eigen::VectorXd& jointArray, const Eigen::Vector3d& vector_world, Eigen::Vector3d& vector_ee);
 	virtual int pose_EEToWorld(const Eigen::VectorXd& jointArray, const std::vector<double>& pose_ee, std::vector<double>& pose_world);
 
@@ -49,12 +81,29 @@ public:
 
 	//KDL::Chain UR3Chain();
     virtual bool setup(const QString& configFilePath="CONFIG/force_control/kinematic_solver_config.json");
+	virtual std::shared_ptr<AbstractKinematicSolver> createThreadContext();
+	virtual uint64_t modelGeneration() const;
+
+	bool isAnalyticIk() const { return m_model->useAnalyticIk; }
 protected:
+	void setModel(const std::shared_ptr<const KinematicModel>& model);
+	void checkOwnerThread();
+
 	QString m_defaultSolverInfo;
-    KDL::Chain m_robot_chain;
-    std::vector<JointLimits> m_robot_joint_limits;
-	KDL::ChainFkSolverPos_recursive* m_fk_solver;
-	KDL::ChainIkSolverPos_LMA* m_ik_solver;
+	std::shared_ptr<const KinematicModel> m_model; // 必须在 LMA 求解器之前声明，求解器引用其中的 chain
+	std::unique_ptr<KDL::ChainIkSolverPos_LMA> m_ik_solver;
+	std::atomic<std::thread::id> m_ownerThread; // 第一次使用 LMA 的线程
+	std::atomic<bool> m_threadWarned;
+
+	int solveIk(const KDL::JntArray& q_init, const KDL::Frame& targetFrame, KDL::JntArray& q_out);
+	int solveIk(const double* q_init, const KDL::Frame& targetFrame, double* q_out);
+	int lmaIk(const KDL::JntArray& q_init, const KDL::Frame& targetFrame, KDL::JntArray& q_out);
+	int analyticIk(const double* q_init, const KDL::Frame& targetFrame, double* q_out) const;
+	bool fitJointLimits(double* q, const double* q_init) const;
+	bool isSixAxis() const;
+	KDL::Frame chainToFrame(const double* q) const;
+	int forwardFrame(const double* q, size_t size, KDL::Frame& frame) const;
+	void chainJacobian(const double* q, double* jac) const;
 	std::vector<double> frameToStdVector(KDL::Frame frame);
 	KDL::Frame stdVectortoFrame(std::vector<double> vec);
 };
@@ -0,0 +1,154 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#include "UrAnalyticIk.h"
+#include <cmath>
+
+namespace {
+const double DH_TOLERANCE = 1e-6;
+const double ZERO_TOLERANCE = 1e-9;
+
+inline bool nearValue(double value, double expect) {
+    return std::fabs(value - expect) < DH_TOLERANCE;
+}
+
+inline double normalizeAngle(double q) {
+    q = std::fmod(q, 2 * M_PI);
+    if (q > M_PI) q -= 2 * M_PI;
+    if (q <= -M_PI) q += 2 * M_PI;
+    return q;
+}
+
+/**
+ * acos/asin 的参数因为舍入误差稍微超出 [-1, 1] 时截断，超出较多时认为无解
+ */
+inline bool clampUnit(double& value) {
+    if (std::fabs(value) > 1 + ZERO_TOLERANCE)
+        return false;
+    if (value > 1) value = 1;
+    if (value < -1) value = -1;
+    return true;
+}
+}
+
+UrAnalyticIk::UrAnalyticIk()
+        : m_valid(false), m_d1(0), m_a2(0), m_a3(0), m_d4(0), m_d5(0), m_d6(0) {
+}
+
+bool UrAnalyticIk::setup(const std::vector<double>& a, const std::vector<double>& alpha,
+                         const std::vector<double>& d, const std::vector<double>& theta,
+                         const KDL::Frame& worldBase, const KDL::Frame& eeFrame) {
+    m_valid = false;
+    if (a.size() != JOINT_NUM || alpha.size() != JOINT_NUM || d.size() != JOINT_NUM || theta.size() != JOINT_NUM)
+        return false;
+
+    const double urAlpha[JOINT_NUM] = {M_PI / 2, 0, 0, M_PI / 2, -M_PI / 2, 0};
+    for (int i = 0; i < JOINT_NUM; i++) {
+        if (!nearValue(alpha[i], urAlpha[i]) || !nearValue(theta[i], 0))
+            return false;
+    }
+    if (!nearValue(a[0], 0) || !nearValue(a[3], 0) || !nearValue(a[4], 0) || !nearValue(a[5], 0))
+        return false;
+    if (!nearValue(d[1], 0) || !nearValue(d[2], 0))
+        return false;
+    if (nearValue(a[1], 0) || nearValue(a[2], 0) || nearValue(d[5], 0))
+        return false;
+
+    m_d1 = d[0];
+    m_a2 = a[1];
+    m_a3 = a[2];
+    m_d4 = d[3];
+    m_d5 = d[4];
+    m_d6 = d[5];
+    m_worldBaseInv = worldBase.Inverse();
+    m_eeFrameInv = eeFrame.Inverse();
+    m_valid = true;
+    return true;
+}
+
+KDL::Frame UrAnalyticIk::forward(const double* q) const {
+    return KDL::Frame::DH(0, M_PI / 2, m_d1, q[0]) *
+           KDL::Frame::DH(m_a2, 0, 0, q[1]) *
+           KDL::Frame::DH(m_a3, 0, 0, q[2]) *
+           KDL::Frame::DH(0, M_PI / 2, m_d4, q[3]) *
+           KDL::Frame::DH(0, -M_PI / 2, m_d5, q[4]) *
+           KDL::Frame::DH(0, 0, m_d6, q[5]);
+}
+
+int UrAnalyticIk::solve(const KDL::Frame& target, double q6Default, double solutions[MAX_SOLUTIONS][JOINT_NUM]) const {
+    if (!m_valid)
+        return 0;
+
+    // 法兰在第一个关节坐标系下的位姿
+    KDL::Frame flange = m_worldBaseInv * target * m_eeFrameInv;
+    const KDL::Vector& p = flange.p;
+    KDL::Vector x6 = flange.M.UnitX();
+    KDL::Vector y6 = flange.M.UnitY();
+    KDL::Vector z6 = flange.M.UnitZ();
+
+    // q1: 第5轴原点在 z1 方向上的分量恒为 d4
+    KDL::Vector p5 = p - m_d6 * z6;
+    double r = std::sqrt(p5.x() * p5.x() + p5.y() * p5.y());
+    if (r < ZERO_TOLERANCE) // 肩部奇异，q1 任意
+        return 0;
+    double sinDelta = m_d4 / r;
+    if (!clampUnit(sinDelta))
+        return 0;
+    double phi = std::atan2(p5.y(), p5.x());
+    double delta = std::asin(sinDelta);
+    double q1s[2] = {phi + delta, phi + M_PI - delta};
+
+    int count = 0;
+    for (int i = 0; i < 2; i++) {
+        double q1 = q1s[i];
+        double s1 = std::sin(q1);
+        double c1 = std::cos(q1);
+
+        // q5: 法兰原点在 z1 方向上的分量为 d4 + d6 * cos(q5)
+        double c5 = (p.x() * s1 - p.y() * c1 - m_d4) / m_d6;
+        if (!clampUnit(c5))
+            continue;
+        double q5Base = std::acos(c5);
+
+        for (int j = 0; j < 2; j++) {
+            double q5 = j == 0 ? q5Base : -q5Base;
+            double s5 = std::sin(q5);
+
+            // q6: z1 在法兰坐标系下为 (sin(q5) cos(q6), -sin(q5) sin(q6), cos(q5))
+            double q6 = q6Default;
+            if (std::fabs(s5) > ZERO_TOLERANCE) {
+                double zx = s1 * x6.x() - c1 * x6.y();
+                double zy = s1 * y6.x() - c1 * y6.y();
+                q6 = std::atan2(-zy / s5, zx / s5);
+            }
+
+            // q2, q3, q4: 第1到第4坐标系是平面 3R
+            KDL::Frame t14 = KDL::Frame::DH(0, M_PI / 2, m_d1, q1).Inverse() * flange *
+                             (KDL::Frame::DH(0, -M_PI / 2, m_d5, q5) * KDL::Frame::DH(0, 0, m_d6, q6)).Inverse();
+            double x = t14.p.x();
+            double y = t14.p.y();
+            double c3 = (x * x + y * y - m_a2 * m_a2 - m_a3 * m_a3) / (2 * m_a2 * m_a3);
+            if (!clampUnit(c3))
+                continue;
+            double q3Base = std::acos(c3);
+            KDL::Vector x4 = t14.M.UnitX();
+            double q234 = std::atan2(x4.y(), x4.x());
+
+            for (int k = 0; k < 2; k++) {
+                double q3 = k == 0 ? q3Base : -q3Base;
+                double q2 = std::atan2(y, x) - std::atan2(m_a3 * std::sin(q3), m_a2 + m_a3 * std::cos(q3));
+                double q4 = q234 - q2 - q3;
+
+                double* q = solutions[count++];
+                q[0] = normalizeAngle(q1);
+                q[1] = normalizeAngle(q2);
+                q[2] = normalizeAngle(q3);
+                q[3] = normalizeAngle(q4);
+                q[4] = normalizeAngle(q5);
+                q[5] = normalizeAngle(q6);
+            }
+        }
+    }
+    return count;
+}
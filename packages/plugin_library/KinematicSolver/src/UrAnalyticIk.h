@@ -0,0 +1,64 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#ifndef COBOTSYS_URANALYTICIK_H
+#define COBOTSYS_URANALYTICIK_H
+
+#include <vector>
+#include "frames.hpp"
+
+/**
+ * UR3/UR5/UR10 这一类机械臂的解析逆解。
+ *
+ * 要求 DH 参数(标准 DH，与 KDL::Frame::DH 相同)满足 UR 的结构：
+ * alpha = [pi/2, 0, 0, pi/2, -pi/2, 0]，a1 = a4 = a5 = a6 = 0，d2 = d3 = 0，theta 偏置全为 0。
+ * 肩部(q1)、腕部(q5)、肘部(q3)各两种构型，最多 8 组解，计算量固定，没有迭代。
+ * 基座和末端执行器的固定变换在 setup() 里给出，solve() 的目标是末端执行器在世界坐标系下的位姿。
+ */
+class UrAnalyticIk {
+public:
+    enum {
+        JOINT_NUM = 6,
+        MAX_SOLUTIONS = 8,
+    };
+
+public:
+    UrAnalyticIk();
+
+    /**
+     * @param a,alpha,d,theta 6 个关节的 DH 参数
+     * @param worldBase 世界坐标系到第一个关节坐标系
+     * @param eeFrame 第 6 轴法兰到末端执行器
+     * @retval true DH 参数是 UR 结构，可以使用解析解
+     * @retval false 不是 UR 结构
+     */
+    bool setup(const std::vector<double>& a, const std::vector<double>& alpha,
+               const std::vector<double>& d, const std::vector<double>& theta,
+               const KDL::Frame& worldBase, const KDL::Frame& eeFrame);
+
+    bool isValid() const { return m_valid; }
+
+    /**
+     * 求所有构型的逆解，角度范围 (-pi, pi]。
+     * @param target 末端执行器位姿
+     * @param q6Default 腕部奇异(q5 = 0 或 pi)时 q1 与 q6 的转轴重合，q6 取这个值
+     * @param solutions 输出，每组 JOINT_NUM 个关节角
+     * @return 解的个数，0 表示不可达
+     */
+    int solve(const KDL::Frame& target, double q6Default, double solutions[MAX_SOLUTIONS][JOINT_NUM]) const;
+
+    /**
+     * 法兰相对于第一个关节坐标系的正解，用于检验
+     */
+    KDL::Frame forward(const double* q) const;
+
+protected:
+    bool m_valid;
+    double m_d1, m_a2, m_a3, m_d4, m_d5, m_d6;
+    KDL::Frame m_worldBaseInv;
+    KDL::Frame m_eeFrameInv;
+};
+
+
+#endif //COBOTSYS_URANALYTICIK_H
@@ -124,6 +124,7 @@ void MotomanDriver::robotStatusWatcher() {
     COBOT_LOG.notice() << "Motoman Status Watcher is Running.";
     while (m_isWatcherRunning) {
         m_udp_msg_cond.wait(lck);
+        auto time_state = std::chrono::steady_clock::now(); // 通知到达的时间作为状态时间戳
 
         if (m_mutex.try_lock()) {
             _updateDigitIoStatus();
@@ -147,6 +148,7 @@ void MotomanDriver::robotStatusWatcher() {
             m_mutex.unlock();
         }
         pStatus->q_actual = q_next;
+        pStatus->timestamp = time_state;
 
 
         // 通知所有观察者，机器人数据已经更新。
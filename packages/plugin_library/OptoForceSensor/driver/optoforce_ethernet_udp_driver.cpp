@@ -8,91 +8,6 @@
 #include <cobotsys_logger.h>
 #include <chrono>
 
-struct HSURecord  // High-speed UDP record
-{
-	uint32_t hs_sequence_;
-	uint32_t ft_sequence_;
-	uint32_t status_;
-	int32_t fx_;
-	int32_t fy_;
-	int32_t fz_;
-	int32_t tx_;
-	int32_t ty_;
-	int32_t tz_;
-
-	enum { HSU_RECORD_SIZE = 36 };
-	void unpack(const uint8_t *buffer);
-	static uint32_t unpack32(const uint8_t *buffer);
-};
-
-uint32_t HSURecord::unpack32(const uint8_t *buffer)
-{
-	return
-		(uint32_t(buffer[0]) << 24) |
-		(uint32_t(buffer[1]) << 16) |
-		(uint32_t(buffer[2]) << 8) |
-		(uint32_t(buffer[3]) << 0);
-}
-
-void HSURecord::unpack(const uint8_t *buffer)
-{
-	hs_sequence_ = unpack32(buffer + 0);
-	ft_sequence_ = unpack32(buffer + 4);
-	status_ = unpack32(buffer + 8);
-	fx_ = unpack32(buffer + 12);
-	fy_ = unpack32(buffer + 16);
-	fz_ = unpack32(buffer + 20);
-	tx_ = unpack32(buffer + 24);
-	ty_ = unpack32(buffer + 28);
-	tz_ = unpack32(buffer + 32);
-}
-
-
-struct HSUCommand
-{
-	uint16_t command_header_;
-	uint16_t command_;
-	uint32_t sample_count_;
-
-	HSUCommand() : command_header_(HEADER)
-	{
-		// empty
-	}
-
-	enum { HEADER = 0x1234 };
-
-	// Possible values for command_
-	enum {
-		CMD_STOP_STREAMING = 0,
-		CMD_START_HIGH_SPEED_STREAMING = 2,
-		CMD_SET_SPEED = 0x0082,
-		CMD_SET_FILTER = 0x0081
-
-	};
-
-	// Special values for sample count
-	enum { INFINITE_SAMPLES = 0 };
-
-	enum { HSU_COMMAND_SIZE = 8 };
-
-	//!Packet structure into buffer for network transport
-	//  Buffer should be RDT_COMMAND_SIZE
-	void pack(uint8_t *buffer) const;
-};
-
-void HSUCommand::pack(uint8_t *buffer) const
-{
-	// Data is big-endian
-	buffer[0] = (command_header_ >> 8) & 0xFF;
-	buffer[1] = (command_header_ >> 0) & 0xFF;
-	buffer[2] = (command_ >> 8) & 0xFF;
-	buffer[3] = (command_ >> 0) & 0xFF;
-	buffer[4] = (sample_count_ >> 8) & 0xFF;
-	buffer[5] = (sample_count_ >> 0) & 0xFF;
-	buffer[6] = (sample_count_ >> 8) & 0xFF;
-	buffer[7] = (sample_count_ >> 0) & 0xFF;
-}
-
 
 OptoforceEthernetUDPDriver::OptoforceEthernetUDPDriver(std::condition_variable& rt_msg_cond, QObject* parent) :
 	QObject(parent),
@@ -181,6 +96,7 @@ void OptoforceEthernetUDPDriver::recvThreadFunc() {
 			else
 			{
 				hsu_record.unpack((uint8_t*)tmp);
+				auto recvTime = std::chrono::steady_clock::now();
 				{
 					tmp_data.force.x = double(hsu_record.fx_) * m_forceScale;
 					tmp_data.force.y = double(hsu_record.fy_) * m_forceScale;
@@ -197,6 +113,13 @@ void OptoforceEthernetUDPDriver::recvThreadFunc() {
 						m_newWrench.torque.x -= m_offsetWrench.torque.x;
 						m_newWrench.torque.y -= m_offsetWrench.torque.y;
 						m_newWrench.torque.z -= m_offsetWrench.torque.z;
+						if (m_wrenchRing) {
+							cobotsys::WrenchSample sample;
+							sample.sequence = m_wrenchRing->written() + 1;
+							sample.time = recvTime;
+							sample.setWrench(m_newWrench);
+							m_wrenchRing->push(sample);
+						}
 						++m_packetCount;
 						m_pMsgCond->notify_all();
 					}
@@ -15,16 +15,14 @@
 #include <QString>
 #include <QTimer>
 #include <cobotsys_data_types.h>
+#include <cobotsys_abstract_force_sensor.h>
 #include <condition_variable>
+#include "optoforce_hsu_protocol.h"
 
 class OptoforceEthernetUDPDriver : public QObject {
 	Q_OBJECT
 public:
 
-#define OPTOFORCE_UDP_PORT  49152
-#define	DEFAULT_FORCE_DIV	10000.0  // Default divide value
-#define	DEFAULT_TORQUE_DIV	100000.0 // Default divide value
-
 	OptoforceEthernetUDPDriver(std::condition_variable& rt_msg_cond, QObject* parent = nullptr);
 	~OptoforceEthernetUDPDriver();
 
@@ -33,6 +31,11 @@ public:
 
 	cobotsys::Wrench getState();
 
+	/**
+	 * 接收线程把每个样本(已减去零点)连同时间戳写入这个缓冲区，接收线程是唯一的写者
+	 */
+	void setWrenchRing(const std::shared_ptr<cobotsys::WrenchRing>& ring) { m_wrenchRing = ring; }
+
 	void onConnect();
 	void onDisconnect();
 	void onReadyRead();
@@ -79,6 +82,7 @@ protected:
 
 	cobotsys::Wrench m_newWrench;
 	cobotsys::Wrench m_offsetWrench;
+	std::shared_ptr<cobotsys::WrenchRing> m_wrenchRing;
 };
 
 
@@ -0,0 +1,127 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#ifndef PROJECT_OPTOFORCE_HSU_PROTOCOL_H
+#define PROJECT_OPTOFORCE_HSU_PROTOCOL_H
+
+#include <stdint.h>
+
+/**
+ * OptoForce EtherDAQ 高速 UDP 协议的数据包格式，Qt 事件循环和独立接收线程两种接收方式共用
+ */
+
+#define OPTOFORCE_UDP_PORT  49152
+#define	DEFAULT_FORCE_DIV	10000.0  // Default divide value
+#define	DEFAULT_TORQUE_DIV	100000.0 // Default divide value
+
+struct HSURecord  // High-speed UDP record
+{
+	uint32_t hs_sequence_;
+	uint32_t ft_sequence_;
+	uint32_t status_;
+	int32_t fx_;
+	int32_t fy_;
+	int32_t fz_;
+	int32_t tx_;
+	int32_t ty_;
+	int32_t tz_;
+
+	enum { HSU_RECORD_SIZE = 36 };
+	void unpack(const uint8_t *buffer);
+	void pack(uint8_t *buffer) const; // 传感器模拟器使用
+	static uint32_t unpack32(const uint8_t *buffer);
+	static void pack32(uint32_t value, uint8_t *buffer);
+};
+
+inline uint32_t HSURecord::unpack32(const uint8_t *buffer)
+{
+	return
+		(uint32_t(buffer[0]) << 24) |
+		(uint32_t(buffer[1]) << 16) |
+		(uint32_t(buffer[2]) << 8) |
+		(uint32_t(buffer[3]) << 0);
+}
+
+inline void HSURecord::unpack(const uint8_t *buffer)
+{
+	hs_sequence_ = unpack32(buffer + 0);
+	ft_sequence_ = unpack32(buffer + 4);
+	status_ = unpack32(buffer + 8);
+	fx_ = unpack32(buffer + 12);
+	fy_ = unpack32(buffer + 16);
+	fz_ = unpack32(buffer + 20);
+	tx_ = unpack32(buffer + 24);
+	ty_ = unpack32(buffer + 28);
+	tz_ = unpack32(buffer + 32);
+}
+
+inline void HSURecord::pack32(uint32_t value, uint8_t *buffer)
+{
+	buffer[0] = (value >> 24) & 0xFF;
+	buffer[1] = (value >> 16) & 0xFF;
+	buffer[2] = (value >> 8) & 0xFF;
+	buffer[3] = (value >> 0) & 0xFF;
+}
+
+inline void HSURecord::pack(uint8_t *buffer) const
+{
+	pack32(hs_sequence_, buffer + 0);
+	pack32(ft_sequence_, buffer + 4);
+	pack32(status_, buffer + 8);
+	pack32((uint32_t) fx_, buffer + 12);
+	pack32((uint32_t) fy_, buffer + 16);
+	pack32((uint32_t) fz_, buffer + 20);
+	pack32((uint32_t) tx_, buffer + 24);
+	pack32((uint32_t) ty_, buffer + 28);
+	pack32((uint32_t) tz_, buffer + 32);
+}
+
+
+struct HSUCommand
+{
+	uint16_t command_header_;
+	uint16_t command_;
+	uint32_t sample_count_;
+
+	HSUCommand() : command_header_(HEADER)
+	{
+		// empty
+	}
+
+	enum { HEADER = 0x1234 };
+
+	// Possible values for command_
+	enum {
+		CMD_STOP_STREAMING = 0,
+		CMD_START_HIGH_SPEED_STREAMING = 2,
+		CMD_SET_SPEED = 0x0082,
+		CMD_SET_FILTER = 0x0081
+
+	};
+
+	// Special values for sample count
+	enum { INFINITE_SAMPLES = 0 };
+
+	enum { HSU_COMMAND_SIZE = 8 };
+
+	//!Packet structure into buffer for network transport
+	//  Buffer should be RDT_COMMAND_SIZE
+	void pack(uint8_t *buffer) const;
+};
+
+inline void HSUCommand::pack(uint8_t *buffer) const
+{
+	// Data is big-endian
+	buffer[0] = (command_header_ >> 8) & 0xFF;
+	buffer[1] = (command_header_ >> 0) & 0xFF;
+	buffer[2] = (command_ >> 8) & 0xFF;
+	buffer[3] = (command_ >> 0) & 0xFF;
+	buffer[4] = (sample_count_ >> 8) & 0xFF;
+	buffer[5] = (sample_count_ >> 0) & 0xFF;
+	buffer[6] = (sample_count_ >> 8) & 0xFF;
+	buffer[7] = (sample_count_ >> 0) & 0xFF;
+}
+
+
+#endif //PROJECT_OPTOFORCE_HSU_PROTOCOL_H
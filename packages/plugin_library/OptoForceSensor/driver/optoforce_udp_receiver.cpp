@@ -0,0 +1,301 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#include "optoforce_udp_receiver.h"
+#include "optoforce_hsu_protocol.h"
+#include <cobotsys_logger.h>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const int POLL_TIMEOUT_MS = 100;
+const int ERROR_BACKOFF_MS = 100; // 套接字出错后的等待时间，传感器断开时每个周期都会出错
+const int RECEIVE_BUFFER_SIZE = 256 * 1024;
+
+template<class T>
+void updateMax(std::atomic<T>& value, T candidate) {
+	T current = value.load(std::memory_order_relaxed);
+	while (candidate > current && !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+	}
+}
+}
+
+OptoforceUdpReceiver::OptoforceUdpReceiver(std::condition_variable& rt_msg_cond) :
+	m_socket(-1),
+	m_running(false),
+	m_pMsgCond(&rt_msg_cond),
+	m_hasSequence(false),
+	m_lastSequence(0),
+	m_forceScale(1.0 / DEFAULT_FORCE_DIV),
+	m_torqueScale(1.0 / DEFAULT_TORQUE_DIV),
+	m_packets(0),
+	m_lost(0),
+	m_reordered(0),
+	m_resyncs(0),
+	m_malformed(0),
+	m_batches(0),
+	m_maxBatch(0),
+	m_errors(0)
+{
+}
+
+OptoforceUdpReceiver::~OptoforceUdpReceiver() {
+	stop();
+}
+
+OptoforceUdpReceiver::Statistics OptoforceUdpReceiver::getStatistics() const {
+	Statistics statistics;
+	statistics.packets = m_packets;
+	statistics.lost = m_lost;
+	statistics.reordered = m_reordered;
+	statistics.resyncs = m_resyncs;
+	statistics.malformed = m_malformed;
+	statistics.batches = m_batches;
+	statistics.maxBatch = m_maxBatch;
+	statistics.errors = m_errors;
+	return statistics;
+}
+
+#if defined(__linux__)
+
+bool OptoforceUdpReceiver::openSocket(const std::string& ip) {
+	addrinfo hints;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	addrinfo* result = nullptr;
+	std::string port = std::to_string(OPTOFORCE_UDP_PORT);
+	if (getaddrinfo(ip.c_str(), port.c_str(), &hints, &result) != 0 || !result) {
+		COBOT_LOG.error("OptoForce") << "Unknown sensor address: " << ip;
+		return false;
+	}
+
+	m_socket = socket(AF_INET, SOCK_DGRAM, 0);
+	bool success = m_socket >= 0;
+	if (success) {
+		int enable = 1;
+		int bufferSize = RECEIVE_BUFFER_SIZE;
+		setsockopt(m_socket, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable));
+		setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+		success = connect(m_socket, result->ai_addr, result->ai_addrlen) == 0;
+	}
+	freeaddrinfo(result);
+
+	if (!success) {
+		COBOT_LOG.error("OptoForce") << "Fail to open UDP socket to " << ip << ": " << strerror(errno);
+		if (m_socket >= 0)
+			close(m_socket);
+		m_socket = -1;
+	}
+	return success;
+}
+
+bool OptoforceUdpReceiver::sendCommand(uint16_t command, uint32_t sampleCount) {
+	uint8_t buffer[HSUCommand::HSU_COMMAND_SIZE];
+	HSUCommand hsuCommand;
+	hsuCommand.command_ = command;
+	hsuCommand.sample_count_ = sampleCount;
+	hsuCommand.pack(buffer);
+	return send(m_socket, buffer, sizeof(buffer), 0) == (ssize_t) sizeof(buffer);
+}
+
+bool OptoforceUdpReceiver::start(const std::string& ip, int frequency, unsigned int filter) {
+	if (m_running) {
+		COBOT_LOG.info("OptoForce") << "Receiver already running";
+		return false;
+	}
+	if (!openSocket(ip))
+		return false;
+
+	frequency = std::max(1, std::min(1000, frequency));
+	bool success = sendCommand(HSUCommand::CMD_SET_SPEED, (uint32_t) (1000 / frequency)) &&
+	               sendCommand(HSUCommand::CMD_SET_FILTER, filter) &&
+	               sendCommand(HSUCommand::CMD_START_HIGH_SPEED_STREAMING, HSUCommand::INFINITE_SAMPLES);
+	if (!success) {
+		COBOT_LOG.error("OptoForce") << "Fail to start streaming: " << strerror(errno);
+		close(m_socket);
+		m_socket = -1;
+		return false;
+	}
+
+	m_hasSequence = false;
+	m_running = true;
+	m_thread = std::thread(&OptoforceUdpReceiver::recvThreadFunc, this);
+	return true;
+}
+
+void OptoforceUdpReceiver::stop() {
+	if (!m_running)
+		return;
+	m_running = false;
+	if (m_thread.joinable())
+		m_thread.join();
+	sendCommand(HSUCommand::CMD_STOP_STREAMING, 0);
+	close(m_socket);
+	m_socket = -1;
+}
+
+void OptoforceUdpReceiver::recvThreadFunc() {
+	uint8_t buffers[BATCH_SIZE][HSURecord::HSU_RECORD_SIZE + 1];
+	char controls[BATCH_SIZE][CMSG_SPACE(sizeof(timespec))];
+	iovec iovecs[BATCH_SIZE];
+	mmsghdr messages[BATCH_SIZE];
+
+	pollfd pfd;
+	pfd.fd = m_socket;
+	pfd.events = POLLIN;
+
+	while (m_running) {
+		int ready = poll(&pfd, 1, POLL_TIMEOUT_MS);
+		if (ready <= 0)
+			continue;
+
+		if (pfd.revents & POLLNVAL) {
+			COBOT_LOG.error("OptoForce") << "UDP socket is no longer valid, receiver thread exits.";
+			break;
+		}
+		if (pfd.revents & (POLLERR | POLLHUP)) {
+			// 读出 SO_ERROR 会清除挂起的错误，否则 poll 一直立即返回
+			int error = 0;
+			socklen_t length = sizeof(error);
+			getsockopt(m_socket, SOL_SOCKET, SO_ERROR, &error, &length);
+			if (m_errors++ % 100 == 0) {
+				COBOT_LOG.warning("OptoForce") << "UDP socket error: " << strerror(error)
+				                               << ", total: " << m_errors;
+			}
+			if (!(pfd.revents & POLLIN)) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(ERROR_BACKOFF_MS));
+				continue;
+			}
+		}
+
+		// 取完所有已到达的包，一次取不完就再取一次
+		int count = BATCH_SIZE;
+		while (count == BATCH_SIZE) {
+			for (int i = 0; i < BATCH_SIZE; i++) {
+				iovecs[i].iov_base = buffers[i];
+				iovecs[i].iov_len = sizeof(buffers[i]);
+				std::memset(&messages[i], 0, sizeof(mmsghdr));
+				messages[i].msg_hdr.msg_iov = &iovecs[i];
+				messages[i].msg_hdr.msg_iovlen = 1;
+				messages[i].msg_hdr.msg_control = controls[i];
+				messages[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+			}
+
+			count = recvmmsg(m_socket, messages, BATCH_SIZE, MSG_DONTWAIT, nullptr);
+			if (count <= 0)
+				break;
+
+			// 内核时间戳是 CLOCK_REALTIME，按包的"年龄"换算到 steady_clock
+			auto steadyNow = std::chrono::steady_clock::now();
+			timespec realNow;
+			clock_gettime(CLOCK_REALTIME, &realNow);
+			int64_t realNowNs = (int64_t) realNow.tv_sec * 1000000000LL + realNow.tv_nsec;
+
+			for (int i = 0; i < count; i++) {
+				auto time = steadyNow;
+				for (cmsghdr* cmsg = CMSG_FIRSTHDR(&messages[i].msg_hdr); cmsg;
+				     cmsg = CMSG_NXTHDR(&messages[i].msg_hdr, cmsg)) {
+					if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+						timespec stamp;
+						std::memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+						int64_t age = realNowNs - ((int64_t) stamp.tv_sec * 1000000000LL + stamp.tv_nsec);
+						if (age > 0)
+							time -= std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+									std::chrono::nanoseconds(age));
+					}
+				}
+				handleRecord(buffers[i], messages[i].msg_len, time);
+			}
+
+			m_batches++;
+			updateMax<uint64_t>(m_maxBatch, (uint64_t) count);
+			m_pMsgCond->notify_all();
+		}
+	}
+}
+
+#else
+
+bool OptoforceUdpReceiver::openSocket(const std::string&) {
+	return false;
+}
+
+bool OptoforceUdpReceiver::sendCommand(uint16_t, uint32_t) {
+	return false;
+}
+
+bool OptoforceUdpReceiver::start(const std::string&, int, unsigned int) {
+	COBOT_LOG.error("OptoForce") << "Dedicated UDP receiver is only available on Linux";
+	return false;
+}
+
+void OptoforceUdpReceiver::stop() {
+}
+
+void OptoforceUdpReceiver::recvThreadFunc() {
+}
+
+#endif
+
+void OptoforceUdpReceiver::handleRecord(const uint8_t* buffer, size_t length,
+                                        std::chrono::steady_clock::time_point time) {
+	if (length != HSURecord::HSU_RECORD_SIZE) {
+		m_malformed++;
+		return;
+	}
+
+	HSURecord record;
+	record.unpack(buffer);
+
+	// 序号是 32 位回绕计数，按差值的符号判断先后
+	// 回退超过几批的不是晚到的包，而是传感器重新开始计数，否则之后的包都会被当作乱序丢掉
+	if (m_hasSequence) {
+		int32_t gap = (int32_t) (record.hs_sequence_ - m_lastSequence);
+		if (gap < -RESYNC_GAP) {
+			m_resyncs++;
+			m_hasSequence = false;
+		}
+		else if (gap <= 0) {
+			m_reordered++;
+			return;
+		}
+		else {
+			m_lost += (uint64_t) (gap - 1);
+		}
+	}
+	m_hasSequence = true;
+	m_lastSequence = record.hs_sequence_;
+	m_packets++;
+
+	// 包的时间由 CLOCK_REALTIME 的年龄换算，系统时间调整时可能比上一个样本早
+	if (time < m_lastTime)
+		time = m_lastTime;
+	m_lastTime = time;
+
+	if (m_wrenchRing) {
+		cobotsys::WrenchSample sample;
+		sample.sequence = m_wrenchRing->written() + 1;
+		sample.time = time;
+		sample.force[0] = record.fx_ * m_forceScale;
+		sample.force[1] = record.fy_ * m_forceScale;
+		sample.force[2] = record.fz_ * m_forceScale;
+		sample.torque[0] = record.tx_ * m_torqueScale;
+		sample.torque[1] = record.ty_ * m_torqueScale;
+		sample.torque[2] = record.tz_ * m_torqueScale;
+		m_wrenchRing->push(sample);
+	}
+}
@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#ifndef PROJECT_OPTOFORCE_UDP_RECEIVER_H
+#define PROJECT_OPTOFORCE_UDP_RECEIVER_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <condition_variable>
+#include <cobotsys_abstract_force_sensor.h>
+
+/**
+ * OptoForce 高速 UDP 数据的独立接收线程，不经过 Qt 事件循环。
+ *
+ * 接收线程用 poll 等待数据，然后用 recvmmsg 一次系统调用取出所有已到达的数据包，
+ * 每个包的时间戳取内核收到包的时间(SO_TIMESTAMPNS)，换算到 steady_clock。
+ * 样本按包序号检查丢包和乱序：序号跳过的计入丢包，比已处理序号旧的包计入乱序并丢弃；
+ * 序号回退超过 RESYNC_GAP 时认为传感器重新开始计数(比如重新上电)，从这个包重新同步序号。
+ * 内核时间戳按 CLOCK_REALTIME 换算，系统时间被调整时可能回退，写入 WrenchRing 的样本时间不早于上一个样本。
+ * 每处理完一批数据包通知一次 rt_msg_cond。
+ * 套接字出错(比如传感器没有上电时收到 ICMP 端口不可达)时读出 SO_ERROR 清除错误，退避一段时间再等，
+ * 不会在 poll 上空转；套接字失效(POLLNVAL)时接收线程退出。
+ *
+ * 只在 Linux 下可用，其他平台 start() 返回 false。
+ */
+class OptoforceUdpReceiver {
+public:
+	enum {
+		BATCH_SIZE = 32, ///< 一次 recvmmsg 最多取出的包数
+		RESYNC_GAP = 4 * BATCH_SIZE, ///< 序号回退超过这么多包时重新同步，不再当作乱序丢弃
+	};
+
+	struct Statistics {
+		uint64_t packets = 0;   ///< 写入缓冲区的样本数
+		uint64_t lost = 0;      ///< 按包序号推算的丢包数
+		uint64_t reordered = 0; ///< 晚到而被丢弃的包数
+		uint64_t resyncs = 0;   ///< 序号大幅回退而重新同步的次数
+		uint64_t malformed = 0; ///< 长度不对的包数
+		uint64_t batches = 0;   ///< recvmmsg 调用次数
+		uint64_t maxBatch = 0;  ///< 单次 recvmmsg 取出的最多包数
+		uint64_t errors = 0;    ///< poll 报告的套接字错误次数
+	};
+
+public:
+	OptoforceUdpReceiver(std::condition_variable& rt_msg_cond);
+	~OptoforceUdpReceiver();
+
+	void setWrenchRing(const std::shared_ptr<cobotsys::WrenchRing>& ring) { m_wrenchRing = ring; }
+
+	/**
+	 * 连接传感器，设置采样频率和滤波，开始数据流并启动接收线程
+	 * @param frequency 采样频率，最高 1000
+	 * @param filter 传感器内部滤波器设置，0 为不滤波
+	 */
+	bool start(const std::string& ip, int frequency, unsigned int filter);
+	void stop();
+	bool isRunning() const { return m_running; }
+
+	Statistics getStatistics() const;
+
+protected:
+	bool openSocket(const std::string& ip);
+	bool sendCommand(uint16_t command, uint32_t sampleCount);
+	void recvThreadFunc();
+	void handleRecord(const uint8_t* buffer, size_t length, std::chrono::steady_clock::time_point time);
+
+protected:
+	int m_socket;
+	std::thread m_thread;
+	std::atomic<bool> m_running;
+	std::condition_variable* m_pMsgCond;
+	std::shared_ptr<cobotsys::WrenchRing> m_wrenchRing;
+
+	bool m_hasSequence;
+	uint32_t m_lastSequence;
+	std::chrono::steady_clock::time_point m_lastTime; ///< 上一个写入缓冲区的样本时间
+	double m_forceScale;
+	double m_torqueScale;
+
+	std::atomic<uint64_t> m_packets;
+	std::atomic<uint64_t> m_lost;
+	std::atomic<uint64_t> m_reordered;
+	std::atomic<uint64_t> m_resyncs;
+	std::atomic<uint64_t> m_malformed;
+	std::atomic<uint64_t> m_batches;
+	std::atomic<uint64_t> m_maxBatch;
+	std::atomic<uint64_t> m_errors;
+};
+
+
+#endif //PROJECT_OPTOFORCE_UDP_RECEIVER_H
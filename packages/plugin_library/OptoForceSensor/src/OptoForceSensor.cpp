@@ -13,10 +13,13 @@ OptoForceSensor::OptoForceSensor() :
 	QObject(nullptr),
 	m_upd_driver(nullptr),
 	m_isWatcherRunning(false),
-	m_isStarted(false)
+	m_isStarted(false),
+	m_attr_sensor_filter(0)
 {
+	m_wrenchRing = std::make_shared<WrenchRing>();
 	m_upd_driver = new OptoforceEthernetUDPDriver(m_rt_msg_cond);
 	if (m_upd_driver) {
+		m_upd_driver->setWrenchRing(m_wrenchRing);
 		connect(m_upd_driver, &OptoforceEthernetUDPDriver::sensorconnected, this, &OptoForceSensor::handleDriverReady);
 		connect(m_upd_driver, &OptoforceEthernetUDPDriver::sensordisconnected, this, &OptoForceSensor::handleDriverDisconnect);
 		connect(m_upd_driver, &QObject::destroyed, [=](QObject*) { handleDriverDisconnect(); });
@@ -24,6 +27,9 @@ OptoForceSensor::OptoForceSensor() :
 }
 
 OptoForceSensor::~OptoForceSensor() {
+	if (m_udpReceiver) {
+		m_udpReceiver->stop();
+	}
 	if (m_isWatcherRunning) {
 		m_isWatcherRunning = false;
 		m_rt_msg_cond.notify_all();
@@ -50,6 +56,13 @@ bool OptoForceSensor::start() {
 		return false;
 	}
 
+	if (m_udpReceiver) {
+		if (!m_udpReceiver->start(m_attr_sensor_ip, m_attr_sensor_frequency, m_attr_sensor_filter))
+			return false;
+		handleDriverReady();
+		return true;
+	}
+
 	//set ip and hz
 	m_upd_driver->setIp(m_attr_sensor_ip.c_str());
 	m_upd_driver->setFrequency(m_attr_sensor_frequency);
@@ -60,6 +73,20 @@ bool OptoForceSensor::start() {
 }
 
 void OptoForceSensor::stop() {
+	if (m_udpReceiver) {
+		if (m_udpReceiver->isRunning()) {
+			m_udpReceiver->stop();
+			auto statistics = m_udpReceiver->getStatistics();
+			COBOT_LOG.info() << "OptoForce packets: " << statistics.packets << ", lost: " << statistics.lost
+				<< ", reordered: " << statistics.reordered << ", resyncs: " << statistics.resyncs
+				<< ", malformed: " << statistics.malformed
+				<< ", batches: " << statistics.batches << ", max batch: " << statistics.maxBatch
+				<< ", errors: " << statistics.errors;
+			handleDriverDisconnect();
+		}
+		return;
+	}
+
 	std::lock_guard<std::mutex> lock_guard(m_mutex);
 
 	if (m_isStarted) {
@@ -82,13 +109,18 @@ void OptoForceSensor::attach(const std::shared_ptr<ForceSensorStreamObserver>& o
 	}
 }
 
+std::shared_ptr<const WrenchRing> OptoForceSensor::getWrenchRing() const {
+	return m_wrenchRing;
+}
+
 void OptoForceSensor::sensorDataWatcher() {
 	std::mutex m;
 	std::unique_lock<std::mutex> lck(m);
 
 	auto time_cur = std::chrono::high_resolution_clock::now();
 
-	auto pStatus = std::make_shared<Wrench>();
+	uint64_t lastSequence = 0;
+	WrenchSample sample;
 
 	while (m_isWatcherRunning) {
 		m_rt_msg_cond.wait(lck);
@@ -99,15 +131,12 @@ void OptoForceSensor::sensorDataWatcher() {
 		//time_cur = time_rdy;
 		//COBOT_LOG.info() << "Status Updated: " << time_diff.count();
 
-		// 抓取当前值
-		if (m_mutex.try_lock()) {
-			if (m_upd_driver) {
-				auto state = m_upd_driver->getState();
-				pStatus->force = state.force;
-				pStatus->torque = state.torque;
-			}
-			m_mutex.unlock();
-		}
+		// 抓取当前值。每次通知用一个新的对象，观察者持有的旧值不会被接收线程改写
+		uint64_t sequence = 0;
+		if (!m_wrenchRing->latest(sample, &sequence) || sequence == lastSequence)
+			continue;
+		lastSequence = sequence;
+		auto pStatus = std::make_shared<Wrench>(sample.toWrench());
 
 		// 通知所有观察者，数据已经更新。
 		if (m_isStarted) {
@@ -126,6 +155,14 @@ bool OptoForceSensor::_setup(const QString& configFilePath) {
 		m_attr_sensor_frequency = json["frequency"].toInt(125);
 		m_protocol = json["protocol"].toString("UDP").toStdString();
 		std::transform(m_protocol.begin(), m_protocol.end(), m_protocol.begin(), ::toupper);//to upper
+		m_attr_sensor_filter = (unsigned int) json["filter"].toInt(0);
+		if (json["receive_mode"].toString("event_loop") == "dedicated_thread") {
+			m_udpReceiver.reset(new OptoforceUdpReceiver(m_rt_msg_cond));
+			m_udpReceiver->setWrenchRing(m_wrenchRing);
+		}
+		else {
+			m_udpReceiver.reset();
+		}
 
 		m_isWatcherRunning = true;
 		m_thread = std::thread(&OptoForceSensor::sensorDataWatcher, this);
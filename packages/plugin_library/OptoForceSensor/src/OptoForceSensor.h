@@ -13,6 +13,7 @@
 #include <QObject>
 #include <QString>
 #include "../driver/optoforce_ethernet_udp_driver.h"
+#include "../driver/optoforce_udp_receiver.h"
 
 using namespace cobotsys;
 
@@ -26,6 +27,7 @@ public:
 	virtual bool start();
 	virtual void stop();
 	virtual void attach(const std::shared_ptr<ForceSensorStreamObserver>& observer);
+	virtual std::shared_ptr<const WrenchRing> getWrenchRing() const;
 protected:
 	void sensorDataWatcher();
 
@@ -51,6 +53,11 @@ protected:
 	std::vector<std::shared_ptr<ForceSensorStreamObserver> > m_observers;
 
 	OptoforceEthernetUDPDriver *m_upd_driver;
+	std::shared_ptr<WrenchRing> m_wrenchRing;
+
+	// receive_mode 为 dedicated_thread 时使用独立接收线程，不经过 Qt 事件循环
+	std::unique_ptr<OptoforceUdpReceiver> m_udpReceiver;
+	unsigned int m_attr_sensor_filter;
 
 };
 
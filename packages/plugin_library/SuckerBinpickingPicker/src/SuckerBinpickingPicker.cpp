@@ -14,6 +14,9 @@ SuckerBinpickingPicker::SuckerBinpickingPicker()
     m_suckerPortIndex = DigitIoPort::Port_3;
     m_cylinderPortIndex = DigitIoPort::Port_0;
     m_hasPickDefPose = false;
+    m_blendRadius = 0;
+    m_vacuumOnDistance = 0.02;
+    m_releaseDistance = 0;
 }
 
 SuckerBinpickingPicker::~SuckerBinpickingPicker() {
@@ -40,6 +43,7 @@ bool SuckerBinpickingPicker::pickObject(const binpicking::BinObjGrabPose &binObj
     m_digitIoDriver->setIo(m_cylinderPortIndex, DigitIoStatus::Reset);
 
     TargetPoint.clear();
+    m_targets.ioEvents.clear();
 
 //    m_defHomePos = {0.72928,-0.20981,0.42024};
 //    m_defHomeRpy = {-M_PI,0,-M_PI/2};
@@ -70,63 +74,78 @@ bool SuckerBinpickingPicker::pickObject(const binpicking::BinObjGrabPose &binObj
     m_targets.moveId = m_moveId1;
     m_targets.position = m_defHomePos;
     m_targets.rpy = m_defHomeRpy;
+    m_targets.blendRadius = m_blendRadius;
     TargetPoint.push_back(m_targets);
 
+    // IO 在运动过程中由 Mover 触发，Wait 点不用再停下来等回调
     m_moveId2 = m_ptrMover->generateMoveId();
     m_targets.moveId = m_moveId2;
     m_targets.position = m_defWaitPos;
     m_targets.rpy = m_defWaitRpy;
+    m_targets.blendRadius = m_blendRadius;
     TargetPoint.push_back(m_targets);
 
+    // 下降时伸出气缸，接触前开真空
     m_moveId3 = m_ptrMover->generateMoveId();
     m_targets.moveId = m_moveId3;
     m_targets.position = positionGrab.position;
     m_targets.rpy = positionGrab.rotation;
+    m_targets.blendRadius = 0;
+    m_targets.ioEvents = {
+            MoveIoEvent::atPathParameter(0, m_cylinderPortIndex, DigitIoStatus::Set, m_digitIoDriver),
+            MoveIoEvent::atDistanceToGoal(m_vacuumOnDistance, m_suckerPortIndex, DigitIoStatus::Set, m_digitIoDriver)
+    };
     TargetPoint.push_back(m_targets);
 
+    // 离开抓取点时收回气缸。抓取点是停止点，Mover 在停留(stopDwell)结束后才触发，真空有时间吸住
     m_moveId4 = m_ptrMover->generateMoveId();
     m_targets.moveId = m_moveId4;
     m_targets.position = m_defWaitPos;
     m_targets.rpy = m_defWaitRpy;
+    m_targets.blendRadius = m_blendRadius;
+    m_targets.ioEvents = {
+            MoveIoEvent::atPathParameter(0, m_cylinderPortIndex, DigitIoStatus::Reset, m_digitIoDriver)
+    };
     TargetPoint.push_back(m_targets);
+    m_targets.ioEvents.clear();
 
     m_moveId5 = m_ptrMover->generateMoveId();
     m_targets.moveId = m_moveId5;
     m_targets.position = m_defHomePos;
     m_targets.rpy = m_defHomeRpy;
+    m_targets.blendRadius = m_blendRadius;
     TargetPoint.push_back(m_targets);
 
+    // 接近放置点时伸出气缸并释放
     m_moveId6 = m_ptrMover->generateMoveId();
     m_targets.moveId = m_moveId6;
     m_targets.position = m_defPlacePos;
     m_targets.rpy = m_defPlaceRpy;
+    m_targets.blendRadius = 0;
+    m_targets.ioEvents = {
+            MoveIoEvent::atDistanceToGoal(m_releaseDistance, m_cylinderPortIndex, DigitIoStatus::Set, m_digitIoDriver),
+            MoveIoEvent::atDistanceToGoal(m_releaseDistance, m_suckerPortIndex, DigitIoStatus::Reset, m_digitIoDriver)
+    };
     TargetPoint.push_back(m_targets);
 
+    // 放置点停留结束、离开时收回气缸，不会和到点时的伸出落在同一个伺服周期
     m_moveId7 = m_ptrMover->generateMoveId();
     m_targets.moveId = m_moveId7;
     m_targets.position = m_defHomePos;
     m_targets.rpy = m_defHomeRpy;
+    m_targets.blendRadius = 0;
+    m_targets.ioEvents = {
+            MoveIoEvent::atPathParameter(0, m_cylinderPortIndex, DigitIoStatus::Reset, m_digitIoDriver)
+    };
     TargetPoint.push_back(m_targets);
+    m_targets.ioEvents.clear();
 
     m_ptrMover->move(TargetPoint);
 
     while(true) {
         m_msg.wait(uniqueLock);
      //   COBOT_LOG.notice("111111111111111111111111111111111111111111111aaa") << m_moveId;
-        if(m_moveId == m_moveId2){
-            m_digitIoDriver->setIo(m_suckerPortIndex, DigitIoStatus::Set);
-            m_digitIoDriver->setIo(m_cylinderPortIndex, DigitIoStatus::Set);
-        }
-        if(m_moveId == m_moveId3){
-            m_digitIoDriver->setIo(m_cylinderPortIndex, DigitIoStatus::Reset);
-        }
-        if(m_moveId == m_moveId6){
-            m_digitIoDriver->setIo(m_cylinderPortIndex, DigitIoStatus::Set);
-            m_digitIoDriver->setIo(m_suckerPortIndex, DigitIoStatus::Reset);
-        }
         if (m_moveId == m_moveId7) {
-            m_digitIoDriver->setIo(m_cylinderPortIndex, DigitIoStatus::Reset);
-
             auto time_end = std::chrono::high_resolution_clock::now();
             std::chrono::duration<double> time_diff =time_end -time_start;
             COBOT_LOG.info() << "******count:"<< count <<"*********************time:" << time_diff.count() * 1000 << "ms";
@@ -310,6 +329,11 @@ bool SuckerBinpickingPicker::setup(const QString &configFilePath) {
             m_defPlaceRpy[2] = jrpy[2].toDouble() * M_PI / 180;
             COBOT_LOG.notice() << "Place: " << m_defPlacePos << ", " << m_defPlaceRpy;
         }
+        m_blendRadius = jsonObject["BlendRadius"].toDouble(0);
+        m_vacuumOnDistance = jsonObject["VacuumOnDistance"].toDouble(m_vacuumOnDistance);
+        m_releaseDistance = jsonObject["ReleaseDistance"].toDouble(m_releaseDistance);
+        COBOT_LOG.notice() << "BlendRadius: " << m_blendRadius << ", VacuumOnDistance: " << m_vacuumOnDistance
+                           << ", ReleaseDistance: " << m_releaseDistance;
         return true;
     }
     return false;
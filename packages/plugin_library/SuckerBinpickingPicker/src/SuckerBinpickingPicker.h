@@ -52,6 +52,9 @@ private:
     cv::Vec3d m_defWaitRpy;
     cv::Point3d m_defPlacePos;
     cv::Vec3d m_defPlaceRpy;
+    double m_blendRadius; // Home、Wait 等中间点的过渡半径，0 表示每个点都停止
+    double m_vacuumOnDistance; // 离抓取点多远时开真空(米)
+    double m_releaseDistance;  // 离放置点多远时释放(米)，0 表示到达时释放
 
     std::vector<RobotWaypoint> TargetPoint;
     RobotWaypoint m_targets;
@@ -12,6 +12,8 @@ CobotUrDigitIoAdapter::CobotUrDigitIoAdapter() {
     m_isOutput = false;
     m_inputIoStatus = 0;
     m_outputIoStatus = 0;
+    m_debugIoLastStatus = 0;
+    m_inputValid = false;
 }
 
 CobotUrDigitIoAdapter::~CobotUrDigitIoAdapter() {
@@ -54,7 +56,7 @@ bool CobotUrDigitIoAdapter::isDigitOutput() const {
 void CobotUrDigitIoAdapter::debugIoStatus() {
     if (isDigitInput() && m_debugIoLastStatus != m_inputIoStatus) {
 #ifdef DEBUG
-        COBOT_LOG.message("Input") << std::hex << setw(8) << m_inputIoStatus;
+        COBOT_LOG.message("Input") << std::hex << setw(8) << m_inputIoStatus.load();
 #endif // DEBUG
 
         m_debugIoLastStatus = m_inputIoStatus;
@@ -100,10 +102,95 @@ bool CobotUrDigitIoAdapter::setToolVoltage(double v) {
 }
 
 void CobotUrDigitIoAdapter::setUrRealTimeCtrl(CobotUrRealTimeCommCtrl* realTimeCommCtrl) {
-    m_realTimeCommCtrl = realTimeCommCtrl;
-    if (m_realTimeCommCtrl == nullptr) {
-        m_inputIoStatus = 0;
-        m_outputIoStatus = 0;
+    std::vector<DigitIoEvent> events;
+    {
+        std::lock_guard<std::mutex> lockGuard(m_ioMutex);
+        m_realTimeCommCtrl = realTimeCommCtrl;
+        if (m_realTimeCommCtrl == nullptr) {
+            // 断开连接，所有输入口当作 Reset，按下的按钮通知 Falling
+            if (m_inputValid) {
+                collectEdges(0, std::chrono::steady_clock::now(), events);
+            }
+            m_inputValid = false;
+            m_inputIoStatus = 0;
+            m_outputIoStatus = 0;
+        }
+    }
+    notifyEdges(events);
+}
+
+void CobotUrDigitIoAdapter::updateInputBits(uint32_t bits, std::chrono::steady_clock::time_point time) {
+    std::vector<DigitIoEvent> events;
+    {
+        std::lock_guard<std::mutex> lockGuard(m_ioMutex);
+        if (m_realTimeCommCtrl == nullptr) // 已经断开，这是断开之前的状态包
+            return;
+        collectEdges(bits, time, events);
+        m_inputValid = true;
+    }
+    notifyEdges(events);
+}
+
+void CobotUrDigitIoAdapter::collectEdges(uint32_t bits, std::chrono::steady_clock::time_point time,
+                                         std::vector<DigitIoEvent>& events) {
+    // 连接后的第一个状态包和全 Reset 比较
+    uint32_t last = m_inputValid ? (uint32_t) m_inputIoStatus.load() : 0;
+    uint32_t changed = last ^ bits;
+    m_inputIoStatus = (int) bits;
+    if (changed == 0 || m_ioObservers.empty())
+        return;
+
+    for (int i = 0; i < 32; i++) {
+        uint32_t mask = 1u << i;
+        if (changed & mask) {
+            DigitIoEvent event;
+            event.port = (DigitIoPort) mask;
+            event.edge = (bits & mask) ? DigitIoEdge::Rising : DigitIoEdge::Falling;
+            event.timestamp = time;
+            events.push_back(event);
+        }
+    }
+}
+
+void CobotUrDigitIoAdapter::notifyEdges(const std::vector<DigitIoEvent>& events) {
+    if (events.empty())
+        return;
+
+    std::vector<std::shared_ptr<DigitIoObserver> > observers;
+    {
+        std::lock_guard<std::mutex> lockGuard(m_ioMutex);
+        observers = m_ioObservers;
+    }
+    for (auto& event : events) {
+        for (auto& observer : observers) {
+            observer->onDigitIoEdge(event);
+        }
+    }
+}
+
+bool CobotUrDigitIoAdapter::attach(const std::shared_ptr<DigitIoObserver>& observer) {
+    if (!m_isInput)
+        return false;
+
+    std::lock_guard<std::mutex> lockGuard(m_ioMutex);
+    for (auto& iter : m_ioObservers) {
+        if (iter.get() == observer.get()) {
+            return true; // Already have attached
+        }
+    }
+    if (observer) {
+        m_ioObservers.push_back(observer);
+    }
+    return true;
+}
+
+void CobotUrDigitIoAdapter::detach(const std::shared_ptr<DigitIoObserver>& observer) {
+    std::lock_guard<std::mutex> lockGuard(m_ioMutex);
+    for (auto iter = m_ioObservers.begin(); iter != m_ioObservers.end(); ++iter) {
+        if (iter->get() == observer.get()) {
+            m_ioObservers.erase(iter);
+            return;
+        }
     }
 }
 
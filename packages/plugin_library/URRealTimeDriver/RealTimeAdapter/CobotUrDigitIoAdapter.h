@@ -8,6 +8,9 @@
 
 
 #include <cobotsys_abstract_digit_io_driver.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
 #include "CobotUrRealTimeCommCtrl.h"
 
 using namespace cobotsys;
@@ -27,24 +30,42 @@ public:
 
     virtual bool setToolVoltage(double v);
 
+    virtual bool attach(const std::shared_ptr<DigitIoObserver>& observer);
+    virtual void detach(const std::shared_ptr<DigitIoObserver>& observer);
+
 
     void setUrRealTimeCtrl(CobotUrRealTimeCommCtrl* realTimeCommCtrl);
 
+    /**
+     * 每个实时状态包调用一次，更新输入口状态并通知跳变。
+     * 不能在 URRealTimeDriver 的锁里调用，观察者的回调在这里执行。
+     * @param bits 实时状态包里的 digital_input_bits (低 32 位)
+     * @param time 状态包的接收时间
+     */
+    void updateInputBits(uint32_t bits, std::chrono::steady_clock::time_point time);
+
 
     // 这是一个内部类，没有怎么严格的要求写。
     std::vector<DigitIoStatus> m_ioPortStatus;
     bool m_isInput;
     bool m_isOutput;
 
-    int m_inputIoStatus;
+    std::atomic<int> m_inputIoStatus; ///< 驱动线程在 m_ioMutex 里写，getIoStatus() 不加锁读
     int m_outputIoStatus;
 
     int m_debugIoLastStatus;
 
     CobotUrRealTimeCommCtrl* m_realTimeCommCtrl;
 
+    std::mutex m_ioMutex;
+    bool m_inputValid; ///< 连接后是否已经收到过输入口状态
+    std::vector<std::shared_ptr<DigitIoObserver> > m_ioObservers;
+
     void debugIoStatus();
 
+    void collectEdges(uint32_t bits, std::chrono::steady_clock::time_point time, std::vector<DigitIoEvent>& events);
+    void notifyEdges(const std::vector<DigitIoEvent>& events);
+
     void setDigitOut(int portIndex, bool b);
 
 };
@@ -18,6 +18,8 @@ URRealTimeDriver::URRealTimeDriver() : QObject(nullptr) {
 
     m_digitInput = std::make_shared<CobotUrDigitIoAdapter>();
     m_digitOutput = std::make_shared<CobotUrDigitIoAdapter>();
+    m_digitInput->m_isInput = true; // 启动之前就可以注册跳变观察者
+    m_digitOutput->m_isOutput = true;
     m_objectAlive = std::make_shared<bool>(true);
     m_urMessage = std::make_shared<std::condition_variable>();
     m_numAlived = std::make_shared<ref_num>();
@@ -78,8 +80,6 @@ void URRealTimeDriver::inrStartHandle() {
     // 这里是数字驱动的部分
     m_digitInput->setUrRealTimeCtrl(m_urDriver->m_urRealTimeCommCtrl);
     m_digitOutput->setUrRealTimeCtrl(m_urDriver->m_urRealTimeCommCtrl);
-    m_digitInput->m_isInput = true;
-    m_digitOutput->m_isOutput = true;
 }
 
 bool URRealTimeDriver::start() {
@@ -137,6 +137,9 @@ void URRealTimeDriver::robotStatusWatcher() {
     std::vector<std::shared_ptr<ArmRobotRealTimeStatusObserver> > observer_tmp;
     std::vector<double> q_next;
 
+    uint32_t inputBits = 0;
+    std::chrono::steady_clock::time_point inputTime;
+
     std::vector<double> daemonQ(6, 0);
     std::mutex daemonLock;
     auto daemonStatus = std::make_shared<ArmRobotStatus>();
@@ -166,11 +169,18 @@ void URRealTimeDriver::robotStatusWatcher() {
         m_urMessage->wait(uniqueLock);
 
         // Update Io Status when Robot Joint Update.
+        bool inputUpdated = false;
         if (m_mutex.try_lock()) {
-            _updateDigitIoStatus();
+            inputUpdated = _updateDigitIoStatus(inputBits, inputTime);
             m_mutex.unlock();
         }
 
+        // 输入口跳变在锁外通知，观察者在机器人状态通知之前就能拿到新的按钮状态
+        if (inputUpdated) {
+            m_digitInput->updateInputBits(inputBits, inputTime);
+            m_digitInput->debugIoStatus();
+        }
+
         // 计算时间间隔
         auto time_rdy = std::chrono::high_resolution_clock::now();
         std::chrono::duration<double> time_diff = time_rdy - time_cur; // 时间间隙
@@ -188,6 +198,7 @@ void URRealTimeDriver::robotStatusWatcher() {
 
                 pStatus->q_actual = robotState->getQActual();
                 pStatus->qd_actual = robotState->getQdActual();
+                pStatus->timestamp = robotState->getReceiveTime();
             }
             m_mutex.unlock();
         }
@@ -277,17 +288,24 @@ void URRealTimeDriver::notify(std::function<void(std::shared_ptr<ArmRobotRealTim
     }
 }
 
-void URRealTimeDriver::_updateDigitIoStatus() {
+bool URRealTimeDriver::_updateDigitIoStatus(uint32_t& inputBits, std::chrono::steady_clock::time_point& inputTime) {
     if (m_digitInput && m_isStarted && m_urDriver) {
         auto outBits = m_urDriver->m_urCommCtrl->ur->getRobotState()->getDigitalOutputBits();
-        auto inBits = m_urDriver->m_urCommCtrl->ur->getRobotState()->getDigitalInputBits();
-
-        m_digitInput->m_inputIoStatus = inBits;
         m_digitOutput->m_outputIoStatus = outBits;
-
-        m_digitInput->debugIoStatus();
         m_digitOutput->debugIoStatus();
+
+        // 输入口使用实时接口的状态包(125Hz/500Hz)，二级接口只有 10Hz，而且 3.0 之前的版本没有工具输入口
+        auto robotState = m_urDriver->m_urRealTimeCommCtrl->ur->getRobotState();
+        auto inBits = robotState->getDigitalInputBits();
+        inputBits = 0;
+        for (size_t i = 0; i < inBits.size() && i < 32; i++) {
+            if (inBits[i])
+                inputBits |= 1u << i;
+        }
+        inputTime = robotState->getReceiveTime();
+        return true;
     }
+    return false;
 }
 
 void URRealTimeDriver::clearAttachedObject() {
@@ -52,7 +52,7 @@ protected:
     void handleDriverDisconnect();
     void notify(std::function<void(std::shared_ptr<ArmRobotRealTimeStatusObserver>& observer)> func);
 
-    void _updateDigitIoStatus();
+    bool _updateDigitIoStatus(uint32_t& inputBits, std::chrono::steady_clock::time_point& inputTime);
 
     void handleObjectDestroy(QObject* object);
 protected:
@@ -150,6 +150,14 @@ double RobotStateRT::getTime() {
     return ret;
 }
 
+std::chrono::steady_clock::time_point RobotStateRT::getReceiveTime() {
+    std::chrono::steady_clock::time_point ret;
+    val_lock_.lock();
+    ret = receive_time_;
+    val_lock_.unlock();
+    return ret;
+}
+
 std::vector<double> RobotStateRT::getQTarget() {
     std::vector<double> ret;
     val_lock_.lock();
@@ -367,9 +375,9 @@ std::vector<double> RobotStateRT::getVActual() {
 }
 
 void RobotStateRT::unpack(uint8_t* buf) {
-    int64_t digital_input_bits;
     uint64_t unpack_to;
     uint16_t offset = 0;
+    auto receive_time = std::chrono::steady_clock::now();
     val_lock_.lock();
     int len;
     memcpy(&len, &buf[offset], sizeof(len));
@@ -407,6 +415,7 @@ void RobotStateRT::unpack(uint8_t* buf) {
 
     memcpy(&unpack_to, &buf[offset], sizeof(unpack_to));
     time_ = RobotStateRT::ntohd(unpack_to);
+    receive_time_ = receive_time;
     offset += sizeof(double);
     q_target_ = unpackVector(buf, offset, 6);
     //COBOT_LOG.notice() << "Ver: " << version_ << ", Len: " << len << ", " << putfixedfloats(5, 1, q_actual_);
@@ -449,8 +458,9 @@ void RobotStateRT::unpack(uint8_t* buf) {
     }
     offset += sizeof(double) * 6;
 
-    memcpy(&digital_input_bits, &buf[offset], sizeof(digital_input_bits));
-    digital_input_bits_ = unpackDigitalInputBits(local2::ntoh64((const uint64_t*) &digital_input_bits));
+    //digital_input_bits is sent as a double whose value holds the bits, e.g. 5.0 is bit 0 and bit 2 set high
+    memcpy(&unpack_to, &buf[offset], sizeof(unpack_to));
+    digital_input_bits_ = unpackDigitalInputBits((int64_t) ntohd(unpack_to));
     offset += sizeof(double);
     motor_temperatures_ = unpackVector(buf, offset, 6);
     offset += sizeof(double) * 6;
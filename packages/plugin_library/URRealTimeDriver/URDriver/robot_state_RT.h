@@ -32,12 +32,14 @@
 
 #endif
 #include <condition_variable>
+#include <chrono>
 
 class RobotStateRT {
 private:
     double version_; //protocol version
 
     double time_; //Time elapsed since the controller was started
+    std::chrono::steady_clock::time_point receive_time_; //Local steady clock time when the message was received
     std::vector<double> q_target_; //Target joint positions
     std::vector<double> qd_target_; //Target joint velocities
     std::vector<double> qdd_target_; //Target joint accelerations
@@ -82,6 +84,7 @@ public:
     ~RobotStateRT();
     double getVersion();
     double getTime();
+    std::chrono::steady_clock::time_point getReceiveTime();
     std::vector<double> getQTarget();
     std::vector<double> getQdTarget();
     std::vector<double> getQddTarget();
@@ -4,542 +4,238 @@
 //
 
 #include <extra2.h>
+#include <algorithm>
+#include <cmath>
 #include "Ur10JointFilter.h"
 
-using namespace Eigen;
-using namespace Eigen::internal;
-using namespace Eigen::Architecture;
-using namespace cobotsys;
-using namespace std;
-using namespace KDL;
-using namespace std;
-Ur10JointFilter::Ur10JointFilter()
-{
-}
-
-Ur10JointFilter::~Ur10JointFilter()
-{
-}
-
-bool Ur10JointFilter::setup(const QString& configFilePath)
-{
+namespace {
+const size_t UR10_JOINT_NUM = 6;
+// UR10 默认限制，单位：度
+const double UR10_POSITION_LIMIT = 360;
+const double UR10_VELOCITY_LIMITS[UR10_JOINT_NUM] = {120, 120, 180, 180, 180, 180};
+const double UR10_ACCELERATION_LIMIT = 1800;
+const double UR10_JERK_LIMIT = 90000;
+
+/**
+ * 读取一组以度为单位的关节参数，转换为弧度；配置里没有或者个数不对时保持原值。
+ */
+void readJointDegrees(const QJsonObject& json, const char* key, std::vector<double>& values) {
+    auto array = readRealArray(json[key]);
+    if (array.empty())
+        return;
+    if (array.size() != values.size()) {
+        COBOT_LOG.warning("JointFilter") << key << " size " << array.size() << " != " << values.size() << ", ignored.";
+        return;
+    }
+    for (size_t i = 0; i < array.size(); i++)
+        values[i] = array[i] * M_PI / 180;
+}
+
+/**
+ * 把 value 限制在 [lower, upper]
+ * @retval true 限制生效
+ */
+inline bool clampValue(double& value, double lower, double upper) {
+    if (value > upper) {
+        value = upper;
+        return true;
+    }
+    if (value < lower) {
+        value = lower;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * 停止距离 d(v) = v^2 / 2A + v * A / 2J 的反解：距离 distance 以内能停下来的最大速度
+ */
+inline double brakeVelocity(double distance, double A, double J) {
+    double rampVel = A * A / (2 * J);
+    return std::sqrt(rampVel * rampVel + 2 * A * std::max(0.0, distance)) - rampVel;
+}
+
+/**
+ * 朝 direction(+1/-1) 方向，下一周期走过的距离，加上当前加速度按加加速度限制降到 0 期间多走的距离。
+ * brakeVelocity() 假设从零加速度开始减速，不扣掉这部分会冲过位置限制。
+ */
+inline double brakeLookahead(double vel, double acc, double direction, double dt, double J) {
+    double v = vel * direction;
+    double a = acc * direction;
+    double distance = std::max(0.0, v) * dt;
+    if (v > 0 && a > 0)
+        distance += v * a / J + a * a * a / (3 * J * J);
+    return distance;
+}
+}
+
+Ur10JointFilter::Ur10JointFilter() {
+    m_positionMin.assign(UR10_JOINT_NUM, -UR10_POSITION_LIMIT * M_PI / 180);
+    m_positionMax.assign(UR10_JOINT_NUM, UR10_POSITION_LIMIT * M_PI / 180);
+    m_velocityLimits.assign(UR10_VELOCITY_LIMITS, UR10_VELOCITY_LIMITS + UR10_JOINT_NUM);
+    for (auto& val : m_velocityLimits) val = val * M_PI / 180;
+    m_accelerationLimits.assign(UR10_JOINT_NUM, UR10_ACCELERATION_LIMIT * M_PI / 180);
+    m_jerkLimits.assign(UR10_JOINT_NUM, UR10_JERK_LIMIT * M_PI / 180);
+    m_resetInterval = 0.1;
+    m_stateValid = false;
+    resizeState(UR10_JOINT_NUM);
+}
+
+Ur10JointFilter::~Ur10JointFilter() {
+    auto stat = getLimitStatistics();
+    if (stat.callCount) {
+        COBOT_LOG.notice("JointFilter") << "Calls: " << stat.callCount << ", resets: " << stat.resetCount;
+        for (size_t i = 0; i < stat.positionHits.size(); i++) {
+            COBOT_LOG.notice("JointFilter") << "J" << i + 1
+                                            << " position: " << stat.positionHits[i]
+                                            << ", velocity: " << stat.velocityHits[i]
+                                            << ", acceleration: " << stat.accelerationHits[i]
+                                            << ", jerk: " << stat.jerkHits[i];
+        }
+    }
+}
+
+bool Ur10JointFilter::setup(const QString& configFilePath) {
     QJsonObject configJson;
-    QString objConfig = FileFinder::find("CONFIG/UrRobotConfig/ur10_180_config.json").c_str();
-    if (objConfig.isEmpty())
-    {
-        COBOT_LOG.notice() << "robot config is empty, robot create fail.";
-    }
-    else
-    {
-        COBOT_LOG.notice() << "Succeed loading the config file.";
-    }
-    auto obj = GlobalObjectFactory::instance()->createObject("KinematicSolverFactory, Ver 1.0", "KinematicSolver");
-    if (loadJson(configJson, configFilePath))
-    {
-        MyThreadParameter.m_kinematicSolver = std::dynamic_pointer_cast<AbstractKinematicSolver>(obj);
-        if (MyThreadParameter.m_kinematicSolver)
-        {
-            if (MyThreadParameter.m_kinematicSolver->setup(objConfig))
-            {
-                COBOT_LOG.notice() << "Create Setup Solver Success";
-            }
-            else
-            {
-                MyThreadParameter.m_kinematicSolver.reset();
-            }
-        }
-        m_jointLimits = readRealArray(configJson["JointLimits"]);
-        m_jointAccLimits = readRealArray(configJson["JointAccLimits"]);
-        //for (auto& val : m_jointLimits) val = val * M_PI / 180 / 1000 * 8;
-       // for (auto& val : m_jointLimits) val = 0.2;
-        m_jointLimits[0] = 0.4;
-        m_jointLimits[1] = 0.4;
-        m_jointLimits[2] = 0.4;
-        m_jointLimits[3] = 0.4;
-        m_jointLimits[4] = 0.4;
-        m_jointLimits[5] = 0.4;
-
-        COBOT_LOG.notice() << "Joint Filter Limits: " << putfixedfloats(6, 1, m_jointLimits, 180 / M_PI);
-    }
+    if (!loadJson(configJson, configFilePath)) {
+        COBOT_LOG.warning("JointFilter") << "Load config fail, use default limits.";
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    readJointDegrees(configJson, "JointPositionMin", m_positionMin);
+    readJointDegrees(configJson, "JointPositionMax", m_positionMax);
+    readJointDegrees(configJson, "JointVelocityLimits", m_velocityLimits);
+    readJointDegrees(configJson, "JointAccelerationLimits", m_accelerationLimits);
+    readJointDegrees(configJson, "JointJerkLimits", m_jerkLimits);
+    m_resetInterval = configJson["ResetInterval"].toDouble(m_resetInterval);
+    m_stateValid = false;
+
+    COBOT_LOG.notice("JointFilter") << "Velocity Limits: " << putfixedfloats(6, 1, m_velocityLimits, 180 / M_PI);
+    COBOT_LOG.notice("JointFilter") << "Acceleration Limits: " << putfixedfloats(6, 1, m_accelerationLimits, 180 / M_PI);
+    COBOT_LOG.notice("JointFilter") << "Jerk Limits: " << putfixedfloats(6, 1, m_jerkLimits, 180 / M_PI);
     return true;
 }
 
-void  Ur10JointFilter::GetDisire() //新建一个线程用来完成数据的差值运算
-{
-    while(MyThreadParameter.Threadflag==1)  //弄个死循环让它一直跑去算了
-    {
-        double t = 0;
-        while (MyThreadParameter.TimeAdd < MyThreadParameter.MyTime * 1000)
-        {
-            //cout << "2" << endl;
-            if(MyThreadParameter.mtx.try_lock())
-            {
-                t = (double) (MyThreadParameter.TimeAdd) / 1000;
-                vector<double>::iterator iter1 = MyThreadParameter.a0.begin();
-                vector<double>::iterator iter2 = MyThreadParameter.a1.begin();
-                vector<double>::iterator iter3 = MyThreadParameter.a2.begin();
-                vector<double>::iterator iter4 = MyThreadParameter.a3.begin();
-                for (int i = 0; i < 6; i++)
-                {
-                    MyThreadParameter.SendBuf[i] =
-                            *iter1 + *iter2 * t + *iter3 * pow(t, (double) 2) + *iter4 * pow(t, (double) 3);
-                    iter1++;
-                    iter2++;
-                    iter3++;
-                    iter4++;
-                }
-                //cout<<MyThreadParameter.TimeAdd<<endl;
-                MyThreadParameter.mtx.unlock();
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(8));
-            MyThreadParameter.TimeAdd += 8;//表示的是毫秒级的数值
-        }
-        MyThreadParameter.FinishFlag = true;//程序执行完毕，将结束标志位置真
-        if(MyThreadParameter.NumFlag<65534)
-            MyThreadParameter.NumFlag++;
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));//必须延时，不然程序跑死了
-    }
-}
-void Ur10JointFilter::TrajectoryPlaner3(std::vector<double>& aim, std::vector<double>& now)  //三次多项式规划函数，点对点规划，
-{
-    // 控制量为初始及末端位置和初始及末端速度
-    std::vector<double> AimNow(aim);
-    static uchar Creatflag=0;
-    if (MyThreadParameter.AimOld != AimNow)  //判断本次的目标值是否与上次的目标值相同，不要重复执行
-    {
-        MyThreadParameter.FinishFlag = false;//程序刚刚开始执行，将结束标志位改变为错误
-        MyThreadParameter.a0.clear();//忘记清空了。。。。。
-        MyThreadParameter.a1.clear();
-        MyThreadParameter.a2.clear();
-        MyThreadParameter.a3.clear();
-        MyThreadParameter.MyTime=DivisionTime(aim,now);
-        cout<<"Result Time: "<<MyThreadParameter.MyTime<<endl;
-        for (int i = 0; i < aim.size(); i++)  //得到每个关节的三次多项式差值参数
-        {
-            double a = now[i];
-            double b = MyThreadParameter.VelBegin[i];
-            double c = (-3 * now[i] + 3 * aim[i] - 2 * MyThreadParameter.MyTime * MyThreadParameter.VelBegin[i]
-                        - MyThreadParameter.MyTime * MyThreadParameter.VelEnd[i]) / pow((double) MyThreadParameter.MyTime, (double) 2);
-            double d = (2 * now[i] - 2 * aim[i] + MyThreadParameter.MyTime * MyThreadParameter.VelBegin[i]
-                        + MyThreadParameter.MyTime * MyThreadParameter.VelEnd[i] )/ pow((double) MyThreadParameter.MyTime, (double) 3);
-            MyThreadParameter.a0.push_back(a);
-            MyThreadParameter.a1.push_back(b);
-            MyThreadParameter.a2.push_back(c);
-            MyThreadParameter.a3.push_back(d);
-        }
-        if(!Creatflag)  //线程只创建一次，不要重复
-        {
-            std::thread Thread1(&Ur10JointFilter::GetDisire,this);
-            Thread1.detach();
-            Creatflag = 1;
-        }
-        MyThreadParameter.TimeAdd = 0;
-    }
-    MyThreadParameter.AimOld = AimNow;
+void Ur10JointFilter::resizeState(size_t jointNum) {
+    m_rawTarget.assign(jointNum, 0);
+    m_position.assign(jointNum, 0);
+    m_velocity.assign(jointNum, 0);
+    m_acceleration.assign(jointNum, 0);
+    m_statistics.positionHits.assign(jointNum, 0);
+    m_statistics.velocityHits.assign(jointNum, 0);
+    m_statistics.accelerationHits.assign(jointNum, 0);
+    m_statistics.jerkHits.assign(jointNum, 0);
 }
 
-
-double  Ur10JointFilter::DivisionTime(vector<double>& aim,vector<double>& now) //使用二分法取得最优的规划时间
-{
-    double Time = MyThreadParameter.TimeMax;
-    double TimeLower=0;//二分法的下限
-    double TimeHighter = MyThreadParameter.TimeMax;//二分法的上限
-    double MiddleTime[6];//二次函数到达峰值的时间
-    bool NextTurnFlag = true;//判断下一次迭代是是要向下减少时间，还是向上增加时间，true为减少时间，false为增加时间
-    double A0[6],A1[6],A2[6],A3[6];//找好四个关节
-    double SpeedMaxStart[6],SpeedMaxStop[6],SpeedMaxMiddle[6];
-    double ASpeedMaxStart[6],ASpeedMaxStop[6];
-
-    while((TimeHighter-TimeLower)>0.1)  //二分法的终止条件是我的精度小于0.1S了
-    {
-        for (int i = 0; i < aim.size(); i++)  //得到每个关节的三次多项式差值参数
-        {
-            double a = now[i];
-            double b = MyThreadParameter.VelBegin[i];
-            double c = (-3 * now[i] + 3 * aim[i] - 2 * Time * MyThreadParameter.VelBegin[i]
-                        - Time * MyThreadParameter.VelEnd[i]) / pow((double) Time, (double) 2);
-            double d = (2 * now[i] - 2 * aim[i] + Time * MyThreadParameter.VelBegin[i]
-                        + Time * MyThreadParameter.VelEnd[i]) / pow((double) Time, (double) 3);
-            A0[i] = a;
-            A1[i] = b;
-            A2[i] = c;
-            A3[i] = d;
-        }
-        for (int i = 0; i < aim.size(); i++)  //获得每个关节的加速度和速度的值，用来判断时间是大了还是小了
-        {
-            MiddleTime[i] = (-1) * A2[i] / A3[i] / 3;
-            SpeedMaxStart[i] = A1[i];
-            SpeedMaxStop[i] = A1[i] + 2 * A2[i] * Time + 3 * A3[i] * pow(Time, 2.0);
-            if ((MiddleTime[i] < 0) || (MiddleTime[i] > Time))
-                SpeedMaxMiddle[i] = 0;
-            else
-            {
-                SpeedMaxMiddle[i] = SpeedMaxStop[i] =
-                        A1[i] + 2 * A2[i] * MiddleTime[i] + 3 * A3[i] * pow(MiddleTime[i], 2.0);
-            }
-            ASpeedMaxStart[i] = 2 * A2[i];
-            ASpeedMaxStop[i] = 2 * A2[i] + 6 * A3[i];
-        }
-        for (int i = 0; i < aim.size(); i++)  //都是弧度制的，分析是否有超过限制。
-        {
-            if (fabs(SpeedMaxStart[i]) > MyThreadParameter.SpeedLimit[i])
-            {
-                NextTurnFlag = false;
-                break;
-            }
-            if (fabs(SpeedMaxStop[i]) > MyThreadParameter.SpeedLimit[i])
-            {
-                NextTurnFlag = false;
-                break;
-            }
-            if (fabs(SpeedMaxMiddle[i]) > MyThreadParameter.SpeedLimit[i])
-            {
-                NextTurnFlag = false;
-                break;
-            }
-            if (fabs(ASpeedMaxStart[i]) > MyThreadParameter.ASpeedLimit[i])
-            {
-                NextTurnFlag = false;
-                break;
-            }
-            if (fabs(ASpeedMaxStop[i]) > MyThreadParameter.ASpeedLimit[i])
-            {
-                NextTurnFlag = false;
-                break;
-            }
-            NextTurnFlag = true;//如果都满足条件了，当然要改变一下啊
-        }
-        if(NextTurnFlag)//如果说都能满足要求,则证明时间还有余量，则把上限设置为当前时间
-            TimeHighter=Time;
-        else//如果说不能满足要求，则证明时间已经太小了，把下限设置为当前时间
-            TimeLower=Time;
-        Time = (TimeHighter+TimeLower)/2;
-        //cout<<TimeHighter<<endl;
+void Ur10JointFilter::resetState(const std::vector<double>& q_actual) {
+    for (size_t i = 0; i < m_position.size(); i++) {
+        m_rawTarget[i] = q_actual[i];
+        m_position[i] = q_actual[i];
+        m_velocity[i] = 0;
+        m_acceleration[i] = 0;
     }
-    return TimeHighter;
+    m_stateValid = true;
+    m_statistics.resetCount++;
 }
 
-double Ur10JointFilter::GetError(vector<double>& target,vector<double>& now)
-{
-    double Error=0;
-    for(int i=0; i<target.size(); i++)
-        Error += (target[i]-now[i])*(target[i]-now[i]);//获得误差的范数
-    return Error;
-}
-
-
-void Ur10JointFilter::PlanerTest(std::vector<double>& target_, const ArmRobotStatusPtr& ptrRobotStatus)
-{
-    //控制两点运动,怎么知道程序是在什么时候改变的？
-    {
-        vector<double> TestBuf;
-        static vector<double> Temp(target_.size(), 0);
-        static uchar justone = 1;
-        static vector<double> vectorold(6,0);
-        static uchar JudgeFlag = 0;
-        if ((target_.size() != 0) && (ptrRobotStatus->q_actual.size() != 0))  //只有当向量不为0时，才能够对程序进行执行
-        {
-            if(justone)
-            {
-                Temp = ptrRobotStatus->q_actual;
-                justone = 0;
-                vectorold = ptrRobotStatus->q_actual;
-                cout<<"lueluelue"<<endl;
-            }
-            if ((GetError(target_, ptrRobotStatus->q_actual) > ErrorLimit) &&
-                (MyThreadParameter.FinishFlag))//只有在Setflag被置位之后才会执行代入指令
-            {
-                Temp = target_;
-                //COBOT_LOG.notice() << putfixedfloats(7,2,Temp,180/M_PI)<<"  Setting";
-                //cout << "Setting  " <<MyThreadParameter.FinishFlag<< endl;
-            }
-            // COBOT_LOG.notice() << putfixedfloats(7,2,Temp,1)<<" 2 "<<(int)MyThreadParameter.FinishFlag;
-            TrajectoryPlaner3(Temp, ptrRobotStatus->q_actual);
-            if(MyThreadParameter.mtx.try_lock())
-            {
-                for (int i = 0; i < target_.size(); i++)
-                {
-                    target_[i] = MyThreadParameter.SendBuf[i];
-                }
-                vectorold = target_;
-                MyThreadParameter.mtx.unlock();
-                //COBOT_LOG.notice() << putfixedfloats(7,2,target_,1)<<" 2 "<<(int)MyThreadParameter.FinishFlag;
-            }
-            else
-                target_=vectorold;
-        }
-    }
-}
-
-void Ur10JointFilter::FilterPlaner(std::vector<double> &target_, const ArmRobotStatusPtr &ptrRobotStatus)
-{
-    {
-        m_target = target_;
-        auto curPosi = ptrRobotStatus->q_actual;
-        auto curVelo = ptrRobotStatus->qd_actual;
-
-        if (m_target.size() != curPosi.size())
-            return;
-
-        if (cxx::distance(curVelo) > 0.001)
-        {
-//        COBOT_LOG.debug() << "J-Speed: " << putfixedfloats(6, 3, curVelo, 180 / M_PI);
-        }
-
-        double maxRadPerTick = 360 * M_PI / 180 / 1000 * 8;
-        if (m_jointLimits.size() != m_target.size())
-        {
-            m_jointLimits.resize(m_target.size(), maxRadPerTick);
-            COBOT_LOG.warning() << "Config Joint Limit use Default: " << maxRadPerTick;
-        }
-
-        auto posiInc = curVelo;
-        std::vector<double> diffNew(m_target.size(), 0);
-
-        cxx::norm_all(posiInc);
-        cxx::add_other(posiInc, m_jointAccLimits);
-
-        for (size_t i = 0; i < m_target.size(); i++)
-        {
-            diffNew[i] = m_target[i] - curPosi[i];
+void Ur10JointFilter::applyFilter(std::vector<double>& target_, const ArmRobotStatusPtr& ptrRobotStatus) {
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
 
-            cxx::limit(diffNew[i], posiInc[i]);
+    const auto& q_actual = ptrRobotStatus->q_actual;
+    if (target_.size() != m_position.size() || q_actual.size() != m_position.size())
+        return;
 
-            cxx::limit(diffNew[i], m_jointLimits[i]);
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - m_lastTime;
+    double dt = elapsed.count();
+    m_statistics.callCount++;
 
-            target_[i] = curPosi[i] + diffNew[i];
-        }
+    if (!m_stateValid || dt > m_resetInterval) {
+        resetState(q_actual);
+        m_lastTime = now;
+        dt = 0;
     }
-}
 
-///***********************TCP梯形差值××××××××××××××××××××××
-//考虑加个判断调价 不然逆解总出问题
-double Ur10JointFilter::LineError(vector<double>&a,vector<double>&b)
-{
-    double error = 0;
-    for(int i=0; i<3; i++)
-    {
-        error += (a[i]-b[i])*(a[i]-b[i]);
+    // URRealTimeDriver 的守护线程会把上一次的输出再送进来，这时继续跟踪上层最近给的目标
+    if (target_ != m_position) {
+        for (size_t i = 0; i < target_.size(); i++)
+            m_rawTarget[i] = target_[i];
     }
-    return error;
-}
 
-vector<double> Ur10JointFilter::RoundP2p(vector<JointAngle> route,vector<double>& JointNow) //定义一个函数用来表示对一系列进行运动
-{
-    //MyThreadParameter.LineP2pCount = 8000;
-    int Size = route.size();
-    vector<double> NOW=route[0],NEXT=route[1];
-    double Tb = TCPMAXSPEED/TCPMAXACC;
-    double Lb = TCPMAXACC * pow(Tb,2.0) *0.5;
-    //cout<<Lb<<endl;
-    double L= sqrt(pow((NOW[0] -NEXT[1]),2.0)+pow((NOW[2] -NEXT[2]),2.0)+pow((NOW[3] -NEXT[3]),2.0));//求取距离
-    double T = 2*Tb + (L-2*Lb)/TCPMAXSPEED;
-    double Lblamu = Lb/L;
-    double Tblamu = Tb/T;
-    double Alafalamu = (2*Lblamu)/pow(Tblamu,2.0);
-    double lamu =0 ;
-    double t=MyThreadParameter.LineP2pCount / T/1000;
-    vector<double> NextPos(JointNow.size(),0);
-    double PowNum;
-    if(t<=Tblamu)
-    {
-        PowNum= t*t;
-        lamu = 0.5 * Alafalamu * PowNum;
+    if (dt < 1e-4) {
+        target_ = m_position;
+        return;
     }
-    else if(t<= (1-Tblamu))
-        lamu = 0.5 *Alafalamu * pow(Tblamu,2.0) +Alafalamu*Tblamu*(t-Tblamu);
-    else if(t <= 1)
-        lamu = 0.5 *Alafalamu * pow(Tblamu,2.0) +Alafalamu*Tblamu*(t-Tblamu)-0.5*Alafalamu*pow((t+Tblamu-1),2.0);
+    m_lastTime = now;
 
-    for(int i=0; i<6; i++)
-        NextPos[i] = NOW[i] + lamu*(NEXT[i]-NOW[i]);
-    vector<double> PosAim=NextPos;
-    vector<double> PosReturn(JointNow.size(),0);
-    MyThreadParameter.m_kinematicSolver->cartToJnt(JointNow,PosAim,PosReturn);
+    for (size_t i = 0; i < m_position.size(); i++) {
+        double goal = m_rawTarget[i];
+        if (clampValue(goal, m_positionMin[i], m_positionMax[i]))
+            m_statistics.positionHits[i]++;
 
-    if(GetError(NextPos,route[1])<0.00001)
-    {
-        MyThreadParameter.LineP2pCount=T*1000;
-        MyThreadParameter.MainOnce=1;
-        MyThreadParameter.MainOnce1 =1;
-        MyThreadParameter.P2pflag =0;
-        MyThreadParameter.FinishFlag = true;
-        COBOT_LOG.notice("Succeeed Point");
+        // 期望速度：本周期到达目标，同时保证在加速度和加加速度限制下还能停在目标上
+        double A = m_accelerationLimits[i];
+        double J = m_jerkLimits[i];
+        double error = goal - m_position[i];
+        double vel = error / dt;
+        double brakeVel = brakeVelocity(std::fabs(error), A, J);
+        clampValue(vel, -brakeVel, brakeVel);
+        // 位置限制按提前量留出余量，正常接近时在限制前停下，不会碰到下面的硬限位
+        double upperDistance = m_positionMax[i] - m_position[i] - brakeLookahead(m_velocity[i], m_acceleration[i], 1, dt, J);
+        double lowerDistance = m_position[i] - m_positionMin[i] - brakeLookahead(m_velocity[i], m_acceleration[i], -1, dt, J);
+        clampValue(vel, -brakeVelocity(lowerDistance, A, J), brakeVelocity(upperDistance, A, J));
+        if (clampValue(vel, -m_velocityLimits[i], m_velocityLimits[i]))
+            m_statistics.velocityHits[i]++;
 
-    }
-    return PosReturn;
-}
-void Ur10JointFilter::LineP2pGo()
-{
-    while(1)
-    {
-        if(!(MyThreadParameter.FinishFlag))
-        {
-            if(MyThreadParameter.mtx.try_lock())
-            {
-                // MyThreadParameter.mtx.lock();
-                MyThreadParameter.targetNow.clear();
-                for (int i = 0; i < 6; i++)
-                    MyThreadParameter.targetNow.push_back(0);
-                MyThreadParameter.targetNow = RoundP2p(MyThreadParameter.route, MyThreadParameter.JointNow);
-                //COBOT_LOG.notice()<<putfixedfloats(7,2,MyThreadParameter.targetNow,M_PI/180);
-                MyThreadParameter.calflag  = 1;
-                MyThreadParameter.mtx.unlock();
-            }
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(8));
-    }
-}
-void Ur10JointFilter::LineP2pTest(std::vector<double>& target_, const ArmRobotStatusPtr& ptrRobotStatus)
-{
-    static std::vector<double> AimNow(target_.size(),0);
-    static std::vector<double> Temp(6,0);
-    static vector<double>  AimOld(6,0);
-    static vector<double> carnow(6,0);
-    static vector<double> jointnow(6,0);
-    vector<double> test(6,M_PI);
-    static uchar NowOnce =1;
-    static uchar outonce =1 ;
-    static vector<double> outAim;
-    static vector<double> outAim1;
-    static uchar firstflag =1;//是否是第一次被执行？
-    static uchar Creatflag=0;
-    static vector<double> JointOld(6,0);
-    jointnow = ptrRobotStatus->q_actual;
-    if(MyThreadParameter.mtx.try_lock())
-    {
-        if ((target_.size() != 0) && (jointnow.size() != 0))
-        {
-            if (MyThreadParameter.FinishFlag)
-            {
-                AimNow = target_;
-                // cout<<"New Aim"<<endl;
-            }
-            double Derror = GetError(AimNow, jointnow);
-            if (MyThreadParameter.FinishFlag && Derror > 0.1)
-            {
-                MyThreadParameter.m_kinematicSolver->jntToCart(AimNow, Temp);
-                MyThreadParameter.m_kinematicSolver->jntToCart(jointnow, AimOld);
-                MyThreadParameter.route.clear();
-                MyThreadParameter.route.push_back(AimOld);
-                MyThreadParameter.route.push_back(Temp);
-                MyThreadParameter.LineP2pCount = 0;
-                MyThreadParameter.FinishFlag = 0;
-                MyThreadParameter.JointNow.clear();
-                MyThreadParameter.Threadflag = 0;
-                // cout<<"lueluelue"<<endl;
-                for (int i = 0; i < 6; i++)
-                    MyThreadParameter.JointNow.push_back(ptrRobotStatus->q_actual[i]);
-                if (!Creatflag)  //线程只创建一次，不要重复
-                {
-                    std::thread Thread2(&Ur10JointFilter::LineP2pGo,this);
-                    Thread2.detach();
-                    Creatflag = 1;
-                }
-            }
-            if (!MyThreadParameter.FinishFlag)
-            {
-                //MyThreadParameter.mtx.lock();//数据同步
-                target_ = MyThreadParameter.targetNow;
-                JointOld = target_;
-                //COBOT_LOG.notice()<<putfixedfloats(7,2,target_,1);//抖动是因为根本没有进入这个东西
-                MyThreadParameter.JointNow.clear();
-                for (int i = 0; i < 6; i++)
-                    MyThreadParameter.JointNow.push_back(ptrRobotStatus->q_actual[i]);
-                MyThreadParameter.LineP2pCount += 8;
-                //COBOT_LOG.notice() << putfixedfloats(7,2,target_,1);
-                MyThreadParameter.mtx.unlock();
-            }
-        }
-        MyThreadParameter.mtx.unlock();
-    }
-    else
-        target_ = JointOld;
-    //就是得另起一个线程，不然主程序会卡死
-}
+        // 期望加速度：加速度要能在速度到达期望值之前按加加速度限制回到 0，否则速度会超调
+        double velError = vel - m_velocity[i];
+        double acc = velError / dt;
+        double rampAcc = std::sqrt(2 * J * std::fabs(velError));
+        clampValue(acc, -rampAcc, rampAcc);
+        double jerkStep = J * dt;
+        if (clampValue(acc, m_acceleration[i] - jerkStep, m_acceleration[i] + jerkStep))
+            m_statistics.jerkHits[i]++;
+        if (clampValue(acc, -A, A))
+            m_statistics.accelerationHits[i]++;
+
+        vel = m_velocity[i] + acc * dt;
+        clampValue(vel, -m_velocityLimits[i], m_velocityLimits[i]);
 
-void Ur10JointFilter::SetEndVel(vector<double>&A,vector<double>&B,vector<double>&C){
-    if(A.size()&&B.size()&&C.size()){
-        for(int i =0;i<6;i++){
-            if((C[i]-B[i])*(B[i]-A[i])<=0)
-                this->MyThreadParameter.VelEnd[i] = 0;
-            else{
-                this->MyThreadParameter.VelEnd[i]=((B[i]-A[i])>0)?(this->MyThreadParameter.SpeedLimit[i]/2)
-                                                  :(-1*this->MyThreadParameter.SpeedLimit[i]/2);
-            }
+        // 硬限位：位置限制优先于加加速度限制。上面的制动余量让正常接近很少走到这里，
+        // 重置时实际位置已经接近限制、调用间隔突然变化或者伺服周期很短(1ms)时仍可能触发，这一步的加加速度不受限制。
+        double pos = m_position[i] + vel * dt;
+        if (clampValue(pos, m_positionMin[i], m_positionMax[i])) {
+            vel = (pos - m_position[i]) / dt;
+            acc = 0;
         }
+
+        m_position[i] = pos;
+        m_velocity[i] = vel;
+        m_acceleration[i] = acc;
+        target_[i] = pos;
     }
 }
 
-
-void Ur10JointFilter::SetPar(int LocationFlag,int CountFlag,std::vector<std::vector<double>>Route) {
-    //cout<<"lueluelue"<<endl;
-    this->MyThreadParameter.CountFlag = CountFlag;
-    if (CountFlag != this->MyThreadParameter.CountFlagOld) {
-        if (Route.size() < 3) {
-            for (int i = 0; i < 6; i++) {
-                this->MyThreadParameter.VelBegin[i] = 0;
-                this->MyThreadParameter.VelEnd[i] = 0;
-            }
-        } else {
-            switch (LocationFlag) {
-                case 0: {
-                    for (int i = 0; i < 6; i++)
-                        this->MyThreadParameter.VelBegin[i] = 0;
-                    SetEndVel(Route[0], Route[1], Route[2]);
-                    for (int i = 0; i < 6; i++)
-                        this->MyThreadParameter.VelEndOld[i] = this->MyThreadParameter.VelEnd[i];
-                }
-                case 1: {
-                    for (int i = 0; i < 6; i++)
-                        this->MyThreadParameter.VelBegin[i] = this->MyThreadParameter.VelEndOld[i];
-                    SetEndVel(Route[0], Route[1], Route[2]);
-                    for (int i = 0; i < 6; i++)
-                        this->MyThreadParameter.VelEndOld[i] = this->MyThreadParameter.VelEnd[i];
-                }
-                case 2: {
-                    for (int i = 0; i < 6; i++)
-                        this->MyThreadParameter.VelBegin[i] = this->MyThreadParameter.VelEndOld[i];
-                    for (int i = 0; i < 6; i++)
-                        this->MyThreadParameter.VelEnd[i] = 0;
-                }
-            }
-        }
-        this->MyThreadParameter.CountFlagOld= CountFlag;
-    }
+void Ur10JointFilter::SetPar(int LocationFlag, int CountFlag, std::vector<std::vector<double>> Route) {
+    // 限幅器不做路径规划，没有需要设置的参数
 }
+
 bool Ur10JointFilter::GetFinishFlag() {
-    return this->MyThreadParameter.FinishFlag;
+    return true;
 }
-void Ur10JointFilter::LittleFilter(std::vector<double>& target_, const ArmRobotStatusPtr& ptrRobotStatus){
-    if((target_.size()>0)&&(ptrRobotStatus->q_actual.size()>0)) {
-        m_target = target_;
-        auto curPosi = ptrRobotStatus->q_actual;
 
-        double maxRadPerTick = 60 * M_PI / 180 / 1000 * 8;
-        if (m_jointLimits.size() != m_target.size()) {
-            m_jointLimits.resize(m_target.size(), maxRadPerTick);
-            COBOT_LOG.warning() << "Config Joint Limit use Default: " << maxRadPerTick;
-        }
-
-        std::vector<double> diffNew(m_target.size(), 0);
-        for (size_t i = 0; i < m_target.size(); i++) {
-            diffNew[i] = m_target[i] - curPosi[i];
-
-            if (diffNew[i] > m_jointLimits[i])//是否又超出限制
-                diffNew[i] = m_jointLimits[i];
-            if (diffNew[i] < -m_jointLimits[i])
-                diffNew[i] = -m_jointLimits[i];
-            target_[i] = curPosi[i] + diffNew[i];
-        }
-    }
+Ur10JointFilter::LimitStatistics Ur10JointFilter::getLimitStatistics() {
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    return m_statistics;
 }
 
-void Ur10JointFilter::applyFilter(std::vector<double>& target_, const ArmRobotStatusPtr& ptrRobotStatus) {
-    //FilterPlaner(target_,ptrRobotStatus);//简单滤波
-    //PlanerTest(target_,ptrRobotStatus);//关节角三次多项式规划运动
-    //LineP2pTest(target_,ptrRobotStatus);//TCP直线运动
-   // LittleFilter(target_,ptrRobotStatus);
-//    //COBOT_LOG.debug() << putfixedfloats(7, 2, diffNew, 180 / M_PI);
+void Ur10JointFilter::resetLimitStatistics() {
+    std::lock_guard<std::mutex> lockGuard(m_mutex);
+    auto jointNum = m_position.size();
+    m_statistics = LimitStatistics();
+    m_statistics.positionHits.assign(jointNum, 0);
+    m_statistics.velocityHits.assign(jointNum, 0);
+    m_statistics.accelerationHits.assign(jointNum, 0);
+    m_statistics.jerkHits.assign(jointNum, 0);
 }
-
@@ -0,0 +1,441 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#include "BlendPlanner.h"
+#include <cobotsys_logger.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include "path_line.hpp"
+#include "path_circle.hpp"
+#include "rotational_interpolation_sa.hpp"
+#include "velocityprofile_trap.hpp"
+
+namespace {
+const double BlendEps = 1e-6;
+const int MaxTimeScaleIter = 10;
+// 关节表的平滑次数。LMA 逆解的姿态精度大约是 1e-3 弧度，这个误差会直接变成伺服周期上的加速度，
+// 每次用 (1, 2, 1)/4 平滑一遍，两端不动。
+const int TableSmoothPasses = 2;
+
+void smoothTable(std::vector<std::vector<double> >& table) {
+    if (table.size() < 3)
+        return;
+    std::vector<std::vector<double> > source;
+    for (int pass = 0; pass < TableSmoothPasses; pass++) {
+        source = table;
+        for (size_t j = 1; j + 1 < table.size(); j++) {
+            for (size_t i = 0; i < table[j].size(); i++)
+                table[j][i] = (source[j - 1][i] + 2 * source[j][i] + source[j + 1][i]) / 4;
+        }
+    }
+}
+
+void appendFrame(std::vector<double>& geometry, const KDL::Frame& frame) {
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++)
+            geometry.push_back(frame.M(r, c));
+    }
+    for (int i = 0; i < 3; i++)
+        geometry.push_back(frame.p(i));
+}
+
+/**
+ * 一段从静止到静止的连续路径，以及这段路径上各路点的完成位置(路径长度)。
+ * geometry 与 path 里的元素一一对应，记录构造元素用的参数。
+ */
+struct SubPath {
+    std::unique_ptr<KDL::Path_Composite> path;
+    std::vector<std::vector<double> > geometry;
+    std::vector<size_t> waypointIndex;
+    std::vector<double> markLength;
+    double maxVel;
+
+    SubPath() : path(new KDL::Path_Composite()), maxVel(0) {}
+
+    void addLine(const KDL::Frame& start, const KDL::Frame& end, double eqRadius) {
+        path->Add(new KDL::Path_Line(start, end, new KDL::RotationalInterpolation_SingleAxis(), eqRadius));
+        std::vector<double> g(1, 0);
+        appendFrame(g, start);
+        appendFrame(g, end);
+        geometry.push_back(g);
+    }
+
+    double addCircle(const KDL::Frame& start, const KDL::Vector& center, const KDL::Frame& end, double alpha,
+                     double eqRadius) {
+        KDL::Path* circle = new KDL::Path_Circle(start, center, end.p, end.M, alpha,
+                                                 new KDL::RotationalInterpolation_SingleAxis(), eqRadius);
+        path->Add(circle);
+        std::vector<double> g(1, 1);
+        appendFrame(g, start);
+        appendFrame(g, end);
+        for (int i = 0; i < 3; i++)
+            g.push_back(center(i));
+        g.push_back(alpha);
+        geometry.push_back(g);
+        return circle->PathLength();
+    }
+};
+}
+
+BlendPlanner::BlendPlanner() {
+    m_cacheSolver = nullptr;
+    m_cacheGeneration = 0;
+}
+
+void BlendPlanner::clearCache() {
+    m_cache.clear();
+    m_trajectoryCache.clear();
+}
+
+void BlendPlanner::updateCache(const std::shared_ptr<AbstractKinematicSolver>& solver) {
+    const auto& a = m_config;
+    const auto& b = m_cacheConfig;
+    // 关节表只和几何、逆解有关，速度和加速度限制改了不用清空
+    bool configChanged = a.eqRadius != b.eqRadius || a.maxJointStep != b.maxJointStep || a.pathStep != b.pathStep;
+    // 同一个求解器对象可能重新 setup() 换了模型，只比较指针不够
+    uint64_t generation = solver->modelGeneration();
+    if (configChanged || solver.get() != m_cacheSolver || generation != m_cacheGeneration) {
+        if (m_cache.size() || m_trajectoryCache.size())
+            COBOT_LOG.notice("BlendPlanner") << "Kinematic config changed, clear trajectory cache.";
+        clearCache();
+        m_cacheSolver = solver.get();
+        m_cacheGeneration = generation;
+    }
+    // 整条轨迹还和时间规划有关
+    bool timingChanged = a.servoPeriod != b.servoPeriod || a.maxTcpVel != b.maxTcpVel || a.maxTcpAcc != b.maxTcpAcc
+                         || a.stopDwell != b.stopDwell || a.jointVelLimit != b.jointVelLimit
+                         || a.jointAccLimit != b.jointAccLimit;
+    if (timingChanged)
+        m_trajectoryCache.clear();
+    m_cacheConfig = m_config;
+    m_cache.setLimit(m_config.cacheMaxEntries, m_config.cacheMaxSamples);
+    m_cache.setTolerance(m_config.cacheJointTolerance, m_config.cachePoseTolerance);
+    m_trajectoryCache.setLimit(m_config.trajectoryCacheMaxEntries, m_config.trajectoryCacheMaxSamples);
+    m_trajectoryCache.setTolerance(m_config.cacheJointTolerance, m_config.cachePoseTolerance);
+}
+
+KDL::Frame BlendPlanner::toFrame(const std::vector<double>& pose) {
+    return KDL::Frame(KDL::Rotation::RPY(pose[3], pose[4], pose[5]), KDL::Vector(pose[0], pose[1], pose[2]));
+}
+
+std::vector<double> BlendPlanner::toPose(const KDL::Frame& frame) {
+    double r, p, y;
+    frame.M.GetRPY(r, p, y);
+    return {frame.p.x(), frame.p.y(), frame.p.z(), r, p, y};
+}
+
+bool BlendPlanner::plan(const std::shared_ptr<AbstractKinematicSolver>& solver,
+                        const std::vector<double>& startJoint,
+                        const std::vector<Waypoint>& waypoints,
+                        std::deque<std::vector<double> >& samples,
+                        std::deque<Mark>& marks) {
+    samples.clear();
+    marks.clear();
+    if (!solver || waypoints.empty())
+        return false;
+    for (auto& wp : waypoints) {
+        if (wp.pose.size() != 6) {
+            COBOT_LOG.error("BlendPlanner") << "Invalid waypoint pose size: " << wp.pose.size();
+            return false;
+        }
+    }
+
+    std::vector<double> startPose;
+    solver->jntToCart(startJoint, startPose);
+    if (startPose.size() != 6)
+        return false;
+
+    // 1. 构造路径。能过渡的路点用圆弧连接，不能过渡的(折返、重合)拆成新的一段，在该点停止。
+    std::vector<std::unique_ptr<SubPath> > subPaths;
+    std::vector<MoveBlendRegion> regions(waypoints.size());
+    subPaths.emplace_back(new SubPath());
+    subPaths.back()->maxVel = m_config.maxTcpVel;
+
+    KDL::Frame start = toFrame(startPose);
+    for (size_t i = 0; i < waypoints.size(); i++) {
+        auto& sub = *subPaths.back();
+        KDL::Frame via = toFrame(waypoints[i].pose);
+        bool isLast = (i + 1 == waypoints.size());
+        double radius = isLast ? 0 : waypoints[i].blendRadius;
+        bool blended = false;
+
+        if (radius > BlendEps) {
+            KDL::Frame next = toFrame(waypoints[i + 1].pose);
+            KDL::Vector ab = via.p - start.p;
+            KDL::Vector bc = next.p - via.p;
+            double abdist = ab.Norm();
+            double bcdist = bc.Norm();
+            if (abdist > BlendEps && bcdist > BlendEps) {
+                double cosAlpha = KDL::dot(ab, bc) / abdist / bcdist;
+                double alpha = std::acos(std::max(-1.0, std::min(1.0, cosAlpha)));
+                if (alpha < BlendEps) {
+                    // 共线，直接通过
+                    sub.addLine(start, via, m_config.eqRadius);
+                    regions[i].blended = true;
+                    blended = true;
+                    start = via;
+                } else if ((M_PI - alpha) > BlendEps) {
+                    // 与 KDL::Path_RoundedComposite::Add 相同的几何关系，只是半径按路段长度自动缩小
+                    double halfAngle = (M_PI - alpha) / 2;
+                    double d = radius / std::tan(halfAngle);
+                    double dMax = std::min(abdist, bcdist * 0.5) * 0.99;
+                    if (d > dMax) {
+                        d = dMax;
+                        radius = d * std::tan(halfAngle);
+                    }
+                    KDL::Path_Line line1(start, via, new KDL::RotationalInterpolation_SingleAxis(), m_config.eqRadius);
+                    KDL::Path_Line line2(via, next, new KDL::RotationalInterpolation_SingleAxis(), m_config.eqRadius);
+                    KDL::Frame circleStart = line1.Pos(line1.LengthToS(abdist - d));
+                    KDL::Frame circleEnd = line2.Pos(line2.LengthToS(d));
+                    KDL::Vector tangent = ab * (ab * bc);
+                    tangent.Normalize();
+
+                    sub.addLine(start, circleStart, m_config.eqRadius);
+                    double circleBegin = sub.path->PathLength();
+                    double circleLength = sub.addCircle(circleStart, circleStart.p - tangent * radius, circleEnd,
+                                                        alpha, m_config.eqRadius);
+                    sub.waypointIndex.push_back(i);
+                    sub.markLength.push_back(circleBegin + circleLength / 2);
+
+                    // 圆弧上的向心加速度 v^2/r 不能超过TCP加速度限制
+                    sub.maxVel = std::min(sub.maxVel, std::sqrt(m_config.maxTcpAcc * radius));
+
+                    regions[i].blended = true;
+                    regions[i].radius = radius;
+                    regions[i].enterDistance = d;
+                    regions[i].exitDistance = d;
+                    start = circleEnd;
+                    continue;
+                }
+            }
+        }
+
+        if (!blended) {
+            sub.addLine(start, via, m_config.eqRadius);
+            start = via;
+        }
+        sub.waypointIndex.push_back(i);
+        sub.markLength.push_back(sub.path->PathLength());
+
+        if (!blended && !isLast) {
+            if (radius > BlendEps) {
+                COBOT_LOG.warning("BlendPlanner") << "Waypoint " << waypoints[i].moveId
+                                                  << " can not be blended, stop at it.";
+            }
+            subPaths.emplace_back(new SubPath());
+            subPaths.back()->maxVel = m_config.maxTcpVel;
+        }
+    }
+
+    // 2. 整条轨迹命中缓存时直接使用，路点标记的序号与路点一一对应
+    updateCache(solver);
+    TrajectoryCache::Key trajectoryKey;
+    trajectoryKey.joint = startJoint;
+    for (auto& wp : waypoints) {
+        trajectoryKey.geometry.insert(trajectoryKey.geometry.end(), wp.pose.begin(), wp.pose.end());
+        trajectoryKey.geometry.push_back(wp.blendRadius);
+    }
+    auto cached = m_trajectoryCache.find(trajectoryKey);
+    if (cached && cached->marks.size() == waypoints.size() * 2) {
+        samples.assign(cached->samples.begin(), cached->samples.end());
+        for (size_t i = 0; i < waypoints.size(); i++)
+            marks.push_back({waypoints[i].moveId, cached->marks[i * 2], regions[i], cached->marks[i * 2 + 1]});
+        return true;
+    }
+
+    // 3. 每一段先求关节表(按元素缓存)，再单独做时间规划，超过关节限制时整体放慢重新采样。
+    std::vector<double> joint = startJoint;
+    for (auto& sub : subPaths) {
+        double pathLength = sub->path->PathLength();
+        std::deque<std::vector<double> > subSamples;
+        std::vector<double> sampleLength;
+
+        if (pathLength > BlendEps) {
+            std::vector<std::vector<double> > table;
+            std::vector<double> tableLength;
+            if (!buildJointTable(solver, joint, *sub->path, sub->geometry, table, tableLength))
+                return false;
+            smoothTable(table);
+
+            double maxVel = sub->maxVel;
+            double maxAcc = m_config.maxTcpAcc;
+            double ratio = 1;
+            int iter = 0;
+            for (; iter < MaxTimeScaleIter; iter++) {
+                if (!sampleTrajectory(table, tableLength, maxVel, maxAcc, subSamples, sampleLength, ratio))
+                    return false;
+                if (ratio <= 1.0)
+                    break;
+                ratio *= 1.02;
+                maxVel /= ratio;
+                maxAcc /= ratio * ratio;
+            }
+            if (iter == MaxTimeScaleIter) {
+                COBOT_LOG.error("BlendPlanner") << "Joint limits can not be satisfied, ratio: " << ratio;
+                return false;
+            }
+        }
+
+        size_t sampleOffset = samples.size();
+        for (size_t k = 0; k < sub->waypointIndex.size(); k++) {
+            size_t idx = 0;
+            while (idx + 1 < sampleLength.size() && sampleLength[idx] < sub->markLength[k] - BlendEps)
+                idx++;
+            auto wpIndex = sub->waypointIndex[k];
+            marks.push_back({waypoints[wpIndex].moveId, sampleOffset + idx, regions[wpIndex], sampleOffset + idx});
+        }
+
+        if (subSamples.size())
+            joint = subSamples.back();
+        samples.insert(samples.end(), subSamples.begin(), subSamples.end());
+
+        // 中间停止点原地停留，夹具动作(气缸、真空)有时间完成，下一段的 IO 动作从停留结束后开始算
+        if (&sub != &subPaths.back() && samples.size() && marks.size()) {
+            auto dwellCount = (size_t) std::ceil(m_config.stopDwell / m_config.servoPeriod);
+            samples.insert(samples.end(), dwellCount, joint);
+            marks.back().leaveIndex = samples.size() - 1;
+        }
+    }
+
+    if (m_config.trajectoryCacheMaxEntries && marks.size() == waypoints.size()) {
+        auto entry = std::make_shared<TrajectoryCache::Entry>();
+        entry->samples.assign(samples.begin(), samples.end());
+        for (auto& mark : marks) {
+            entry->marks.push_back(mark.sampleIndex);
+            entry->marks.push_back(mark.leaveIndex);
+        }
+        m_trajectoryCache.insert(trajectoryKey, entry);
+    }
+    return true;
+}
+
+bool BlendPlanner::buildJointTable(const std::shared_ptr<AbstractKinematicSolver>& solver,
+                                   const std::vector<double>& startJoint,
+                                   KDL::Path_Composite& elements,
+                                   const std::vector<std::vector<double> >& geometry,
+                                   std::vector<std::vector<double> >& table,
+                                   std::vector<double>& tableLength) {
+    table.assign(1, startJoint);
+    tableLength.assign(1, 0);
+
+    double offset = 0;
+    for (int e = 0; e < elements.GetNrOfSegments(); e++) {
+        KDL::Path* element = elements.GetSegment(e);
+        double length = element->PathLength();
+        if (length <= BlendEps)
+            continue;
+
+        TrajectoryCache::Key key;
+        key.joint = table.back();
+        key.geometry = geometry[e];
+        auto cached = m_cache.find(key);
+        if (!cached) {
+            auto entry = std::make_shared<TrajectoryCache::Entry>();
+            auto count = (size_t) std::max(1.0, std::ceil(length / m_config.pathStep));
+            std::vector<double> seed = key.joint;
+            std::vector<double> joint;
+            entry->samples.push_back(seed);
+            for (size_t k = 1; k <= count; k++) {
+                double s = element->LengthToS(length * k / count);
+                if (solver->cartToJnt(seed, toPose(element->Pos(s)), joint) != 0 || joint.size() != seed.size()) {
+                    COBOT_LOG.error("BlendPlanner") << "IK failed at path length: " << offset + length * k / count;
+                    return false;
+                }
+                for (size_t i = 0; i < joint.size(); i++) {
+                    double step = joint[i] - seed[i];
+                    if (std::fabs(step) > m_config.maxJointStep) {
+                        COBOT_LOG.error("BlendPlanner") << "IK jump on joint " << i << ": " << step;
+                        return false;
+                    }
+                }
+                entry->samples.push_back(joint);
+                seed = joint;
+            }
+            m_cache.insert(key, entry);
+            cached = entry;
+        }
+
+        // 第一项是元素起点，与上一个元素的终点重复
+        size_t count = cached->samples.size() - 1;
+        for (size_t k = 1; k <= count; k++) {
+            table.push_back(cached->samples[k]);
+            tableLength.push_back(offset + length * k / count);
+        }
+        offset += length;
+    }
+    return true;
+}
+
+bool BlendPlanner::sampleTrajectory(const std::vector<std::vector<double> >& table,
+                                    const std::vector<double>& tableLength,
+                                    double maxVel, double maxAcc,
+                                    std::deque<std::vector<double> >& samples,
+                                    std::vector<double>& sampleLength,
+                                    double& timeScale) {
+    samples.clear();
+    sampleLength.clear();
+    timeScale = 1;
+    if (table.size() < 2)
+        return true;
+
+    const std::vector<double>& startJoint = table.front();
+    double dt = m_config.servoPeriod;
+    double pathLength = tableLength.back();
+    KDL::VelocityProfile_Trap profile(maxVel, maxAcc);
+    profile.SetProfile(0, pathLength);
+    auto count = (size_t) std::ceil(profile.Duration() / dt);
+
+    // 第 k 个采样点，k <= 0 时机器人静止在起点
+    auto jointAt = [&](long k) -> const std::vector<double>& {
+        return k <= 0 ? startJoint : samples[k - 1];
+    };
+    // 逐个伺服周期检查关节速度和加速度，最后一个采样点之后机器人静止
+    auto checkLimit = [&](size_t i, double vel, double acc) {
+        if (i < m_config.jointVelLimit.size() && m_config.jointVelLimit[i] > 0)
+            timeScale = std::max(timeScale, std::fabs(vel) / m_config.jointVelLimit[i]);
+        if (i < m_config.jointAccLimit.size() && m_config.jointAccLimit[i] > 0)
+            timeScale = std::max(timeScale, std::sqrt(std::fabs(acc) / m_config.jointAccLimit[i]));
+    };
+
+    // 关节表第 j 项处 dq/ds，用相邻两项的中心差分，两端用单侧差分
+    auto slopeAt = [&](size_t j, size_t i) {
+        size_t a = j > 0 ? j - 1 : 0;
+        size_t b = std::min(j + 1, table.size() - 1);
+        double ds = tableLength[b] - tableLength[a];
+        return ds > 0 ? (table[b][i] - table[a][i]) / ds : 0.0;
+    };
+
+    std::vector<double> joint(startJoint.size());
+    size_t seg = 1;
+    for (size_t k = 1; k <= count; k++) {
+        double s = std::max(0.0, std::min(pathLength, profile.Pos(k * dt)));
+        // s 单调不减，区间只需要往前找
+        while (seg + 1 < tableLength.size() && tableLength[seg] < s)
+            seg++;
+        double span = tableLength[seg] - tableLength[seg - 1];
+        double t = span > 0 ? std::max(0.0, std::min(1.0, (s - tableLength[seg - 1]) / span)) : 1.0;
+        // 三次 Hermite 插值(Catmull-Rom)，dq/ds 在表项处连续，采样点变密时不会出现速度阶跃
+        double t2 = t * t;
+        double t3 = t2 * t;
+        double h00 = 2 * t3 - 3 * t2 + 1;
+        double h10 = t3 - 2 * t2 + t;
+        double h01 = -2 * t3 + 3 * t2;
+        double h11 = t3 - t2;
+        for (size_t i = 0; i < joint.size(); i++) {
+            joint[i] = h00 * table[seg - 1][i] + h01 * table[seg][i]
+                       + (h10 * slopeAt(seg - 1, i) + h11 * slopeAt(seg, i)) * span;
+            double vel = (joint[i] - jointAt(k - 1)[i]) / dt;
+            double velPrev = (jointAt(k - 1)[i] - jointAt(k - 2)[i]) / dt;
+            checkLimit(i, vel, (vel - velPrev) / dt);
+        }
+        samples.push_back(joint);
+        sampleLength.push_back(s);
+    }
+    for (size_t i = 0; i < joint.size(); i++) {
+        double vel = (jointAt((long) count)[i] - jointAt((long) count - 1)[i]) / dt;
+        checkLimit(i, 0, vel / dt);
+    }
+    return true;
+}
@@ -0,0 +1,138 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#ifndef COBOTSYS_BLENDPLANNER_H
+#define COBOTSYS_BLENDPLANNER_H
+
+#include <cobotsys_abstract_arm_robot_move_driver.h>
+#include <cobotsys_abstract_kinematic_solver.h>
+#include <deque>
+#include <vector>
+#include "frames.hpp"
+#include "path_composite.hpp"
+#include "TrajectoryCache.h"
+
+using namespace cobotsys;
+
+/**
+ * 带过渡半径的笛卡尔路点规划。
+ *
+ * 与 orocos_kdl 的 Path_RoundedComposite 相同的做法：相邻两段直线在路点处用圆弧相切连接，
+ * 区别是每个路点可以有自己的过渡半径，半径过大时自动缩小而不是抛异常。
+ * 先沿路径按固定弧长步长求逆解得到关节表，平滑掉逆解的误差，再用一个梯形速度曲线做时间规划，按伺服周期采样，
+ * 在关节表上做三次 Hermite 插值得到关节序列。每个伺服周期的关节速度/加速度都要在限制以内，
+ * 超过时整体放慢后重新采样，不用重新求逆解。
+ *
+ * 缓存分两级，都是 TrajectoryCache:
+ *   - 整条轨迹: 关键字是起点关节角和所有路点的位姿、过渡半径，命中时直接复制采样点和路点标记，
+ *     不再求逆解、做时间规划和重新采样。同一条路线反复执行(例如固定的码垛路线)时规划的开销只有一次复制。
+ *   - 路径元素(直线/圆弧)的关节表: 只和几何有关，关键字是元素的几何参数和元素起点的关节角。
+ *     取放料路线里抓取点每次都不一样，整条轨迹不会命中，但是不经过抓取点的元素
+ *     (例如 Home 处的过渡圆弧、Home 到 Place 的直线)仍然可以命中，只需要重新做时间规划。
+ * 换了运动学求解器、求解器重新加载了模型(AbstractKinematicSolver::modelGeneration)或者几何参数后两级都清空，
+ * 速度、加速度、关节限制等时间规划参数改变时只清空整条轨迹。
+ */
+class BlendPlanner {
+public:
+    struct Waypoint {
+        uint32_t moveId;
+        std::vector<double> pose; ///< xyz, rpy
+        double blendRadius;       ///< 0 表示在该点停止
+    };
+
+    /**
+     * 路点到达标记，采样点序号到达 sampleIndex 时通知该路点完成。
+     * 停止点后面有 Config::stopDwell 的停留，leaveIndex 是停留的最后一个采样点，其他路点与 sampleIndex 相同。
+     */
+    struct Mark {
+        uint32_t moveId;
+        size_t sampleIndex;
+        MoveBlendRegion region;
+        size_t leaveIndex;
+    };
+
+    struct Config {
+        double servoPeriod = 0.008;  ///< 伺服周期(秒)
+        double maxTcpVel = 0.8;      ///< TCP最大速度(m/s)
+        double maxTcpAcc = 3.5;      ///< TCP最大加速度(m/s^2)，同时限制过渡圆弧上的向心加速度
+        double eqRadius = 0.1;       ///< 姿态等效半径(米)，用于把转角换算成路径长度
+        double maxJointStep = 0.2;   ///< 关节表相邻点关节角最大变化(弧度)，超过认为逆解跳变
+        double pathStep = 0.005;     ///< 关节表的弧长步长(米)，插值误差随步长平方增长
+        double stopDwell = 0.1;      ///< 中间停止点的停留时间(秒)，停止点上触发的 IO 与离开时触发的 IO 至少间隔这么久
+        std::vector<double> jointVelLimit; ///< 关节速度限制(rad/s)
+        std::vector<double> jointAccLimit; ///< 关节加速度限制(rad/s^2)
+
+        size_t cacheMaxEntries = 64;        ///< 关节表缓存条数上限，0 表示不缓存
+        size_t cacheMaxSamples = 100000;    ///< 关节表缓存关节角总数上限
+        size_t trajectoryCacheMaxEntries = 16;      ///< 整条轨迹缓存条数上限，0 表示不缓存
+        size_t trajectoryCacheMaxSamples = 100000;  ///< 整条轨迹缓存采样点总数上限
+        double cacheJointTolerance = 1e-3;  ///< 起点关节角的量化步长(弧度)
+        double cachePoseTolerance = 1e-4;   ///< 几何参数的量化步长(米，旋转矩阵元素，路点的 rpy)
+    };
+
+public:
+    BlendPlanner();
+
+    Config& config() { return m_config; }
+
+    const TrajectoryCache& cache() const { return m_cache; }
+    const TrajectoryCache& trajectoryCache() const { return m_trajectoryCache; }
+    void clearCache();
+
+    /**
+     * 规划一段连续运动，最后一个路点总是停止点。
+     * @param[in] solver 运动学求解器
+     * @param[in] startJoint 当前关节角
+     * @param[in] waypoints 路点
+     * @param[out] samples 按伺服周期采样的关节角
+     * @param[out] marks 每个路点的完成标记，与 waypoints 一一对应
+     * @retval true 规划成功
+     * @retval false 路点不可达或者逆解不连续
+     */
+    bool plan(const std::shared_ptr<AbstractKinematicSolver>& solver,
+              const std::vector<double>& startJoint,
+              const std::vector<Waypoint>& waypoints,
+              std::deque<std::vector<double> >& samples,
+              std::deque<Mark>& marks);
+
+protected:
+    /**
+     * 沿路径元素按弧长步长求逆解。
+     * @param[in] startJoint 路径起点的关节角
+     * @param[in] elements 路径元素
+     * @param[in] geometry 每个元素的几何参数，用作缓存关键字
+     * @param[out] table 关节表，第一个是 startJoint
+     * @param[out] tableLength 关节表每一项对应的路径长度
+     */
+    bool buildJointTable(const std::shared_ptr<AbstractKinematicSolver>& solver,
+                         const std::vector<double>& startJoint,
+                         KDL::Path_Composite& elements,
+                         const std::vector<std::vector<double> >& geometry,
+                         std::vector<std::vector<double> >& table,
+                         std::vector<double>& tableLength);
+
+    bool sampleTrajectory(const std::vector<std::vector<double> >& table,
+                          const std::vector<double>& tableLength,
+                          double maxVel, double maxAcc,
+                          std::deque<std::vector<double> >& samples,
+                          std::vector<double>& sampleLength,
+                          double& timeScale);
+
+    void updateCache(const std::shared_ptr<AbstractKinematicSolver>& solver);
+
+    static KDL::Frame toFrame(const std::vector<double>& pose);
+    static std::vector<double> toPose(const KDL::Frame& frame);
+
+protected:
+    Config m_config;
+
+    TrajectoryCache m_cache;                // 路径元素的关节表
+    TrajectoryCache m_trajectoryCache;      // 整条采样好的轨迹
+    AbstractKinematicSolver* m_cacheSolver; // 缓存对应的求解器，只用于比较
+    uint64_t m_cacheGeneration;             // 缓存对应的模型版本号
+    Config m_cacheConfig;                   // 缓存对应的参数
+};
+
+
+#endif //COBOTSYS_BLENDPLANNER_H
@@ -0,0 +1,118 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#include "CubicSpline.h"
+
+CubicSpline::CubicSpline(size_t maxKnots)
+        : m_maxKnots(maxKnots < 2 ? 2 : maxKnots), m_n(0) {
+    m_t.resize(m_maxKnots);
+    m_y.resize(m_maxKnots);
+    m_h.resize(m_maxKnots);
+    m_m.resize(m_maxKnots);
+    m_cp.resize(m_maxKnots);
+    m_dp.resize(m_maxKnots);
+}
+
+bool CubicSpline::fit(const double* t, const double* y, size_t n,
+                      Boundary startType, double v0, Boundary endType, double vn) {
+    if (n < 2 || n > m_maxKnots)
+        return false;
+
+    for (size_t i = 0; i < n; i++) {
+        m_t[i] = t[i];
+        m_y[i] = y[i];
+        if (i > 0) {
+            m_h[i - 1] = t[i] - t[i - 1];
+            if (m_h[i - 1] <= 0)
+                return false;
+        }
+    }
+    m_n = n;
+
+    // 方程组: sub[i] * M[i-1] + diag[i] * M[i] + sup[i] * M[i+1] = rhs[i]
+    // 按行直接做前向消元，sub/diag/sup/rhs 不单独存
+    double sup, diag, rhs;
+    for (size_t i = 0; i < n; i++) {
+        double sub = 0;
+        if (i == 0) {
+            if (startType == Clamped) {
+                diag = 2 * m_h[0];
+                sup = m_h[0];
+                rhs = 6 * ((m_y[1] - m_y[0]) / m_h[0] - v0);
+            } else {
+                diag = 1;
+                sup = 0;
+                rhs = 0;
+            }
+        } else if (i == n - 1) {
+            if (endType == Clamped) {
+                sub = m_h[n - 2];
+                diag = 2 * m_h[n - 2];
+                rhs = 6 * (vn - (m_y[n - 1] - m_y[n - 2]) / m_h[n - 2]);
+            } else {
+                diag = 1;
+                rhs = 0;
+            }
+            sup = 0;
+        } else {
+            sub = m_h[i - 1];
+            diag = 2 * (m_h[i - 1] + m_h[i]);
+            sup = m_h[i];
+            rhs = 6 * ((m_y[i + 1] - m_y[i]) / m_h[i] - (m_y[i] - m_y[i - 1]) / m_h[i - 1]);
+        }
+
+        double denom = diag - (i > 0 ? sub * m_cp[i - 1] : 0);
+        m_cp[i] = sup / denom;
+        m_dp[i] = (rhs - (i > 0 ? sub * m_dp[i - 1] : 0)) / denom;
+    }
+
+    m_m[n - 1] = m_dp[n - 1];
+    for (size_t i = n - 1; i-- > 0;) {
+        m_m[i] = m_dp[i] - m_cp[i] * m_m[i + 1];
+    }
+    return true;
+}
+
+void CubicSpline::knotDerivatives(size_t i, double& v, double& a) const {
+    if (i + 1 < m_n) {
+        v = (m_y[i + 1] - m_y[i]) / m_h[i] - m_h[i] * (2 * m_m[i] + m_m[i + 1]) / 6;
+    } else {
+        v = (m_y[i] - m_y[i - 1]) / m_h[i - 1] + m_h[i - 1] * (m_m[i - 1] + 2 * m_m[i]) / 6;
+    }
+    a = m_m[i];
+}
+
+void CubicSpline::eval(double t, double& p, double& v, double& a) const {
+    size_t i = 0;
+    while (i + 2 < m_n && t > m_t[i + 1])
+        i++;
+
+    double h = m_h[i];
+    double A = (m_t[i + 1] - t) / h;
+    double B = (t - m_t[i]) / h;
+    p = A * m_y[i] + B * m_y[i + 1] + ((A * A * A - A) * m_m[i] + (B * B * B - B) * m_m[i + 1]) * h * h / 6;
+    v = (m_y[i + 1] - m_y[i]) / h - (3 * A * A - 1) * h * m_m[i] / 6 + (3 * B * B - 1) * h * m_m[i + 1] / 6;
+    a = A * m_m[i] + B * m_m[i + 1];
+}
+
+void QuinticSegment::set(double p0, double v0, double a0, double p1, double v1, double a1, double T) {
+    duration = T;
+    double T2 = T * T;
+    double T3 = T2 * T;
+    double T4 = T3 * T;
+    double T5 = T4 * T;
+    double dp = p1 - p0;
+    c[0] = p0;
+    c[1] = v0;
+    c[2] = a0 / 2;
+    c[3] = (20 * dp - (8 * v1 + 12 * v0) * T - (3 * a0 - a1) * T2) / (2 * T3);
+    c[4] = (-30 * dp + (14 * v1 + 16 * v0) * T + (3 * a0 - 2 * a1) * T2) / (2 * T4);
+    c[5] = (12 * dp - 6 * (v1 + v0) * T - (a0 - a1) * T2) / (2 * T5);
+}
+
+void QuinticSegment::eval(double t, double& p, double& v, double& a) const {
+    p = c[0] + t * (c[1] + t * (c[2] + t * (c[3] + t * (c[4] + t * c[5]))));
+    v = c[1] + t * (2 * c[2] + t * (3 * c[3] + t * (4 * c[4] + t * 5 * c[5])));
+    a = 2 * c[2] + t * (6 * c[3] + t * (12 * c[4] + t * 20 * c[5]));
+}
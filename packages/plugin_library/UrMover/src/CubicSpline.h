@@ -0,0 +1,77 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#ifndef COBOTSYS_CUBICSPLINE_H
+#define COBOTSYS_CUBICSPLINE_H
+
+#include <vector>
+#include <cstddef>
+
+/**
+ * 一维三次样条，二阶导连续。
+ *
+ * 求解节点二阶导数 M 的三对角方程组(Thomas 算法)，所有缓冲区在构造时按最大节点数分配，
+ * fit() 过程中不再分配内存，耗时只和节点数有关。
+ */
+class CubicSpline {
+public:
+    enum Boundary {
+        Clamped = 0, ///< 给定端点速度
+        Natural = 1, ///< 端点二阶导为0
+    };
+
+public:
+    explicit CubicSpline(size_t maxKnots = 16);
+
+    size_t maxKnots() const { return m_maxKnots; }
+
+    /**
+     * 拟合样条。
+     * @param t 节点时间，严格递增
+     * @param y 节点值
+     * @param n 节点数，2 <= n <= maxKnots()
+     * @param startType 起点边界条件
+     * @param v0 起点速度，startType 为 Clamped 时有效
+     * @param endType 终点边界条件
+     * @param vn 终点速度，endType 为 Clamped 时有效
+     * @retval true 拟合成功
+     * @retval false 节点数不对或者时间不递增
+     */
+    bool fit(const double* t, const double* y, size_t n,
+             Boundary startType, double v0, Boundary endType, double vn);
+
+    /**
+     * 节点 i 处的速度和加速度
+     */
+    void knotDerivatives(size_t i, double& v, double& a) const;
+
+    /**
+     * 计算 t 时刻的位置、速度、加速度，t 超出范围时按端点段外推。
+     */
+    void eval(double t, double& p, double& v, double& a) const;
+
+protected:
+    size_t m_maxKnots;
+    size_t m_n;
+    std::vector<double> m_t;
+    std::vector<double> m_y;
+    std::vector<double> m_h;
+    std::vector<double> m_m;  // 节点二阶导
+    std::vector<double> m_cp; // Thomas 算法的中间量
+    std::vector<double> m_dp;
+};
+
+/**
+ * 五次多项式段，两端位置、速度、加速度都给定。
+ */
+struct QuinticSegment {
+    double c[6] = {0, 0, 0, 0, 0, 0};
+    double duration = 0;
+
+    void set(double p0, double v0, double a0, double p1, double v1, double a1, double T);
+    void eval(double t, double& p, double& v, double& a) const;
+};
+
+
+#endif //COBOTSYS_CUBICSPLINE_H
@@ -10,7 +10,15 @@
 InterCubicMover::InterCubicMover() {
     m_robotConnected = true;
     m_exitLoop = false;
-    m_timeMoveScale_ = 3;
+    m_clearMoveTarget = false;
+    m_windowSize = 3; // guide 目标流的参数，见类的说明
+    m_servoPeriod = 0.008;
+    m_maxJointVel = 1.0;
+    m_maxJointAcc = 4.0;
+    m_minSegmentTime = 0.008;
+    m_knotHead = 0;
+    m_knotCount = 0;
+    resizeBuffers(6);
 }
 
 InterCubicMover::~InterCubicMover() {
@@ -21,9 +29,46 @@ InterCubicMover::~InterCubicMover() {
 }
 
 bool InterCubicMover::setup(const QString& configFilePath) {
+    QJsonObject json;
+    if (configFilePath.isEmpty() || !loadJson(json, configFilePath))
+        return true;
+
+    std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
+    // 窗口参数先取顶层的值，再用 StreamType 对应的 StreamProfiles 覆盖
+    QString streamType = json["StreamType"].toString();
+    QJsonObject profile = json["StreamProfiles"].toObject()[streamType].toObject();
+    if (!streamType.isEmpty() && profile.isEmpty()) {
+        COBOT_LOG.warning("InCb") << "Unknown StreamType: " << streamType;
+    }
+    m_windowSize = (size_t) std::max(2, json["WindowSize"].toInt((int) m_windowSize));
+    m_windowSize = (size_t) std::max(2, profile["WindowSize"].toInt((int) m_windowSize));
+    m_minSegmentTime = json["MinSegmentTime"].toDouble(m_minSegmentTime);
+    m_minSegmentTime = profile["MinSegmentTime"].toDouble(m_minSegmentTime);
+    m_servoPeriod = json["ServoPeriod"].toDouble(m_servoPeriod);
+    m_maxJointVel = json["MaxJointVelocity"].toDouble(m_maxJointVel);
+    m_maxJointAcc = json["MaxJointAcceleration"].toDouble(m_maxJointAcc);
+    resizeBuffers(6);
+    COBOT_LOG.notice("InCb") << "StreamType: " << streamType << ", Window: " << m_windowSize
+                             << ", MinSegmentTime: " << m_minSegmentTime
+                             << ", Latency >= " << m_windowSize * m_minSegmentTime * 1000 << "ms"
+                             << ", MaxJointVelocity: " << m_maxJointVel;
     return true;
 }
 
+void InterCubicMover::resizeBuffers(size_t jointNum) {
+    m_splines.assign(jointNum, CubicSpline(m_windowSize + 1));
+    m_segments.assign(jointNum, QuinticSegment());
+    m_knotTime.assign(m_windowSize + 1, 0);
+    m_knotValue.assign(m_windowSize + 1, 0);
+    m_knotSpeed.assign(m_windowSize + 1, 0);
+    m_knotDist.assign(m_windowSize + 1, 0);
+    m_knots.assign(m_windowSize, Knot());
+    m_knotHead = 0;
+    m_knotCount = 0;
+    m_setVel.assign(jointNum, 0);
+    m_setAcc.assign(jointNum, 0);
+}
+
 bool InterCubicMover::move(uint32_t moveId, const cv::Point3d& pos, const cv::Vec3d& rpy) {
     std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
     if (m_robotConnected) {
@@ -58,7 +103,11 @@ void InterCubicMover::setRealTimeDriver(const std::shared_ptr<AbstractArmRobotRe
 
 void InterCubicMover::setKinematicSolver(const std::shared_ptr<AbstractKinematicSolver>& kinematicSolver) {
     std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
-    m_kinematicSolver = kinematicSolver;
+    m_sharedKinematicSolver = kinematicSolver;
+    // 移动线程使用自己的上下文，不和调用者共享迭代求解器的中间状态；不支持上下文的求解器直接共用
+    m_kinematicSolver = kinematicSolver ? kinematicSolver->createThreadContext() : nullptr;
+    if (!m_kinematicSolver)
+        m_kinematicSolver = kinematicSolver;
 }
 
 
@@ -93,105 +142,201 @@ void InterCubicMover::notify(const InterCubicMover::MoveTarget& moveTarget, Move
 }
 
 
-std::vector<double> interp_cubic(std::vector<double>& p0_pos, std::vector<double>& p1_pos,
-                                 std::vector<double>& p0_vel, std::vector<double>& p1_vel,
-                                 double t = 0.008, double T = 1) {
-    /*Returns positions of the joints at time 't' */
-    std::vector<double> positions;
-    for (unsigned int i = 0; i < p0_pos.size(); i++) {
-        double a = p0_pos[i];
-        double b = p0_vel[i];
-        double c = (-3 * p0_pos[i] + 3 * p1_pos[i] - 2 * T * p0_vel[i] - T * p1_vel[i]) / pow(T, 2);
-        double d = (2 * p0_pos[i] - 2 * p1_pos[i] + T * p0_vel[i] + T * p1_vel[i]) / pow(T, 3);
-        positions.push_back(a + b * t + c * pow(t, 2) + d * pow(t, 3));
+void filter_move_joint_target(InterCubicMover::Joint6d& target_) {
+    for (int i = 0; i < target_.size(); i++) {
+        if (target_[i] > M_PI * 1.9) target_[i] -= M_PI * 2;
+        if (target_[i] < -M_PI * 1.9) target_[i] += M_PI * 2;
+    }
+}
+
+/**
+ * 从队列里取目标求逆解，放进滑动窗口，直到窗口满或者队列空。
+ * 节点和逆解都是定长类型，不分配内存。
+ * @retval false 有目标不可达，已经通知并清空所有目标
+ */
+bool InterCubicMover::fillWindow() {
+    MoveTarget moveTarget;
+    while (m_knotCount < m_knots.size() && pickMoveTarget(moveTarget)) {
+        Joint6d seed = m_knotCount ? knotAt(m_knotCount - 1).joint : Joint6d(Joint6d::Map(m_setPos.data()));
+        Knot& knot = knotAt(m_knotCount);
+        knot.target = moveTarget;
+        if (m_kinematicSolver->cartToJnt(seed, toIsometry(moveTarget), knot.joint) != 0) {
+            COBOT_LOG.error() << "Target: " << moveTarget.pos << ", " << moveTarget.rpy
+                              << " Can Not Reached!";
+            notify(moveTarget, MoveResult::InvalidMoveTarget);
+            clearAll();
+            return false;
+        }
+        filter_move_joint_target(knot.joint);
+        knot.duration = 0; // startSegment() 里按速度限制计算
+        m_knotCount++;
     }
-    return positions;
+    return true;
 }
 
-void filter_move_joint_target(std::vector<double>& target_) {
-    for (auto& iter : target_) {
-        if (iter > M_PI * 1.9) iter -= M_PI * 2;
-        if (iter < -M_PI * 1.9) iter += M_PI * 2;
+/**
+ * 在窗口的所有节点上拟合样条(起点速度为当前速度，终点停止)，得到下一个节点的速度和加速度，
+ * 然后用五次多项式从当前状态过渡到下一个节点。每次只执行这一段，到达节点后重新拟合，
+ * 所以新目标加入时输出仍然是二阶连续的。
+ */
+void InterCubicMover::startSegment() {
+    size_t m = m_knotCount;
+    size_t n = m + 1;
+
+    // 节点时间：沿窗口做一次前向/后向的速度限制(梯形速度)，窗口末尾按停止计算
+    m_knotSpeed[0] = 0;
+    for (auto v : m_setVel)
+        m_knotSpeed[0] = std::max(m_knotSpeed[0], std::fabs(v));
+    for (size_t k = 1; k <= m; k++) {
+        m_knotDist[k] = 0;
+        for (size_t j = 0; j < m_setPos.size(); j++) {
+            double prev = k > 1 ? knotAt(k - 2).joint[j] : m_setPos[j];
+            m_knotDist[k] = std::max(m_knotDist[k], std::fabs(knotAt(k - 1).joint[j] - prev));
+        }
+        m_knotSpeed[k] = std::min(m_maxJointVel,
+                                  std::sqrt(m_knotSpeed[k - 1] * m_knotSpeed[k - 1] + 2 * m_maxJointAcc * m_knotDist[k]));
+    }
+    m_knotSpeed[m] = 0;
+    for (size_t k = m - 1; k >= 1; k--) {
+        m_knotSpeed[k] = std::min(m_knotSpeed[k],
+                                  std::sqrt(m_knotSpeed[k + 1] * m_knotSpeed[k + 1] + 2 * m_maxJointAcc * m_knotDist[k + 1]));
+    }
+    for (size_t k = 1; k <= m; k++) {
+        double speedSum = m_knotSpeed[k - 1] + m_knotSpeed[k];
+        double T = speedSum > 1e-9 ? 2 * m_knotDist[k] / speedSum : 0;
+        knotAt(k - 1).duration = std::max(m_minSegmentTime, T);
+    }
+
+    const auto& next = knotAt(0);
+    for (size_t j = 0; j < m_setPos.size(); j++) {
+        double v1 = 0, a1 = 0;
+        if (m_knotCount > 1) {
+            m_knotTime[0] = 0;
+            m_knotValue[0] = m_setPos[j];
+            for (size_t k = 1; k < n; k++) {
+                m_knotTime[k] = m_knotTime[k - 1] + knotAt(k - 1).duration;
+                m_knotValue[k] = knotAt(k - 1).joint[j];
+            }
+            if (m_splines[j].fit(m_knotTime.data(), m_knotValue.data(), n,
+                                 CubicSpline::Clamped, m_setVel[j], CubicSpline::Clamped, 0)) {
+                m_splines[j].knotDerivatives(1, v1, a1);
+            }
+        }
+        m_segments[j].set(m_setPos[j], m_setVel[j], m_setAcc[j], next.joint[j], v1, a1, next.duration);
+    }
+}
+
+/**
+ * 按当前速度平滑减速到停止
+ */
+void InterCubicMover::stopSegment() {
+    double maxVel = 0;
+    for (auto v : m_setVel)
+        maxVel = std::max(maxVel, std::fabs(v));
+    double T = std::max(m_minSegmentTime, 2 * maxVel / m_maxJointAcc);
+    for (size_t j = 0; j < m_setPos.size(); j++) {
+        m_segments[j].set(m_setPos[j], m_setVel[j], m_setAcc[j], m_setPos[j] + m_setVel[j] * T / 2, 0, 0, T);
     }
 }
 
 void InterCubicMover::moveProcess() {
     auto timePoint = std::chrono::high_resolution_clock::now();
+    auto servoPeriod = std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(
+            std::chrono::duration<double>(m_servoPeriod));
 
-    std::vector<double> curPose;
-    std::vector<double> targetJoint;
-    MoveTarget moveTarget;
-    std::vector<double> jnt_posi, src_posi;
-
+    bool moving = false;     // 正在执行 m_segments
+    bool stopping = false;   // 正在执行清除目标后的减速段
+    bool holding = false;    // 已经到达最后一个节点，等待实际位置到达
+    double segTime = 0;
+    MoveTarget holdTarget;
 
     COBOT_LOG.notice() << "InterCubicMover is running.";
-    auto hres_start = std::chrono::high_resolution_clock::now();
     while (!m_exitLoop) {
-        timePoint = timePoint + std::chrono::milliseconds(1);
-
-        if (pickMoveTarget(moveTarget)) {
-            auto movePose = toVector(moveTarget);
-
-            if (m_kinematicSolver->cartToJnt(m_curJoint, movePose, targetJoint) == 0) {
-                filter_move_joint_target(targetJoint);
-                m_kinematicSolver->jntToCart(m_curJoint, src_posi);
-                auto jointSpaceDiff = targetJoint;
-                for (size_t i = 0; i < targetJoint.size(); i++) {
-                    jointSpaceDiff[i] = src_posi[i] - movePose[i];
-                    if (i > 2) jointSpaceDiff[i] = 0;
+        timePoint += servoPeriod;
+
+        m_mutex.lock();
+        bool clearAction = m_clearMoveTarget;
+        m_clearMoveTarget = false;
+        if (!moving && !holding)
+            m_setPos = m_curJoint;
+        m_mutex.unlock();
+
+        if (m_setPos.size() != m_splines.size()) {
+            std::this_thread::sleep_until(timePoint);
+            continue;
+        }
+
+        if (clearAction) {
+            for (size_t k = 0; k < m_knotCount; k++)
+                notify(knotAt(k).target, MoveResult::Cancled);
+            m_knotCount = 0;
+            if (holding) {
+                notify(holdTarget, MoveResult::Cancled);
+                holding = false;
+            }
+            if (moving) {
+                stopSegment();
+                stopping = true;
+                segTime = 0;
+            }
+        }
+
+        if (!moving) {
+            if (!holding) {
+                std::fill(m_setVel.begin(), m_setVel.end(), 0);
+                std::fill(m_setAcc.begin(), m_setAcc.end(), 0);
+            }
+            if (fillWindow() && m_knotCount) {
+                if (holding) {
+                    // 停在上一个目标时又来了新目标，直接出发
+                    notify(holdTarget, MoveResult::Success);
+                    holding = false;
                 }
-                auto jointSpaceLen = cxx::distance(jointSpaceDiff);
-
-
-                auto moveTimeBegin = std::chrono::high_resolution_clock::now();
-                std::vector<double> targetJointVel(targetJoint.size(), 0);
-
-                m_mutex.lock();
-                auto move_begin_joint = m_curJoint;
-                auto move_begin_joint_vel = m_curJointVel;
-                m_mutex.unlock();
-
-                double move_time_max_ = jointSpaceLen / 1.0 * m_timeMoveScale_;
-                if (move_time_max_ > 3.5) move_time_max_ = 3.5;
-
-                COBOT_LOG.notice("JointSpaceLen") << jointSpaceLen << ", " << move_time_max_;
-
-                // Move Until Arrival Target
-                while (isTargetNotArrival(moveTarget)) {
-                    std::chrono::duration<double> delta_t_
-                            = std::chrono::high_resolution_clock::now() - moveTimeBegin;
-
-                    std::vector<double> positions_;
-                    if (delta_t_.count() < move_time_max_) {
-                        positions_ = interp_cubic(move_begin_joint, targetJoint,
-                                                  move_begin_joint_vel, targetJointVel, delta_t_.count(),
-                                                  move_time_max_);
-                    } else {
-                        positions_ = targetJoint;
-//                        COBOT_LOG.notice("positions_") << "Cubic Joint Over.";
-                    }
-//                    calcStepJointDegree(positions_);
-                    m_mutex.lock();
-                    auto posiDiff = m_curJoint;
-                    m_mutex.unlock();
-                    for (size_t i = 0; i < posiDiff.size(); i++) posiDiff[i] = positions_[i] - posiDiff[i];
-//                    COBOT_LOG.debug("positions_") << putfixedfloats(6, 1, posiDiff, 180 / M_PI);
-                    m_realTimeDriver->move(positions_);
-
-                    std::this_thread::sleep_until(timePoint);
-
-                    timePoint += std::chrono::milliseconds(2);
-                    if (m_exitLoop) {
-                        break;
-                    }
+                startSegment();
+                moving = true;
+                segTime = 0;
+            }
+        }
+
+        if (moving) {
+            segTime += m_servoPeriod;
+            while (moving && segTime >= m_segments[0].duration) {
+                // 到达节点
+                segTime -= m_segments[0].duration;
+                for (size_t j = 0; j < m_setPos.size(); j++)
+                    m_segments[j].eval(m_segments[j].duration, m_setPos[j], m_setVel[j], m_setAcc[j]);
+
+                if (stopping) {
+                    stopping = false;
+                    moving = false;
+                    break;
                 }
-            } else {
-                COBOT_LOG.error() << "Target: " << moveTarget.pos << ", " << moveTarget.rpy
-                                  << " Can Not Reached!";
-                notify(moveTarget, MoveResult::InvalidMoveTarget);
-                clearAll();
+
+                auto reached = knotAt(0).target;
+                m_knotHead = (m_knotHead + 1) % m_knots.size();
+                m_knotCount--;
+                fillWindow();
+                if (m_knotCount) {
+                    notify(reached, MoveResult::Success);
+                    startSegment();
+                } else {
+                    moving = false;
+                    holding = true;
+                    holdTarget = reached;
+                    m_poseLastError = std::numeric_limits<double>::max();
+                }
+            }
+            if (moving) {
+                for (size_t j = 0; j < m_setPos.size(); j++)
+                    m_segments[j].eval(segTime, m_setPos[j], m_setVel[j], m_setAcc[j]);
             }
+            m_realTimeDriver->move(m_setPos);
+        } else if (holding) {
+            m_realTimeDriver->move(m_setPos);
+            if (!isTargetNotArrival(holdTarget))
+                holding = false;
         }
+
         std::this_thread::sleep_until(timePoint);
     }
     COBOT_LOG.notice() << "InterCubicMover is stopped.";
@@ -209,6 +354,7 @@ void InterCubicMover::clearAttachedObject() {
     m_mutex.lock();
     m_observers.clear();
     m_kinematicSolver.reset();
+    m_sharedKinematicSolver.reset();
     m_realTimeDriver.reset();
     m_mutex.unlock();
 }
@@ -236,6 +382,18 @@ std::vector<double> InterCubicMover::toVector(const InterCubicMover::MoveTarget&
     return j;
 }
 
+/**
+ * 与 KDL::Rotation::RPY 相同：先绕 x 转 roll，再绕 y 转 pitch，再绕 z 转 yaw(固定轴)
+ */
+Eigen::Isometry3d InterCubicMover::toIsometry(const InterCubicMover::MoveTarget& moveTarget) {
+    Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+    pose.linear() = (Eigen::AngleAxisd(moveTarget.rpy[2], Eigen::Vector3d::UnitZ()) *
+                     Eigen::AngleAxisd(moveTarget.rpy[1], Eigen::Vector3d::UnitY()) *
+                     Eigen::AngleAxisd(moveTarget.rpy[0], Eigen::Vector3d::UnitX())).toRotationMatrix();
+    pose.translation() = Eigen::Vector3d(moveTarget.pos.x, moveTarget.pos.y, moveTarget.pos.z);
+    return pose;
+}
+
 double InterCubicMover::poseDiff(const std::vector<double>& a, const std::vector<double>& b) {
     double diff_sum = 0;
     if (a.size() == b.size()) {
@@ -272,6 +430,7 @@ void InterCubicMover::clearAll() {
     m_mutex.lock();
     tmpTargets = m_targets;
     m_targets.clear();
+    m_clearMoveTarget = true;
     m_mutex.unlock();
 
     for (auto& iter : tmpTargets) {
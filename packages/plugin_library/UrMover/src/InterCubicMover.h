@@ -13,11 +13,28 @@
 #include <thread>
 #include <deque>
 #include <chrono>
+#include <Eigen/Geometry>
+#include <cobotsys_abstract_kinematic_solver.h>
+#include "CubicSpline.h"
 
 using namespace cobotsys;
 
+/**
+ * 关节空间插补的 Mover。
+ *
+ * 收到的目标先求逆解放进一个滑动窗口，在窗口内拟合三次样条得到节点速度/加速度，
+ * 再用五次多项式从当前设定点过渡到下一个节点，按伺服周期输出二阶连续的关节设定点。
+ * 适合 ForceGuideController、打磨路径这类密集的目标流。
+ *
+ * 窗口越长，节点速度越接近整条路径的样条，但新目标要等前面的节点都走完才到达，
+ * 延迟大约是 WindowSize * max(MinSegmentTime, 目标间隔)。配置文件的 StreamProfiles 按目标流的类型给出这两个参数，
+ * StreamType 选用其中一个: guide 是拖动示教这类要跟手的目标流(3 个节点、8 ms，约 24 ms)，
+ * path 是打磨路径这类预先生成、更看重平滑的目标流(8 个节点、16 ms，约 128 ms)。不给配置文件时用 guide。
+ */
 class InterCubicMover : public AbstractArmRobotMoveDriver, public ArmRobotRealTimeStatusObserver {
 public:
+    typedef AbstractKinematicSolver::Joint6d Joint6d;
+
     InterCubicMover();
     virtual ~InterCubicMover();
 
@@ -28,7 +45,7 @@ public:
     virtual void setRealTimeDriver(const std::shared_ptr<AbstractArmRobotRealTimeDriver>& realTimeDriver);
     virtual void setKinematicSolver(const std::shared_ptr<AbstractKinematicSolver>& kinematicSolver);
 
-    virtual std::shared_ptr<AbstractKinematicSolver>& getKinematicSolver() { return m_kinematicSolver; }
+    virtual std::shared_ptr<AbstractKinematicSolver>& getKinematicSolver() { return m_sharedKinematicSolver; }
 
     virtual void onArmRobotConnect();
     virtual void onArmRobotDisconnect();
@@ -44,7 +61,8 @@ public:
 protected:
     std::vector<std::shared_ptr<ArmRobotMoveStatusObserver> > m_observers;
     std::shared_ptr<AbstractArmRobotRealTimeDriver> m_realTimeDriver;
-    std::shared_ptr<AbstractKinematicSolver> m_kinematicSolver;
+    std::shared_ptr<AbstractKinematicSolver> m_kinematicSolver;       // 移动线程专用的求解器上下文
+    std::shared_ptr<AbstractKinematicSolver> m_sharedKinematicSolver; // setKinematicSolver() 给的求解器，调用者在其他线程里使用
 
     std::vector<double> m_curJoint;
     std::vector<double> m_curJointVel;
@@ -59,6 +77,43 @@ protected:
     };
     std::deque<MoveTarget> m_targets;
 
+    struct Knot {
+        MoveTarget target;
+        Joint6d joint;
+        double duration; ///< 从上一个节点运动到这里的时间
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+    // 已经求过逆解、还没有到达的目标。定长的环形缓冲，容量 m_windowSize，从 m_knotHead 开始 m_knotCount 个
+    std::vector<Knot, Eigen::aligned_allocator<Knot> > m_knots;
+    size_t m_knotHead;
+    size_t m_knotCount;
+
+    Knot& knotAt(size_t k) { return m_knots[(m_knotHead + k) % m_knots.size()]; }
+
+    // 以下缓冲区在 resizeBuffers() 里分配，每个周期的计算不再分配内存
+    std::vector<CubicSpline> m_splines;     // 每个关节一条样条
+    std::vector<QuinticSegment> m_segments; // 正在执行的段，每个关节一个
+    std::vector<double> m_knotTime;
+    std::vector<double> m_knotValue;
+    std::vector<double> m_knotSpeed;
+    std::vector<double> m_knotDist;
+    std::vector<double> m_setPos; // 当前输出的关节设定点
+    std::vector<double> m_setVel;
+    std::vector<double> m_setAcc;
+
+    size_t m_windowSize;
+    double m_servoPeriod;
+    double m_maxJointVel;
+    double m_maxJointAcc;
+    double m_minSegmentTime;
+    bool m_clearMoveTarget;
+
+    void resizeBuffers(size_t jointNum);
+    bool fillWindow();
+    void startSegment();
+    void stopSegment();
+
 
     double m_poseLastError;
 
@@ -70,12 +125,11 @@ protected:
     void notify(const MoveTarget& moveTarget, MoveResult moveResult);
 
     static std::vector<double> toVector(const MoveTarget& moveTarget);
+    static Eigen::Isometry3d toIsometry(const MoveTarget& moveTarget);
     static double poseDiff(const std::vector<double>& a, const std::vector<double>& b);
 
     std::thread m_moverThread;
     bool m_exitLoop;
-
-    double m_timeMoveScale_;
 };
 
 #endif //COBOTSYS_INTERCUBLICMOVER_H
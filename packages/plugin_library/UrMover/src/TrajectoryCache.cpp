@@ -0,0 +1,101 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#include "TrajectoryCache.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+const double MinTolerance = 1e-12;
+
+void appendQuantized(std::vector<int64_t>& key, const std::vector<double>& values, double tolerance) {
+    key.push_back((int64_t) values.size());
+    for (auto value : values)
+        key.push_back((int64_t) std::llround(value / tolerance));
+}
+}
+
+size_t TrajectoryCache::QuantizedKeyHash::operator()(const QuantizedKey& key) const {
+    size_t seed = key.size();
+    for (auto value : key)
+        seed ^= std::hash<int64_t>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    return seed;
+}
+
+TrajectoryCache::TrajectoryCache() {
+    m_maxEntries = 64;
+    m_maxSamples = 100000;
+    m_sampleCount = 0;
+    m_jointTolerance = 1e-3;
+    m_poseTolerance = 1e-4;
+    m_hitCount = 0;
+    m_missCount = 0;
+}
+
+void TrajectoryCache::setLimit(size_t maxEntries, size_t maxSamples) {
+    m_maxEntries = maxEntries;
+    m_maxSamples = maxSamples;
+    evict();
+}
+
+void TrajectoryCache::setTolerance(double jointTolerance, double poseTolerance) {
+    jointTolerance = std::max(MinTolerance, jointTolerance);
+    poseTolerance = std::max(MinTolerance, poseTolerance);
+    if (jointTolerance != m_jointTolerance || poseTolerance != m_poseTolerance) {
+        m_jointTolerance = jointTolerance;
+        m_poseTolerance = poseTolerance;
+        clear();
+    }
+}
+
+TrajectoryCache::QuantizedKey TrajectoryCache::quantize(const Key& key) const {
+    QuantizedKey quantized;
+    quantized.reserve(key.joint.size() + key.geometry.size() + 2);
+    appendQuantized(quantized, key.joint, m_jointTolerance);
+    appendQuantized(quantized, key.geometry, m_poseTolerance);
+    return quantized;
+}
+
+TrajectoryCache::EntryPtr TrajectoryCache::find(const Key& key) {
+    auto iter = m_index.find(quantize(key));
+    if (iter == m_index.end()) {
+        m_missCount++;
+        return nullptr;
+    }
+    m_hitCount++;
+    m_lru.splice(m_lru.begin(), m_lru, iter->second);
+    return m_lru.front().second;
+}
+
+void TrajectoryCache::insert(const Key& key, const EntryPtr& entry) {
+    if (!entry || m_maxEntries == 0 || entry->samples.size() > m_maxSamples)
+        return;
+
+    QuantizedKey quantized = quantize(key);
+    auto iter = m_index.find(quantized);
+    if (iter != m_index.end()) {
+        m_sampleCount -= iter->second->second->samples.size();
+        m_lru.erase(iter->second);
+        m_index.erase(iter);
+    }
+
+    m_lru.emplace_front(quantized, entry);
+    m_index.emplace(std::move(quantized), m_lru.begin());
+    m_sampleCount += entry->samples.size();
+    evict();
+}
+
+void TrajectoryCache::clear() {
+    m_lru.clear();
+    m_index.clear();
+    m_sampleCount = 0;
+}
+
+void TrajectoryCache::evict() {
+    while (m_lru.size() && (m_lru.size() > m_maxEntries || m_sampleCount > m_maxSamples)) {
+        m_sampleCount -= m_lru.back().second->samples.size();
+        m_index.erase(m_lru.back().first);
+        m_lru.pop_back();
+    }
+}
@@ -0,0 +1,90 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+#ifndef COBOTSYS_TRAJECTORYCACHE_H
+#define COBOTSYS_TRAJECTORYCACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * 关节轨迹的缓存，BlendPlanner 用它缓存路径元素的关节表和整条采样好的轨迹。
+ *
+ * 关键字由起点的关节角和几何参数组成，按容差量化成整数后放进哈希表，查找的开销与条目数无关。
+ * 落在同一个量化格子里的关键字总是命中同一个条目；相差很小但是落在格子边界两侧的关键字算作不同的路线，
+ * 只是多做一次规划。
+ * 容量按条目数和关节角总数限制，超出时淘汰最久未使用的条目。
+ */
+class TrajectoryCache {
+public:
+    struct Entry {
+        std::vector<std::vector<double> > samples; ///< 关节角序列，第一个是起点
+        std::vector<size_t> marks;                 ///< 整条轨迹的条目: 每个路点的完成和离开采样点序号，成对存放
+    };
+    typedef std::shared_ptr<const Entry> EntryPtr;
+
+    struct Key {
+        std::vector<double> joint;    ///< 起点的关节角，按关节容差量化
+        std::vector<double> geometry; ///< 几何参数，按位姿容差量化
+    };
+
+public:
+    TrajectoryCache();
+
+    /**
+     * @param maxEntries 最多缓存的条目数
+     * @param maxSamples 所有条目的关节角总数上限
+     */
+    void setLimit(size_t maxEntries, size_t maxSamples);
+
+    /**
+     * 容差改变时清空缓存
+     * @param jointTolerance 起点关节角的量化步长(弧度)
+     * @param poseTolerance 几何参数的量化步长
+     */
+    void setTolerance(double jointTolerance, double poseTolerance);
+
+    EntryPtr find(const Key& key);
+
+    /**
+     * 插入一个条目，同一个量化关键字已有的条目被替换
+     */
+    void insert(const Key& key, const EntryPtr& entry);
+    void clear();
+
+    size_t size() const { return m_lru.size(); }
+    size_t sampleCount() const { return m_sampleCount; }
+    uint64_t hitCount() const { return m_hitCount; }
+    uint64_t missCount() const { return m_missCount; }
+
+protected:
+    typedef std::vector<int64_t> QuantizedKey;
+
+    struct QuantizedKeyHash {
+        size_t operator()(const QuantizedKey& key) const;
+    };
+
+    typedef std::list<std::pair<QuantizedKey, EntryPtr> > LruList;
+    typedef std::unordered_map<QuantizedKey, LruList::iterator, QuantizedKeyHash> Index;
+
+    QuantizedKey quantize(const Key& key) const;
+    void evict();
+
+protected:
+    LruList m_lru; // 最近使用的在前面
+    Index m_index;
+    size_t m_maxEntries;
+    size_t m_maxSamples;
+    size_t m_sampleCount;
+    double m_jointTolerance;
+    double m_poseTolerance;
+    uint64_t m_hitCount;
+    uint64_t m_missCount;
+};
+
+
+#endif //COBOTSYS_TRAJECTORYCACHE_H
@@ -6,6 +6,7 @@
 #include "UrMover.h"
 #include <Eigen/Dense>
 #include <extra2.h>
+#include <algorithm>
 using namespace Eigen;
 
 UrMover::UrMover() {
@@ -28,12 +29,32 @@ UrMover::UrMover() {
     m_robotConnected = true;
     m_curJointNum = 0;
     m_exitLoop = false;
+    m_clearMoveTarget = false;
+    m_blendSampleCount = 0;
+    m_exitPlan = false;
+    m_blendPlanDone = false;
+
+    auto& blendConfig = m_blendPlanner.config();
+    blendConfig.maxTcpVel = TCPMAXSPEED;
+    blendConfig.maxTcpAcc = TCPMAXACC;
+    blendConfig.jointVelLimit.assign(MyThreadParameter.SpeedLimit, MyThreadParameter.SpeedLimit + 6);
+    blendConfig.jointAccLimit.assign(MyThreadParameter.ASpeedLimit, MyThreadParameter.ASpeedLimit + 6);
 }
 UrMover::~UrMover() {
+    m_mutex.lock();
     m_exitLoop = true;
+    m_moverCond.notify_all();
+    m_mutex.unlock();
     if (m_moverThread.joinable()) {
         m_moverThread.join();
     }
+    m_planMutex.lock();
+    m_exitPlan = true;
+    m_planCond.notify_all();
+    m_planMutex.unlock();
+    if (m_planThread.joinable()) {
+        m_planThread.join();
+    }
 }
 bool UrMover::setup(const QString &configFilePath) {
 
@@ -83,7 +104,8 @@ bool UrMover::move(const std::vector<RobotWaypoint> &waypoints) {
     cout << "oooooooooooooooooooooooo" << endl;
     if (m_robotConnected) {
         for (int i = 0; i < waypoints.size(); i++) {
-            m_targets.push_back({waypoints[i].moveId, waypoints[i].position, waypoints[i].rpy});
+            m_targets.push_back({waypoints[i].moveId, waypoints[i].position, waypoints[i].rpy,
+                                 waypoints[i].blendRadius, waypoints[i].ioEvents});
             COBOT_LOG.debug() << "Total Targets : " << m_targets.size();
         }
         MyThreadParameter.SizeFlag = m_targets.size();
@@ -108,7 +130,14 @@ void UrMover::setRealTimeDriver(const std::shared_ptr<AbstractArmRobotRealTimeDr
 }
 
 void UrMover::setKinematicSolver(const std::shared_ptr<AbstractKinematicSolver> &kinematicSolver) {
-    m_kinematicSolver = kinematicSolver;
+    m_sharedKinematicSolver = kinematicSolver;
+    // 移动线程使用自己的上下文，不和调用者共享迭代求解器的中间状态；不支持上下文的求解器直接共用
+    m_kinematicSolver = kinematicSolver ? kinematicSolver->createThreadContext() : nullptr;
+    if (!m_kinematicSolver)
+        m_kinematicSolver = kinematicSolver;
+    m_planKinematicSolver = kinematicSolver ? kinematicSolver->createThreadContext() : nullptr;
+    if (!m_planKinematicSolver)
+        m_planKinematicSolver = kinematicSolver;
 }
 
 
@@ -122,6 +151,7 @@ void UrMover::onArmRobotDisconnect() {
     m_robotConnected = false;
     clearAll();
     m_curJointNum++;
+    m_moverCond.notify_all();
 }
 
 void UrMover::onArmRobotStatusUpdate(const ArmRobotStatusPtr &ptrRobotStatus) {
@@ -129,6 +159,7 @@ void UrMover::onArmRobotStatusUpdate(const ArmRobotStatusPtr &ptrRobotStatus) {
     m_curJoint = ptrRobotStatus->q_actual;
     m_qcurJoint = ptrRobotStatus->qd_actual;
     m_curJointNum++;
+    m_moverCond.notify_all();
 }
 
 void UrMover::notify(const UrMover::MoveTarget &moveTarget, MoveResult moveResult) {
@@ -144,9 +175,316 @@ void UrMover::notify(const UrMover::MoveTarget &moveTarget, MoveResult moveResul
     }
 }
 
+void UrMover::notify(uint32_t moveId, MoveResult moveResult, const MoveBlendRegion& blendRegion) {
+    std::vector<std::shared_ptr<ArmRobotMoveStatusObserver> > observers;
+    m_mutex.lock();
+    observers = m_observers;
+    m_mutex.unlock();
+
+    for (auto &ob : observers) {
+        if (ob) {
+            ob->onMoveBlendFinish(moveId, moveResult, blendRegion);
+        }
+    }
+}
+
+/**
+ * 连续路点(blendRadius > 0)的输出。
+ * 队列里有带过渡半径或者 IO 动作的目标时，把整个队列交给规划线程一次规划完(半径为0的路点停止)，
+ * 等待结果的周期保持上一个指令不动；规划好以后每个机器人状态周期输出一个采样点，
+ * 越过触发位置时设置 IO，采样点到达过渡圆弧中点时通知对应路点完成。
+ * 轨迹执行过程中新加入的连续路点从当前轨迹的终点开始提前规划，当前轨迹输出完后直接接上。
+ * @retval true 本周期已由连续路点处理
+ * @retval false 没有连续路点，交给原来的单点规划
+ */
+bool UrMover::blendProcess(const std::vector<double>& joint) {
+    if (m_blendSamples.empty() && m_blendMarks.empty()) {
+        if (!takeBlendPlan()) {
+            m_planMutex.lock();
+            bool planning = (bool) m_blendPlan;
+            m_planMutex.unlock();
+            if (planning) // 规划线程还没有算完
+                return true;
+            if (MyThreadParameter.SJointAngle.size()) // 单点规划还没有执行完
+                return false;
+            return requestBlendPlan(joint);
+        }
+    } else if (m_blendSamples.size()) {
+        m_planMutex.lock();
+        bool planning = (bool) m_blendPlan;
+        m_planMutex.unlock();
+        if (!planning)
+            requestBlendPlan(m_blendSamples.back());
+    }
+
+    if (m_blendSamples.size()) {
+        m_realTimeDriver->move(m_blendSamples.front());
+        m_blendSamples.pop_front();
+        m_blendSampleCount++;
+    }
+
+    fireIoEvents();
+
+    while (m_blendMarks.size() &&
+           (m_blendMarks.front().sampleIndex < m_blendSampleCount || m_blendSamples.empty())) {
+        auto mark = m_blendMarks.front();
+        m_blendMarks.pop_front();
+        notify(mark.moveId, MoveResult::Success, mark.region);
+    }
+    return true;
+}
+
+/**
+ * 从队列取走连续路点交给规划线程
+ * @param startJoint 轨迹起点，空闲时是当前关节角，提前规划时是当前轨迹的最后一个采样点
+ * @retval false 队列里没有连续路点
+ */
+bool UrMover::requestBlendPlan(const std::vector<double>& startJoint) {
+    auto plan = std::make_shared<BlendPlan>();
+    plan->startJoint = startJoint;
+    m_mutex.lock();
+    // 与 GetSerialsJoint 一样一次取走整个队列，避免带过渡半径的路点落到单点规划里。
+    // IO 动作需要按规划好的采样点触发，所以带 IO 动作的队列也走这里。
+    bool hasBlend = false;
+    for (auto& target : m_targets) {
+        if (target.blendRadius > 0 || target.ioEvents.size())
+            hasBlend = true;
+    }
+    if (hasBlend) {
+        for (auto& target : m_targets) {
+            plan->waypoints.push_back({target.moveId, toVector(target), target.blendRadius});
+            plan->ioEvents.push_back(target.ioEvents);
+        }
+        m_targets.clear();
+    }
+    m_mutex.unlock();
+
+    if (plan->waypoints.empty())
+        return false;
+
+    m_planMutex.lock();
+    m_blendPlan = plan;
+    m_blendPlanDone = false;
+    m_planCond.notify_all();
+    m_planMutex.unlock();
+    return true;
+}
+
+/**
+ * 接过规划线程算好的结果
+ * @retval false 没有算好的规划，或者规划失败
+ */
+bool UrMover::takeBlendPlan() {
+    std::shared_ptr<BlendPlan> plan;
+    m_planMutex.lock();
+    if (m_blendPlan && m_blendPlanDone) {
+        plan = m_blendPlan;
+        m_blendPlan.reset();
+    }
+    m_planMutex.unlock();
+
+    if (!plan)
+        return false;
+
+    if (!plan->success) {
+        COBOT_LOG.error() << "Blend waypoints from " << plan->waypoints.front().moveId
+                          << " to " << plan->waypoints.back().moveId << " Can Not Reached!";
+        for (auto& wp : plan->waypoints) {
+            notify(wp.moveId, MoveResult::InvalidMoveTarget, MoveBlendRegion());
+        }
+        clearAll();
+        return false;
+    }
+    m_blendSamples.swap(plan->samples);
+    m_blendMarks.swap(plan->marks);
+    m_ioEvents.swap(plan->scheduledIoEvents);
+    m_blendSampleCount = 0;
+    return true;
+}
+
+/**
+ * 规划线程，逆解和 IO 触发点的正解都在这里做，不占用 moveProcess 的伺服周期
+ */
+void UrMover::planProcess() {
+    while (true) {
+        std::shared_ptr<BlendPlan> plan;
+        std::unique_lock<std::mutex> uniqueLock(m_planMutex);
+        m_planCond.wait(uniqueLock, [&] {
+            return m_exitPlan || (m_blendPlan && !m_blendPlanDone);
+        });
+        if (m_exitPlan)
+            break;
+        plan = m_blendPlan;
+        uniqueLock.unlock();
+
+        planBlendTargets(*plan);
+
+        uniqueLock.lock();
+        if (m_blendPlan == plan) // 规划期间没有被取消
+            m_blendPlanDone = true;
+    }
+}
+
+void UrMover::planBlendTargets(BlendPlan& plan) {
+    auto hres_start = std::chrono::high_resolution_clock::now();
+    plan.success = m_blendPlanner.plan(m_planKinematicSolver, plan.startJoint, plan.waypoints,
+                                       plan.samples, plan.marks);
+    if (!plan.success)
+        return;
+    scheduleIoEvents(plan);
+    std::chrono::duration<double> time_diff = std::chrono::high_resolution_clock::now() - hres_start;
+    auto& cache = m_blendPlanner.cache();
+    auto& trajectoryCache = m_blendPlanner.trajectoryCache();
+    COBOT_LOG.notice() << "Blend waypoints: " << plan.waypoints.size() << ", samples: " << plan.samples.size()
+                       << ", plan time: " << time_diff.count() * 1000 << "ms"
+                       << ", trajectory cache hit/miss: " << trajectoryCache.hitCount() << "/" << trajectoryCache.missCount()
+                       << ", cache hit/miss: " << cache.hitCount() << "/" << cache.missCount()
+                       << ", io events: " << plan.scheduledIoEvents.size();
+}
+
+/**
+ * 把路点上的 IO 动作换算成采样点序号。
+ * 到路点 i 的这一段是上一个路点的离开标记(停止点在停留结束时)到路点 i 的完成标记之间的采样点，
+ * 逐点正解得到 TCP 位置，路径比例按 TCP 走过的长度计算。一直没有满足条件的动作在路点完成时触发。
+ * 所以停止点上触发的动作(比如到点伸出气缸)和下一个路点路径比例 0 的动作(离开时收回气缸)不会落在同一个采样点。
+ */
+void UrMover::scheduleIoEvents(BlendPlan& plan) {
+    const auto& samples = plan.samples;
+    const auto& marks = plan.marks;
+    auto& scheduled = plan.scheduledIoEvents;
+    scheduled.clear();
+    if (samples.empty())
+        return;
+
+    std::vector<double> pose;
+    std::vector<double> prevPose;
+    std::vector<double> distToGoal;
+    std::vector<double> pathLength;
+    size_t begin = 0;
+    for (size_t i = 0; i < plan.waypoints.size() && i < marks.size(); i++) {
+        size_t end = std::min(marks[i].sampleIndex, samples.size() - 1);
+        if (plan.ioEvents[i].size() && end >= begin) {
+            const auto& goal = plan.waypoints[i].pose;
+            distToGoal.clear();
+            pathLength.clear();
+            for (size_t k = begin; k <= end; k++) {
+                m_planKinematicSolver->jntToCart(samples[k], pose);
+                double step = 0;
+                if (k > begin) {
+                    double dx = pose[0] - prevPose[0];
+                    double dy = pose[1] - prevPose[1];
+                    double dz = pose[2] - prevPose[2];
+                    step = std::sqrt(dx * dx + dy * dy + dz * dz);
+                }
+                pathLength.push_back((pathLength.empty() ? 0 : pathLength.back()) + step);
+                double dx = pose[0] - goal[0];
+                double dy = pose[1] - goal[1];
+                double dz = pose[2] - goal[2];
+                distToGoal.push_back(std::sqrt(dx * dx + dy * dy + dz * dz));
+                prevPose = pose;
+            }
+
+            for (auto& event : plan.ioEvents[i]) {
+                size_t k = 0;
+                for (; k + 1 < distToGoal.size(); k++) {
+                    if (event.trigger == MoveIoEvent::DistanceToGoal && distToGoal[k] <= event.value)
+                        break;
+                    if (event.trigger == MoveIoEvent::PathParameter &&
+                        pathLength[k] >= event.value * pathLength.back())
+                        break;
+                }
+                scheduled.push_back({begin + k, plan.waypoints[i].moveId, event});
+            }
+        }
+        begin = std::min(marks[i].leaveIndex, samples.size() - 1);
+    }
+
+    std::stable_sort(scheduled.begin(), scheduled.end(),
+                     [](const ScheduledIoEvent& a, const ScheduledIoEvent& b) {
+                         return a.sampleIndex < b.sampleIndex;
+                     });
+}
+
+/**
+ * 已经输出到触发采样点的 IO 动作，在本周期直接设置
+ */
+void UrMover::fireIoEvents() {
+    while (m_ioEvents.size() &&
+           (m_ioEvents.front().sampleIndex < m_blendSampleCount || m_blendSamples.empty())) {
+        auto scheduled = m_ioEvents.front();
+        m_ioEvents.pop_front();
+
+        auto ioDriver = scheduled.event.ioDriver;
+        if (!ioDriver && m_realTimeDriver)
+            ioDriver = m_realTimeDriver->getDigitIoDriver();
+        if (ioDriver) {
+            ioDriver->setIo(scheduled.event.ioPorts, scheduled.event.ioStatus);
+            COBOT_LOG.debug() << std::setw(5) << scheduled.moveId << " IO event at sample " << m_blendSampleCount;
+        } else {
+            COBOT_LOG.warning() << std::setw(5) << scheduled.moveId << " IO event has no digit io driver.";
+        }
+    }
+}
+
+void UrMover::cancelBlendTargets() {
+    auto marks = m_blendMarks;
+    m_blendMarks.clear();
+    m_blendSamples.clear();
+    m_ioEvents.clear();
+    for (auto& mark : marks) {
+        notify(mark.moveId, MoveResult::Cancled, mark.region);
+    }
+
+    // 交给规划线程的路点也取消，正在规划的结果算完后丢弃
+    std::shared_ptr<BlendPlan> plan;
+    m_planMutex.lock();
+    plan.swap(m_blendPlan);
+    m_blendPlanDone = false;
+    m_planMutex.unlock();
+    if (plan) {
+        for (auto& wp : plan->waypoints) {
+            notify(wp.moveId, MoveResult::Cancled, MoveBlendRegion());
+        }
+    }
+}
+
+
+UrMover::LoopStatistics UrMover::getLoopStatistics() {
+    std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
+    return m_loopStatistics;
+}
+
+void UrMover::resetLoopStatistics() {
+    std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
+    m_loopStatistics = LoopStatistics();
+}
+
+void UrMover::updateLoopStatistics(uint64_t jointNum, uint64_t jointNumOld,
+                                   const std::chrono::high_resolution_clock::time_point& wakeTime,
+                                   const std::chrono::high_resolution_clock::time_point& lastWakeTime) {
+    std::chrono::duration<double, std::milli> period = wakeTime - lastWakeTime;
+    std::chrono::duration<double, std::milli> stepTime = std::chrono::high_resolution_clock::now() - wakeTime;
+
+    std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
+    auto& stat = m_loopStatistics;
+    stat.stepCount++;
+    if (jointNumOld && jointNum > jointNumOld + 1)
+        stat.missedUpdates += jointNum - jointNumOld - 1;
+
+    stat.lastStepTime = stepTime.count();
+    stat.maxStepTime = std::max(stat.maxStepTime, stat.lastStepTime);
+    stat.meanStepTime += (stat.lastStepTime - stat.meanStepTime) / stat.stepCount;
+
+    if (stat.stepCount > 1) {
+        auto n = stat.stepCount - 1;
+        stat.lastPeriod = period.count();
+        stat.minPeriod = (n == 1) ? stat.lastPeriod : std::min(stat.minPeriod, stat.lastPeriod);
+        stat.maxPeriod = std::max(stat.maxPeriod, stat.lastPeriod);
+        stat.meanPeriod += (stat.lastPeriod - stat.meanPeriod) / n;
+    }
+}
 
 void UrMover::moveProcess() {
-    auto timePoint = std::chrono::high_resolution_clock::now();
     std::vector<double> joint;
     std::vector<double> curPose;
     std::vector<double> targetJoint;
@@ -164,19 +502,28 @@ void UrMover::moveProcess() {
     static int VVV=0;
 
     auto hres_start = std::chrono::high_resolution_clock::now();
-    while (!m_exitLoop) {
-        timePoint = timePoint + std::chrono::milliseconds(1);
-        m_mutex.lock();
+    auto wakeTime = hres_start;
+    auto lastWakeTime = hres_start;
+    while (true) {
+        // 没有新的机器人状态时阻塞，每个状态更新只计算一步。新的目标在下一个状态更新时处理。
+        std::unique_lock<std::recursive_mutex> uniqueLock(m_mutex);
+        m_moverCond.wait(uniqueLock, [&] {
+            return m_exitLoop || m_clearMoveTarget || m_curJointNum != jointNumOld;
+        });
+        if (m_exitLoop)
+            break;
+        wakeTime = std::chrono::high_resolution_clock::now();
         jointNum = m_curJointNum;
         joint = m_curJoint;
         clearAction = m_clearMoveTarget;
         m_clearMoveTarget = false;
-        m_mutex.unlock();
+        uniqueLock.unlock();
 
         m_kinematicSolver->jntToCart(joint, curPose);
 
         if (clearAction) {
             clearAction = false;
+            cancelBlendTargets();
             if (!noMoveTarget) {
                 noMoveTarget = true;
                 moveFinished = true;
@@ -186,7 +533,9 @@ void UrMover::moveProcess() {
             }
         }
 
-        if (jointNum > jointNumOld) {
+        if (jointNum > jointNumOld && blendProcess(joint)) {
+            // 连续路点已经输出
+        } else if (jointNum > jointNumOld) {
             // Pick target
             if (noMoveTarget) {
                 if (pickMoveTarget(moveTarget, MOVES)) {
@@ -284,11 +633,19 @@ void UrMover::moveProcess() {
                 pose_err_last = actual_pose_diff;
             }//截止到这里是目标存在
         }
+        if (jointNum > jointNumOld) {
+            updateLoopStatistics(jointNum, jointNumOld, wakeTime, lastWakeTime);
+            lastWakeTime = wakeTime;
+        }
         jointNumOld = jointNum;
-        std::this_thread::sleep_until(timePoint);
 
     }
-    COBOT_LOG.notice() << "UrMover is stopped.";
+    auto stat = getLoopStatistics();
+    COBOT_LOG.notice() << "UrMover is stopped. Steps: " << stat.stepCount
+                       << ", missed: " << stat.missedUpdates
+                       << ", period(ms) min/mean/max: " << stat.minPeriod << "/" << stat.meanPeriod << "/"
+                       << stat.maxPeriod
+                       << ", step time(ms) mean/max: " << stat.meanStepTime << "/" << stat.maxStepTime;
 }
 
 #define FilASpeedLimit 0.1
@@ -317,15 +674,27 @@ bool UrMover::LittleFilter(vector<double>& Now){
 void UrMover::clearAttachedObject() {
     m_mutex.lock();
     m_exitLoop = true;
+    m_moverCond.notify_all();
     m_mutex.unlock();
 
     if (m_moverThread.joinable()) {
         m_moverThread.join();
     }
 
+    m_planMutex.lock();
+    m_exitPlan = true;
+    m_planCond.notify_all();
+    m_planMutex.unlock();
+
+    if (m_planThread.joinable()) {
+        m_planThread.join();
+    }
+
     m_mutex.lock();
     m_observers.clear();
     m_kinematicSolver.reset();
+    m_planKinematicSolver.reset();
+    m_sharedKinematicSolver.reset();
     m_realTimeDriver.reset();
     m_mutex.unlock();
 }
@@ -378,6 +747,7 @@ bool UrMover::start() {
     std::lock_guard<std::recursive_mutex> lockGuard(m_mutex);
     if (m_kinematicSolver && m_realTimeDriver) {
         m_moverThread = std::thread(&UrMover::moveProcess, this);
+        m_planThread = std::thread(&UrMover::planProcess, this);
         return true;
     }
     return false;
@@ -392,6 +762,7 @@ void UrMover::clearAll() {
     tmpTargets = m_targets;
     m_targets.clear();
     m_clearMoveTarget = true;
+    m_moverCond.notify_all();
     auto num_tgt = tmpTargets.size();
     m_mutex.unlock();
 
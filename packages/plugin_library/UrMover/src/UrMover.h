@@ -10,6 +10,7 @@
 #include <mutex>
 #include <cobotsys_abstract_arm_robot_realtime_driver.h>
 #include <thread>
+#include <condition_variable>
 #include <deque>
 #include <chrono>
 #include <cobotsys_abstract_arm_robot_realtime_driver.h>
@@ -25,6 +26,7 @@
 #include "chainfksolverpos_recursive.hpp"
 #include <Eigen/Dense>
 #include <queue>
+#include "BlendPlanner.h"
 
 using namespace cobotsys;
 using namespace std;
@@ -112,6 +114,24 @@ public:
         uint32_t moveId;
         cv::Point3d pos;
         cv::Vec3d rpy;
+        double blendRadius; ///< 过渡半径，大于0时不在该点停止
+        std::vector<MoveIoEvent> ioEvents; ///< 运动到该点过程中触发的 IO 动作
+    };
+
+    /**
+     * moveProcess 循环统计，时间单位为毫秒。
+     * period 是相邻两个机器人状态更新之间的间隔，step time 是处理一个状态更新所用的时间。
+     */
+    struct LoopStatistics {
+        uint64_t stepCount = 0;
+        uint64_t missedUpdates = 0; ///< 处理不及时而跳过的状态更新数
+        double lastPeriod = 0;
+        double minPeriod = 0;
+        double maxPeriod = 0;
+        double meanPeriod = 0;
+        double lastStepTime = 0;
+        double maxStepTime = 0;
+        double meanStepTime = 0;
     };
 
     UrMover();
@@ -124,7 +144,7 @@ public:
     virtual void setRealTimeDriver(const std::shared_ptr<AbstractArmRobotRealTimeDriver>& realTimeDriver);
     virtual void setKinematicSolver(const std::shared_ptr<AbstractKinematicSolver>& kinematicSolver);
 
-    virtual std::shared_ptr<AbstractKinematicSolver>& getKinematicSolver() { return m_kinematicSolver; }
+    virtual std::shared_ptr<AbstractKinematicSolver>& getKinematicSolver() { return m_sharedKinematicSolver; }
 
     virtual void onArmRobotConnect();
     virtual void onArmRobotDisconnect();
@@ -137,6 +157,9 @@ public:
     virtual bool start();
     virtual void clearAll();
 
+    LoopStatistics getLoopStatistics();
+    void resetLoopStatistics();
+
     virtual void applyFilter(std::vector<double>& target_, vector<double> & m_target,MoveMethod Method);
     virtual double  DivisionTime(vector<double>& aim,vector<double>& now);//使用二分法获得最短的规划时间
     virtual void  GetDisire(); //新建一个线程用来完成数据的差值运算
@@ -159,7 +182,9 @@ protected:
     int MyCountFlag = 0;
     std::vector<std::shared_ptr<ArmRobotMoveStatusObserver> > m_observers;
     std::shared_ptr<AbstractArmRobotRealTimeDriver> m_realTimeDriver;
-    std::shared_ptr<AbstractKinematicSolver> m_kinematicSolver;
+    std::shared_ptr<AbstractKinematicSolver> m_kinematicSolver;       // 移动线程专用的求解器上下文
+    std::shared_ptr<AbstractKinematicSolver> m_sharedKinematicSolver; // setKinematicSolver() 给的求解器，调用者在其他线程里使用
+    std::shared_ptr<AbstractKinematicSolver> m_planKinematicSolver;   // 规划线程专用的求解器上下文
     vector<JointAngle> MyRoute;
 //    Eigen::Matrix4d m_cam2base;
 //    std::vector<double> m_initialJoint;
@@ -175,13 +200,62 @@ protected:
     bool pickMoveTarget(MoveTarget& moveTarget,IFThread A);
 
     void notify(const MoveTarget& moveTarget, MoveResult moveResult);
+    void notify(uint32_t moveId, MoveResult moveResult, const MoveBlendRegion& blendRegion);
+
+    struct BlendPlan;
+    bool blendProcess(const std::vector<double>& joint);
+    bool requestBlendPlan(const std::vector<double>& startJoint);
+    bool takeBlendPlan();
+    void planProcess();
+    void planBlendTargets(BlendPlan& plan);
+    void cancelBlendTargets();
+    void scheduleIoEvents(BlendPlan& plan);
+    void fireIoEvents();
 
     static std::vector<double> toVector(const MoveTarget& moveTarget);
     static double poseDiff(const std::vector<double>& a, const std::vector<double>& b);
 
+    void updateLoopStatistics(uint64_t jointNum, uint64_t jointNumOld,
+                              const std::chrono::high_resolution_clock::time_point& wakeTime,
+                              const std::chrono::high_resolution_clock::time_point& lastWakeTime);
+
     std::thread m_moverThread;
     bool m_exitLoop;
+    std::condition_variable_any m_moverCond; // 新的机器人状态、清除目标、退出时唤醒 moveProcess
+    LoopStatistics m_loopStatistics;
     ThreadParameter MyThreadParameter;//声明一个结构体的全局变量，这样不论是主线程还是其他都可以使用这个变量
+
+    BlendPlanner m_blendPlanner;
+    std::deque<std::vector<double> > m_blendSamples; // 连续路点的关节序列，每个机器人状态周期输出一个
+    std::deque<BlendPlanner::Mark> m_blendMarks;
+    size_t m_blendSampleCount;
+
+    struct ScheduledIoEvent {
+        size_t sampleIndex; // 输出完这个序号的采样点后触发
+        uint32_t moveId;
+        MoveIoEvent event;
+    };
+    std::deque<ScheduledIoEvent> m_ioEvents; // 按 sampleIndex 排序
+
+    /**
+     * 一次连续路点规划。moveProcess 从队列取走目标后交给规划线程，
+     * 规划线程填好结果，moveProcess 在当前轨迹输出完后整体接过来，伺服周期里不做逆解。
+     */
+    struct BlendPlan {
+        std::vector<double> startJoint;
+        std::vector<BlendPlanner::Waypoint> waypoints;
+        std::vector<std::vector<MoveIoEvent> > ioEvents;
+        bool success = false;
+        std::deque<std::vector<double> > samples;
+        std::deque<BlendPlanner::Mark> marks;
+        std::deque<ScheduledIoEvent> scheduledIoEvents;
+    };
+    std::thread m_planThread;
+    std::mutex m_planMutex;
+    std::condition_variable m_planCond;
+    bool m_exitPlan;
+    std::shared_ptr<BlendPlan> m_blendPlan; // 已经交给规划线程、还没有被 moveProcess 接过来的规划
+    bool m_blendPlanDone;
 };
 
 
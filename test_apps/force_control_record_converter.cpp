@@ -0,0 +1,153 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+/**
+ * 把 ForceControlRecorder 记录的二进制文件转换为 CSV 或者 NumPy(.npy) 文件。
+ *
+ * 每条记录一行，列依次为:
+ *   time(相对开始记录的秒数), source(1 力样本, 2 运动指令), sequence,
+ *   raw_fx..raw_tz, comp_fx..comp_tz, filt_fx..filt_tz, offset_x..offset_rz, cmd_q1..cmd_q6, act_q1..act_q6
+ * 记录中没有的字段为 NaN。npy 文件是 N x 39 的 float64 数组，列顺序同上，用 numpy.load 读取。
+ *
+ * 用法: force_control_record_converter <记录文件> <输出文件.csv | 输出文件.npy>
+ */
+
+#include <cobotsys_force_control_recorder.h>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace cobotsys;
+
+namespace {
+const char* const GROUPS[] = {"raw_", "comp_", "filt_", "offset_", "cmd_", "act_"};
+const char* const WRENCH_AXES[] = {"fx", "fy", "fz", "tx", "ty", "tz"};
+const char* const OFFSET_AXES[] = {"x", "y", "z", "rx", "ry", "rz"};
+const char* const JOINT_AXES[] = {"q1", "q2", "q3", "q4", "q5", "q6"};
+
+std::vector<std::string> columnNames() {
+    std::vector<std::string> names = {"time", "source", "sequence"};
+    for (int group = 0; group < 6; group++) {
+        const char* const* axes = group < 3 ? WRENCH_AXES : (group == 3 ? OFFSET_AXES : JOINT_AXES);
+        for (int i = 0; i < 6; i++)
+            names.push_back(std::string(GROUPS[group]) + axes[i]);
+    }
+    return names;
+}
+
+void toRow(const ForceControlRecorder::Header& header, const ForceControlRecord& record, std::vector<double>& row) {
+    row.clear();
+    row.push_back((record.time - header.startTime) * 1e-9);
+    row.push_back(record.source);
+    row.push_back(record.sequence);
+    const double* groups[] = {record.rawWrench, record.compensatedWrench, record.filteredWrench,
+                              record.offset, record.commandQ, record.measuredQ};
+    for (auto group : groups)
+        row.insert(row.end(), group, group + 6);
+}
+
+bool writeCsv(const std::string& path, const ForceControlRecorder::Header& header,
+              const std::vector<ForceControlRecord>& records) {
+    std::ofstream file(path);
+    if (!file)
+        return false;
+
+    std::vector<std::string> names = columnNames();
+    for (size_t i = 0; i < names.size(); i++)
+        file << (i ? "," : "") << names[i];
+    file << "\n";
+
+    file.precision(std::numeric_limits<double>::max_digits10);
+    std::vector<double> row;
+    for (const auto& record : records) {
+        toRow(header, record, row);
+        for (size_t i = 0; i < row.size(); i++) {
+            if (i)
+                file << ",";
+            if (row[i] == row[i])
+                file << row[i];
+        }
+        file << "\n";
+    }
+    return (bool) file;
+}
+
+/**
+ * NPY 1.0 格式: 魔数、版本、Header 长度(小端 uint16)、Python 字典形式的 Header，按 64 字节对齐
+ */
+bool writeNpy(const std::string& path, const ForceControlRecorder::Header& header,
+              const std::vector<ForceControlRecord>& records) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    const size_t columns = columnNames().size();
+    std::ostringstream dict;
+    dict << "{'descr': '<f8', 'fortran_order': False, 'shape': (" << records.size() << ", " << columns << "), }";
+    std::string text = dict.str();
+    const size_t preamble = 10;
+    size_t total = ((preamble + text.size() + 1 + 63) / 64) * 64;
+    text.append(total - preamble - text.size() - 1, ' ');
+    text.push_back('\n');
+
+    uint16_t length = (uint16_t) text.size();
+    const char magic[] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0};
+    file.write(magic, sizeof(magic));
+    const char lengthBytes[] = {(char) (length & 0xFF), (char) (length >> 8)};
+    file.write(lengthBytes, 2);
+    file.write(text.data(), text.size());
+
+    // 只支持小端机器，与 '<f8' 一致
+    std::vector<double> row;
+    for (const auto& record : records) {
+        toRow(header, record, row);
+        file.write((const char*) row.data(), row.size() * sizeof(double));
+    }
+    return (bool) file;
+}
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <record file> <output.csv | output.npy>" << std::endl;
+        return 1;
+    }
+
+    ForceControlRecorder::Header header;
+    std::vector<ForceControlRecord> records;
+    if (!ForceControlRecorder::load(argv[1], header, records))
+        return 1;
+
+    uint64_t sensorCount = 0;
+    for (const auto& record : records) {
+        if (record.source == ForceControlRecord::SOURCE_SENSOR)
+            sensorCount++;
+    }
+    std::cout << "records: " << records.size() << " (sensor " << sensorCount << ", robot "
+              << records.size() - sensorCount << "), lost: " << header.lost << ", overflow: " << header.overflow
+              << std::endl;
+
+    std::string output = argv[2];
+    bool success = endsWith(output, ".npy") ? writeNpy(output, header, records) : writeCsv(output, header, records);
+    if (!success) {
+        std::cerr << "Fail to write " << output << std::endl;
+        return 1;
+    }
+    if (endsWith(output, ".npy")) {
+        std::vector<std::string> names = columnNames();
+        std::cout << "columns:";
+        for (const auto& name : names)
+            std::cout << " " << name;
+        std::cout << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,296 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+/**
+ * 负载重力、重心和力传感器零点标定。
+ *
+ * 机械臂依次慢速运动到配置文件给出的一组关节角，每个姿态静止一段时间后平均传感器读数，
+ * 末端旋转在这个姿态下只做一次正解。全部姿态采集完后用 GravityCalibrator 做最小二乘，
+ * 输出每个姿态的残差，结果写入文件。ForceControlSolver 配置中的 gravity_calibration 指向这个文件即可使用。
+ *
+ * 配置文件格式见 CONFIG/ForceControlConfig/gravity_calibration_config.json，姿态要让末端朝向尽量分散。
+ *
+ * 用法: gravity_calibration [配置文件] [输出文件]
+ */
+
+#include <cobotsys.h>
+#include <extra2.h>
+#include <cobotsys_global_object_factory.h>
+#include <cobotsys_file_finder.h>
+#include <cobotsys_abstract_arm_robot_realtime_driver.h>
+#include <cobotsys_abstract_force_sensor.h>
+#include <cobotsys_abstract_kinematic_solver.h>
+#include <cobotsys_gravity_compensation.h>
+#include <QApplication>
+#include <QJsonArray>
+#include <Eigen/StdVector>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+using namespace cobotsys;
+typedef std::vector<Eigen::Matrix3d, Eigen::aligned_allocator<Eigen::Matrix3d> > RotationList;
+
+namespace {
+const double MOVE_PERIOD = 0.008;
+const double ARRIVE_TOLERANCE = 0.005;
+
+/**
+ * 记录最新的关节角，按需累加传感器读数
+ */
+class CalibrationObserver : public ArmRobotRealTimeStatusObserver, public ForceSensorStreamObserver {
+public:
+    CalibrationObserver() : robotReady(false), sensorReady(false), m_collecting(false), m_count(0) {
+        for (auto& value : m_sum)
+            value = 0;
+    }
+
+    virtual void onArmRobotConnect() {}
+    virtual void onArmRobotDisconnect() { robotReady = false; }
+    virtual void onArmRobotStatusUpdate(const ArmRobotStatusPtr& ptrRobotStatus) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_q = ptrRobotStatus->q_actual;
+        robotReady = m_q.size() == 6;
+    }
+
+    virtual void onForceSensorConnect() {}
+    virtual void onForceSensorDisconnect() { sensorReady = false; }
+    virtual void onForceSensorDataStreamUpdate(const std::shared_ptr<Wrench>& ptrWrench) {
+        sensorReady = true;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_collecting)
+            return;
+        m_sum[0] += ptrWrench->force.x;
+        m_sum[1] += ptrWrench->force.y;
+        m_sum[2] += ptrWrench->force.z;
+        m_sum[3] += ptrWrench->torque.x;
+        m_sum[4] += ptrWrench->torque.y;
+        m_sum[5] += ptrWrench->torque.z;
+        m_count++;
+    }
+
+    std::vector<double> jointQ() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_q;
+    }
+
+    void startCollect() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& value : m_sum)
+            value = 0;
+        m_count = 0;
+        m_collecting = true;
+    }
+
+    /**
+     * @return 平均用到的样本个数
+     */
+    int stopCollect(double wrench[6]) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_collecting = false;
+        for (int i = 0; i < 6; i++)
+            wrench[i] = m_count > 0 ? m_sum[i] / m_count : 0;
+        return m_count;
+    }
+
+public:
+    std::atomic<bool> robotReady;
+    std::atomic<bool> sensorReady;
+
+protected:
+    std::mutex m_mutex;
+    std::vector<double> m_q;
+    bool m_collecting;
+    double m_sum[6];
+    int m_count;
+};
+
+template<class T>
+std::shared_ptr<T> createFromConfig(const QJsonObject& json, const char* key, const char* factory, const char* type) {
+    QJsonObject object = json[key].toObject();
+    auto pObject = std::dynamic_pointer_cast<T>(GlobalObjectFactory::instance()->createObject(
+            object["factory"].toString(factory), object["type"].toString(type)));
+    if (!pObject || !pObject->setup(object["config"].toString())) {
+        COBOT_LOG.error("GravityCalib") << "Fail to create " << key;
+        return nullptr;
+    }
+    return pObject;
+}
+
+bool waitFor(const std::atomic<bool>& flag, double timeout) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+    while (!flag) {
+        if (std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+/**
+ * 从当前位置按最大关节速度插值运动到目标，到位或超时返回
+ */
+bool moveTo(AbstractArmRobotRealTimeDriver& robot, CalibrationObserver& observer,
+            const std::vector<double>& target, double maxJointSpeed) {
+    std::vector<double> command = observer.jointQ();
+    double maxStep = maxJointSpeed * MOVE_PERIOD;
+    auto wakeTime = std::chrono::steady_clock::now();
+    bool commandDone = false;
+    while (!commandDone) {
+        commandDone = true;
+        for (size_t i = 0; i < command.size(); i++) {
+            double delta = target[i] - command[i];
+            if (std::fabs(delta) > maxStep) {
+                delta = delta > 0 ? maxStep : -maxStep;
+                commandDone = false;
+            }
+            command[i] += delta;
+        }
+        robot.move(command);
+        wakeTime += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(MOVE_PERIOD));
+        std::this_thread::sleep_until(wakeTime);
+    }
+
+    for (int retry = 0; retry < 500; retry++) {
+        std::vector<double> q = observer.jointQ();
+        double error = 0;
+        for (size_t i = 0; i < q.size(); i++)
+            error = std::max(error, std::fabs(q[i] - target[i]));
+        if (error < ARRIVE_TOLERANCE)
+            return true;
+        robot.move(target);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+int runCalibration(const QJsonObject& json, const std::string& outputPath) {
+    auto robot = createFromConfig<AbstractArmRobotRealTimeDriver>(
+            json, "robot_object", "URRealTimeDriverFactory, Ver 1.0", "URRealTimeDriver");
+    auto sensor = createFromConfig<AbstractForceSensor>(
+            json, "sensor_object", "OptoForceSensorFactory, Ver 1.0", "OptoForceSensor");
+    auto solver = createFromConfig<AbstractKinematicSolver>(
+            json, "kinematic_object", "KinematicSolverFactory, Ver 1.0", "KinematicSolver");
+    if (!robot || !sensor || !solver)
+        return 1;
+
+    auto observer = std::make_shared<CalibrationObserver>();
+    robot->attach(observer);
+    sensor->attach(observer);
+    robot->start();
+    sensor->start();
+    if (!waitFor(observer->robotReady, 10) || !waitFor(observer->sensorReady, 10)) {
+        COBOT_LOG.error("GravityCalib") << "Robot or force sensor not ready";
+        return 1;
+    }
+
+    double maxJointSpeed = json["max_joint_speed"].toDouble(0.3);
+    double settleTime = json["settle_time"].toDouble(2.0);
+    double averageTime = json["average_time"].toDouble(1.0);
+
+    GravityCalibrator calibrator;
+    RotationList rotations;
+    std::vector<std::vector<double> > wrenches;
+    int index = 0;
+    for (const auto& value : json["poses"].toArray()) {
+        std::vector<double> target = readRealArray(value);
+        for (auto& angle : target)
+            angle *= M_PI / 180;
+        index++;
+        if (target.size() != 6) {
+            COBOT_LOG.warning("GravityCalib") << "Skip pose " << index << ", need 6 joint angles";
+            continue;
+        }
+        if (!moveTo(*robot, *observer, target, maxJointSpeed)) {
+            COBOT_LOG.warning("GravityCalib") << "Skip pose " << index << ", robot not arrived";
+            continue;
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(settleTime));
+
+        observer->startCollect();
+        std::this_thread::sleep_for(std::chrono::duration<double>(averageTime));
+        std::vector<double> wrench(6);
+        int count = observer->stopCollect(wrench.data());
+
+        // 每个姿态只做一次正解
+        std::vector<double> q = observer->jointQ();
+        Eigen::Isometry3d pose;
+        if (count == 0 || q.size() != 6 ||
+            solver->jntToCart(Eigen::Map<const AbstractKinematicSolver::Joint6d>(q.data()), pose) != 0) {
+            COBOT_LOG.warning("GravityCalib") << "Skip pose " << index << ", no wrench or FK failed";
+            continue;
+        }
+        calibrator.addSample(pose.linear(), wrench.data());
+        rotations.push_back(pose.linear());
+        wrenches.push_back(wrench);
+        COBOT_LOG.notice("GravityCalib") << "Pose " << index << ": " << count << " samples, " << wrench;
+    }
+
+    sensor->stop();
+    robot->stop();
+
+    GravityCalibrator::Result result;
+    int retval = calibrator.solve(result);
+    if (retval != 0) {
+        COBOT_LOG.error("GravityCalib") << (retval == -1 ? "Need at least 3 poses" : "Poses are too similar")
+                                        << ", samples: " << calibrator.sampleCount()
+                                        << ", condition number: " << result.conditionNumber;
+        return 1;
+    }
+
+    GravityCompensation compensation;
+    compensation.setParameters(result.parameters);
+    std::cout << std::fixed << std::setprecision(4)
+              << "mass(kg): " << result.mass << std::endl
+              << "gravity(N): " << result.parameters.gravity.transpose() << std::endl
+              << "center(m): " << result.parameters.center.transpose() << std::endl
+              << "force offset(N): " << result.parameters.forceOffset.transpose() << std::endl
+              << "torque offset(Nm): " << result.parameters.torqueOffset.transpose() << std::endl
+              << "residual rms force(N): " << result.forceRms << ", torque(Nm): " << result.torqueRms
+              << ", condition number: " << result.conditionNumber << std::endl;
+    for (size_t i = 0; i < wrenches.size(); i++) {
+        double external[6];
+        compensation.compensate(rotations[i], wrenches[i].data(), external);
+        std::cout << "pose " << i + 1 << " residual:";
+        for (auto value : external)
+            std::cout << " " << std::setw(8) << value;
+        std::cout << std::endl;
+    }
+    std::cout << std::defaultfloat;
+
+    return compensation.save(outputPath) ? 0 : 1;
+}
+}
+
+int main(int argc, char** argv) {
+    QApplication a(argc, argv);
+    cobotsys::init_library(argc, argv);
+
+    GlobalObjectFactory globalObjectFactory;
+    globalObjectFactory.loadLibrarys();
+
+    std::string configPath = argc > 1 ? argv[1] : "CONFIG/ForceControlConfig/gravity_calibration_config.json";
+    std::string outputPath = argc > 2 ? argv[2] : "gravity_calibration.json";
+
+    QJsonObject json;
+    if (!loadJson(json, configPath)) {
+        COBOT_LOG.error("GravityCalib") << "Fail to load " << configPath;
+        return 1;
+    }
+
+    // 驱动依赖 Qt 事件循环，标定过程放在单独的线程里
+    int retval = 1;
+    std::thread worker([&]() {
+        retval = runCalibration(json, outputPath);
+        QMetaObject::invokeMethod(&a, "quit", Qt::QueuedConnection);
+    });
+    a.exec();
+    worker.join();
+    return retval;
+}
@@ -0,0 +1,558 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+/**
+ * OptoForce EtherDAQ 高速 UDP 传感器模拟器，用来在没有传感器的机器上测试力控。
+ *
+ * 在 UDP 端口(默认 49152)上响应与真实传感器相同的命令: CMD_SET_SPEED 设置发送间隔，
+ * CMD_START_HIGH_SPEED_STREAMING 开始向命令的发送方发送 36 字节的 HSURecord，CMD_STOP_STREAMING 停止。
+ * OptoForceSensor 的两种接收方式都可以直接连接，把配置中的 sensor_ip 改成模拟器的地址即可。
+ *
+ * 力由接触模型产生: 工具末端压入一个平面时，法向力为弹簧阻尼力，切向为库仑摩擦，
+ * 再叠加负载重力(可选，读取 gravity_calibration 的标定结果)、缓慢漂移的零点和白噪声。
+ * 末端位姿有两种来源:
+ *   - script: 按时间线性插值的关键帧(位置和 rpy 角)，从开始发送数据时计时
+ *   - robot_object: 机器人驱动(比如连接 URSim 的 URRealTimeDriver)的当前关节角做正解，可以和力控闭环
+ * record 指定文件时，每个发出的样本连同末端位置和压入深度写入 CSV，用于对比力控的响应和延迟。
+ *
+ * 配置文件格式见 CONFIG/ForceControlConfig/optoforce_simulator_config.json。robot_object 为空时使用 script，
+ * 否则 robot_object 和 kinematic_object 的写法与 gravity_calibration_config.json 相同。
+ * duration 大于 0 时发送这么多秒后自动退出，packet_loss 是模拟的丢包率(丢弃的包序号照常增加)。
+ *
+ * 用法: optoforce_simulator [配置文件]，Ctrl+C 退出
+ */
+
+#include <cobotsys.h>
+#include <extra2.h>
+#include <cobotsys_global_object_factory.h>
+#include <cobotsys_file_finder.h>
+#include <cobotsys_abstract_arm_robot_realtime_driver.h>
+#include <cobotsys_abstract_kinematic_solver.h>
+#include <cobotsys_gravity_compensation.h>
+#include <optoforce_hsu_protocol.h>
+#include <QApplication>
+#include <QJsonArray>
+#include <Eigen/StdVector>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#if defined(__linux__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace cobotsys;
+typedef std::chrono::steady_clock SimClock;
+
+namespace {
+const int IDLE_POLL_MS = 100;
+const int MAX_OVERRUN_TICKS = 10;
+const double FRICTION_SMOOTH_SPEED = 1e-3; ///< 切向速度小于这个值时摩擦力线性减小，避免静止时来回跳变
+
+std::atomic<bool> g_quit(false);
+
+void onSignal(int) {
+    g_quit = true;
+}
+
+Eigen::Vector3d readVector3(const QJsonValue& value, const Eigen::Vector3d& defaultValue) {
+    std::vector<double> values = readRealArray(value);
+    if (values.size() != 3)
+        return defaultValue;
+    return Eigen::Vector3d(values[0], values[1], values[2]);
+}
+
+/**
+ * 按时间插值的末端位姿关键帧
+ */
+class PoseScript {
+public:
+    bool load(const QJsonObject& json) {
+        m_keyframes.clear();
+        m_loop = json["loop"].toBool(false);
+        for (const auto& value : json["keyframes"].toArray()) {
+            QJsonObject object = value.toObject();
+            Keyframe keyframe;
+            keyframe.time = object["time"].toDouble(0);
+            keyframe.position = readVector3(object["position"], Eigen::Vector3d::Zero());
+            Eigen::Vector3d rpy = readVector3(object["rpy"], Eigen::Vector3d::Zero()) * M_PI / 180;
+            keyframe.rotation = Eigen::AngleAxisd(rpy[2], Eigen::Vector3d::UnitZ()) *
+                                Eigen::AngleAxisd(rpy[1], Eigen::Vector3d::UnitY()) *
+                                Eigen::AngleAxisd(rpy[0], Eigen::Vector3d::UnitX());
+            if (!m_keyframes.empty() && keyframe.time <= m_keyframes.back().time) {
+                COBOT_LOG.error("OptoForceSim") << "Keyframe time must be increasing: " << keyframe.time;
+                return false;
+            }
+            m_keyframes.push_back(keyframe);
+        }
+        if (m_keyframes.empty()) {
+            Keyframe keyframe;
+            keyframe.time = 0;
+            keyframe.position.setZero();
+            keyframe.rotation.setIdentity();
+            m_keyframes.push_back(keyframe);
+        }
+        return true;
+    }
+
+    void pose(double time, Eigen::Isometry3d& pose) const {
+        const double duration = m_keyframes.back().time;
+        if (m_loop && duration > 0)
+            time = std::fmod(time, duration);
+
+        size_t next = 0;
+        while (next < m_keyframes.size() && m_keyframes[next].time <= time)
+            next++;
+        if (next == 0 || next == m_keyframes.size()) {
+            const Keyframe& keyframe = next == 0 ? m_keyframes.front() : m_keyframes.back();
+            pose.linear() = keyframe.rotation.toRotationMatrix();
+            pose.translation() = keyframe.position;
+            return;
+        }
+
+        const Keyframe& a = m_keyframes[next - 1];
+        const Keyframe& b = m_keyframes[next];
+        double t = (time - a.time) / (b.time - a.time);
+        pose.linear() = a.rotation.slerp(t, b.rotation).toRotationMatrix();
+        pose.translation() = a.position + t * (b.position - a.position);
+    }
+
+protected:
+    struct Keyframe {
+        double time;
+        Eigen::Vector3d position;
+        Eigen::Quaterniond rotation;
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    std::vector<Keyframe, Eigen::aligned_allocator<Keyframe> > m_keyframes;
+    bool m_loop = false;
+};
+
+/**
+ * 平面接触模型，平面和末端位姿都在基坐标系下，输出传感器坐标系(与法兰重合)下的力
+ */
+class ContactModel {
+public:
+    void load(const QJsonObject& json) {
+        m_surfacePoint = readVector3(json["surface_point"], Eigen::Vector3d::Zero());
+        m_surfaceNormal = readVector3(json["surface_normal"], Eigen::Vector3d::UnitZ()).normalized();
+        m_toolTip = readVector3(json["tool_tip"], Eigen::Vector3d::Zero());
+        m_stiffness = json["stiffness"].toDouble(5000);
+        m_damping = json["damping"].toDouble(50);
+        m_friction = json["friction"].toDouble(0.3);
+        m_hasLast = false;
+    }
+
+    /**
+     * @param flange 法兰相对基坐标系的位姿
+     * @param dt 与上一次调用的时间间隔
+     * @param[out] wrench fx, fy, fz, tx, ty, tz
+     */
+    void wrench(const Eigen::Isometry3d& flange, double dt, double wrench[6]) {
+        m_tip = flange * m_toolTip;
+        Eigen::Vector3d velocity = Eigen::Vector3d::Zero();
+        if (m_hasLast && dt > 0)
+            velocity = (m_tip - m_lastTip) / dt;
+        m_lastTip = m_tip;
+        m_hasLast = true;
+
+        // 压入深度为正时才有接触，法向力不能把工具往平面里拉
+        m_penetration = (m_surfacePoint - m_tip).dot(m_surfaceNormal);
+        Eigen::Vector3d force = Eigen::Vector3d::Zero();
+        if (m_penetration > 0) {
+            double normalForce = std::max(0.0, m_stiffness * m_penetration - m_damping * velocity.dot(m_surfaceNormal));
+            Eigen::Vector3d tangent = velocity - velocity.dot(m_surfaceNormal) * m_surfaceNormal;
+            double speed = tangent.norm();
+            force = normalForce * m_surfaceNormal;
+            if (speed > 0)
+                force -= m_friction * normalForce * std::min(1.0, speed / FRICTION_SMOOTH_SPEED) * tangent / speed;
+        }
+
+        // 作用在工具末端的接触力经工具传到传感器，力矩按末端相对传感器原点计算
+        Eigen::Vector3d sensorForce = flange.linear().transpose() * force;
+        Eigen::Vector3d sensorTorque = m_toolTip.cross(sensorForce);
+        for (int i = 0; i < 3; i++) {
+            wrench[i] = sensorForce[i];
+            wrench[i + 3] = sensorTorque[i];
+        }
+    }
+
+    const Eigen::Vector3d& tip() const { return m_tip; }
+    double penetration() const { return m_penetration; }
+
+protected:
+    Eigen::Vector3d m_surfacePoint;
+    Eigen::Vector3d m_surfaceNormal;
+    Eigen::Vector3d m_toolTip;   ///< 工具末端在法兰坐标系下的位置
+    double m_stiffness = 0;      ///< N/m
+    double m_damping = 0;        ///< N/(m/s)
+    double m_friction = 0;       ///< 摩擦系数
+    bool m_hasLast = false;
+    Eigen::Vector3d m_lastTip = Eigen::Vector3d::Zero();
+    Eigen::Vector3d m_tip = Eigen::Vector3d::Zero();
+    double m_penetration = 0;
+};
+
+/**
+ * 记录机器人最新的关节角
+ */
+class RobotPoseObserver : public ArmRobotRealTimeStatusObserver {
+public:
+    virtual void onArmRobotConnect() {}
+    virtual void onArmRobotDisconnect() {}
+    virtual void onArmRobotStatusUpdate(const ArmRobotStatusPtr& ptrRobotStatus) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_q = ptrRobotStatus->q_actual;
+    }
+
+    bool jointQ(std::vector<double>& q) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        q = m_q;
+        return q.size() == 6;
+    }
+
+protected:
+    std::mutex m_mutex;
+    std::vector<double> m_q;
+};
+
+template<class T>
+std::shared_ptr<T> createFromConfig(const QJsonObject& object) {
+    auto pObject = std::dynamic_pointer_cast<T>(GlobalObjectFactory::instance()->createObject(
+            object["factory"].toString(), object["type"].toString()));
+    if (!pObject || !pObject->setup(object["config"].toString())) {
+        COBOT_LOG.error("OptoForceSim") << "Fail to create " << object["type"].toString();
+        return nullptr;
+    }
+    return pObject;
+}
+
+#if defined(__linux__)
+
+class SensorSimulator {
+public:
+    SensorSimulator() : m_generator(0) {}
+
+    ~SensorSimulator() {
+        if (m_socket >= 0)
+            close(m_socket);
+        if (m_robot)
+            m_robot->stop();
+    }
+
+    bool setup(const QJsonObject& json) {
+        m_intervalMs = std::max(1, 1000 / std::max(1, json["frequency"].toInt(1000)));
+        m_duration = json["duration"].toDouble(0);
+        m_packetLoss = json["packet_loss"].toDouble(0);
+        m_generator.seed((unsigned) json["seed"].toInt(1));
+
+        QJsonObject noise = json["noise"].toObject();
+        m_forceNoise = noise["force"].toDouble(0);
+        m_torqueNoise = noise["torque"].toDouble(0);
+        QJsonObject drift = json["bias_drift"].toObject();
+        m_forceDrift = drift["force"].toDouble(0);
+        m_torqueDrift = drift["torque"].toDouble(0);
+
+        m_contact.load(json["contact"].toObject());
+        if (!m_script.load(json["script"].toObject()))
+            return false;
+
+        QString calibrationFile = json["gravity_calibration"].toString();
+        m_hasPayload = false;
+        if (!calibrationFile.isEmpty()) {
+            if (!m_payload.load(FileFinder::find(calibrationFile.toStdString()))) {
+                COBOT_LOG.error("OptoForceSim") << "Fail to load " << calibrationFile;
+                return false;
+            }
+            m_hasPayload = true;
+        }
+
+        QJsonObject robotObject = json["robot_object"].toObject();
+        if (!robotObject.isEmpty()) {
+            m_robot = createFromConfig<AbstractArmRobotRealTimeDriver>(robotObject);
+            m_kinematic = createFromConfig<AbstractKinematicSolver>(json["kinematic_object"].toObject());
+            if (!m_robot || !m_kinematic)
+                return false;
+            m_robotObserver = std::make_shared<RobotPoseObserver>();
+            m_robot->attach(m_robotObserver);
+            m_robot->start();
+        }
+
+        QString recordFile = json["record"].toString();
+        if (!recordFile.isEmpty()) {
+            m_record.open(recordFile.toStdString());
+            if (!m_record) {
+                COBOT_LOG.error("OptoForceSim") << "Fail to open " << recordFile;
+                return false;
+            }
+            m_record << "time,hs_sequence,fx,fy,fz,tx,ty,tz,tip_x,tip_y,tip_z,penetration\n";
+        }
+
+        return openSocket(json["bind_ip"].toString("0.0.0.0").toStdString(), json["port"].toInt(OPTOFORCE_UDP_PORT));
+    }
+
+    void run() {
+        pollfd pfd;
+        pfd.fd = m_socket;
+        pfd.events = POLLIN;
+
+        while (!g_quit) {
+            if (!m_streaming) {
+                if (poll(&pfd, 1, IDLE_POLL_MS) > 0)
+                    handleCommands();
+                continue;
+            }
+
+            std::this_thread::sleep_until(m_nextTick);
+            handleCommands();
+            if (!m_streaming)
+                continue;
+
+            auto now = SimClock::now();
+            double time = std::chrono::duration<double>(m_nextTick - m_streamStart).count();
+            m_nextTick += std::chrono::milliseconds(m_intervalMs);
+            if (now - m_nextTick > std::chrono::milliseconds(m_intervalMs * MAX_OVERRUN_TICKS)) {
+                m_nextTick = now + std::chrono::milliseconds(m_intervalMs);
+                m_overruns++;
+            }
+            if (m_duration > 0 && time > m_duration)
+                break;
+
+            sendSample(time);
+        }
+
+        COBOT_LOG.notice("OptoForceSim") << "Sent: " << m_sent << ", dropped: " << m_dropped
+                                         << ", overruns: " << m_overruns;
+    }
+
+protected:
+    bool openSocket(const std::string& ip, int port) {
+        m_socket = socket(AF_INET, SOCK_DGRAM, 0);
+        if (m_socket < 0) {
+            COBOT_LOG.error("OptoForceSim") << "socket: " << strerror(errno);
+            return false;
+        }
+
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons((uint16_t) port);
+        if (inet_pton(AF_INET, ip.c_str(), &address.sin_addr) != 1 ||
+            bind(m_socket, (sockaddr*) &address, sizeof(address)) != 0) {
+            COBOT_LOG.error("OptoForceSim") << "Fail to bind " << ip << ":" << port << ", " << strerror(errno);
+            return false;
+        }
+        COBOT_LOG.notice("OptoForceSim") << "Listening on " << ip << ":" << port;
+        return true;
+    }
+
+    /**
+     * 处理所有已经到达的命令，不阻塞
+     */
+    void handleCommands() {
+        uint8_t buffer[64];
+        sockaddr_in peer;
+        socklen_t peerLength = sizeof(peer);
+        ssize_t length;
+        while ((length = recvfrom(m_socket, buffer, sizeof(buffer), MSG_DONTWAIT, (sockaddr*) &peer, &peerLength)) >= 0) {
+            if (length != HSUCommand::HSU_COMMAND_SIZE || ((buffer[0] << 8) | buffer[1]) != HSUCommand::HEADER) {
+                COBOT_LOG.warning("OptoForceSim") << "Ignore invalid command, length " << length;
+                peerLength = sizeof(peer);
+                continue;
+            }
+
+            // HSUCommand::pack 把 sample_count 的低 16 位写了两遍
+            uint16_t command = (uint16_t) ((buffer[2] << 8) | buffer[3]);
+            uint16_t value = (uint16_t) ((buffer[6] << 8) | buffer[7]);
+            switch (command) {
+            case HSUCommand::CMD_SET_SPEED:
+                m_intervalMs = std::max(1, std::min(1000, (int) value));
+                COBOT_LOG.notice("OptoForceSim") << "Sample interval: " << m_intervalMs << " ms";
+                break;
+            case HSUCommand::CMD_SET_FILTER:
+                COBOT_LOG.notice("OptoForceSim") << "Filter " << value << " ignored";
+                break;
+            case HSUCommand::CMD_START_HIGH_SPEED_STREAMING:
+                m_peer = peer;
+                m_streaming = true;
+                m_streamStart = SimClock::now();
+                m_nextTick = m_streamStart;
+                m_lastTime = 0;
+                COBOT_LOG.notice("OptoForceSim") << "Start streaming to " << inet_ntoa(peer.sin_addr)
+                                                 << ":" << ntohs(peer.sin_port);
+                break;
+            case HSUCommand::CMD_STOP_STREAMING:
+                m_streaming = false;
+                COBOT_LOG.notice("OptoForceSim") << "Stop streaming";
+                break;
+            default:
+                COBOT_LOG.warning("OptoForceSim") << "Unknown command " << command;
+                break;
+            }
+            peerLength = sizeof(peer);
+        }
+    }
+
+    void updatePose(double time) {
+        if (!m_robot) {
+            m_script.pose(time, m_flange);
+            return;
+        }
+
+        std::vector<double> q;
+        Eigen::Isometry3d pose;
+        if (m_robotObserver->jointQ(q) &&
+            m_kinematic->jntToCart(Eigen::Map<const AbstractKinematicSolver::Joint6d>(q.data()), pose) == 0) {
+            m_flange = pose;
+        }
+    }
+
+    void sendSample(double time) {
+        double dt = time - m_lastTime;
+        m_lastTime = time;
+        updatePose(time);
+
+        double wrench[6];
+        m_contact.wrench(m_flange, dt, wrench);
+
+        if (m_hasPayload) {
+            double gravity[6];
+            m_payload.gravityWrench(m_flange.linear(), gravity);
+            const GravityCompensation::Parameters& parameters = m_payload.getParameters();
+            for (int i = 0; i < 3; i++) {
+                wrench[i] += gravity[i] + parameters.forceOffset[i];
+                wrench[i + 3] += gravity[i + 3] + parameters.torqueOffset[i];
+            }
+        }
+
+        // 零点按随机游走漂移，噪声每个样本独立
+        std::normal_distribution<double> normal(0, 1);
+        double driftScale = std::sqrt(std::max(0.0, dt));
+        for (int i = 0; i < 6; i++) {
+            bool isForce = i < 3;
+            m_bias[i] += (isForce ? m_forceDrift : m_torqueDrift) * driftScale * normal(m_generator);
+            wrench[i] += m_bias[i] + (isForce ? m_forceNoise : m_torqueNoise) * normal(m_generator);
+        }
+
+        HSURecord record;
+        record.hs_sequence_ = ++m_sequence;
+        record.ft_sequence_ = m_sequence;
+        record.status_ = 0;
+        record.fx_ = (int32_t) std::lround(wrench[0] * DEFAULT_FORCE_DIV);
+        record.fy_ = (int32_t) std::lround(wrench[1] * DEFAULT_FORCE_DIV);
+        record.fz_ = (int32_t) std::lround(wrench[2] * DEFAULT_FORCE_DIV);
+        record.tx_ = (int32_t) std::lround(wrench[3] * DEFAULT_TORQUE_DIV);
+        record.ty_ = (int32_t) std::lround(wrench[4] * DEFAULT_TORQUE_DIV);
+        record.tz_ = (int32_t) std::lround(wrench[5] * DEFAULT_TORQUE_DIV);
+
+        // 模拟丢包时序号照常增加，接收端可以统计到
+        if (m_packetLoss > 0 && std::uniform_real_distribution<double>(0, 1)(m_generator) < m_packetLoss) {
+            m_dropped++;
+        } else {
+            uint8_t buffer[HSURecord::HSU_RECORD_SIZE];
+            record.pack(buffer);
+            if (sendto(m_socket, buffer, sizeof(buffer), 0, (sockaddr*) &m_peer, sizeof(m_peer)) == (ssize_t) sizeof(buffer))
+                m_sent++;
+            else
+                m_dropped++;
+        }
+
+        if (m_record) {
+            const Eigen::Vector3d& tip = m_contact.tip();
+            m_record << time << "," << record.hs_sequence_;
+            for (int i = 0; i < 6; i++)
+                m_record << "," << wrench[i];
+            m_record << "," << tip.x() << "," << tip.y() << "," << tip.z() << "," << m_contact.penetration() << "\n";
+        }
+    }
+
+protected:
+    int m_socket = -1;
+    sockaddr_in m_peer;
+    bool m_streaming = false;
+    int m_intervalMs = 1;
+    double m_duration = 0;
+    SimClock::time_point m_streamStart;
+    SimClock::time_point m_nextTick;
+    double m_lastTime = 0;
+    uint32_t m_sequence = 0;
+
+    PoseScript m_script;
+    ContactModel m_contact;
+    GravityCompensation m_payload;
+    bool m_hasPayload = false;
+    Eigen::Isometry3d m_flange = Eigen::Isometry3d::Identity();
+
+    std::shared_ptr<AbstractArmRobotRealTimeDriver> m_robot;
+    std::shared_ptr<AbstractKinematicSolver> m_kinematic;
+    std::shared_ptr<RobotPoseObserver> m_robotObserver;
+
+    std::mt19937 m_generator;
+    double m_forceNoise = 0;
+    double m_torqueNoise = 0;
+    double m_forceDrift = 0;
+    double m_torqueDrift = 0;
+    double m_bias[6] = {0, 0, 0, 0, 0, 0};
+    double m_packetLoss = 0;
+
+    std::ofstream m_record;
+    uint64_t m_sent = 0;
+    uint64_t m_dropped = 0;
+    uint64_t m_overruns = 0;
+};
+
+#endif
+}
+
+int main(int argc, char** argv) {
+    QApplication a(argc, argv);
+    cobotsys::init_library(argc, argv);
+
+    std::string configPath = argc > 1 ? argv[1] : "CONFIG/ForceControlConfig/optoforce_simulator_config.json";
+    QJsonObject json;
+    if (!loadJson(json, configPath)) {
+        COBOT_LOG.error("OptoForceSim") << "Fail to load " << configPath;
+        return 1;
+    }
+
+#if defined(__linux__)
+    GlobalObjectFactory globalObjectFactory;
+    if (!json["robot_object"].toObject().isEmpty())
+        globalObjectFactory.loadLibrarys();
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    // 机器人驱动依赖 Qt 事件循环，模拟器放在单独的线程里
+    int retval = 1;
+    std::thread worker([&]() {
+        SensorSimulator simulator;
+        if (simulator.setup(json)) {
+            simulator.run();
+            retval = 0;
+        }
+        QMetaObject::invokeMethod(&a, "quit", Qt::QueuedConnection);
+    });
+    a.exec();
+    g_quit = true;
+    worker.join();
+    return retval;
+#else
+    COBOT_LOG.error("OptoForceSim") << "Only supported on Linux";
+    return 1;
+#endif
+}
@@ -0,0 +1,179 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+/**
+ * 离线生成机械臂的可达性地图(ReachabilityMap)。
+ *
+ * 在求解器配置文件给出的关节限位内均匀随机采样，批量正解得到末端位姿，可操作度作为评分。
+ * 第一遍采样确定工作空间的包围盒，第二遍用同样的随机序列填充体素，最后写入二进制文件，
+ * 再用另一组随机关节角检查地图的命中率，以及用地图初值做逆解的成功率。
+ *
+ * 用法: reachability_map_builder [求解器配置文件] [输出文件] [采样个数] [体素边长(米)]
+ */
+
+#include <cobotsys.h>
+#include <extra2.h>
+#include <cobotsys_global_object_factory.h>
+#include <cobotsys_file_finder.h>
+#include <cobotsys_abstract_kinematic_solver.h>
+#include <cobotsys_reachability_map.h>
+#include <QApplication>
+#include <Eigen/StdVector>
+#include <fstream>
+#include <random>
+#include <iostream>
+
+using namespace cobotsys;
+typedef AbstractKinematicSolver::Joint6d Joint6d;
+typedef std::vector<Joint6d, Eigen::aligned_allocator<Joint6d> > JointList;
+typedef std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d> > PoseList;
+
+namespace {
+const size_t CHUNK_SIZE = 4096;
+const unsigned int SAMPLE_SEED = 20170418;
+
+struct JointRange {
+    double lower;
+    double upper;
+};
+
+bool loadJointRanges(const std::string& configPath, std::vector<JointRange>& ranges) {
+    QJsonObject json;
+    if (!loadJson(json, configPath))
+        return false;
+    ranges.clear();
+    foreach (const QJsonValue& value, json["param"].toArray()) {
+        QJsonObject limits = value.toObject()["limits"].toObject();
+        JointRange range;
+        range.lower = limits["lower"].toDouble(-M_PI);
+        range.upper = limits["upper"].toDouble(M_PI);
+        ranges.push_back(range);
+    }
+    return ranges.size() == ReachabilityMap::JOINT_NUM;
+}
+
+/**
+ * 按关节限位均匀采样 count 组关节角并做正解
+ */
+void sampleChunk(AbstractKinematicSolver& solver, const std::vector<JointRange>& ranges, std::mt19937& generator,
+                 size_t count, JointList& joints, PoseList& poses) {
+    std::uniform_real_distribution<double> unit(0, 1);
+    joints.resize(count);
+    poses.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        for (int j = 0; j < ReachabilityMap::JOINT_NUM; j++)
+            joints[i][j] = ranges[j].lower + (ranges[j].upper - ranges[j].lower) * unit(generator);
+    }
+    solver.jntToCartBatch(joints.data(), count, poses.data());
+}
+}
+
+int main(int argc, char** argv) {
+    QApplication a(argc, argv);
+    cobotsys::init_library(argc, argv);
+
+    GlobalObjectFactory globalObjectFactory;
+    globalObjectFactory.loadLibrarys();
+
+    std::string solverConfig = argc > 1 ? argv[1] : "CONFIG/UrRobotConfig/ur10_180_config.json";
+    std::string outputPath = argc > 2 ? argv[2] : "reachability.map";
+    size_t sampleCount = argc > 3 ? (size_t) std::max(1, atoi(argv[3])) : 2000000;
+    double resolution = argc > 4 ? atof(argv[4]) : 0.05;
+    if (resolution <= 0) {
+        COBOT_LOG.error("ReachMap") << "Invalid resolution: " << resolution;
+        return 1;
+    }
+
+    std::string configPath = FileFinder::find(solverConfig);
+    auto solver = std::dynamic_pointer_cast<AbstractKinematicSolver>(
+            GlobalObjectFactory::instance()->createObject("KinematicSolverFactory, Ver 1.0", "KinematicSolver"));
+    if (!solver || !solver->setup(configPath.c_str())) {
+        COBOT_LOG.error("ReachMap") << "Fail to create KinematicSolver with " << solverConfig;
+        return 1;
+    }
+    std::vector<JointRange> ranges;
+    if (!loadJointRanges(configPath, ranges)) {
+        COBOT_LOG.error("ReachMap") << "Need " << ReachabilityMap::JOINT_NUM << " joint limits in " << solverConfig;
+        return 1;
+    }
+
+    JointList joints;
+    PoseList poses;
+
+    // 第一遍：工作空间包围盒，四周留一个体素的余量
+    std::mt19937 generator(SAMPLE_SEED);
+    Eigen::Vector3d minCorner = Eigen::Vector3d::Constant(1e10);
+    Eigen::Vector3d maxCorner = Eigen::Vector3d::Constant(-1e10);
+    for (size_t done = 0; done < sampleCount; done += CHUNK_SIZE) {
+        size_t count = std::min(CHUNK_SIZE, sampleCount - done);
+        sampleChunk(*solver, ranges, generator, count, joints, poses);
+        for (size_t i = 0; i < count; i++) {
+            minCorner = minCorner.cwiseMin(poses[i].translation());
+            maxCorner = maxCorner.cwiseMax(poses[i].translation());
+        }
+    }
+    minCorner -= Eigen::Vector3d::Constant(resolution);
+    maxCorner += Eigen::Vector3d::Constant(resolution);
+
+    // 第二遍：同样的随机序列，按可操作度保留每个体素每个方向的最佳关节角
+    ReachabilityMapBuilder builder(minCorner, maxCorner, resolution);
+    AbstractKinematicSolver::Manipulability quality;
+    generator.seed(SAMPLE_SEED);
+    for (size_t done = 0; done < sampleCount; done += CHUNK_SIZE) {
+        size_t count = std::min(CHUNK_SIZE, sampleCount - done);
+        sampleChunk(*solver, ranges, generator, count, joints, poses);
+        for (size_t i = 0; i < count; i++) {
+            double score = solver->manipulability(joints[i], quality) == 0 ? quality.measure : 0;
+            builder.addSample(poses[i], joints[i], score);
+        }
+    }
+
+    ReachabilityMap map;
+    builder.build(map);
+    if (!map.save(outputPath))
+        return 1;
+
+    const Eigen::Vector3i& dims = map.dims();
+    size_t cellCount = (size_t) dims[0] * dims[1] * dims[2];
+    size_t occupied = 0;
+    double coverageSum = 0;
+    for (int z = 0; z < dims[2]; z++) {
+        for (int y = 0; y < dims[1]; y++) {
+            for (int x = 0; x < dims[0]; x++) {
+                Eigen::Vector3d center = map.minCorner() + (Eigen::Vector3d(x, y, z).array() + 0.5).matrix() * resolution;
+                double coverage = map.coverage(center);
+                occupied += coverage > 0;
+                coverageSum += coverage;
+            }
+        }
+    }
+    std::ifstream saved(outputPath, std::ios::binary | std::ios::ate);
+    std::cout << "samples:        " << builder.sampleCount() << std::endl
+              << "bounds:         [" << minCorner.transpose() << "] - [" << maxCorner.transpose() << "]" << std::endl
+              << "grid:           " << dims.transpose() << " (" << cellCount << " cells)" << std::endl
+              << "occupied cells: " << occupied << std::endl
+              << "mean coverage:  " << (occupied ? coverageSum / occupied : 0) << std::endl
+              << "seeds:          " << map.seedCount() << std::endl
+              << "file size:      " << (saved.is_open() ? (long long) saved.tellg() : -1) << " bytes" << std::endl;
+
+    // 检查：另一组随机关节角的正解应当落在地图里，地图初值的逆解成功率
+    ReachabilityMap loaded;
+    if (!loaded.load(outputPath))
+        return 1;
+    std::mt19937 checkGenerator(SAMPLE_SEED + 1);
+    size_t checkCount = std::min<size_t>(sampleCount, 10000);
+    sampleChunk(*solver, ranges, checkGenerator, checkCount, joints, poses);
+    size_t hit = 0, seeded = 0, solved = 0;
+    Joint6d seed, solution;
+    for (size_t i = 0; i < checkCount; i++) {
+        hit += loaded.isReachable(poses[i]);
+        if (loaded.seed(poses[i], seed)) {
+            seeded++;
+            solved += solver->cartToJnt(seed, poses[i], solution) == 0;
+        }
+    }
+    std::cout << "check hit rate: " << (double) hit / checkCount << std::endl
+              << "seeded IK:      " << solved << " / " << seeded << std::endl;
+    return 0;
+}
@@ -0,0 +1,304 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+/**
+ * CapsuleCollisionChecker 的正确性和耗时测试。
+ *
+ * 按同一个配置文件另外搭一个参考模型：连杆位姿用 Eigen 逐个相乘 DH 变换，
+ * 线段之间、线段到长方体的距离在线段参数上做三分搜索(距离是凸函数)，与 CapsuleCollisionChecker 比较。
+ * 随机关节角下比较最小距离，误差超过 LENGTH_TOLERANCE 的采样个数应为 0；
+ * 另外检查 distanceBatch()、firstCollision() 与逐点 distance() 一致。
+ * 耗时输出 distance() 单次调用的平均值/p50/p99/最大值，以及占 8 毫秒伺服周期的比例。
+ *
+ * 用法: test_capsule_collision_benchmark [采样个数] [碰撞检测配置文件]
+ */
+
+#include <cobotsys.h>
+#include <extra2.h>
+#include <cobotsys_capsule_collision.h>
+#include <QJsonArray>
+#include <Eigen/StdVector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace cobotsys;
+typedef std::chrono::steady_clock BenchClock;
+
+namespace {
+const double PI = 3.14159265358979323846;
+const double LENGTH_TOLERANCE = 2e-4;   // 被测实现在线段上搜索到 0.1 毫米
+const double SERVO_PERIOD_NS = 8e6;     // UR 伺服周期 8 毫秒
+const int SEARCH_ITERATIONS = 100;
+
+/**
+ * 凸函数 f(s), s in [0, 1] 的最小值
+ */
+template<class F>
+double minimizeConvex(F f) {
+    double lo = 0, hi = 1;
+    for (int i = 0; i < SEARCH_ITERATIONS; i++) {
+        double m1 = lo + (hi - lo) / 3;
+        double m2 = hi - (hi - lo) / 3;
+        if (f(m1) < f(m2))
+            hi = m2;
+        else
+            lo = m1;
+    }
+    return std::min(f((lo + hi) / 2), std::min(f(0), f(1)));
+}
+
+double pointSegmentDistance(const Eigen::Vector3d& p, const Eigen::Vector3d& a, const Eigen::Vector3d& b) {
+    Eigen::Vector3d ab = b - a;
+    double length2 = ab.squaredNorm();
+    double t = length2 > 0 ? std::max(0.0, std::min(1.0, (p - a).dot(ab) / length2)) : 0;
+    return (a + ab * t - p).norm();
+}
+
+/**
+ * 参考模型：只依赖配置文件，不用被测类的任何中间结果
+ */
+class ReferenceModel {
+public:
+    struct Capsule {
+        int frame;
+        int dhLink;
+        int link;
+        Eigen::Vector3d start;
+        Eigen::Vector3d end;
+        double radius;
+    };
+
+    struct Box {
+        Eigen::Matrix3d rotation; // 长方体坐标系到世界坐标系
+        Eigen::Vector3d center;
+        Eigen::Vector3d halfSize;
+    };
+
+    bool load(const std::string& configPath) {
+        QJsonObject json, robotJson;
+        if (!loadJson(json, configPath) || !loadJson(robotJson, json["kinematic_config"].toString().toStdString()))
+            return false;
+
+        std::vector<double> linkRadius = readRealArray(json["link_radius"]);
+        if (linkRadius.empty())
+            linkRadius.push_back(0.05);
+        foreach (const QJsonValue& value, robotJson["param"].toArray()) {
+            QJsonObject dh = value.toObject()["dh"].toObject();
+            m_dh.push_back({dh["a"].toDouble(), dh["alpha"].toDouble(), dh["d"].toDouble(), dh["theta"].toDouble()});
+        }
+        linkRadius.resize(m_dh.size(), linkRadius.back());
+        m_worldBase = readFrame(robotJson["world_base"].toObject());
+        Eigen::Isometry3d eeFrame = readFrame(robotJson["ee_frame"].toObject());
+
+        int link = 0;
+        for (size_t i = 0; i < m_dh.size(); i++) {
+            bool hasCapsule = false;
+            if (std::fabs(m_dh[i][2]) > 1e-6) {
+                m_capsules.push_back({(int) i, (int) i, link, Eigen::Vector3d::Zero(),
+                                      Eigen::Vector3d(0, 0, m_dh[i][2]), linkRadius[i]});
+                hasCapsule = true;
+            }
+            if (std::fabs(m_dh[i][0]) > 1e-6) {
+                m_capsules.push_back({(int) i + 1, (int) i, link, Eigen::Vector3d(-m_dh[i][0], 0, 0),
+                                      Eigen::Vector3d::Zero(), linkRadius[i]});
+                hasCapsule = true;
+            }
+            if (hasCapsule)
+                link++;
+        }
+        if (eeFrame.translation().norm() > 1e-6) {
+            m_capsules.push_back({(int) m_dh.size(), (int) m_dh.size(), link, Eigen::Vector3d::Zero(),
+                                  eeFrame.translation(), json["tool_radius"].toDouble(0.04)});
+        }
+
+        m_selfCollisionGap = json["self_collision_gap"].toInt(2);
+        for (auto value : readRealArray(json["ignore_obstacle_links"]))
+            m_ignoreLinks.push_back((int) value);
+        foreach (const QJsonValue& value, json["boxes"].toArray()) {
+            QJsonObject boxObj = value.toObject();
+            std::vector<double> size = readRealArray(boxObj["size"]);
+            size.resize(3, 0);
+            Eigen::Isometry3d pose = readFrame(boxObj);
+            m_boxes.push_back({pose.linear(), pose.translation(), Eigen::Vector3d(size[0], size[1], size[2]).cwiseAbs() * 0.5});
+        }
+        foreach (const QJsonValue& value, json["planes"].toArray()) {
+            QJsonObject planeObj = value.toObject();
+            std::vector<double> normal = readRealArray(planeObj["normal"]);
+            normal.resize(3, 0);
+            Eigen::Vector3d n(normal[0], normal[1], normal[2]);
+            m_planes.push_back(std::make_pair(n / n.norm(), planeObj["offset"].toDouble() / n.norm()));
+        }
+        return !m_capsules.empty();
+    }
+
+    size_t jointCount() const { return m_dh.size(); }
+
+    double distance(const double* q) const {
+        std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d> > frames(1, m_worldBase);
+        for (size_t i = 0; i < m_dh.size(); i++) {
+            frames.push_back(frames.back() *
+                             Eigen::AngleAxisd(m_dh[i][3] + q[i], Eigen::Vector3d::UnitZ()) *
+                             Eigen::Translation3d(m_dh[i][0], 0, m_dh[i][2]) *
+                             Eigen::AngleAxisd(m_dh[i][1], Eigen::Vector3d::UnitX()));
+        }
+        std::vector<Eigen::Vector3d> start, end;
+        for (auto& capsule : m_capsules) {
+            start.push_back(frames[capsule.frame] * capsule.start);
+            end.push_back(frames[capsule.frame] * capsule.end);
+        }
+
+        double best = std::numeric_limits<double>::max();
+        for (size_t i = 0; i < m_capsules.size(); i++) {
+            for (size_t j = i + 1; j < m_capsules.size(); j++) {
+                if (std::abs(m_capsules[j].link - m_capsules[i].link) < m_selfCollisionGap)
+                    continue;
+                double dist = minimizeConvex([&](double s) {
+                    return pointSegmentDistance(start[i] + (end[i] - start[i]) * s, start[j], end[j]);
+                });
+                best = std::min(best, dist - m_capsules[i].radius - m_capsules[j].radius);
+            }
+
+            if (std::find(m_ignoreLinks.begin(), m_ignoreLinks.end(), m_capsules[i].dhLink) != m_ignoreLinks.end())
+                continue;
+            for (auto& box : m_boxes) {
+                Eigen::Vector3d localStart = box.rotation.transpose() * (start[i] - box.center);
+                Eigen::Vector3d localEnd = box.rotation.transpose() * (end[i] - box.center);
+                double dist = minimizeConvex([&](double s) {
+                    Eigen::Vector3d d = (localStart + (localEnd - localStart) * s).cwiseAbs() - box.halfSize;
+                    return d.cwiseMax(0.0).norm() + std::min(d.maxCoeff(), 0.0);
+                });
+                best = std::min(best, dist - m_capsules[i].radius);
+            }
+            for (auto& plane : m_planes) {
+                double dist = std::min(plane.first.dot(start[i]), plane.first.dot(end[i])) - plane.second;
+                best = std::min(best, dist - m_capsules[i].radius);
+            }
+        }
+        return best;
+    }
+
+protected:
+    static Eigen::Isometry3d readFrame(const QJsonObject& obj) {
+        std::vector<double> xyz = readRealArray(obj["xyz"]);
+        std::vector<double> rpy = readRealArray(obj["rpy"]);
+        xyz.resize(3, 0);
+        rpy.resize(3, 0);
+        Eigen::Isometry3d frame = Eigen::Isometry3d::Identity();
+        frame.translate(Eigen::Vector3d(xyz[0], xyz[1], xyz[2]));
+        frame.rotate(Eigen::AngleAxisd(rpy[2], Eigen::Vector3d::UnitZ()));
+        frame.rotate(Eigen::AngleAxisd(rpy[1], Eigen::Vector3d::UnitY()));
+        frame.rotate(Eigen::AngleAxisd(rpy[0], Eigen::Vector3d::UnitX()));
+        return frame;
+    }
+
+protected:
+    std::vector<std::vector<double> > m_dh; // a, alpha, d, theta
+    Eigen::Isometry3d m_worldBase;
+    std::vector<Capsule> m_capsules;
+    std::vector<int> m_ignoreLinks;
+    int m_selfCollisionGap;
+    std::vector<Box> m_boxes;
+    std::vector<std::pair<Eigen::Vector3d, double> > m_planes;
+};
+
+double percentile(const std::vector<double>& sorted, double ratio) {
+    if (sorted.empty())
+        return 0;
+    size_t index = (size_t) std::ceil(ratio * sorted.size());
+    return sorted[std::min(sorted.size(), std::max<size_t>(index, 1)) - 1];
+}
+
+double g_sink = 0;
+}
+
+int main(int argc, char** argv) {
+    cobotsys::init_library(argc, argv);
+
+    size_t count = argc > 1 ? (size_t) std::max(1, atoi(argv[1])) : 20000;
+    std::string configPath = argc > 2 ? argv[2] : "CONFIG/CollisionConfig/ur10_cell.json";
+
+    CapsuleCollisionChecker checker;
+    ReferenceModel reference;
+    if (!checker.setup(configPath) || !reference.load(configPath)) {
+        COBOT_LOG.error("CollisionBench") << "Fail to load " << configPath;
+        return 1;
+    }
+    size_t jointNum = checker.jointCount();
+    if (jointNum != reference.jointCount()) {
+        COBOT_LOG.error("CollisionBench") << "Joint count mismatch: " << jointNum << " vs " << reference.jointCount();
+        return 1;
+    }
+
+    // 随机关节角，另外用一条连续的关节轨迹测 firstCollision
+    std::mt19937 generator(20170418);
+    std::uniform_real_distribution<double> angle(-PI, PI);
+    std::vector<double> joints(count * jointNum);
+    for (auto& q : joints)
+        q = angle(generator);
+
+    // 正确性
+    size_t mismatch = 0, colliding = 0;
+    double maxError = 0;
+    for (size_t k = 0; k < count; k++) {
+        double expected = reference.distance(&joints[k * jointNum]);
+        CapsuleCollisionChecker::DistanceResult result;
+        double actual = checker.distance(&joints[k * jointNum], &result);
+        double error = std::fabs(actual - expected);
+        maxError = std::max(maxError, error);
+        if (error > LENGTH_TOLERANCE || result.distance != actual)
+            mismatch++;
+        if (actual < 0)
+            colliding++;
+    }
+
+    std::vector<double> distances(count);
+    checker.distanceBatch(joints.data(), count, distances.data());
+    size_t batchMismatch = 0;
+    std::vector<std::vector<double> > trajectory;
+    int expectedFirst = -1;
+    for (size_t k = 0; k < count; k++) {
+        if (distances[k] != checker.distance(&joints[k * jointNum]))
+            batchMismatch++;
+        trajectory.push_back(std::vector<double>(&joints[k * jointNum], &joints[(k + 1) * jointNum]));
+        if (expectedFirst < 0 && distances[k] < 0.05)
+            expectedFirst = (int) k;
+    }
+    int first = checker.firstCollision(trajectory, 0.05);
+
+    // 单次调用耗时
+    std::vector<double> latency(count);
+    for (size_t k = 0; k < count; k++) {
+        auto start = BenchClock::now();
+        g_sink += checker.distance(&joints[k * jointNum]);
+        latency[k] = std::chrono::duration<double, std::nano>(BenchClock::now() - start).count();
+    }
+    std::sort(latency.begin(), latency.end());
+    double sum = 0;
+    for (auto value : latency)
+        sum += value;
+
+    auto start = BenchClock::now();
+    checker.distanceBatch(joints.data(), count, distances.data());
+    double batchNs = std::chrono::duration<double, std::nano>(BenchClock::now() - start).count() / count;
+    for (auto value : distances)
+        g_sink += value;
+
+    std::cout << configPath << ": " << checker.capsuleCount() << " capsules, " << checker.obstacleCount()
+              << " obstacles, " << count << " samples, " << colliding << " colliding" << std::endl;
+    std::cout << std::fixed << std::setprecision(0)
+              << "distance(ns)  mean " << sum / count << ", p50 " << percentile(latency, 0.5)
+              << ", p99 " << percentile(latency, 0.99) << ", max " << percentile(latency, 1.0) << std::endl
+              << "distanceBatch " << batchNs << " ns/sample, " << std::setprecision(4)
+              << batchNs / SERVO_PERIOD_NS * 100 << " % of 8 ms period" << std::endl;
+    std::cout << std::scientific << std::setprecision(2)
+              << "max error " << maxError << ", mismatch: " << mismatch << ", batch mismatch: " << batchMismatch
+              << ", firstCollision: " << first << " (expected " << expectedFirst << ")" << std::endl;
+    return (mismatch == 0 && batchMismatch == 0 && first == expectedFirst) ? 0 : 1;
+}
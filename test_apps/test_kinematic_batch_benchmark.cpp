@@ -0,0 +1,217 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+/**
+ * KinematicSolver 批量接口吞吐量测试。
+ *
+ * 沿一条随机游走的关节路径生成位姿，分别用 std::vector 单次接口、Joint6d/Isometry3d 单次接口、
+ * 批量接口做正解和逆解，输出每秒处理的位姿数，以及逆解结果再正解后的位置误差。
+ * 最后把位姿分给多个线程，每个线程用 createThreadContext() 的上下文做批量逆解，看吞吐量随线程数的变化。
+ *
+ * 用法: test_kinematic_batch_benchmark [求解器配置文件] [位姿个数]
+ */
+
+#include <cobotsys.h>
+#include <extra2.h>
+#include <cobotsys_global_object_factory.h>
+#include <cobotsys_file_finder.h>
+#include <cobotsys_abstract_kinematic_solver.h>
+#include <QApplication>
+#include <Eigen/StdVector>
+#include <chrono>
+#include <random>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+using namespace cobotsys;
+typedef std::chrono::high_resolution_clock BenchClock;
+typedef AbstractKinematicSolver::Joint6d Joint6d;
+typedef std::vector<Joint6d, Eigen::aligned_allocator<Joint6d> > JointList;
+typedef std::vector<Eigen::Isometry3d, Eigen::aligned_allocator<Eigen::Isometry3d> > PoseList;
+
+namespace {
+
+double elapsedSeconds(const BenchClock::time_point& start) {
+    return std::chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+void printRow(const std::string& name, size_t count, int failCount, double seconds, double maxError) {
+    std::cout << std::left << std::setw(28) << name
+              << std::right << std::setw(8) << count
+              << std::setw(6) << failCount
+              << std::setw(12) << std::fixed << std::setprecision(2) << seconds * 1e6 / count
+              << std::setw(12) << std::setprecision(0) << count / seconds
+              << std::setw(12) << std::scientific << std::setprecision(1) << maxError
+              << std::defaultfloat << std::endl;
+}
+
+/**
+ * 逆解结果再正解，与目标的最大位置误差(米)
+ */
+double maxPositionError(AbstractKinematicSolver& solver, const JointList& joints, const PoseList& poses,
+                        const std::vector<int>& results) {
+    double maxError = 0;
+    Eigen::Isometry3d pose;
+    for (size_t i = 0; i < joints.size(); i++) {
+        if (results[i] != 0)
+            continue;
+        solver.jntToCart(joints[i], pose);
+        maxError = std::max(maxError, (pose.translation() - poses[i].translation()).norm());
+    }
+    return maxError;
+}
+
+std::vector<double> toStdVector(const Joint6d& q) {
+    return std::vector<double>(q.data(), q.data() + q.size());
+}
+
+std::vector<double> poseToStdVector(const Eigen::Isometry3d& pose) {
+    Eigen::Vector3d ypr = pose.rotation().eulerAngles(2, 1, 0);
+    return {pose.translation().x(), pose.translation().y(), pose.translation().z(), ypr[2], ypr[1], ypr[0]};
+}
+}
+
+int main(int argc, char** argv) {
+    QApplication a(argc, argv);
+    cobotsys::init_library(argc, argv);
+
+    GlobalObjectFactory globalObjectFactory;
+    globalObjectFactory.loadLibrarys();
+
+    QString solverConfig = argc > 1 ? argv[1] : "CONFIG/UrRobotConfig/ur10_180_config.json";
+    size_t count = argc > 2 ? (size_t) std::max(1, atoi(argv[2])) : 20000;
+
+    auto solver = std::dynamic_pointer_cast<AbstractKinematicSolver>(
+            GlobalObjectFactory::instance()->createObject("KinematicSolverFactory, Ver 1.0", "KinematicSolver"));
+    if (!solver || !solver->setup(FileFinder::find(solverConfig.toStdString()).c_str())) {
+        COBOT_LOG.error("Bench") << "Fail to create KinematicSolver with " << solverConfig;
+        return 1;
+    }
+
+    // 关节空间随机游走，相邻位姿接近，模拟一条连续路径
+    std::mt19937 generator(20170418);
+    std::uniform_real_distribution<double> start(-M_PI, M_PI);
+    std::uniform_real_distribution<double> step(-0.01, 0.01);
+    JointList pathJoints(count);
+    Joint6d q;
+    for (int j = 0; j < q.size(); j++)
+        q[j] = start(generator);
+    for (size_t i = 0; i < count; i++) {
+        for (int j = 0; j < q.size(); j++)
+            q[j] += step(generator);
+        pathJoints[i] = q;
+    }
+    const Joint6d& seed = pathJoints.front();
+
+    std::cout << std::left << std::setw(28) << "case"
+              << std::right << std::setw(8) << "count" << std::setw(6) << "fail"
+              << std::setw(12) << "us/pose" << std::setw(12) << "pose/s" << std::setw(12) << "posErr(m)" << std::endl;
+
+    // 正解
+    PoseList poses(count);
+    std::vector<std::vector<double> > stdJoints(count), stdPoses(count);
+    for (size_t i = 0; i < count; i++)
+        stdJoints[i] = toStdVector(pathJoints[i]);
+
+    auto t0 = BenchClock::now();
+    int failCount = 0;
+    for (size_t i = 0; i < count; i++)
+        failCount += solver->jntToCart(stdJoints[i], stdPoses[i]) != 0;
+    printRow("FK std::vector", count, failCount, elapsedSeconds(t0), 0);
+
+    t0 = BenchClock::now();
+    failCount = 0;
+    for (size_t i = 0; i < count; i++)
+        failCount += solver->jntToCart(pathJoints[i], poses[i]) != 0;
+    printRow("FK Joint6d", count, failCount, elapsedSeconds(t0), 0);
+
+    t0 = BenchClock::now();
+    failCount = solver->jntToCartBatch(pathJoints.data(), count, poses.data());
+    printRow("FK batch", count, failCount, elapsedSeconds(t0), 0);
+
+    // 逆解，路径上用上一个结果作初值
+    JointList solved(count);
+    std::vector<int> results(count);
+    std::vector<double> stdSolved;
+    for (size_t i = 0; i < count; i++)
+        stdPoses[i] = poseToStdVector(poses[i]);
+
+    t0 = BenchClock::now();
+    failCount = 0;
+    std::vector<double> stdSeed = toStdVector(seed);
+    for (size_t i = 0; i < count; i++) {
+        results[i] = solver->cartToJnt(stdSeed, stdPoses[i], stdSolved);
+        if (results[i] == 0) {
+            stdSeed = stdSolved;
+            solved[i] = Eigen::Map<const Joint6d>(stdSolved.data());
+        } else {
+            failCount++;
+        }
+    }
+    printRow("IK std::vector (path)", count, failCount, elapsedSeconds(t0),
+             maxPositionError(*solver, solved, poses, results));
+
+    t0 = BenchClock::now();
+    failCount = 0;
+    Joint6d pathSeed = seed;
+    for (size_t i = 0; i < count; i++) {
+        results[i] = solver->cartToJnt(pathSeed, poses[i], solved[i]);
+        if (results[i] == 0)
+            pathSeed = solved[i];
+        else
+            failCount++;
+    }
+    printRow("IK Joint6d (path)", count, failCount, elapsedSeconds(t0),
+             maxPositionError(*solver, solved, poses, results));
+
+    t0 = BenchClock::now();
+    failCount = solver->cartToJntBatch(seed, poses.data(), count, solved.data(), results.data(), true);
+    printRow("IK batch (path)", count, failCount, elapsedSeconds(t0),
+             maxPositionError(*solver, solved, poses, results));
+
+    // 逆解，所有位姿用同一个初值，比如给一组抓取候选位姿排序
+    t0 = BenchClock::now();
+    failCount = solver->cartToJntBatch(seed, poses.data(), count, solved.data(), results.data(), false);
+    printRow("IK batch (fixed seed)", count, failCount, elapsedSeconds(t0),
+             maxPositionError(*solver, solved, poses, results));
+
+    // 多线程，每个线程一个上下文，各自处理连续的一段位姿
+    size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threadNum = 1; threadNum <= maxThreads; threadNum *= 2) {
+        std::vector<std::shared_ptr<AbstractKinematicSolver> > contexts(threadNum);
+        for (auto& context : contexts) {
+            context = solver->createThreadContext();
+            if (!context) {
+                COBOT_LOG.error("Bench") << "KinematicSolver does not support thread context";
+                return 1;
+            }
+        }
+
+        std::vector<int> threadFails(threadNum, 0);
+        std::vector<std::thread> threads;
+        size_t chunk = (count + threadNum - 1) / threadNum;
+        t0 = BenchClock::now();
+        for (size_t k = 0; k < threadNum; k++) {
+            size_t begin = std::min(count, k * chunk);
+            size_t end = std::min(count, begin + chunk);
+            threads.emplace_back([&, k, begin, end]() {
+                if (begin < end) {
+                    threadFails[k] = contexts[k]->cartToJntBatch(pathJoints[begin], poses.data() + begin, end - begin,
+                                                                 solved.data() + begin, results.data() + begin, true);
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        double seconds = elapsedSeconds(t0);
+
+        failCount = 0;
+        for (auto fail : threadFails)
+            failCount += fail;
+        printRow("IK batch " + std::to_string(threadNum) + " thread(s)", count, failCount, seconds,
+                 maxPositionError(*solver, solved, poses, results));
+    }
+    return 0;
+}
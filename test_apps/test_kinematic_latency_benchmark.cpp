@@ -0,0 +1,231 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+/**
+ * KinematicSolver 单次调用延迟测试。
+ *
+ * 依次用 UR3/UR5/UR10 的求解器配置，在关节限位内随机采样，逐次计时：
+ * 正解、近初值逆解(初值在真值附近)、远初值逆解(初值随机)、雅可比矩阵、vector_WorldToEE、pose_EEToWorld。
+ * 输出每种调用延迟的平均值和 p50/p90/p99/最大值，逆解另外输出失败率
+ * (返回错误码，或者结果再正解与目标的位置误差超过 0.1 毫米、姿态误差超过 1e-3 弧度)。
+ * 与 test_kinematic_batch_benchmark 看吞吐量不同，这里看的是单次调用的分布，用来比较求解器改动前后的差别。
+ *
+ * 用法: test_kinematic_latency_benchmark [采样个数] [求解器配置文件 ...]
+ */
+
+#include <cobotsys.h>
+#include <extra2.h>
+#include <cobotsys_global_object_factory.h>
+#include <cobotsys_file_finder.h>
+#include <cobotsys_abstract_kinematic_solver.h>
+#include <QApplication>
+#include <QJsonArray>
+#include <Eigen/StdVector>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <iomanip>
+#include <iostream>
+
+using namespace cobotsys;
+typedef std::chrono::steady_clock BenchClock;
+
+namespace {
+const double IK_POSITION_TOLERANCE = 1e-4;
+const double IK_ORIENTATION_TOLERANCE = 1e-3; // 弧度
+const double NEAR_SEED_OFFSET = 0.05;
+
+/**
+ * 记录每次调用的耗时(纳秒)，最后排序求分位数
+ */
+class LatencyRecorder {
+public:
+    explicit LatencyRecorder(size_t count) : m_failCount(0) { m_samples.reserve(count); }
+
+    void start() { m_start = BenchClock::now(); }
+
+    void stop(bool success = true) {
+        m_samples.push_back(std::chrono::duration<double, std::nano>(BenchClock::now() - m_start).count());
+        if (!success)
+            m_failCount++;
+    }
+
+    /**
+     * 计时之后才能判断失败的情况，比如逆解结果的校验
+     */
+    void markFailed() { m_failCount++; }
+
+    void print(const std::string& name, bool showFailRate) {
+        std::sort(m_samples.begin(), m_samples.end());
+        double sum = 0;
+        for (auto value : m_samples)
+            sum += value;
+        std::cout << std::left << std::setw(20) << name << std::right << std::fixed << std::setprecision(0)
+                  << std::setw(10) << (m_samples.empty() ? 0 : sum / m_samples.size())
+                  << std::setw(10) << percentile(0.5)
+                  << std::setw(10) << percentile(0.9)
+                  << std::setw(10) << percentile(0.99)
+                  << std::setw(10) << percentile(1.0);
+        if (showFailRate)
+            std::cout << std::setw(10) << std::setprecision(2) << 100.0 * m_failCount / m_samples.size() << "%";
+        std::cout << std::defaultfloat << std::endl;
+    }
+
+protected:
+    double percentile(double ratio) const {
+        if (m_samples.empty())
+            return 0;
+        size_t index = (size_t) std::ceil(ratio * m_samples.size());
+        return m_samples[std::min(m_samples.size(), std::max<size_t>(index, 1)) - 1];
+    }
+
+protected:
+    std::vector<double> m_samples;
+    size_t m_failCount;
+    BenchClock::time_point m_start;
+};
+
+bool loadJointLimits(const std::string& configPath, std::vector<double>& lower, std::vector<double>& upper) {
+    QJsonObject json;
+    if (!loadJson(json, configPath))
+        return false;
+    lower.clear();
+    upper.clear();
+    foreach (const QJsonValue& value, json["param"].toArray()) {
+        QJsonObject limits = value.toObject()["limits"].toObject();
+        // 采样范围限制在一圈以内，超出的部分只是重复的位姿
+        lower.push_back(std::max(-M_PI, limits["lower"].toDouble(-M_PI)));
+        upper.push_back(std::min(M_PI, limits["upper"].toDouble(M_PI)));
+    }
+    return !lower.empty();
+}
+
+bool ikSucceeded(AbstractKinematicSolver& solver, int result, const Eigen::VectorXd& solution,
+                 const Eigen::Affine3d& target) {
+    Eigen::Affine3d pose;
+    if (result != 0 || solver.jntToCart(solution, pose) != 0)
+        return false;
+    if ((pose.translation() - target.translation()).norm() >= IK_POSITION_TOLERANCE)
+        return false;
+    // 只比较位置时，末端位置对但姿态翻转的解也会算作成功
+    Eigen::AngleAxisd error(pose.linear().transpose() * target.linear());
+    return std::fabs(error.angle()) < IK_ORIENTATION_TOLERANCE;
+}
+
+bool runConfig(const std::string& solverConfig, size_t count) {
+    std::string configPath = FileFinder::find(solverConfig);
+    auto solver = std::dynamic_pointer_cast<AbstractKinematicSolver>(
+            GlobalObjectFactory::instance()->createObject("KinematicSolverFactory, Ver 1.0", "KinematicSolver"));
+    std::vector<double> lower, upper;
+    if (!solver || !solver->setup(configPath.c_str()) || !loadJointLimits(configPath, lower, upper)) {
+        COBOT_LOG.error("Bench") << "Fail to create KinematicSolver with " << solverConfig;
+        return false;
+    }
+
+    // 采样关节角，正解得到目标位姿
+    size_t jointNum = lower.size();
+    std::mt19937 generator(20170418);
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::uniform_real_distribution<double> offset(-NEAR_SEED_OFFSET, NEAR_SEED_OFFSET);
+    std::vector<Eigen::VectorXd> joints(count, Eigen::VectorXd(jointNum));
+    std::vector<Eigen::VectorXd> nearSeeds(count, Eigen::VectorXd(jointNum));
+    std::vector<Eigen::VectorXd> farSeeds(count, Eigen::VectorXd(jointNum));
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < jointNum; j++) {
+            joints[i][j] = lower[j] + (upper[j] - lower[j]) * unit(generator);
+            nearSeeds[i][j] = std::max(lower[j], std::min(upper[j], joints[i][j] + offset(generator)));
+            farSeeds[i][j] = lower[j] + (upper[j] - lower[j]) * unit(generator);
+        }
+    }
+
+    std::cout << std::endl << solverConfig << ", " << count << " samples" << std::endl;
+    std::cout << std::left << std::setw(20) << "case(ns)" << std::right
+              << std::setw(10) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p90"
+              << std::setw(10) << "p99" << std::setw(10) << "max" << std::setw(11) << "fail" << std::endl;
+
+    std::vector<Eigen::Affine3d, Eigen::aligned_allocator<Eigen::Affine3d> > poses(count);
+    LatencyRecorder fk(count);
+    for (size_t i = 0; i < count; i++) {
+        fk.start();
+        int result = solver->jntToCart(joints[i], poses[i]);
+        fk.stop(result == 0);
+    }
+    fk.print("FK", false);
+
+    Eigen::VectorXd solution;
+    LatencyRecorder ikNear(count);
+    for (size_t i = 0; i < count; i++) {
+        ikNear.start();
+        int result = solver->cartToJnt(nearSeeds[i], poses[i], solution);
+        ikNear.stop();
+        if (!ikSucceeded(*solver, result, solution, poses[i]))
+            ikNear.markFailed();
+    }
+    ikNear.print("IK near seed", true);
+
+    LatencyRecorder ikFar(count);
+    for (size_t i = 0; i < count; i++) {
+        ikFar.start();
+        int result = solver->cartToJnt(farSeeds[i], poses[i], solution);
+        ikFar.stop();
+        if (!ikSucceeded(*solver, result, solution, poses[i]))
+            ikFar.markFailed();
+    }
+    ikFar.print("IK far seed", true);
+
+    Eigen::MatrixXd jac;
+    LatencyRecorder jacobian(count);
+    for (size_t i = 0; i < count; i++) {
+        jacobian.start();
+        int result = solver->jacobian(joints[i], jac);
+        jacobian.stop(result == 0);
+    }
+    jacobian.print("Jacobian", false);
+
+    Eigen::Vector3d vectorWorld(0, 0, -1), vectorEE;
+    LatencyRecorder worldToEE(count);
+    for (size_t i = 0; i < count; i++) {
+        worldToEE.start();
+        int result = solver->vector_WorldToEE(joints[i], vectorWorld, vectorEE);
+        worldToEE.stop(result == 0);
+    }
+    worldToEE.print("vector_WorldToEE", false);
+
+    std::vector<double> poseEE = {0, 0, 0.1, 0, 0, M_PI / 2}, poseWorld;
+    LatencyRecorder eeToWorld(count);
+    for (size_t i = 0; i < count; i++) {
+        eeToWorld.start();
+        int result = solver->pose_EEToWorld(joints[i], poseEE, poseWorld);
+        eeToWorld.stop(result == 0);
+    }
+    eeToWorld.print("pose_EEToWorld", false);
+    return true;
+}
+}
+
+int main(int argc, char** argv) {
+    QApplication a(argc, argv);
+    cobotsys::init_library(argc, argv);
+
+    GlobalObjectFactory globalObjectFactory;
+    globalObjectFactory.loadLibrarys();
+
+    size_t count = argc > 1 ? (size_t) std::max(1, atoi(argv[1])) : 20000;
+    std::vector<std::string> configs;
+    for (int i = 2; i < argc; i++)
+        configs.push_back(argv[i]);
+    if (configs.empty()) {
+        configs = {"CONFIG/UrRobotConfig/ur3_config.json",
+                   "CONFIG/UrRobotConfig/ur5_config.json",
+                   "CONFIG/UrRobotConfig/ur10_config.json"};
+    }
+
+    int failConfigs = 0;
+    for (auto& config : configs) {
+        if (!runConfig(config, count))
+            failConfigs++;
+    }
+    return failConfigs == 0 ? 0 : 1;
+}
@@ -0,0 +1,475 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+/**
+ * UrMover 规划器基准测试。
+ *
+ * 用固定的路点集(CONFIG/benchmark/planner_waypoints.json)依次驱动各个 Mover，
+ * 机器人用一个简单的伺服模型代替(每个周期执行上一次的关节指令，一阶惯性跟随)。
+ * 输出每段的规划耗时、总运动时间、关节速度/加速度/加加速度峰值和跟踪误差。
+ *
+ * 用法: test_planner_benchmark [路点配置文件]
+ */
+
+#include <cobotsys.h>
+#include <extra2.h>
+#include <cobotsys_global_object_factory.h>
+#include <cobotsys_file_finder.h>
+#include <cobotsys_abstract_arm_robot_move_driver.h>
+#include <cobotsys_abstract_arm_robot_realtime_driver.h>
+#include <cobotsys_abstract_kinematic_solver.h>
+#include <QApplication>
+#include <QJsonArray>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <iomanip>
+#include <iostream>
+
+using namespace cobotsys;
+typedef std::chrono::high_resolution_clock BenchClock;
+
+namespace {
+
+struct ServoSample {
+    BenchClock::time_point time;
+    std::vector<double> command;
+    std::vector<double> actual;
+    double latency; ///< 状态发布到收到指令的时间(毫秒)，没有新指令时为负数
+};
+
+/**
+ * 仿真机器人：每个伺服周期把最近一次的指令经过一阶惯性环节作用到关节上，然后发布状态。
+ */
+class SimServoDriver : public AbstractArmRobotRealTimeDriver {
+public:
+    SimServoDriver(const std::vector<double>& startJoint, double period, double timeConstant)
+            : m_actual(startJoint), m_command(startJoint), m_period(period), m_exitLoop(false), m_started(false) {
+        m_alpha = 1 - std::exp(-period / timeConstant);
+        m_hasNewCommand = false;
+        m_latency = -1;
+    }
+
+    virtual ~SimServoDriver() { stop(); }
+
+    virtual bool setup(const QString& configFilePath) { return true; }
+
+    virtual void move(const std::vector<double>& q) {
+        std::lock_guard<std::mutex> lockGuard(m_mutex);
+        if (q.size() != m_command.size())
+            return;
+        m_command = q;
+        if (!m_hasNewCommand) {
+            std::chrono::duration<double, std::milli> latency = BenchClock::now() - m_lastPublish;
+            m_latency = latency.count();
+            m_hasNewCommand = true;
+        }
+    }
+
+    virtual std::shared_ptr<AbstractDigitIoDriver> getDigitIoDriver(int deviceId) { return nullptr; }
+
+    virtual void attach(const std::shared_ptr<ArmRobotRealTimeStatusObserver>& observer) {
+        std::lock_guard<std::mutex> lockGuard(m_mutex);
+        m_observers.push_back(observer);
+    }
+
+    virtual bool start() {
+        m_exitLoop = false;
+        m_started = true;
+        m_thread = std::thread(&SimServoDriver::servoProcess, this);
+        return true;
+    }
+
+    virtual bool isStarted() const { return m_started; }
+
+    virtual void stop() {
+        m_exitLoop = true;
+        if (m_thread.joinable())
+            m_thread.join();
+        m_started = false;
+    }
+
+    virtual QString getRobotUrl() { return "sim"; }
+
+    virtual std::vector<double> getRobotJointQ() {
+        std::lock_guard<std::mutex> lockGuard(m_mutex);
+        return m_actual;
+    }
+
+    virtual void clearAttachedObject() {
+        std::lock_guard<std::mutex> lockGuard(m_mutex);
+        m_observers.clear();
+    }
+
+    void startRecord() {
+        std::lock_guard<std::mutex> lockGuard(m_mutex);
+        m_samples.clear();
+        m_record = true;
+    }
+
+    std::vector<ServoSample> stopRecord() {
+        std::lock_guard<std::mutex> lockGuard(m_mutex);
+        m_record = false;
+        return m_samples;
+    }
+
+protected:
+    void servoProcess() {
+        auto timePoint = BenchClock::now();
+        auto period = std::chrono::duration_cast<BenchClock::duration>(std::chrono::duration<double>(m_period));
+        while (!m_exitLoop) {
+            timePoint += period;
+            std::this_thread::sleep_until(timePoint);
+
+            auto status = std::make_shared<ArmRobotStatus>();
+            std::vector<std::shared_ptr<ArmRobotRealTimeStatusObserver> > observers;
+            m_mutex.lock();
+            if (m_record)
+                m_samples.push_back({timePoint, m_command, m_actual, m_hasNewCommand ? m_latency : -1});
+            std::vector<double> qd(m_actual.size());
+            for (size_t i = 0; i < m_actual.size(); i++) {
+                double q = m_actual[i] + (m_command[i] - m_actual[i]) * m_alpha;
+                qd[i] = (q - m_actual[i]) / m_period;
+                m_actual[i] = q;
+            }
+            status->q_actual = m_actual;
+            status->qd_actual = qd;
+            status->q_target = m_command;
+            m_hasNewCommand = false;
+            m_lastPublish = BenchClock::now();
+            observers = m_observers;
+            m_mutex.unlock();
+
+            for (auto& ob : observers) {
+                if (ob) ob->onArmRobotStatusUpdate(status);
+            }
+        }
+    }
+
+protected:
+    std::mutex m_mutex;
+    std::vector<std::shared_ptr<ArmRobotRealTimeStatusObserver> > m_observers;
+    std::vector<double> m_actual;
+    std::vector<double> m_command;
+    double m_period;
+    double m_alpha;
+    bool m_exitLoop;
+    bool m_started;
+    bool m_hasNewCommand;
+    bool m_record = false;
+    double m_latency;
+    BenchClock::time_point m_lastPublish;
+    std::vector<ServoSample> m_samples;
+    std::thread m_thread;
+};
+
+/**
+ * 记录每个 moveId 的完成时间和结果。
+ */
+class MoveRecorder : public ArmRobotMoveStatusObserver {
+public:
+    virtual void onMoveFinish(uint32_t moveId, MoveResult moveResult) {
+        std::lock_guard<std::mutex> lockGuard(m_mutex);
+        if (m_finishTime.count(moveId))
+            return;
+        m_finishTime[moveId] = BenchClock::now();
+        m_result[moveId] = moveResult;
+        m_cond.notify_all();
+    }
+
+    bool waitAll(const std::vector<uint32_t>& moveIds, double timeout) {
+        std::unique_lock<std::mutex> uniqueLock(m_mutex);
+        return m_cond.wait_for(uniqueLock, std::chrono::duration<double>(timeout), [&] {
+            for (auto id : moveIds) {
+                if (m_finishTime.count(id) == 0)
+                    return false;
+            }
+            return true;
+        });
+    }
+
+    std::map<uint32_t, BenchClock::time_point> m_finishTime;
+    std::map<uint32_t, MoveResult> m_result;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+};
+
+struct WaypointSet {
+    std::string name;
+    std::vector<RobotWaypoint> waypoints;
+};
+
+enum MoveApi { MoveWaypoints, MoveEachPoint, MoveSync };
+
+struct MoverCase {
+    std::string name;
+    std::string type;
+    MoveApi api;
+    bool useBlend;
+};
+
+struct BenchResult {
+    bool finished = false;
+    int failed = 0;
+    double duration = 0;       ///< 秒
+    double firstCommand = 0;   ///< move() 调用到第一个指令的时间(毫秒)
+    std::vector<double> segmentPlanTime; ///< 每段内单步最长耗时(毫秒)
+    double peakVel = 0;
+    double peakAcc = 0;
+    double peakJerk = 0;
+    double maxTrackError = 0;  ///< 弧度
+    double rmsTrackError = 0;
+};
+
+bool loadBenchConfig(const QString& path, std::vector<double>& startJoint, double& period, double& timeConstant,
+                     QString& solverConfig, std::vector<WaypointSet>& sets) {
+    QJsonObject json;
+    if (!loadJson(json, path))
+        return false;
+
+    startJoint = readRealArray(json["StartJoint"]);
+    for (auto& q : startJoint) q *= M_PI / 180;
+    period = json["ServoModel"].toObject()["Period"].toDouble(0.008);
+    timeConstant = json["ServoModel"].toObject()["TimeConstant"].toDouble(0.02);
+    solverConfig = json["Solver"].toString();
+
+    for (const auto& jset : json["Sets"].toArray()) {
+        WaypointSet set;
+        set.name = jset.toObject()["Name"].toString().toStdString();
+        for (const auto& jwp : jset.toObject()["Waypoints"].toArray()) {
+            auto values = readRealArray(jwp);
+            if (values.size() < 6) {
+                COBOT_LOG.warning("Bench") << "Invalid waypoint in " << set.name;
+                continue;
+            }
+            for (int i = 3; i < 6; i++) values[i] *= M_PI / 180;
+            auto wp = RobotWaypoint::fromArray(values);
+            wp.blendRadius = values.size() > 6 ? values[6] : 0;
+            set.waypoints.push_back(wp);
+        }
+        sets.push_back(set);
+    }
+    return startJoint.size() == 6 && sets.size();
+}
+
+std::shared_ptr<AbstractKinematicSolver> createSolver(const QString& solverConfig) {
+    auto solver = std::dynamic_pointer_cast<AbstractKinematicSolver>(
+            GlobalObjectFactory::instance()->createObject("KinematicSolverFactory, Ver 1.0", "KinematicSolver"));
+    if (solver && solver->setup(FileFinder::find(solverConfig.toStdString()).c_str()))
+        return solver;
+    return nullptr;
+}
+
+void computeMotionStats(const std::vector<ServoSample>& samples, double period, BenchResult& result) {
+    double sumErr2 = 0;
+    size_t errCount = 0;
+    std::vector<double> v1, v2, a1;
+    for (size_t k = 0; k < samples.size(); k++) {
+        auto& cmd = samples[k].command;
+        double err = 0;
+        for (size_t i = 0; i < cmd.size(); i++)
+            err = std::max(err, std::fabs(cmd[i] - samples[k].actual[i]));
+        result.maxTrackError = std::max(result.maxTrackError, err);
+        sumErr2 += err * err;
+        errCount++;
+
+        if (k == 0) continue;
+        std::vector<double> vel(cmd.size());
+        for (size_t i = 0; i < cmd.size(); i++) {
+            vel[i] = (cmd[i] - samples[k - 1].command[i]) / period;
+            result.peakVel = std::max(result.peakVel, std::fabs(vel[i]));
+        }
+        if (v1.size()) {
+            std::vector<double> acc(cmd.size());
+            for (size_t i = 0; i < cmd.size(); i++) {
+                acc[i] = (vel[i] - v1[i]) / period;
+                result.peakAcc = std::max(result.peakAcc, std::fabs(acc[i]));
+                if (a1.size())
+                    result.peakJerk = std::max(result.peakJerk, std::fabs(acc[i] - a1[i]) / period);
+            }
+            a1 = acc;
+        }
+        v1 = vel;
+    }
+    if (errCount)
+        result.rmsTrackError = std::sqrt(sumErr2 / errCount);
+}
+
+BenchResult runCase(const MoverCase& moverCase, const WaypointSet& set, const std::vector<double>& startJoint,
+                    double period, double timeConstant, const QString& solverConfig) {
+    BenchResult result;
+
+    auto driver = std::make_shared<SimServoDriver>(startJoint, period, timeConstant);
+    auto recorder = std::make_shared<MoveRecorder>();
+    auto solver = createSolver(solverConfig);
+    auto mover = std::dynamic_pointer_cast<AbstractArmRobotMoveDriver>(
+            GlobalObjectFactory::instance()->createObject("UrMoverFactory, Ver 1.0",
+                                                           moverCase.api == MoveSync ? "InterCubicMover"
+                                                                                     : moverCase.type.c_str()));
+    std::shared_ptr<AbstractSyncMover> syncMover;
+    if (moverCase.api == MoveSync) {
+        syncMover = std::dynamic_pointer_cast<AbstractSyncMover>(
+                GlobalObjectFactory::instance()->createObject("UrMoverFactory, Ver 1.0", moverCase.type.c_str()));
+    }
+    if (!solver || !mover || (moverCase.api == MoveSync && !syncMover)) {
+        COBOT_LOG.error("Bench") << "Fail to create " << moverCase.name;
+        return result;
+    }
+
+    driver->start();
+    mover->setRealTimeDriver(driver);
+    mover->setKinematicSolver(solver);
+    mover->attach(recorder);
+    if (syncMover) syncMover->setArmRobotMover(mover);
+    mover->start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::vector<RobotWaypoint> waypoints = set.waypoints;
+    std::vector<uint32_t> moveIds;
+    for (auto& wp : waypoints) {
+        wp.moveId = AbstractArmRobotMoveDriver::generateMoveId();
+        if (!moverCase.useBlend) wp.blendRadius = 0;
+        moveIds.push_back(wp.moveId);
+    }
+
+    driver->startRecord();
+    auto startTime = BenchClock::now();
+    switch (moverCase.api) {
+    case MoveWaypoints:
+        mover->move(waypoints);
+        break;
+    case MoveEachPoint:
+        for (auto& wp : waypoints)
+            mover->move(wp.moveId, wp.position, wp.rpy);
+        break;
+    case MoveSync:
+        // SyncMover 自己生成 moveId，这里按完成顺序统计
+        moveIds.clear();
+        syncMover->move(waypoints);
+        break;
+    }
+
+    if (moverCase.api == MoveSync) {
+        std::lock_guard<std::mutex> lockGuard(recorder->m_mutex);
+        for (auto& iter : recorder->m_finishTime)
+            moveIds.push_back(iter.first);
+        result.finished = moveIds.size() == waypoints.size();
+    } else {
+        result.finished = recorder->waitAll(moveIds, 120);
+    }
+    auto endTime = BenchClock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300)); // 等待跟踪误差收敛
+    auto samples = driver->stopRecord();
+
+    mover->clearAll();
+    if (syncMover) syncMover->clearAttachedObject();
+    mover->clearAttachedObject();
+    driver->stop();
+    driver->clearAttachedObject();
+
+    // 每段: 上一个路点完成到这个路点完成之间，单步处理的最长时间
+    std::lock_guard<std::mutex> lockGuard(recorder->m_mutex);
+    auto segStart = startTime;
+    for (auto id : moveIds) {
+        if (recorder->m_finishTime.count(id) == 0)
+            break;
+        if (recorder->m_result[id] != MoveResult::Success)
+            result.failed++;
+        auto segEnd = recorder->m_finishTime[id];
+        double planTime = 0;
+        for (auto& s : samples) {
+            if (s.time >= segStart && s.time <= segEnd && s.latency > planTime)
+                planTime = s.latency;
+        }
+        result.segmentPlanTime.push_back(planTime);
+        segStart = segEnd;
+        endTime = segEnd;
+    }
+    result.duration = std::chrono::duration<double>(endTime - startTime).count();
+
+    for (auto& s : samples) {
+        if (s.latency >= 0) {
+            result.firstCommand = std::chrono::duration<double, std::milli>(s.time - startTime).count();
+            break;
+        }
+    }
+
+    std::vector<ServoSample> motion;
+    for (auto& s : samples) {
+        if (s.time >= startTime) motion.push_back(s);
+    }
+    computeMotionStats(motion, period, result);
+    return result;
+}
+
+void printResult(const MoverCase& moverCase, const WaypointSet& set, const BenchResult& result) {
+    double maxPlan = 0, sumPlan = 0;
+    for (auto t : result.segmentPlanTime) {
+        maxPlan = std::max(maxPlan, t);
+        sumPlan += t;
+    }
+    auto meanPlan = result.segmentPlanTime.size() ? sumPlan / result.segmentPlanTime.size() : 0;
+
+    std::cout << std::left << std::setw(20) << moverCase.name << std::setw(18) << set.name
+              << std::right << std::fixed
+              << std::setw(6) << (result.finished ? "yes" : "NO")
+              << std::setw(5) << result.failed
+              << std::setprecision(3) << std::setw(9) << result.duration
+              << std::setprecision(2) << std::setw(9) << result.firstCommand
+              << std::setw(9) << meanPlan << std::setw(9) << maxPlan
+              << std::setw(9) << result.peakVel << std::setw(10) << result.peakAcc
+              << std::setprecision(0) << std::setw(11) << result.peakJerk
+              << std::setprecision(4) << std::setw(9) << result.maxTrackError
+              << std::setw(9) << result.rmsTrackError << std::endl;
+
+    std::cout << "    segment plan time(ms):";
+    std::cout << std::setprecision(2);
+    for (auto t : result.segmentPlanTime)
+        std::cout << " " << t;
+    std::cout << std::endl;
+}
+}
+
+int main(int argc, char** argv) {
+    QApplication a(argc, argv);
+    cobotsys::init_library(argc, argv);
+
+    GlobalObjectFactory globalObjectFactory;
+    globalObjectFactory.loadLibrarys();
+
+    QString configPath = argc > 1 ? argv[1] : "CONFIG/benchmark/planner_waypoints.json";
+    std::vector<double> startJoint;
+    std::vector<WaypointSet> sets;
+    double period, timeConstant;
+    QString solverConfig;
+    if (!loadBenchConfig(configPath, startJoint, period, timeConstant, solverConfig, sets)) {
+        COBOT_LOG.error("Bench") << "Fail to load " << configPath;
+        return 1;
+    }
+
+    std::vector<MoverCase> cases = {
+            {"UrMover", "UrMover", MoveWaypoints, false},      // GetSerialsJoint + STrajectoryPlaner3/DivisionTime
+            {"UrMover(blend)", "UrMover", MoveWaypoints, true}, // BlendPlanner
+            {"InterCubicMover", "InterCubicMover", MoveEachPoint, false},
+            {"SyncMover", "SyncMover", MoveSync, false},
+    };
+
+    std::cout << std::left << std::setw(20) << "mover" << std::setw(18) << "set"
+              << std::right << std::setw(6) << "done" << std::setw(5) << "fail"
+              << std::setw(9) << "time(s)" << std::setw(9) << "1st(ms)"
+              << std::setw(9) << "plan(ms)" << std::setw(9) << "max(ms)"
+              << std::setw(9) << "vel" << std::setw(10) << "acc" << std::setw(11) << "jerk"
+              << std::setw(9) << "track" << std::setw(9) << "rms" << std::endl;
+
+    for (auto& moverCase : cases) {
+        for (auto& set : sets) {
+            auto result = runCase(moverCase, set, startJoint, period, timeConstant, solverConfig);
+            printResult(moverCase, set, result);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,198 @@
+//
+// Copyright (c) 2017 Wuhan Collaborative Robot Technology Co.,Ltd. All rights reserved.
+//
+
+/**
+ * 六维力滤波器组的一致性和耗时测试。
+ *
+ * 用随机力信号比较两组实现:
+ *   - WrenchIirFilter 与 ForceController 中 Simulink 生成的逐轴 DiscreteTransferFcn(状态交错存放)
+ *   - WrenchExponentialFilter 与原来按 std::vector 逐轴计算的 ExponentialFilter
+ * 输出逐位不一致的采样个数(应为 0)和每个采样(6 个轴)的平均耗时，以及占 1 kHz 控制周期的比例。
+ * 滤波系数读取 ForceControlSolver 配置中的 filter_param。
+ *
+ * 用法: test_wrench_filter_benchmark [采样个数] [ForceControlSolver 配置文件]
+ */
+
+#include <cobotsys.h>
+#include <extra2.h>
+#include <cobotsys_wrench_filter.h>
+#include <QJsonArray>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace cobotsys;
+typedef std::chrono::steady_clock BenchClock;
+
+namespace {
+const double CONTROL_PERIOD_NS = 1e6; // 1 kHz
+
+/**
+ * ForceController::step 中 DiscreteTransferFcn 的原样逐轴实现
+ */
+class ReferenceIirFilter {
+public:
+    ReferenceIirFilter(const double num[3], const double den[3]) {
+        for (int i = 0; i < 3; i++) {
+            m_num[i] = num[i];
+            m_den[i] = den[i];
+        }
+        for (auto& state : m_states)
+            state = 0;
+    }
+
+    void filter(const double input[6], double output[6]) {
+        double tmp[6];
+        for (int i = 0; i < 6; i++) {
+            int memOffset = i << 1;
+            double w = ((input[i] - m_den[1] * m_states[memOffset]) - m_states[memOffset + 1] * m_den[2]) / m_den[0];
+            tmp[i] = w;
+            w *= m_num[0];
+            w += m_num[1] * m_states[memOffset];
+            w += m_states[memOffset + 1] * m_num[2];
+            output[i] = w;
+        }
+        for (int i = 0; i < 6; i++) {
+            int memOffset = i << 1;
+            m_states[memOffset + 1] = m_states[memOffset];
+            m_states[memOffset] = tmp[i];
+        }
+    }
+
+protected:
+    double m_num[3];
+    double m_den[3];
+    double m_states[12];
+};
+
+/**
+ * 原 ExponentialFilter 的逐轴实现，每次调用都要拷贝 std::vector
+ */
+class ReferenceExponentialFilter {
+public:
+    explicit ReferenceExponentialFilter(float factor) : m_first(true), m_factor(factor), m_value(6) {}
+
+    void filter(std::vector<double>& source, std::vector<double>& result) {
+        result.resize(6);
+        if (m_first) {
+            m_value = source;
+            m_first = false;
+        } else {
+            for (size_t i = 0; i < 6; i++)
+                m_value.at(i) += m_factor * (source.at(i) - m_value.at(i));
+        }
+        result = m_value;
+    }
+
+protected:
+    bool m_first;
+    float m_factor;
+    std::vector<double> m_value;
+};
+
+void printCost(const std::string& name, BenchClock::duration elapsed, size_t count) {
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count() / count;
+    std::cout << std::setw(28) << std::left << name << std::right
+              << std::setw(10) << ns << " ns/sample, "
+              << std::setprecision(4) << std::setw(8) << ns / CONTROL_PERIOD_NS * 100 << " % of 1 kHz period"
+              << std::setprecision(2) << std::endl;
+}
+
+/**
+ * 防止编译器把没有用到的结果优化掉
+ */
+double g_sink = 0;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    std::string configPath = argc > 2 ? argv[2] : "CONFIG/ForceControlConfig/force_control_solver_config.json";
+
+    double num[3] = {0.79519990113706318, 0.1868726045543786, 0.48976439578823106};
+    double den[3] = {1.0, 0.3815584570930084, 0.76551678814900237};
+    QJsonObject json;
+    if (loadJson(json, configPath)) {
+        std::vector<double> values = readRealArray(json["filter_param"].toObject()["num"]);
+        for (size_t i = 0; i < 3 && i < values.size(); i++)
+            num[i] = values[i];
+        values = readRealArray(json["filter_param"].toObject()["den"]);
+        for (size_t i = 0; i < 3 && i < values.size(); i++)
+            den[i] = values[i];
+    } else {
+        COBOT_LOG.warning("FilterBench") << "Fail to load " << configPath << ", use default filter_param";
+    }
+
+    // 力传感器读数: 慢变的外力加噪声
+    std::vector<double> input(count * 6);
+    std::mt19937 generator(1);
+    std::normal_distribution<double> noise(0, 0.5);
+    for (size_t k = 0; k < count; k++) {
+        for (int i = 0; i < 6; i++)
+            input[k * 6 + i] = 10 * std::sin(0.001 * k + i) + noise(generator);
+    }
+
+    std::vector<double> reference(count * 6);
+    std::vector<double> result(count * 6);
+
+    // IIR
+    ReferenceIirFilter referenceIir(num, den);
+    auto start = BenchClock::now();
+    for (size_t k = 0; k < count; k++)
+        referenceIir.filter(&input[k * 6], &reference[k * 6]);
+    auto referenceIirTime = BenchClock::now() - start;
+
+    WrenchIirFilter iir;
+    iir.setCoefficients(num, den);
+    start = BenchClock::now();
+    for (size_t k = 0; k < count; k++)
+        iir.filter(&input[k * 6], &result[k * 6]);
+    auto iirTime = BenchClock::now() - start;
+
+    size_t iirMismatch = 0;
+    for (size_t k = 0; k < count; k++) {
+        if (std::memcmp(&reference[k * 6], &result[k * 6], sizeof(double) * 6) != 0)
+            iirMismatch++;
+    }
+
+    // 指数平滑
+    const float factor = 0.1f;
+    ReferenceExponentialFilter referenceExponential(factor);
+    std::vector<double> source(6), filtered(6);
+    start = BenchClock::now();
+    for (size_t k = 0; k < count; k++) {
+        source.assign(&input[k * 6], &input[k * 6] + 6);
+        referenceExponential.filter(source, filtered);
+        std::copy(filtered.begin(), filtered.end(), &reference[k * 6]);
+    }
+    auto referenceExponentialTime = BenchClock::now() - start;
+
+    WrenchExponentialFilter exponential(factor);
+    start = BenchClock::now();
+    for (size_t k = 0; k < count; k++)
+        exponential.filter(&input[k * 6], &result[k * 6]);
+    auto exponentialTime = BenchClock::now() - start;
+
+    size_t exponentialMismatch = 0;
+    for (size_t k = 0; k < count; k++) {
+        if (std::memcmp(&reference[k * 6], &result[k * 6], sizeof(double) * 6) != 0)
+            exponentialMismatch++;
+    }
+
+    for (auto value : result)
+        g_sink += value;
+
+    std::cout << "samples: " << count << ", num: " << num[0] << " " << num[1] << " " << num[2]
+              << ", den: " << den[0] << " " << den[1] << " " << den[2] << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    printCost("ForceController filter", referenceIirTime, count);
+    printCost("WrenchIirFilter", iirTime, count);
+    printCost("ExponentialFilter", referenceExponentialTime, count);
+    printCost("WrenchExponentialFilter", exponentialTime, count);
+    std::cout << "mismatch iir: " << iirMismatch << ", exponential: " << exponentialMismatch << std::endl;
+    return (iirMismatch == 0 && exponentialMismatch == 0) ? 0 : 1;
+}